@@ -0,0 +1,176 @@
+// =============================================================================
+/**
+ * A test of the catcher's attach mode.  A child process mallocs an array,
+ * fills it, and then touches every page of it in a loop; once it is running,
+ * the catcher attaches to it for a while, and the trace it leaves must hold
+ * faults on the array, which the child allocated before the catcher came.
+ * Run it from the directory of the catcher and the manager:
+ *
+ *   VMT_SIZE=64 ./attach_test [<seconds>]
+ */
+// =============================================================================
+
+
+
+// =============================================================================
+// INCLUDES
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+// =============================================================================
+
+
+
+// =============================================================================
+// MACROS AND CONSTANTS
+
+/** The size of a page. */
+#define PAGE_SIZE 4096
+
+/** The number of pages in the child's array. */
+#define PAGES 256
+
+/** The name of the trace, to which the catcher adds the child's process ID. */
+#define TRACE_NAME "attach_test.csv"
+
+/** How long the catcher stays attached, in seconds, when no time is given. */
+#define DEFAULT_SECONDS "1"
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Fill an array, tell the parent where it is, and touch every page of
+ *         it, a pass each millisecond, until killed.
+ * \param  ready The pipe on which to send the array's address.
+ */
+static void touch_pages (int ready)
+{
+
+  // Under Yama, only an ancestor may attach, unless it is allowed.
+  prctl(PR_SET_PTRACER, PR_SET_PTRACER_ANY, 0, 0, 0);
+
+  volatile char* array = malloc(PAGES * PAGE_SIZE);
+  if (array == NULL) {
+    fprintf(stderr, "ERROR: malloc failed\n");
+    exit(1);
+  }
+  memset((char*)array, 1, PAGES * PAGE_SIZE);
+  uintptr_t address = (uintptr_t)array;
+  if (write(ready, &address, sizeof(address)) != sizeof(address)) {
+    exit(1);
+  }
+  close(ready);
+
+  struct timespec pause = { 0, 1000000 };
+  while (1) {
+    for (size_t page = 0; page < PAGES; ++page) {
+      array[page * PAGE_SIZE] += 1;
+    }
+    nanosleep(&pause, NULL);
+  }
+
+} // touch_pages ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Count the faults of a trace on a range of pages.
+ * \param  name  The trace's file name.
+ * \param  start The first page.
+ * \param  end   The end of the last page.
+ * \return The number of faults, or -1 if the trace cannot be read.
+ */
+static long count_faults (const char* name, uintptr_t start, uintptr_t end)
+{
+
+  FILE* trace = fopen(name, "r");
+  if (trace == NULL) {
+    return -1;
+  }
+  long               faults = 0;
+  char               line[256];
+  unsigned long long page;
+  char               kind;
+  while (fgets(line, sizeof(line), trace) != NULL) {
+    if (sscanf(line, "%llx,%*u,%*d,%*u,%c", &page, &kind) == 2 && kind == 'F' && page >= start && page < end) {
+      faults += 1;
+    }
+  }
+  fclose(trace);
+  return faults;
+
+} // count_faults ()
+// =============================================================================
+
+
+
+// =============================================================================
+int main (int argc, char** argv)
+{
+
+  const char* seconds = (argc > 1) ? argv[1] : DEFAULT_SECONDS;
+  if (atoi(seconds) < 1) {
+    fprintf(stderr, "USAGE: %s [<seconds>]\n", argv[0]);
+    return 1;
+  }
+
+  int ready[2];
+  if (pipe(ready) == -1) {
+    fprintf(stderr, "ERROR: pipe failed\n");
+    return 1;
+  }
+  pid_t child = fork();
+  if (child == 0) {
+    close(ready[0]);
+    touch_pages(ready[1]);
+  }
+  close(ready[1]);
+  uintptr_t array;
+  if (child == -1 || read(ready[0], &array, sizeof(array)) != sizeof(array)) {
+    fprintf(stderr, "ERROR: the child did not start\n");
+    return 1;
+  }
+  close(ready[0]);
+
+  // The catcher attaches, traces for the time given, and detaches.
+  char pid[16];
+  snprintf(pid, sizeof(pid), "%d", (int)child);
+  setenv("VMT_TRACENAME", TRACE_NAME, 1);
+  pid_t catcher = fork();
+  if (catcher == 0) {
+    execl("./catcher", "./catcher", "-p", pid, "-t", seconds, (char*)NULL);
+    fprintf(stderr, "ERROR: ./catcher could not be run\n");
+    _exit(127);
+  }
+  int status = 0;
+  waitpid(catcher, &status, 0);
+  kill(child, SIGKILL);
+  waitpid(child, NULL, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    printf("FAILED: the catcher exited with status %d\n", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+    return 1;
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), "attach_test.%d.csv", (int)child);
+  long faults = count_faults(name, array & ~(uintptr_t)(PAGE_SIZE - 1), array + PAGES * PAGE_SIZE);
+  if (faults <= 0) {
+    printf("FAILED: %s holds %s\n", name, (faults == 0) ? "no faults on the array" : "nothing; it cannot be read");
+    return 1;
+  }
+  printf("ok: %ld faults on the array in %s\n", faults, name);
+  return 0;
+
+} // main ()
+// =============================================================================
@@ -0,0 +1,258 @@
+/* =============================================================================================================================== */
+/**
+ * \file capture.c
+ * \brief Snapshots of evicted pages, annotated in the trace with what they compress to and the hash of their contents.
+ *
+ * For studies of compressed caching done offline, without page images: each page that the manager evicts is copied into a ring,
+ * and a thread of the manager's own compresses each copy with the codec of the compressed cache (see `lz.c`), checks whether it
+ * is one word over and over (see `samefill.c`), and hashes it, so that duplicate contents can be found.  It appends the result
+ * to the trace, as an annotation of the page, from its own stream.  Eviction then costs a copy; a page evicted while the ring
+ * is full is not annotated, and is counted.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <stdint.h>      // For uint64_t
+#include <string.h>      // For memcpy()
+#include <time.h>        // For nanosleep()
+
+#include "capture.h"
+#include "lz.h"
+#include "samefill.h"
+#include "vmt_mman.h"
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS and CONSTANTS */
+
+/** How long the annotating thread sleeps when the ring is empty, in nanoseconds. */
+#define IDLE_NS 1000000
+
+/** Room for the compressed bytes of any page, however little it compresses. */
+#define COMPRESSED_CAPACITY (CAPTURE_PAGE_SIZE + CAPTURE_PAGE_SIZE / 255 + 64)
+
+/** The primes of XXH64. */
+#define PRIME1 11400714785074694791ULL
+#define PRIME2 14029467366897019727ULL
+#define PRIME3  1609587929392839161ULL
+#define PRIME4  9650029242287828579ULL
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Take or release a spin lock.  Every caller has every signal blocked, so that no thread takes one twice.
+ */
+static void capture_lock (volatile int* lock) {
+
+  while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE) != 0) {
+    while (__atomic_load_n(lock, __ATOMIC_RELAXED) != 0) {
+      __builtin_ia32_pause();
+    }
+  }
+
+} // capture_lock ()
+
+static void capture_unlock (volatile int* lock) {
+
+  __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+
+} // capture_unlock ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  The steps of XXH64: mix a word into a lane, and merge a lane into the hash.
+ */
+static inline uint64_t rotl64 (uint64_t x, int r) {
+
+  return (x << r) | (x >> (64 - r));
+
+} // rotl64 ()
+
+static inline uint64_t xxh64_round (uint64_t acc, uint64_t input) {
+
+  acc = acc + input * PRIME2;
+  acc = rotl64(acc, 31);
+  return acc * PRIME1;
+
+} // xxh64_round ()
+
+static inline uint64_t xxh64_merge (uint64_t hash, uint64_t lane) {
+
+  hash = hash ^ xxh64_round(0, lane);
+  return hash * PRIME1 + PRIME4;
+
+} // xxh64_merge ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+uint64_t capture_hash (const void* buffer, size_t size) {
+
+  const uint8_t* p     = buffer;
+  uint64_t       v1    = PRIME1 + PRIME2;
+  uint64_t       v2    = PRIME2;
+  uint64_t       v3    = 0;
+  uint64_t       v4    = -PRIME1;
+
+  for (size_t i = 0; i < size; i = i + 32) {
+    uint64_t words[4];
+    memcpy(words, p + i, sizeof(words));
+    v1 = xxh64_round(v1, words[0]);
+    v2 = xxh64_round(v2, words[1]);
+    v3 = xxh64_round(v3, words[2]);
+    v4 = xxh64_round(v4, words[3]);
+  }
+
+  uint64_t hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+  hash = xxh64_merge(hash, v1);
+  hash = xxh64_merge(hash, v2);
+  hash = xxh64_merge(hash, v3);
+  hash = xxh64_merge(hash, v4);
+  hash = hash + size;
+
+  hash = hash ^ (hash >> 33);
+  hash = hash * PRIME2;
+  hash = hash ^ (hash >> 29);
+  hash = hash * PRIME3;
+  return hash ^ (hash >> 32);
+
+} // capture_hash ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+bool capture_create (capture_s* capture, tracebuf_s* trace) {
+
+  memset(capture, 0, sizeof(capture_s));
+  capture->trace = trace;
+  capture->slots = vmt_malloc(CAPTURE_SLOTS * sizeof(capture_slot_s));
+  if (capture->slots == NULL) {
+    return false;
+  }
+  return true;
+
+} // capture_create ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+bool capture_page (capture_s* capture, const void* page) {
+
+  bool taken = false;
+
+  capture_lock(&capture->lock);
+  if (capture->stopped == false && capture->head - __atomic_load_n(&capture->tail, __ATOMIC_ACQUIRE) < CAPTURE_SLOTS) {
+    capture_slot_s* slot = &capture->slots[capture->head % CAPTURE_SLOTS];
+    slot->page = (uintptr_t) page;
+    memcpy(slot->contents, page, CAPTURE_PAGE_SIZE);
+    __atomic_store_n(&capture->head, capture->head + 1, __ATOMIC_RELEASE);
+    capture->captured++;
+    taken = true;
+  } else {
+    capture->dropped++;
+  }
+  capture_unlock(&capture->lock);
+
+  return taken;
+
+} // capture_page ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Annotate the snapshots in the ring, under the annotating lock.
+ * \return The number annotated.
+ */
+static size_t annotate (capture_s* capture, tracebuf_stream_s* stream) {
+
+  uint8_t  compressed[COMPRESSED_CAPACITY];
+  uint64_t head  = __atomic_load_n(&capture->head, __ATOMIC_ACQUIRE);
+  size_t   count = 0;
+
+  for (uint64_t tail = capture->tail; tail != head; tail++) {
+    capture_slot_s* slot = &capture->slots[tail % CAPTURE_SLOTS];
+    uint64_t        word;
+    uint32_t        size = (uint32_t) lz_compress(slot->contents, CAPTURE_PAGE_SIZE, compressed, sizeof(compressed));
+    if (samefill_check(slot->contents, CAPTURE_PAGE_SIZE, &word)) {
+      size = size | TRACEBUF_CAPTURE_FILLED;
+    }
+    tracebuf_annotate(capture->trace, stream, slot->page, size, capture_hash(slot->contents, CAPTURE_PAGE_SIZE));
+    __atomic_store_n(&capture->tail, tail + 1, __ATOMIC_RELEASE);
+    count++;
+  }
+  return count;
+
+} // annotate ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+void* capture_run (void* capture_ptr) {
+
+  capture_s*         capture = capture_ptr;
+  tracebuf_stream_s* stream  = tracebuf_open(capture->trace);
+  struct timespec    idle    = { 0, IDLE_NS };
+
+  while (true) {
+    capture_lock(&capture->annotate_lock);
+    if (capture->stopped == true) {
+      capture_unlock(&capture->annotate_lock);
+      return NULL;
+    }
+    size_t count = annotate(capture, stream);
+    capture_unlock(&capture->annotate_lock);
+    if (count == 0) {
+      nanosleep(&idle, NULL);
+    }
+  }
+
+} // capture_run ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+void capture_stop (capture_s* capture, tracebuf_stream_s* stream) {
+
+  capture_lock(&capture->annotate_lock);
+  capture_lock(&capture->lock);
+  capture->stopped = true;
+  capture_unlock(&capture->lock);
+  annotate(capture, stream);
+  capture_unlock(&capture->annotate_lock);
+
+} // capture_stop ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+void capture_fork_child (capture_s* capture) {
+
+  capture->lock          = 0;
+  capture->annotate_lock = 0;
+  capture->head          = 0;
+  capture->tail          = 0;
+  capture->captured      = 0;
+  capture->dropped       = 0;
+  capture->stopped       = false;
+
+} // capture_fork_child ()
+/* =============================================================================================================================== */
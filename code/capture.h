@@ -0,0 +1,123 @@
+/* =============================================================================================================================== */
+/**
+ * \file capture.h
+ * \brief Snapshots of evicted pages, annotated in the trace with what they compress to and the hash of their contents.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#if !defined (_CAPTURE_H)
+#define _CAPTURE_H
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tracebuf.h"
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS */
+
+/** The number of snapshots that may await their annotation. */
+#define CAPTURE_SLOTS     256
+
+/** The size of a snapshot: a page. */
+#define CAPTURE_PAGE_SIZE 4096
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* TYPES */
+
+/** One snapshot. */
+typedef struct capture_slot_struct {
+  uintptr_t page;
+  uint8_t   contents[CAPTURE_PAGE_SIZE];
+} capture_slot_s;
+
+/**
+ * The snapshots awaiting their annotation, in a ring: threads that evict pages fill the slot at `head`, under `lock`, while
+ * there is room, and the annotating thread empties the slot at `tail`, under `annotate_lock`, which it holds only while it
+ * works.  A slot between `tail` and `head` belongs to the annotating thread alone.
+ */
+typedef struct capture_struct {
+  tracebuf_s*       trace;
+  capture_slot_s*   slots;
+  volatile uint64_t head;
+  volatile uint64_t tail;
+  volatile int      lock;
+  volatile int      annotate_lock;
+  volatile bool     stopped;
+  volatile uint64_t captured;  // Snapshots taken.
+  volatile uint64_t dropped;   // Pages not taken, the ring being full.
+} capture_s;
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* FUNCTIONS */
+
+/**
+ * \brief  Create an empty ring of snapshots.
+ * \param  capture The ring.
+ * \param  trace   The trace that receives the annotations.
+ * \return Whether the ring could be allocated.
+ */
+bool capture_create (capture_s* capture, tracebuf_s* trace);
+
+/**
+ * \brief  Take a snapshot of a page as it is evicted; it is annotated later, in the background.  Safe to call from a signal
+ *         handler, with every signal blocked.
+ * \param  capture The ring.
+ * \param  page    The page, readable, `CAPTURE_PAGE_SIZE` bytes.
+ * \return Whether the snapshot was taken; `false` if the ring was full.
+ */
+bool capture_page (capture_s* capture, const void* page);
+
+/**
+ * \brief  Annotate snapshots as they come, until the ring is stopped; the start routine of a thread, with every signal blocked.
+ * \param  capture The ring.
+ * \return `NULL`, once the ring is stopped.
+ */
+void* capture_run (void* capture);
+
+/**
+ * \brief  Annotate what snapshots remain, in the caller's stream, and stop the ring: snapshots are no longer taken.
+ * \param  capture The ring.
+ * \param  stream  The calling thread's stream.
+ */
+void capture_stop (capture_s* capture, tracebuf_stream_s* stream);
+
+/**
+ * \brief  Restart the ring, empty, in the child of a fork (), where the thread that held its locks does not exist.
+ * \param  capture The ring.
+ */
+void capture_fork_child (capture_s* capture);
+
+/**
+ * \brief  Hash a buffer with XXH64 (seed 0).
+ * \param  buffer The buffer.
+ * \param  size   Its size; a multiple of 32.
+ * \return The hash.
+ */
+uint64_t capture_hash (const void* buffer, size_t size);
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#endif /* _CAPTURE_H */
+/* =============================================================================================================================== */
@@ -3,13 +3,31 @@
  * System Call Catcher
  *
  * Forks and runs itself as parent and the benchmark with the manager as the
- * child Child is stopped every time it enters or exits a system call, where we
- * can examine or change the registers of the child Information on all the system
- * calls is stored inside the table.
+ * child. A seccomp filter, generated from the table, stops the child only when
+ * it enters a system call that passes pointers, where we can examine or change
+ * the registers of the child. Every other system call runs without a stop.
+ * Information on all the system calls is stored inside the table, in
+ * syscall_table.h.
  *
- * Current buggs/issues:
- * - Does not work on multithreaded programs yet.
- * - I have not implemented `mmap` and `break` outcall handling.
+ * The exits of `mmap`, `brk`, `mprotect` and `rt_sigaction` are stopped on
+ * too, and sent to the manager's exit handlers with their result. `munmap` is
+ * sent to its handler on entry instead, before the pages can be mapped again
+ * by another thread.
+ *
+ * Every thread is followed, each with its own state and its own slot in the
+ * channel, so that several can be in the manager at once. So is every process
+ * the program starts, with fork (), vfork () or clone (), and every program it
+ * executes: one catcher supervises them all from a single `waitpid (-1)`
+ * loop, and may start several programs at once. Each exec () is given the
+ * manager and its settings again, should the program have changed its
+ * environment.
+ *
+ * With `-p`, the catcher attaches to a program that is already running
+ * instead, for a window of time or of faults: it seizes every thread, loads
+ * the manager into the program with a dlopen () that it has the program call,
+ * and stops every thread on every system call (there is no filter) until the
+ * window is over. It then stops every thread outside the manager, has the
+ * manager unprotect the program's memory, and lets the program go.
  *
  * @author Luka Duranovic
  * @date   Monday, November 22, 2021
@@ -21,584 +39,1499 @@
 // =============================================================================
 // INCLUDES
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
 #include <string.h>
 #include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <limits.h>
+#include <errno.h>
+#include <sched.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <sys/time.h>
 #include <sys/mman.h>
 #include <sys/wait.h>
 #include <sys/ptrace.h>
 #include <sys/user.h>
+#include <sys/syscall.h>
+#include "syscall_table.h"
+#include "syscall_filter.h"
+#include "channel.h"
+#include "syscall_log.h"
+#include <linux/futex.h>
 // =============================================================================
 
 
 
 // =============================================================================
-// SYSTEM CALL TABLE
+// MACROS
 
-/**
- * We are tracking what to do with each system call.
- * Possible values:
- *   - `-1` means string.
- *   - `0` means not a string or a struct.
- *   - `>1` is a struct, and the value represents the size of the struct.
- * Values with names need to be replaced with sizes.
- * Information found on "https://filippo.io/linux-syscall-table/".
- *
- * NOTE: Have to figure out what to do with `void` pointers.
- * TODO: Values with names need to be replaced with sizes.
- */
-static const int table[314][6] = {
-
-	// 1. `read`
-	{0,-1,0,0,0,0},
-
-	// 2. `write`
-	{0,-1,0,0,0,0},
-
-	// 3. `open`
-	{-1,0,0,0,0,0},
-
-	// 4. `close`
-	{0,0,0,0,0,0},
-	{-1,-1,0,0,0,0},//        5. stat
-	{0,-1,0,0,0,0},//         6. fstat
-	{-1,-1,0,0,0,0},//        7. lstat
-	{1/*sizeof(pollfd__user)*/,0,0,0,0,0},//poll
-	{0,0,0,0,0,0},//lseek
-	{0,0,0,0,0,0},//mmap
-	{0,0,0,0,0,0},//mprotect
-	{0,0,0,0,0,0},//munmap
-	{0,0,0,0,0,0},//brk
-	{0,1,1/*sizeof(sigaction__user),sizeof(sigaction__user)*/,0,0,0},//rt_sigaction
-	{0,1,1/*sizeof(sigset_t__user),sizeof(sigset_t__user)*/,0,0,0},//rt_sigprocmask
-	{0,0,0,0,0,0},//rt_sigreturn
-	{0,0,0,0,0,0},//ioctl
-	{0,-1,0,0,0,0},//pread64
-	{0,-1,0,0,0,0},//pwrite64
-	{0,1/*sizeof(iovec__user)*/,0,0,0,0},//readv
-	{0,1/*sizeof(iovec__user)*/,0,0,0,0},//writev
-	{-1,0,0,0,0,0},//access
-	{1/*int__user*/,0,0,0,0,0},//pipe
-	{0,1/*sizeof(fd_set__user)*/,1/*same*/,1/*same*/,1/*sizeof(timeval_user)*/,0},//select
-	{0,0,0,0,0,0},//sched_yield
-	{0,0,0,0,0,0},//mremap
-	{0,0,0,0,0,0},//msync
-	{0,0,1/*sizeof(unsigned char__user)*/,0,0,0},//mincore
-	{0,0,0,0,0,0},//madvise
-	{0,0,0,0,0,0},//shmget
-	{0,1/*sizeof(char__user)*/,0,0,0,0},//shmat
-	{0,0,1/*sizeof(shmid_ds__user)*/,0,0,0},//shmctl
-	{0,0,0,0,0,0},//dup
-	{0,0,0,0,0,0},//dup2
-	{0,0,0,0,0,0},//pause
-	{1/*sizeof(timespec__user)*/,1/*same*/,0,0,0,0},//nanosleep
-	{0,1/*sizeof(itimerval__user)*/,0,0,0,0},//getitimer
-	{0,0,0,0,0,0},//alarm
-	{0,1/*sizeof(itimerval__user)*/,1/*same*/,0,0,0},//setitimer
-	{0,0,0,0,0,0},//getpid
-	{0,0,1/*sizeof(loff_t__user)*/,0,0,0},//sendfile
-	{0,0,0,0,0,0},//socket
-	{0,1/*sizeof(sockaddr__user*)*/,0,0,0,0},//connect
-	{0,1/*sizeof(sockaddr__user)*/,1/*sizeof(int__user*/,0,0,0},//accept
-	{0,1/*sizeof(void__user)*/,0,0,1/*sizeof(sockaddr_user)*/,0},//sendto
-	{0,1/*sizeof(void__user)*/,0,0,1/*sizeof(sockaddr__user)*/,1/*sizeof(int__user)*/},//recvfrom
-	{0,1/*sizeof(msghdr__user)*/,0,0,0,0},//sendmsg
-	{0,1/*sizeof(msghdr__user)*/,0,0,0,0},//recvmsg
-	{0,0,0,0,0,0},//shutdown
-	{0,1/*sizeof(sockaddr__user)*/,0,0,0,0},//bind
-	{0,0,0,0,0,0},//listen
-	{0,1/*sizeof(sockaddr__user)*/,1/*sizeof(int__user)*/,0,0,0},//getsockname
-	{0,1/*sizeof(sockaddr__user)*/,1/*sizeof(int__user)*/,0,0,0},//getpeername
-	{0,0,0,1/*sizeof(int__user)*/,0,0},//socketpair
-	{0,0,0,-1,0,0},//setsockopt
-	{0,0,0,-1,1/*sizeof(int_user)*/,0},//getsockopt
-	{0,0,0,1/*int__user*/,1/*int__user*/,0},//clone
-	{0,0,0,0,0,0},//fork
-	{0,0,0,0,0,0},//vfork
-	{-1,1/*help*/,1/*help*/,0,0,0},//execv
-	{0,0,0,0,0,0},//exit
-	{0,1/*int__user*/,0,1/*rusage__user*/,0,0},//wait4
-	{0,0,0,0,0,0},//kill
-	{1/*new_utsname__user*/,0,0,0,0,0},//uname
-	{0,0,0,0,0,0},//semget
-	{0,1/*sembuf__user*/,0,0,0,0},//semop
-	{0,0,0,0,0,0},//semctl
-	{-1,0,0,0,0,0},//shmdt
-	{0,0,0,0,0,0},//msgget
-	{0,1/*msgbuf__user*/,0,0,0,0},//msgsnd
-	{0,1/*msgbuf__user*/,0,0,0,0},//msgrcv
-	{0,0,1/*msqid_ds__user*/,0,0,0},//msgctl
-	{0,0,0,0,0,0},//fcntl
-	{0,0,0,0,0,0},//flock
-	{0,0,0,0,0,0},//fsync
-	{0,0,0,0,0,0},//fdatasync
-	{-1,0,0,0,0,0},//truncate
-	{0,0,0,0,0,0},//ftruncate
-	{0,1/*linux_dirent__user*/,0,0,0,0},//getdents
-	{-1,0,0,0,0,0},//getcwd
-	{-1,0,0,0,0,0},//chdir
-	{0,0,0,0,0,0},//fchdir
-	{-1,-1,0,0,0,0},//rename
-	{-1,0,0,0,0,0},//mkdir
-	{-1,0,0,0,0,0},//rmdir
-	{-1,0,0,0,0,0},//creat
-	{-1,-1,0,0,0,0},//link
-	{-1,0,0,0,0,0},//unlink
-	{-1,-1,0,0,0,0},//symlink
-	{-1,-1,0,0,0,0},//readlink
-	{-1,0,0,0,0,0},//chmod
-	{0,0,0,0,0,0},//fchmod
-	{-1,0,0,0,0,0},//chown
-	{0,0,0,0,0,0},//fchown
-	{-1,0,0,0,0,0},//lchown
-	{0,0,0,0,0,0},//umask
-	{1/*timeval__user*/,1/*timexone__user*/,0,0,0,0},//gettimeofday
-	{0,1/*rlimit__user*/,0,0,0,0},//getrlimit
-	{0,1/*rusage__user*/,0,0,0,0},//getrusage
-	{1/*sysinfo__user*/,0,0,0,0,0},//sysinfo
-	{1/*tms__user*/,0,0,0,0,0},//times
-	{0,0,0,0,0,0},//ptrace
-	{0,0,0,0,0,0},//getuid
-	{0,0,-1,0,0,0},//syslog
-	{0,0,0,0,0,0},//getgid
-	{0,0,0,0,0,0},//setuid
-	{0,0,0,0,0,0},//setgid
-	{0,0,0,0,0,0},//geteuid
-	{0,0,0,0,0,0},//getegid
-	{0,0,0,0,0,0},//setpgid
-	{0,0,0,0,0,0},//getppid
-	{0,0,0,0,0,0},//getpgrp
-	{0,0,0,0,0,0},//setsid
-	{0,0,0,0,0,0},//setreuid
-	{0,0,0,0,0,0},//setregid
-	{0,1/*gid_t__user*/,0,0,0,0},//getgroups
-	{0,1/*gid_t__user*/,0,0,0,0},//setgroups
-	{0,0,0,0,0,0},//setresuid
-	{1/*uid_t__user*/,1/*same*/,1/*same*/,0,0,0},//getresuid
-	{0,0,0,0,0,0},//setresgid
-	{1/*gid_t__user*/,1/*same*/,1/*same*/,0,0,0},//getresgid
-	{0,0,0,0,0,0},//getpgid
-	{0,0,0,0,0,0},//setfsuid
-	{0,0,0,0,0,0},//setfsgid
-	{0,0,0,0,0,0},//getsid
-	{0,0,0,0,0,0},//capget
-	{0,0,0,0,0,0},//capset
-	{1/*sigset_t__user*/,0,0,0,0,0},//rt_sigpending
-	{1/*sigset_t__user*/,1/*siginfo_r__user*/,1/*timespec__user*/,0,0,0},//sigtimedwait
-	{0,0,1/*siginfo_r__user*/,0,0,0},//trsigqueueinfo
-	{1/*sigset_t__user*/,0,0,0,0,0},//rt_sigsuspend
-	{1/*stack_t__user*/,1/*stack_t__user*/,0,0,0,0},//sigaltstack
-	{-1,1/*utimbuf__user*/,0,0,0,0},//utime
-	{-1,0,0,0,0,0},//mknod
-	{-1,0,0,0,0,0},//uselib
-	{0,0,0,0,0,0},//personality
-	{0,1/*ustat__user*/,0,0,0,0},//ustat
-	{-1,1/*statfs__user*/,0,0,0,0},//statfs
-	{0,1/*statfs_user*/,0,0,0,0},//fstatfs
-	{0,0,0,0,0,0},//sysfs
-	{0,0,0,0,0,0},//getpriority
-	{0,0,0,0,0,0},//setpriority
-	{0,1/*sched_param__user*/,0,0,0,0},//sched_getparam
-	{0,1/*sched_param__user*/,0,0,0,0},//sched_getparam
-	{0,0,1/*sched_param__user*/,0,0,0},//sched_setscheduler
-	{0,0,0,0,0,0},//sched_getscheduler
-	{0,0,0,0,0,0},//sched_get_priority_max
-	{0,0,0,0,0,0},//sched_get_priority_min
-	{0,1/*timespec__user*/,0,0,0,0},//sched_rr_get_interval
-	{0,0,0,0,0,0},//mlock
-	{0,0,0,0,0,0},//munlock
-	{0,0,0,0,0,0},//mlockall
-	{0,0,0,0,0,0},//munlockall
-	{0,0,0,0,0,0},//vhangup
-	{0,1/*help*/,0,0,0,0},//modify_ldt
-	{-1,-1,0,0,0,0},//pivot_root
-	{1/*__sysctl_args__user*/,0,0,0,0,0},//_sysctl
-	{0,0,0,0,0,0},//prctl
-	{1/*task_struct*/,0,1/*unsigned long__user*/,0,0,0},//arch_prctl
-	{1/*timex__user*/,0,0,0,0,0},//adjtimex
-	{0,1/*rlimit__user*/,0,0,0,0},//setrlimit
-	{-1,0,0,0,0,0},//chroot
-	{0,0,0,0,0,0},//sync
-	{-1,0,0,0,0,0},//acct
-	{1/*timeval__user*/,1/*timezone__user*/,0,0,0,0},//settimeofday
-	{-1,-1,-1,0,1/*help*/,0},//mount
-	{-1,0,0,0,0,0},//umount2
-	{-1,0,0,0,0,0},//swapon
-	{-1,0,0,0,0,0},//swapoff
-	{0,0,0,0,0,1/*help*/},//reboot
-	{-1,0,0,0,0,0},//sethostname
-	{-1,0,0,0,0,0},//setdomainname
-	{0,0,0,0,0,0},//iopl
-	{0,0,0,0,0,0},//ioperm
-	{0,0,0,0,0,0},//create_module NI
-	{1/*help*/,0,-1,0,0,0},//init_module
-	{-1,0,0,0,0,0},//delete_module
-	{0,0,0,0,0,0},//get_kernel_syms NI
-	{0,0,0,0,0,0},//query_module NI
-	{0,-1,0,1/*help*/,0,0},//quotactl
-	{0,0,0,0,0,0},//nfsservctl NI
-	{0,0,0,0,0,0},//getpmsg NI
-	{0,0,0,0,0,0},//afs_syscall NI
-	{0,0,0,0,0,0},//putpmsg NI
-	{0,0,0,0,0,0},//tuxcall NI
-	{0,0,0,0,0,0},//security NI
-	{0,0,0,0,0,0},//gettid
-	{0,0,0,0,0,0},//readahead
-	{-1,-1,1/*help*/,0,0,0},//setxattr
-	{-1,-1,1/*help*/,0,0,0},//lsetxattr
-	{0,-1,1/*help*/,0,0,0},//fsetxattr
-	{-1,-1,1/*help*/,0,0,0},//getxattr
-	{-1,-1,1/*help*/,0,0,0},//lgetxattr
-	{0,-1,1/*help*/,0,0,0},//fgetxattr
-	{-1,-1,0,0,0,0},//listxattr
-	{-1,-1,0,0,0,0},//llistxattr
-	{0,-1,0,0,0,0},//flistxattr
-	{-1,1,0,0,0,0},//removexattr
-	{-1,-1,0,0,0,0},//lremovexattr
-	{0,-1,0,0,0,0},//fremovexattr
-	{0,0,0,0,0,0},//tkill
-	{1/*time_t__user*/,0,0,0,0,0},//time
-	{1/*u32__user*/,0,0,1/*timespec__user*/,1/*u32__user*/,0},//futex
-	{0,0,1/*long__user*/,0,0,0},//sched_getaffinity
-	{0,0,1/*long__user*/,0,0,0},//sched_setaffinity
-	{1/*user_desc__user*/,0,0,0,0,0},//set_thread_area
-	{0,1/*aio_context_t__user*/,0,0,0,0},//io_setup
-	{0,0,0,0,0,0},//io_destroy
-	{0,0,0,1/*io_event__user*/,1/*timespec__user*/,0},//io_getevents
-	{0,0,1/*iocb__user*__user**/,0,0,0},//io_submit
-	{0,1/*iocb__user*/,1/*io_event__user*/,0,0,0},//io_cancel
-	{1/*user_desc__user*/,0,0,0,0,0},//get_thread_area
-	{0,-1,0,0,0,0},//lookup_dcookie
-	{0,0,0,0,0,0},//epoll_create
-	{0,0,0,0,0,0},//epoll_ctl_old NI
-	{0,0,0,0,0,0},//epoll_wait_old NI
-	{0,0,0,0,0,0},//remap_file_pages
-	{0,1/*linux_dirent64__user*/,0,0,0,0},//getdents64
-	{1/*int__user*/,0,0,0,0,0},//set_tid_address
-	{0,0,0,0,0,0},//restart_syscall
-	{0,1/*sembuf__user*/,0,1/*timespec__user*/,0,0},//semtimedop
-	{0,0,0,0,0,0},//fadvise64
-	{0,1/*sigevent__user*/,1/*timer_t__user*/,0,0,0},//timer_create
-	{0,0,1/*itimerspec__user*/,1/*itimerspec__user*/,0,0},//timer_settime
-	{0,1/*itimerspec__user*/,0,0,0,0},//timer_gettime
-	{0,0,0,0,0,0},//timer_getoverrun
-	{0,0,0,0,0,0},//timer_delete
-	{0,1/*timespec__user*/,0,0,0,0},//clock_settime
-	{0,1/*timespec__user*/,0,0,0,0},//clock_gettime
-	{0,1/*timespec__user*/,0,0,0,0},//clock_getres
-	{0,0,1/*timespec__user*/,1/*timespec__user*/,0,0},//clock_nanosleep
-	{0,0,0,0,0,0},//exit_group
-	{0,1/*epoll_event__user*/,0,0,0,0},//epoll_wait
-	{0,0,0,1/*epoll_event__user*/,0,0},//epoll_ctl
-	{0,0,0,0,0,0},//tgkill
-	{-1,1/*timeval__user*/,0,0,0,0},//utimes
-	{0,0,0,0,0,0},//vserver NI
-	{0,0,0,1/*long__user*/,0,0},//mbind
-	{0,1/*long__user*/,0,0,0,0},//set_mempolicy
-	{1/*int__user*/,1/*long__user*/,0,0,0,0},//get_mempolicy
-	{-1,0,0,1/*mq_attr__user*/,0,0},//mq_open
-	{-1,0,0,0,0,0},//mq_unlink
-	{0,-1,0,0,1/*timespec__user*/,0},//mq_timesend
-	{0,-1,0,1/*int__user*/,1/*timespec__user*/,0},//mq_timedreceive
-	{0,1/*sigevent__user*/,0,0,0,0},//mq_notify
-	{0,1/*mq_attr__user*/,1/*mq_attr__user*/,0,0,0},//mq_getsetattr
-	{0,0,1/*kexec_segment__user*/,0,0,0},//kexec_load
-	{0,0,1/*siginfo__user*/,0,1/*rusage__user*/,0},//waitid
-	{-1,-1,1/*help*/,0,0,0},//add_key
-	{-1,-1,-1,0,0,0},//request_key
-	{0,0,0,0,0,0},//keyctl
-	{0,0,0,0,0,0},//ioprio_get
-	{0,0,0,0,0,0},//ionotify_init
-	{0,-1,0,0,0,0},//ionotify_add_watch
-	{0,0,0,0,0,0},//ionotify_rm_watch
-	{0,0,0,0,0,0},//migrate_pages
-	{0,0,1/*unsigned long__user*/,1/*unsigned long__user*/,0,0},
-	{0,-1,0,0,0,0},//openat
-	{0,-1,0,0,0,0},//mkdirat
-	{0,-1,0,0,0,0},//mknodat
-	{0,-1,0,0,0,0},//fchownat
-	{0,-1,1/*timeval__user*/,0,0,0},//futimesat
-	{0,-1,1/*stat__user*/,0,0,0},//newfstatat
-	{0,-1,0,0,0,0},//unlinkat
-	{0,-1,0,-1,0,0},//renameat
-	{0,-1,0,-1,0,0},//linkat
-	{-1,0,-1,0,0,0},//symlinkat
-	{0,-1,-1,0,0,0},//readlinkat
-	{0,-1,0,0,0,0},//fchmodat
-	{0,-1,0,0,0,0},//faccesat
-	{0,1/*fd_set__user*/,1/*fd_set__user*/,1/*fd_set__user*/,1/*timespec__user*/,1/*help*/},//pselect6
-	{1/*pollfd__user*/,0,1/*timespec__user*/,1/*sigset_t__user*/,0,0},//ppoll
-	{0,0,0,0,0,0},//unshare
-	{1/*robust_list_head__user*/,0,0,0,0,0},//set_robust_list
-	{0,1/*robust_list_head__user*__user**/,1/*size_t__user*/,0,0,0},//get_robust_list
-	{0,1/*loff_t__user*/,0,1/*loff_t__user*/,0,0},//splice
-	{0,0,0,0,0,0},//tee
-	{0,0,0,0,0,0},//sync_file_range
-	{0,1/*iover__user*/,0,0,0,0},//vmsplice
-	{0,0,1/*help*/,1/*int__user*/,1/*int__user*/,0},//move_pages
-	{0,-1,1/*timespec__user*/,0,0,0},//utimensat
-	{0,1/*epoll_event__user*/,0,0,1/*sigset_t__user*/,0},//epoll_pwait
-	{0,1/*sigset_t__user*/,0,0,0,0},//signalfd
-	{0,0,0,0,0,0},//timerfd_create
-	{0,0,0,0,0,0},//eventfd
-	{0,0,0,0,0,0},//fallocate
-	{0,0,1/*itimerspec__user*/,1/*itimer_spec__user*/,0,0},//timerfd_settime
-	{0,1/*itimerspec__user*/,0,0,0,0},//timerfd_gettime
-	{0,1/*sockaddr__user*/,1/*int__user*/,0,0,0},//accept4
-	{0,1/*sigset_t__user*/,0,0,0,0},//signalfd4
-	{0,0,0,0,0,0},//eventfd2
-	{0,0,0,0,0,0},//epoll_create1
-	{0,0,0,0,0,0},//dup3
-	{1/*int__user*/,0,0,0,0,0},//pipe2
-	{0,0,0,0,0,0},//inotify_init1
-	{0,1/*iovec__user*/,0,0,0,0},//preadv
-	{0,1/*iover__user*/,0,0,0,0},//pwritev
-	{0,0,0,1/*siginfo_t__user*/,0,0},//rt_tgsigqueueinfo
-	{1/*perf_event_attr__user*/,0,0,0,0,0},//perf_event_open
-	{0,1/*mmsghdr__user*/,0,0,1/*timespec__user*/,0},//recvmmsg
-	{0,0,0,0,0,0},//fanotify_init
-	{0,0,0,0,-1,0},//fanotify_mark
-	{0,0,0,0,1/*rlimit64__user*/,1/*rlimit64__user*/},//prlimit64
-	{0,-1,1/*file_handle__user*/,1/*int__user*/,0,0},//name_to_handle_at
-	{0,1/*file_handle__user*/,0,0,0,0},//open_by_handle_at
-	{0,1/*timex__user*/,0,0,0,0},//clock_adjtime
-	{0,0,0,0,0,0},//syncfs
-	{0,1/*mmsghdr__user*/,0,0,0,0},//sendmmsg
-	{0,0,0,0,0,0},//setns
-	{1/*unsigned__user*/,1/*unsigned__user*/,1/*getcpu_cache__user*/,0,0,0},//getcpu
-	{0,1/*iovec__user*/,0,1/*iovec__user*/,0,0},//process_vm_readv
-	{0,1/*iovec__user*/,0,1/*iovec__user*/,0,0},//process_vm_writev
-	{0,0,0,0,0,0},//kcmp
-	{0,-1,0,0,0,0},//finit_module
-};
+// Status of the child when it stops for a `SECCOMP_RET_TRACE` system call.
+#define SECCOMP_STOP (SIGTRAP | (PTRACE_EVENT_SECCOMP << 8))
+
+// Status of the child when it stops on exit from a system call, which it only
+// does when restarted with `PTRACE_SYSCALL`.
+#define SYSCALL_STOP (SIGTRAP | 0x80)
+
+// Size of the x86-64 red zone, which the code interrupted by a system call may
+// still be using below its stack pointer.
+#define RED_ZONE 128
+
+// Number of records of the system call log kept before they are written.
+#define LOG_RECORDS 4096
+
+// Status of a thread when it stops for one of the ptrace events it follows.
+#define EVENT_STOP(event) (SIGTRAP | ((event) << 8))
+
+// Most variables in the environment of a program that is executed, for it to
+// be given the manager's.
+#define ENVIRONMENT_MAX 4096
+
+// Environment variables that every traced program is given, as the catcher
+// has them, other than LD_PRELOAD.
+#define ENVIRONMENT_VARS 6
+
+// How often, in microseconds, the catcher checks whether the window of an
+// attached program is over.
+#define WINDOW_CHECK_US 100000
+
+// The kernel's description of a system call stop, of which the catcher needs
+// only whether it is the entry; glibc does not have it yet.
+#if !defined (PTRACE_GET_SYSCALL_INFO)
+#define PTRACE_GET_SYSCALL_INFO 0x420e
+#endif
+#define SYSCALL_INFO_ENTRY 1
+
+// How a thread is kept stopped while the catcher detaches: at the entry of a
+// system call, which runs once it is let go, or anywhere else.
+#define HELD_ENTRY 1
+#define HELD_STOP 2
 // =============================================================================
 
 
 
 // =============================================================================
-// GLOBALS
+// TYPES
 
-// Shared space used to communicate with the child.
-static int shared_fd;
-static void *shared;
+// What the catcher saw of one system call.
+struct syscall_stats {
 
-// Contains the address of functions in the child.
-struct addr_info {
+	// Stops on entry, and how long the child stayed stopped for them (from
+	// when we saw the stop to when we restarted it).
+	unsigned long stops;
+	uint64_t stopped_ns;
+	// Round trips through the walker, and how long they took, from the request
+	// to its completion.
+	unsigned long walks;
+	uint64_t walk_ns;
+	// Bytes walked, and pages unprotected, by those walks.
+	uint64_t walked;
+	uint64_t unprotected;
+
+};
 
-	void* walker;
-	void* brk;
-	void* mmap;
-	void* munmap;
-	void* mprotect;
-	void* sigaction;
+// Where a traced thread is, as far as the catcher is concerned.
+enum tracee_state {
+
+	// Running, or stopped on a system call the catcher lets through.
+	TRACEE_RUNNING = 0,
+	// Sent to the walker or an exit handler; it stops again on the wake that
+	// completes the request.
+	TRACEE_IN_MANAGER,
+	// Stopped at its start, before the event of the thread that created it has
+	// told whose manager handles it; it is held until then.
+	TRACEE_NEW,
+	// Restarted with PTRACE_SYSCALL, to stop on exit from a system call whose
+	// exit is handled, or whose walk unprotected pages.
+	TRACEE_AWAIT_EXIT,
 
 };
 
-// Contains the data to share with the child.
-struct walker_info {
+// A traced thread. Its index is that of its slot in the channel.
+struct tracee {
 
-	void* ptr;
-	int length;
+	// The thread; 0 if the entry is free.
+	pid_t tid;
+	// The process whose manager handles the thread: its own, or, for a child
+	// that shares its parent's memory until it executes a program, the
+	// parent's; 0 while unknown.
+	pid_t pid;
+	enum tracee_state state;
+	// Whether the thread is a program the catcher started, which has not yet
+	// executed it; its environment is the catcher's own.
+	int launching;
+	// Whether the system call runs once the manager is done (after a walk) or
+	// not (after an exit handler).
+	int rerun;
+	// The registers when the thread was sent to the manager, restored after.
+	struct user_regs_struct saved;
+	// The system call the manager is handling, when the request was posted, and
+	// the address of the word whose wake completes it, in the thread's memory.
+	long walk_nr;
+	uint64_t walk_start;
+	unsigned long long int done_addr;
+	// The system call whose exit is handled, and its arguments; -1 if none.
+	long exit_nr;
+	unsigned long long int exit_args[6];
+	// Whether the walk of the system call unprotected pages, which are
+	// protected again on its exit.
+	int reprotect;
+	// HELD_ENTRY or HELD_STOP once kept stopped for detaching; 0 before.
+	int held;
 
 };
+// =============================================================================
+
+
 
-// Addresses of the walker and exit handler functions in the child.
-static void *walk_struct_addr = NULL;
-static void *brk_addr = NULL;
-static void *mmap_addr = NULL;
-static void *munmap_addr = NULL;
-static void *mprotect_addr = NULL;
-static void *sigaction_addr = NULL;
+// =============================================================================
+// GLOBALS
+
+// Memory shared with the child (see channel.h).
+static struct channel *channel;
+
+// The one system call that is traced by its argument: the shared `FUTEX_WAKE`
+// with which the manager completes a request.
+static const struct syscall_filter_arg completion = { __NR_futex, 1, FUTEX_WAKE };
+
+// The manager, by absolute path, so that it is found from any directory.
+static char manager_path[PATH_MAX];
+
+// The variables that every traced program is given, as "NAME=value".
+static char *environment[ENVIRONMENT_VARS];
+static int environment_count = 0;
+
+// The traced threads.
+static struct tracee tracees[CHANNEL_SLOTS];
+
+// The program attached to with `-p`; 0 when the catcher started the program.
+// Its manager's vmt_detach (), and whether every thread is being stopped, to
+// detach.
+static pid_t attached_pid = 0;
+static unsigned long long int detach_addr = 0;
+static int draining = 0;
+
+// Set when the window of an attached program is to close early, on SIGINT or
+// SIGTERM.
+static volatile sig_atomic_t window_over = 0;
+
+// Statistics of each system call, by number.
+static struct syscall_stats stats[SYSCALL_TABLE_SIZE];
+
+// The system call log, and the records not yet written to it; -1 when there
+// is no log.
+static int log_fd = -1;
+static struct syscall_log_record log_records[LOG_RECORDS];
+static int log_count = 0;
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Catches when the child sends the addresses of the walker and exit handlers.
+ * The registration of the manager that handles a thread, as the channel has
+ * it; NULL until that manager has registered, which it does just before the
+ * program's main ().
  */
-void handler (int signum) {
+static struct channel_process *find_process (struct tracee *t) {
+
+	if (t == NULL || t->pid == 0) {
+		return NULL;
+	}
+	for (int i = 0; i < CHANNEL_PROCESSES; i++) {
+		struct channel_process *process = &channel->processes[i];
+		if (process->pid == (uint32_t) t->pid && __atomic_load_n(&process->registered, __ATOMIC_ACQUIRE)) {
+			return process;
+		}
+	}
+	return NULL;
+
+} // find_process ()
+// =============================================================================
+
 
-	if (signum == SIGUSR1) {
 
-		// Interpret the shared space as `addr_info` struct and get all the fields.
-		struct addr_info* info = (struct addr_info*) shared;
-		walk_struct_addr = info->walker;
-		brk_addr = info->brk;
-		mmap_addr = info->mmap;
-		munmap_addr = info->munmap;
-		mprotect_addr = info->mprotect;
-		sigaction_addr = info->sigaction;
+// =============================================================================
+/**
+ * Drops the registration of a process: once it has executed another program,
+ * whose manager registers anew, or, with its entry, once it has exited.
+ */
+static void forget_process (pid_t pid, int exited) {
 
+	for (int i = 0; i < CHANNEL_PROCESSES; i++) {
+		struct channel_process *process = &channel->processes[i];
+		if (process->pid == (uint32_t) pid) {
+			__atomic_store_n(&process->registered, 0, __ATOMIC_RELEASE);
+			if (exited) {
+				__atomic_store_n(&process->pid, 0, __ATOMIC_RELEASE);
+			}
+			return;
+		}
 	}
 
-} // handler ()
+} // forget_process ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * TODO: Write something meaningful here.
+ * The time on CLOCK_MONOTONIC, which the manager's trace also uses, in
+ * nanoseconds.
  */
-int main (int argc, char * argv[]) {
+static uint64_t now_ns () {
 
-	int status = 0;
-	int counter = 0;
-	int in_call = 0;
-	pid_t pid;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+} // now_ns ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Writes the records of the system call log held so far.
+ */
+static void log_flush () {
+
+	size_t size = log_count * sizeof(struct syscall_log_record);
+	const char *buffer = (const char *) log_records;
+	while (size > 0) {
+		ssize_t written = write(log_fd, buffer, size);
+		if (written == -1) {
+			perror("catcher: writing system call log");
+			close(log_fd);
+			log_fd = -1;
+			break;
+		}
+		buffer = buffer + written;
+		size = size - written;
+	}
+	log_count = 0;
+
+} // log_flush ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Adds an event to the system call log, if there is one.
+ */
+static void log_event (uint64_t time, pid_t tid, long nr, uint32_t event, uint64_t value) {
+
+	if (log_fd == -1) {
+		return;
+	}
+	struct syscall_log_record *record = &log_records[log_count];
+	record->time = time;
+	record->value = value;
+	record->tid = (uint32_t) tid;
+	record->nr = (int32_t) nr;
+	record->event = event;
+	record->unused = 0;
+	log_count++;
+	if (log_count == LOG_RECORDS) {
+		log_flush();
+	}
+
+} // log_event ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Prints the statistics of every system call the child stopped on, and their
+ * totals, on stderr, away from the output of the child.
+ */
+static void print_stats () {
+
+	struct syscall_stats total = { 0 };
+	for (int nr = 0; nr < SYSCALL_TABLE_SIZE; nr++) {
+		total.stops += stats[nr].stops;
+		total.stopped_ns += stats[nr].stopped_ns;
+		total.walks += stats[nr].walks;
+		total.walk_ns += stats[nr].walk_ns;
+		total.walked += stats[nr].walked;
+		total.unprotected += stats[nr].unprotected;
+	}
+
+	fprintf(stderr, "catcher: %lu stops (%.3f ms stopped), %lu walks (%.3f ms), %llu bytes walked, %llu pages unprotected\n",
+			total.stops, total.stopped_ns / 1e6, total.walks, total.walk_ns / 1e6,
+			(unsigned long long) total.walked, (unsigned long long) total.unprotected);
+	if (total.stops == 0) {
+		return;
+	}
+	fprintf(stderr, "%8s %10s %12s %10s %12s %14s %12s\n", "syscall", "stops", "stopped ms", "walks", "walk ms", "bytes", "pages");
+	for (int nr = 0; nr < SYSCALL_TABLE_SIZE; nr++) {
+		if (stats[nr].stops > 0) {
+			fprintf(stderr, "%8d %10lu %12.3f %10lu %12.3f %14llu %12llu\n", nr, stats[nr].stops, stats[nr].stopped_ns / 1e6,
+					stats[nr].walks, stats[nr].walk_ns / 1e6, (unsigned long long) stats[nr].walked,
+					(unsigned long long) stats[nr].unprotected);
+		}
+	}
+
+} // print_stats ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Whether the manager walks the arguments of a system call: true if the table
+ * has it walk any of them. `write` is left out, as the manager's wrapper
+ * walks its buffer (but for an attached program, whose calls the manager does
+ * not wrap), and so is `rt_sigprocmask`, which the manager itself makes
+ * around every change to a page's protection, in the middle of walks.
+ */
+static int is_walked (int nr) {
+
+	return (nr != __NR_write || attached_pid != 0) && nr != __NR_rt_sigprocmask && syscall_walks(nr);
+
+} // is_walked ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * A manager's exit handler for a system call; NULL if the system call has
+ * none, or there is no manager.
+ */
+static void *exit_handler (struct channel_process *process, long nr) {
+
+	if (process == NULL) {
+		return NULL;
+	}
+	switch (nr) {
+		case __NR_mmap:
+			return process->info.mmap;
+		case __NR_mprotect:
+			return process->info.mprotect;
+		case __NR_brk:
+			return process->info.brk;
+		case __NR_rt_sigaction:
+			return process->info.sigaction;
+		default:
+			return NULL;
+	}
+
+} // exit_handler ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Whether the child must stop on a system call: true if it is walked or has
+ * an exit handler. (The manager's completion wake is traced separately, by its
+ * argument.)
+ */
+static int is_traced (int nr) {
+
+	return is_walked(nr) || nr == __NR_mmap || nr == __NR_mprotect || nr == __NR_munmap || nr == __NR_brk || nr == __NR_rt_sigaction;
+
+} // is_traced ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Finds the entry of a traced thread, giving it one and a slot in the channel
+ * if it has none yet. Returns NULL if every slot is taken; such a thread's
+ * system calls are let through.
+ */
+static struct tracee *find_tracee (pid_t tid) {
+
+	struct tracee *free_entry = NULL;
+	for (int i = 0; i < CHANNEL_SLOTS; i++) {
+		if (tracees[i].tid == tid) {
+			return &tracees[i];
+		}
+		if (tracees[i].tid == 0 && free_entry == NULL) {
+			free_entry = &tracees[i];
+		}
+	}
+
+	if (free_entry == NULL) {
+		static int warned = 0;
+		if (!warned) {
+			fprintf(stderr, "catcher: more than %d threads; the rest are not walked\n", CHANNEL_SLOTS);
+			warned = 1;
+		}
+		return NULL;
+	}
+
+	memset(free_entry, 0, sizeof(*free_entry));
+	free_entry->tid = tid;
+	free_entry->exit_nr = -1;
+	__atomic_store_n(&channel->slots[free_entry - tracees].tid, (uint32_t) tid, __ATOMIC_RELEASE);
+	return free_entry;
+
+} // find_tracee ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Frees the entry and slot of a thread that has exited.
+ */
+static void release_tracee (pid_t tid) {
+
+	for (int i = 0; i < CHANNEL_SLOTS; i++) {
+		if (tracees[i].tid == tid) {
+			tracees[i].tid = 0;
+			__atomic_store_n(&channel->slots[i].tid, 0, __ATOMIC_RELEASE);
+			return;
+		}
+	}
+
+} // release_tracee ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Whether every traced thread is kept stopped, for detaching.
+ */
+static int all_held (void) {
+
+	for (int i = 0; i < CHANNEL_SLOTS; i++) {
+		if (tracees[i].tid != 0 && tracees[i].held == 0) {
+			return 0;
+		}
+	}
+	return 1;
+
+} // all_held ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Whether a thread stopped with PTRACE_SYSCALL is at the entry of the system
+ * call, rather than its exit.
+ */
+static int syscall_entry (pid_t tid) {
+
+	unsigned char info[128] = { 0 };
+	ptrace(PTRACE_GET_SYSCALL_INFO, tid, sizeof(info), info);
+	return info[0] == SYSCALL_INFO_ENTRY;
+
+} // syscall_entry ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Sends a stopped thread into its manager, to the function at `addr`, with the
+ * registers in `regs` (which hold its arguments). The caller has kept the
+ * thread's registers as they were in its `saved`, to be restored once the
+ * request completes.
+ */
+static void send_to_manager (struct tracee *t, struct channel_process *process, long nr, struct user_regs_struct *regs, void *addr, int rerun) {
+
+	struct channel_slot *slot = &channel->slots[t - tracees];
+
+	t->state = TRACEE_IN_MANAGER;
+	t->rerun = rerun;
+	t->walk_nr = nr;
+	t->walk_start = now_ns();
+	t->done_addr = process->self + ((uintptr_t) &slot->done - (uintptr_t) channel);
+	__atomic_store_n(&slot->request, slot->request + 1, __ATOMIC_RELEASE);
+	log_event(t->walk_start, t->tid, nr, SYSCALL_LOG_WALK, slot->request);
+
+	//set the instuction pointer to the manager's function; it is entered as if
+	//called: its frame goes below the red zone of the interrupted code, with the
+	//stack aligned as after a call
+	regs->rip = (unsigned long long int) addr;
+	regs->rsp = ((regs->rsp - RED_ZONE) & ~15ULL) - 8;
+
+	ptrace(PTRACE_SETREGS, t->tid, NULL, regs);
+
+} // send_to_manager ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * The process a thread belongs to, from /proc; the thread itself if that
+ * cannot be read.
+ */
+static pid_t read_tgid (pid_t tid) {
+
+	char path[64];
+	char line[128];
+	pid_t tgid = tid;
+	snprintf(path, sizeof(path), "/proc/%d/status", tid);
+	FILE *status = fopen(path, "r");
+	if (status == NULL) {
+		return tid;
+	}
+	while (fgets(line, sizeof(line), status) != NULL) {
+		if (sscanf(line, "Tgid: %d", &tgid) == 1) {
+			break;
+		}
+	}
+	fclose(status);
+	return tgid;
+
+} // read_tgid ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Whether the clone () or clone3 () on which a thread is stopped, at its
+ * PTRACE_EVENT_CLONE, shares the caller's memory, as a new thread does.
+ */
+static int clone_shares_memory (pid_t tid) {
 
-	//used to get register values of the child function
 	struct user_regs_struct regs;
-	//stores the original registers when we change them
-	struct user_regs_struct temp_regs;
+	ptrace(PTRACE_GETREGS, tid, NULL, &regs);
+	unsigned long long int flags = regs.rdi;
+	if (regs.orig_rax == __NR_clone3) {
+		//the flags are the first field of struct clone_args
+		errno = 0;
+		flags = ptrace(PTRACE_PEEKDATA, tid, regs.rdi, NULL);
+		if (errno != 0) {
+			return 1;
+		}
+	}
+	return (flags & CLONE_VM) != 0;
+
+} // clone_shares_memory ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Reads a string of a stopped thread into `buffer`, of `size` bytes, with
+ * PTRACE_PEEKDATA, which reads pages the manager has protected too. Returns
+ * its length, or -1 if it cannot be read or does not fit.
+ */
+static long peek_string (pid_t tid, unsigned long long int addr, char *buffer, size_t size) {
+
+	size_t length = 0;
+	while (length + sizeof(long) <= size) {
+		errno = 0;
+		long word = ptrace(PTRACE_PEEKDATA, tid, addr + length, NULL);
+		if (errno != 0) {
+			return -1;
+		}
+		memcpy(buffer + length, &word, sizeof(word));
+		char *end = memchr(buffer + length, '\0', sizeof(word));
+		if (end != NULL) {
+			return end - buffer;
+		}
+		length = length + sizeof(word);
+	}
+	return -1;
+
+} // peek_string ()
+// =============================================================================
 
-	//catcher for when child sends over the addresses of its functions
-	struct sigaction handle;
-	handle.sa_handler = handler;
-	sigaction(SIGUSR1, &handle, NULL);
 
-	//forks to exec the traced program as a child process
-	switch(pid = fork()){
+
+// =============================================================================
+/**
+ * Gives a program about to be executed the manager and the catcher's settings,
+ * which it may have dropped from its environment: the `envp` of the execve ()
+ * or execveat () the thread is stopped on is replaced by a copy, below the red
+ * zone of its stack, in which the catcher's variables replace the program's
+ * (the manager is put first in a LD_PRELOAD it already had). The copy need not
+ * outlive the call. If it cannot be made, the call is left alone.
+ */
+static void inject_environment (pid_t tid, struct user_regs_struct *regs, long nr) {
+
+	unsigned long long int *envp = (nr == __NR_execveat) ? &regs->r10 : &regs->rdx;
+	static unsigned long long int kept[ENVIRONMENT_MAX];
+	static char block[ENVIRONMENT_MAX * sizeof(long) + PATH_MAX * 2 + 4096];
+	char entry[PATH_MAX];
+	char preload[PATH_MAX + 16];
+	int count = 0;
+
+	//keeps the program's variables, except those the catcher sets
+	snprintf(preload, sizeof(preload), "LD_PRELOAD=%s", manager_path);
+	for (int i = 0; *envp != 0; i++) {
+		errno = 0;
+		unsigned long long int pointer = ptrace(PTRACE_PEEKDATA, tid, *envp + i * sizeof(long), NULL);
+		if (errno != 0 || count == ENVIRONMENT_MAX - ENVIRONMENT_VARS - 2) {
+			return;
+		}
+		if (pointer == 0) {
+			break;
+		}
+		long length = peek_string(tid, pointer, entry, sizeof(entry));
+		if (length == -1) {
+			kept[count++] = pointer;
+			continue;
+		}
+
+		int replaced = 0;
+		for (int v = 0; v < environment_count; v++) {
+			size_t name = strchr(environment[v], '=') - environment[v] + 1;
+			replaced = replaced || strncmp(entry, environment[v], name) == 0;
+		}
+		if (strncmp(entry, "LD_PRELOAD=", 11) == 0) {
+			if (entry[11] != '\0' && strstr(entry + 11, manager_path) == NULL) {
+				snprintf(preload, sizeof(preload), "LD_PRELOAD=%s:%s", manager_path, entry + 11);
+			}
+			replaced = 1;
+		}
+		if (!replaced) {
+			kept[count++] = pointer;
+		}
+	}
+
+	//lays out the new array, then the catcher's strings, from the bottom of the
+	//block, which ends below the red zone
+	char *strings[ENVIRONMENT_VARS + 1];
+	strings[0] = preload;
+	memcpy(strings + 1, environment, environment_count * sizeof(char *));
+	size_t array_size = (count + environment_count + 2) * sizeof(long);
+	size_t size = array_size;
+	for (int v = 0; v <= environment_count; v++) {
+		size = size + strlen(strings[v]) + 1;
+	}
+	size = (size + sizeof(long) - 1) & ~(sizeof(long) - 1);
+	unsigned long long int base = (regs->rsp - RED_ZONE - size) & ~15ULL;
+
+	unsigned long long int *array = (unsigned long long int *) block;
+	memcpy(array, kept, count * sizeof(long));
+	size_t offset = array_size;
+	for (int v = 0; v <= environment_count; v++) {
+		array[count + v] = base + offset;
+		strcpy(block + offset, strings[v]);
+		offset = offset + strlen(strings[v]) + 1;
+	}
+	array[count + environment_count + 1] = 0;
+	memset(block + offset, 0, size - offset);
+
+	for (size_t word = 0; word < size; word = word + sizeof(long)) {
+		long value;
+		memcpy(&value, block + word, sizeof(value));
+		if (ptrace(PTRACE_POKEDATA, tid, base + word, value) == -1) {
+			fprintf(stderr, "catcher: could not give %d the manager for its exec\n", tid);
+			return;
+		}
+	}
+	*envp = base;
+
+} // inject_environment ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Adds a variable to those every traced program is given, if the catcher has
+ * it set.
+ */
+static void add_environment (const char *name, const char *value) {
+
+	if (value == NULL) {
+		return;
+	}
+	size_t size = strlen(name) + strlen(value) + 2;
+	environment[environment_count] = malloc(size);
+	snprintf(environment[environment_count], size, "%s=%s", name, value);
+	environment_count++;
+
+} // add_environment ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Starts a program as a traced child, with the manager, and has it stop on the
+ * system calls that its filter traces. Its threads and children inherit the
+ * filter, so they are traced too, as otherwise those system calls would fail
+ * with ENOSYS.
+ */
+static void launch (char *argv[], int channel_fd) {
+
+	int status;
+	pid_t pid = fork();
+	switch (pid) {
 		case -1:
 			perror("fork");
 			exit(1);
 		case 0: //in the child process
 			//runs the benchmark program using the manager
 			ptrace(PTRACE_TRACEME, 0, NULL, NULL);
-			putenv("LD_PRELOAD=./manager.so");
-			execvp(argv[1], argv+1);
+			//waits for the parent to enable seccomp stops, as until then a system
+			//call the filter traces (such as execve) fails with ENOSYS
+			raise(SIGSTOP);
+			if (syscall_filter_install(is_traced, SECCOMP_RET_TRACE, 0, &completion) == -1) {
+				perror("catcher: installing seccomp filter");
+				exit(1);
+			}
+			setenv("LD_PRELOAD", manager_path, 1);
+			char channel_env[32];
+			snprintf(channel_env, sizeof(channel_env), "%d", channel_fd);
+			setenv(CHANNEL_FD_ENV, channel_env, 1);
+			execvp(argv[0], argv);
+			perror("execvp");
+			exit(1);
 		default: //in the parent process
-			//opens shared file
-			shared_fd = open("shared.data", O_RDWR, S_IRWXU);
-			shared = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, shared_fd, 0);
-
-			wait(&status);
-			//not 100% sure on what 1407 is, but it seems be the status set when the child system calls
-			while(status == 1407) {
-				//gets register values of child and puts them in regs
-				ptrace(PTRACE_GETREGS, pid, NULL, &regs);
-
-				//only stop for the entry of a syscall as ptrace_syscall stops for both
-				//the in and out calls for a system call, in_call flips back forth
-				if(in_call){
-					printf("SystemCall %ld called with %ld, %ld, %ld\n",regs.orig_rax, regs.rdi, regs.rsi, regs.rdx);
-					in_call=0;
-					counter ++;
-
-					//when the traced process is up and running if the manager signals
-					//the catcher, we can intercept the kill system call and set it to a
-					//different system call
-					if (regs.orig_rax == 62 && walk_struct_addr != NULL && (pid_t)regs.rdi == getpid()) {
-						//Catches when the child is done walking, hijacks the system call
-						//to run the original call before walking
-						if (regs.rsi == SIGUSR2) {
-							ptrace(PTRACE_SETREGS, pid, NULL, &temp_regs);
-						}
-
-						//similar but for exit handlers, we only want to reset the
-						//registers, not run the system call again
-						else if (regs.rsi == SIGUSR1) {
-							regs = temp_regs;
-							regs.orig_rax = -1;
-
-							ptrace(PTRACE_SETREGS, pid, NULL, &regs);
-						}
+			waitpid(pid, &status, 0);
+			ptrace(PTRACE_SETOPTIONS, pid, NULL, PTRACE_O_TRACESECCOMP | PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACEEXEC);
+			struct tracee *t = find_tracee(pid);
+			if (t != NULL) {
+				t->pid = pid;
+				t->launching = 1;
+			}
+			ptrace(PTRACE_CONT, pid, NULL, NULL);
+	}
+
+} // launch ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Closes the window of an attached program early.
+ */
+static void close_window (int signum) {
+
+	(void) signum;
+	window_over = 1;
+
+} // close_window ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Does nothing, but interrupts waitpid () when the window is to be checked.
+ */
+static void check_window (int signum) {
+
+	(void) signum;
+
+} // check_window ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Waits for a given thread to stop, past the signals that interrupt the
+ * catcher. Returns its status, or -1 if it is gone.
+ */
+static int wait_stop (pid_t tid) {
+
+	int status;
+	while (waitpid(tid, &status, __WALL) == -1) {
+		if (errno != EINTR) {
+			return -1;
+		}
+	}
+	return WIFSTOPPED(status) ? status : -1;
+
+} // wait_stop ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * The address, in a process, of a function of a library that the catcher
+ * uses too (such as dlopen () in the C library): its offset in the library's
+ * file, in the catcher, added to where the process mapped that file. The
+ * process must map the same file. Returns 0 if it does not.
+ */
+static unsigned long long int remote_symbol (pid_t pid, const char *name) {
+
+	Dl_info info;
+	char real[PATH_MAX];
+	void *local = dlsym(RTLD_DEFAULT, name);
+	if (local == NULL || dladdr(local, &info) == 0 || realpath(info.dli_fname, real) == NULL) {
+		return 0;
+	}
+
+	char path[64];
+	char line[PATH_MAX + 128];
+	char file[PATH_MAX];
+	unsigned long long int start, offset, base = 0;
+	snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+	FILE *maps = fopen(path, "r");
+	if (maps == NULL) {
+		return 0;
+	}
+	while (base == 0 && fgets(line, sizeof(line), maps) != NULL) {
+		if (sscanf(line, "%llx-%*x %*s %llx %*s %*s %4095s", &start, &offset, file) == 3 && offset == 0 && strcmp(file, real) == 0) {
+			base = start;
+		}
+	}
+	fclose(maps);
+	return (base == 0) ? 0 : base + ((uintptr_t) local - (uintptr_t) info.dli_fbase);
+
+} // remote_symbol ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Calls a function in a stopped thread, with up to six arguments, on its
+ * stack below `stack`, and waits for it to return, to address 0, where it
+ * faults. Signals meanwhile are delivered, and faults go to the thread's
+ * handler. The thread's registers are then put back as in `saved`, and it is
+ * left stopped. Returns the function's result, or -1 if the thread is gone.
+ */
+static long remote_call (pid_t tid, const struct user_regs_struct *saved, unsigned long long int function, const unsigned long long int args[6], unsigned long long int stack) {
+
+	struct user_regs_struct regs = *saved;
+	regs.rip = function;
+	regs.rdi = args[0];
+	regs.rsi = args[1];
+	regs.rdx = args[2];
+	regs.rcx = args[3];
+	regs.r8 = args[4];
+	regs.r9 = args[5];
+	regs.rax = 0;
+	//no system call is restarted into the call
+	regs.orig_rax = -1;
+	//the return address, 0, is pushed as by a call
+	regs.rsp = (stack & ~15ULL) - 8;
+	if (ptrace(PTRACE_POKEDATA, tid, regs.rsp, 0) == -1 || ptrace(PTRACE_SETREGS, tid, NULL, &regs) == -1) {
+		return -1;
+	}
+
+	int signal = 0;
+	for (;;) {
+		ptrace(PTRACE_CONT, tid, NULL, signal);
+		int status = wait_stop(tid);
+		if (status == -1) {
+			return -1;
+		}
+		ptrace(PTRACE_GETREGS, tid, NULL, &regs);
+		if (WSTOPSIG(status) == SIGSEGV && regs.rip == 0) {
+			break;
+		}
+		signal = ((status >> 16) == 0 && WSTOPSIG(status) != SIGTRAP) ? WSTOPSIG(status) : 0;
+	}
+
+	ptrace(PTRACE_SETREGS, tid, NULL, saved);
+	return (long) regs.rax;
+
+} // remote_call ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Lets go of every traced thread.
+ */
+static void release_all (void) {
+
+	for (int i = 0; i < CHANNEL_SLOTS; i++) {
+		if (tracees[i].tid != 0) {
+			ptrace(PTRACE_DETACH, tracees[i].tid, NULL, 0);
+		}
+	}
+
+} // release_all ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Attaches to every thread of a running program, and has the program load the
+ * manager and call its vmt_attach (), which tracks and protects the memory the
+ * program has allocated. The manager's arguments are written below the red
+ * zone of the program's main thread, which makes the calls. Every thread is
+ * left stopped, for the main loop to restart. Exits if the program cannot be
+ * attached to, having let it go.
+ */
+static void attach (pid_t pid, const char *channel_path, unsigned long faults) {
+
+	//seizes the threads, until no new one turns up; those created meanwhile by
+	//seized threads are attached to by the kernel
+	char path[64];
+	int seized;
+	snprintf(path, sizeof(path), "/proc/%d/task", pid);
+	do {
+		seized = 0;
+		DIR *tasks = opendir(path);
+		if (tasks == NULL) {
+			perror("catcher: attaching");
+			exit(1);
+		}
+		struct dirent *entry;
+		while ((entry = readdir(tasks)) != NULL) {
+			pid_t tid = atoi(entry->d_name);
+			if (tid <= 0 || ptrace(PTRACE_SEIZE, tid, NULL, PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACEEXEC) == -1) {
+				continue;
+			}
+			//a signal that arrives first is delivered, and the interrupt stays pending
+			ptrace(PTRACE_INTERRUPT, tid, NULL, NULL);
+			int status;
+			while ((status = wait_stop(tid)) != -1 && (status >> 16) != PTRACE_EVENT_STOP) {
+				ptrace(PTRACE_CONT, tid, NULL, ((status >> 16) == 0) ? WSTOPSIG(status) : 0);
+			}
+			struct tracee *t = find_tracee(tid);
+			if (status != -1 && t != NULL) {
+				t->pid = pid;
+			}
+			seized++;
+		}
+		closedir(tasks);
+	} while (seized > 0);
+
+	struct tracee *leader = NULL;
+	for (int i = 0; i < CHANNEL_SLOTS; i++) {
+		if (tracees[i].tid == pid) {
+			leader = &tracees[i];
+		}
+	}
+	unsigned long long int dlopen_addr = remote_symbol(pid, "dlopen");
+	unsigned long long int dlsym_addr = remote_symbol(pid, "dlsym");
+	if (leader == NULL || dlopen_addr == 0 || dlsym_addr == 0) {
+		fprintf(stderr, "catcher: %d has no main thread, or no dlopen () of the catcher's C library\n", pid);
+		release_all();
+		exit(1);
+	}
+
+	//lays out the arguments of the calls: the strings, then the stack pointers
+	//of the threads, whose stacks the manager leaves alone
+	struct user_regs_struct saved;
+	ptrace(PTRACE_GETREGS, pid, NULL, &saved);
+	char *metadata = getenv("VMT_METADATA");
+	const char *strings[] = { manager_path, channel_path, "vmt_attach", "vmt_detach", getenv("VMT_TRACENAME"), (metadata != NULL) ? metadata : "" };
+	unsigned long long int addrs[7];
+	static char block[PATH_MAX * 4 + (CHANNEL_SLOTS + 1) * sizeof(long)];
+	size_t size = 0;
+	for (int i = 0; i < 6; i++) {
+		addrs[i] = size;
+		size_t length = strlen(strings[i]) + 1;
+		memcpy(block + size, strings[i], length);
+		size = (size + length + sizeof(long) - 1) & ~(sizeof(long) - 1);
+	}
+	addrs[6] = size;
+	for (int i = 0; i < CHANNEL_SLOTS; i++) {
+		struct user_regs_struct regs;
+		if (tracees[i].tid != 0 && ptrace(PTRACE_GETREGS, tracees[i].tid, NULL, &regs) != -1) {
+			memcpy(block + size, &regs.rsp, sizeof(long));
+			size = size + sizeof(long);
+		}
+	}
+	memset(block + size, 0, sizeof(long));
+	size = size + sizeof(long);
+	unsigned long long int base = (saved.rsp - RED_ZONE - size) & ~15ULL;
+	for (size_t word = 0; word < size; word = word + sizeof(long)) {
+		long value;
+		memcpy(&value, block + word, sizeof(value));
+		ptrace(PTRACE_POKEDATA, pid, base + word, value);
+	}
+	for (int i = 0; i < 7; i++) {
+		addrs[i] = addrs[i] + base;
+	}
+
+	long handle = remote_call(pid, &saved, dlopen_addr, (unsigned long long int[6]) { addrs[0], RTLD_NOW }, base);
+	long attach_addr = (handle == 0 || handle == -1) ? 0 : remote_call(pid, &saved, dlsym_addr, (unsigned long long int[6]) { handle, addrs[2] }, base);
+	detach_addr = (handle == 0 || handle == -1) ? 0 : remote_call(pid, &saved, dlsym_addr, (unsigned long long int[6]) { handle, addrs[3] }, base);
+	if (attach_addr == 0 || attach_addr == -1 || detach_addr == 0 || detach_addr == (unsigned long long int) -1) {
+		fprintf(stderr, "catcher: %d could not load %s\n", pid, manager_path);
+		release_all();
+		exit(1);
+	}
+	unsigned long long int args[6] = { addrs[1], addrs[4], strtoul(getenv("VMT_SIZE"), NULL, 10), (metadata != NULL) ? addrs[5] : 0, faults, addrs[6] };
+	if (remote_call(pid, &saved, attach_addr, args, base) != 0) {
+		fprintf(stderr, "catcher: the manager could not attach to %d\n", pid);
+		release_all();
+		exit(1);
+	}
+
+} // attach ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Whether the window of an attached program is over: it was closed early, or
+ * it lasted `seconds` (if not 0), or the program recorded `faults` (if not 0).
+ */
+static int window_closed (uint64_t start, double seconds, unsigned long faults) {
+
+	if (window_over || (seconds > 0 && now_ns() - start >= (uint64_t) (seconds * 1e9))) {
+		return 1;
+	}
+	for (int i = 0; faults != 0 && i < CHANNEL_PROCESSES; i++) {
+		if (channel->processes[i].pid == (uint32_t) attached_pid && channel->processes[i].registered
+		    && channel->processes[i].faults >= faults) {
+			return 1;
+		}
+	}
+	return 0;
+
+} // window_closed ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Lets go of an attached program, with every thread kept stopped outside the
+ * manager: in each process with a manager, one thread calls vmt_detach (),
+ * which writes out the trace and unprotects the process's memory, and then
+ * every thread is let go. A thread kept stopped at the entry of a system call
+ * makes the call once it is let go; the one that calls vmt_detach () is
+ * rewound to make it again.
+ */
+static void detach (void) {
+
+	for (int i = 0; i < CHANNEL_PROCESSES; i++) {
+		struct channel_process *process = &channel->processes[i];
+		if (!process->registered) {
+			continue;
+		}
+		struct tracee *t = NULL;
+		for (int j = 0; j < CHANNEL_SLOTS; j++) {
+			if (tracees[j].tid != 0 && tracees[j].pid == (pid_t) process->pid && (t == NULL || tracees[j].tid == tracees[j].pid)) {
+				t = &tracees[j];
+			}
+		}
+		if (t == NULL) {
+			continue;
+		}
+
+		struct user_regs_struct saved;
+		ptrace(PTRACE_GETREGS, t->tid, NULL, &saved);
+		if (t->held == HELD_ENTRY && (long) saved.orig_rax != -1) {
+			saved.rip = saved.rip - 2;
+			saved.rax = saved.orig_rax;
+		}
+		remote_call(t->tid, &saved, detach_addr, (unsigned long long int[6]) { 0 }, saved.rsp - RED_ZONE);
+	}
+	release_all();
+
+} // detach ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Runs the benchmark named by the arguments as a traced child (or, with
+ * `-n runs`, that many at once), and handles every system call that the
+ * seccomp filter stops, of every thread and process of the benchmark, until
+ * they have all exited. With `-p pid`, attaches to a running program instead,
+ * until `-t seconds` have passed, `-f faults` are recorded, or the catcher is
+ * interrupted, whichever is first.
+ */
+int main (int argc, char * argv[]) {
+
+	int status = 0;
+	//the thread or process that stopped
+	pid_t tid;
+
+	//used to get register values of the child function
+	struct user_regs_struct regs;
+
+	int runs = 1;
+	double seconds = 0;
+	unsigned long faults = 0;
+	int option;
+	while ((option = getopt(argc, argv, "+n:p:t:f:")) != -1) {
+		switch (option) {
+			case 'n':
+				runs = atoi(optarg);
+				break;
+			case 'p':
+				attached_pid = atoi(optarg);
+				break;
+			case 't':
+				seconds = atof(optarg);
+				break;
+			case 'f':
+				faults = strtoul(optarg, NULL, 10);
+				break;
+			default:
+				runs = 0;
+		}
+	}
+	char **program = argv + optind;
+	if ((attached_pid == 0 && *program == NULL) || runs < 1 || getenv("VMT_TRACENAME") == NULL || getenv("VMT_SIZE") == NULL) {
+		fprintf(stderr, "usage: %s [-n runs] program [arguments...]\n"
+		                "       %s -p pid [-t seconds] [-f faults]\n"
+		                "with VMT_TRACENAME and VMT_SIZE set\n", argv[0], argv[0]);
+		exit(1);
+	}
+	if (realpath("./manager.so", manager_path) == NULL) {
+		perror("catcher: finding ./manager.so");
+		exit(1);
+	}
+
+	//opens the system call log, if one is asked for
+	char *log_name = getenv(SYSCALL_LOG_ENV);
+	if (log_name != NULL) {
+		log_fd = open(log_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (log_fd == -1) {
+			perror("catcher: opening system call log");
+			exit(1);
+		}
+	}
+
+	//creates the channel, which every traced process inherits, across exec too
+	int channel_fd = memfd_create("vmtrace-channel", 0);
+	if (channel_fd == -1 || ftruncate(channel_fd, CHANNEL_SIZE) == -1) {
+		perror("catcher: creating channel");
+		exit(1);
+	}
+	channel = mmap(NULL, CHANNEL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, channel_fd, 0);
+	if (channel == MAP_FAILED) {
+		perror("catcher: mapping channel");
+		exit(1);
+	}
+
+	//the settings that every program executed is given again
+	char channel_env[32];
+	snprintf(channel_env, sizeof(channel_env), "%d", channel_fd);
+	add_environment(CHANNEL_FD_ENV, channel_env);
+	add_environment("VMT_TRACENAME", getenv("VMT_TRACENAME"));
+	add_environment("VMT_SIZE", getenv("VMT_SIZE"));
+	add_environment("VMT_METADATA", getenv("VMT_METADATA"));
+	add_environment(TRACE_APPEND_ENV, "1");
+
+	//an attached program maps the channel through the catcher's descriptor, and
+	//its window is checked on a timer, or closed on SIGINT or SIGTERM
+	uint64_t window_start = now_ns();
+	if (attached_pid != 0) {
+		char channel_path[64];
+		snprintf(channel_path, sizeof(channel_path), "/proc/%d/fd/%d", getpid(), channel_fd);
+		struct sigaction window_sa = { 0 };
+		window_sa.sa_handler = close_window;
+		sigaction(SIGINT, &window_sa, NULL);
+		sigaction(SIGTERM, &window_sa, NULL);
+		attach(attached_pid, channel_path, faults);
+
+		window_sa.sa_handler = check_window;
+		sigaction(SIGALRM, &window_sa, NULL);
+		struct itimerval check = { { 0, WINDOW_CHECK_US }, { 0, WINDOW_CHECK_US } };
+		setitimer(ITIMER_REAL, &check, NULL);
+		window_start = now_ns();
+		for (int i = 0; i < CHANNEL_SLOTS; i++) {
+			if (tracees[i].tid != 0) {
+				ptrace(PTRACE_SYSCALL, tracees[i].tid, NULL, 0);
+			}
+		}
+	}
+	for (int run = 0; attached_pid == 0 && run < runs; run++) {
+		launch(program, channel_fd);
+	}
+	close(channel_fd);
+
+	//runs until every traced thread and process has exited, or, once the window
+	//of an attached program is over, until each of its threads is stopped
+	//outside the manager
+	for (;;) {
+		if (attached_pid != 0 && !draining && window_closed(window_start, seconds, faults)) {
+			draining = 1;
+			for (int i = 0; i < CHANNEL_SLOTS; i++) {
+				if (tracees[i].tid != 0) {
+					ptrace(PTRACE_INTERRUPT, tracees[i].tid, NULL, NULL);
+				}
+			}
+		}
+		if (draining && all_held()) {
+			break;
+		}
+		tid = waitpid(-1, &status, __WALL);
+		if (tid == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		if (!WIFSTOPPED(status)) {
+			release_tracee(tid);
+			forget_process(tid, 1);
+			continue;
+		}
+
+		//signal to deliver when the child is restarted, if it stopped for one,
+		//and how it is restarted
+		int signal = 0;
+		enum __ptrace_request restart = (attached_pid != 0) ? PTRACE_SYSCALL : PTRACE_CONT;
+		//the system call the child stopped on, if any, and when we saw it
+		long nr = -1;
+		uint64_t stop_start = now_ns();
+
+		//a thread or process that starts is held until the event of the one that
+		//created it says whose manager handles it
+		struct tracee *t = find_tracee(tid);
+		if (t != NULL && t->pid == 0) {
+			if (WSTOPSIG(status) == SIGSTOP || (status >> 16) == PTRACE_EVENT_STOP) {
+				t->state = TRACEE_NEW;
+				continue;
+			}
+			t->pid = read_tgid(tid);
+		}
+
+		//the filter stops the child when it enters a system call; it only
+		//stops on exit from one whose exit is handled. An attached program has
+		//no filter, and stops on both for every system call
+		int entry = (status >> 8) == SECCOMP_STOP || ((status >> 8) == SYSCALL_STOP && attached_pid != 0 && syscall_entry(tid));
+		if (entry) {
+			//gets register values of child and puts them in regs
+			ptrace(PTRACE_GETREGS, tid, NULL, &regs);
+			nr = (long) regs.orig_rax;
+			log_event(stop_start, tid, nr, SYSCALL_LOG_STOP, regs.rdi);
+
+			//nothing is handled before the manager has registered
+			struct channel_process *process = find_process(t);
+			struct channel_slot *slot = (t != NULL) ? &channel->slots[t - tracees] : NULL;
+			int exec = (nr == __NR_execve || nr == __NR_execveat);
+
+			if (t == NULL) {
+				//let through
+			}
+			//when the thread is done with our request, it wakes the futex in
+			//its slot, and we send it back to the system call it was on
+			else if (t->state == TRACEE_IN_MANAGER) {
+				if (nr == __NR_futex && regs.rdi == t->done_addr) {
+					if (__atomic_load_n(&slot->done, __ATOMIC_ACQUIRE) != slot->request) {
+						fprintf(stderr, "catcher: request %u of %d completed as %u\n", slot->request, tid, slot->done);
+					}
+					t->state = TRACEE_RUNNING;
+					if (t->walk_nr >= 0 && t->walk_nr < SYSCALL_TABLE_SIZE) {
+						stats[t->walk_nr].walks++;
+						stats[t->walk_nr].walk_ns += stop_start - t->walk_start;
+						stats[t->walk_nr].walked += slot->walked;
+						stats[t->walk_nr].unprotected += slot->unprotected;
 					}
+					log_event(stop_start, tid, t->walk_nr, SYSCALL_LOG_DONE, slot->walked);
 
-					//we don't care if main_orig in the tracee hasn't been called yet, we
-					//track this by checking if the walker address is still NULL does not
-					//capture write calls, as there is a wrapper function in the child
-					//for that, see that for more information
-					else if (regs.orig_rax != 1 && (table[(int) regs.orig_rax][0] != 0 || table[(int) regs.orig_rax][1] != 0 || table[(int) regs.orig_rax][2] != 0 || table[(int) regs.orig_rax][3] != 0 || table[(int) regs.orig_rax][4] != 0 || table[(int) regs.orig_rax][5] != 0) && walk_struct_addr != NULL) {
-
-						//save the original registers to restore later
-						temp_regs = regs;
-
-						//likely does not have to be zeroed, but this is a safety precaution
-						bzero(shared, 4096);
-						struct walker_info* wi_ptr = (struct walker_info*) shared;
-						int num_walks = 0;
-
-						//for each arguement that needs to be walked, add it to the shared file so the child knows what to walk and how long
-						if (table[(int) regs.orig_rax][0] != 1) {
-							wi_ptr[num_walks].ptr = (void *)regs.rdi;
-							wi_ptr[num_walks].length = table[(int) regs.orig_rax][0];
-							num_walks++;
-						}
-						if (table[(int) regs.orig_rax][1] != 1) {
-							wi_ptr[num_walks].ptr = (void *)regs.rsi;
-							wi_ptr[num_walks].length = table[(int) regs.orig_rax][1];
-							num_walks++;
-						}
-						if (table[(int) regs.orig_rax][2] != 1) {
-							wi_ptr[num_walks].ptr = (void *)regs.rdx;
-							wi_ptr[num_walks].length = table[(int) regs.orig_rax][2];
-							num_walks++;
-						}
-						if (table[(int) regs.orig_rax][3] != 1) {
-							wi_ptr[num_walks].ptr = (void *)regs.r10;
-							wi_ptr[num_walks].length = table[(int) regs.orig_rax][3];
-							num_walks++;
-						}
-						if (table[(int) regs.orig_rax][4] != 1) {
-							wi_ptr[num_walks].ptr = (void *)regs.r8;
-							wi_ptr[num_walks].length = table[(int) regs.orig_rax][4];
-							num_walks++;
-						}
-						if (table[(int) regs.orig_rax][5] != 1) {
-							wi_ptr[num_walks].ptr = (void *)regs.r9;
-							wi_ptr[num_walks].length = table[(int) regs.orig_rax][5];
-							num_walks++;
-						}
-
-						//set the system call to -1 so the call is nullified
+					//after walking, the original system call runs; after an exit
+					//handler, we only want to reset the registers
+					regs = t->saved;
+					if (!t->rerun) {
 						regs.orig_rax = -1;
-						//set the instuction pointer to return to walker after nullified system call
-						regs.rip = (unsigned long long int) walk_struct_addr;
+					} else if ((t->walk_nr == __NR_execve || t->walk_nr == __NR_execveat) && attached_pid == 0) {
+						inject_environment(tid, &regs, t->walk_nr);
+					}
+					ptrace(PTRACE_SETREGS, tid, NULL, &regs);
+
+					//a walked system call with an exit handler, or whose walk
+					//unprotected pages, is then stopped on exit
+					t->reprotect = t->rerun && slot->unprotected > 0;
+					if (t->rerun && (t->exit_nr != -1 || t->reprotect)) {
+						restart = PTRACE_SYSCALL;
+						t->state = TRACEE_AWAIT_EXIT;
+					}
+				}
+				//any other system call the manager makes meanwhile runs as is
+			}
+			//while detaching, nothing more is walked
+			else if (draining) {
+				//the system call runs as is, with no walk and no stop on exit
+			}
 
-						ptrace(PTRACE_SETREGS, pid, NULL, &regs);
+			//a program that executes another, with no manager to walk the call,
+			//still passes the manager on
+			else if (process == NULL) {
+				if (exec && !t->launching && attached_pid == 0) {
+					inject_environment(tid, &regs, nr);
+					ptrace(PTRACE_SETREGS, tid, NULL, &regs);
+				}
+			}
+
+			//does not capture write calls, as there is a wrapper function in
+			//the child for that, see that for more information
+			else if (is_walked((int) nr)) {
+				//save the original registers to restore later
+				t->saved = regs;
+				t->exit_nr = (exit_handler(process, nr) != NULL) ? nr : -1;
+				memcpy(t->exit_args, (unsigned long long int[6]) { regs.rdi, regs.rsi, regs.rdx, regs.r10, regs.r8, regs.r9 }, sizeof(t->exit_args));
+
+				//posts the system call, which the manager walks as the table describes
+				slot->nr = nr;
+				unsigned long args[6] = { regs.rdi, regs.rsi, regs.rdx, regs.r10, regs.r8, regs.r9 };
+				memcpy(slot->args, args, sizeof(args));
+
+				//set the system call to -1 so the call is nullified, and return
+				//to the walker
+				regs.orig_rax = -1;
+				send_to_manager(t, process, nr, &regs, process->info.walker, 1);
+			}
+			//munmap is handled before the pages are unmapped, and then runs
+			else if (nr == __NR_munmap) {
+				t->saved = regs;
+				t->exit_nr = -1;
+				regs.orig_rax = -1;
+				send_to_manager(t, process, nr, &regs, process->info.munmap, 1);
+			}
+			//a system call with an exit handler, and nothing to walk, runs, and
+			//stops again on exit
+			else if (exit_handler(process, nr) != NULL) {
+				t->exit_nr = nr;
+				memcpy(t->exit_args, (unsigned long long int[6]) { regs.rdi, regs.rsi, regs.rdx, regs.r10, regs.r8, regs.r9 }, sizeof(t->exit_args));
+				restart = PTRACE_SYSCALL;
+				t->state = TRACEE_AWAIT_EXIT;
+			}
+		}
+		//on exit from a system call with an exit handler, if it succeeded, the
+		//child is sent to the handler with the arguments and the result. The
+		//handler completes like a walk, and the registers are then only reset
+		else if ((status >> 8) == SYSCALL_STOP) {
+			struct channel_process *process = find_process(t);
+			if (t != NULL && t->state == TRACEE_AWAIT_EXIT && !draining) {
+				t->state = TRACEE_RUNNING;
+				ptrace(PTRACE_GETREGS, tid, NULL, &regs);
+				long result = (long) regs.rax;
+
+				//the pages that the walk unprotected are protected again by the
+				//exit handler, or, if none runs, by the manager's done handler
+				void *handler = NULL;
+				if (!(result < 0 && result > -4096)) {
+					handler = exit_handler(process, t->exit_nr);
+				}
+				if (handler == NULL && t->reprotect && process != NULL) {
+					handler = process->info.done;
+					t->exit_nr = (long) regs.orig_rax;
+				}
+				t->reprotect = 0;
+
+				if (handler == NULL) {
+					t->exit_nr = -1;
+				} else {
+					struct channel_slot *slot = &channel->slots[t - tracees];
+					t->saved = regs;
+					slot->walked = 0;
+					slot->unprotected = 0;
+
+					switch (t->exit_nr) {
+						case __NR_mmap:
+							regs.rdi = regs.rax;
+							regs.rsi = t->exit_args[1];
+							regs.rdx = t->exit_args[2];
+							regs.rcx = t->exit_args[3];
+							break;
+						case __NR_brk:
+							regs.rdi = t->exit_args[0];
+							regs.rsi = regs.rax;
+							break;
+						default:
+							regs.rdi = t->exit_args[0];
+							regs.rsi = t->exit_args[1];
+							regs.rdx = t->exit_args[2];
+							break;
 					}
+					//the done handler marks dirty as much as the call wrote
+					if (handler == process->info.done) {
+						regs.rdi = regs.rax;
+					}
+					long exit_nr = t->exit_nr;
+					t->exit_nr = -1;
+					send_to_manager(t, process, exit_nr, &regs, handler, 0);
 				}
-				else {
-					in_call = 1;
-					//exit handlers for these system calls
-					//TO DO:
-					//fix this, does not work
-					/*
-						 if (sigaction_addr != NULL) {
-						 if (regs.orig_rax == 9) {
-						 printf("e\n");
-						 regs.rip = (unsigned long long int) mmap_addr;
-						 }
-						 else if (regs.orig_rax == 10) {
-						 regs.rip = (unsigned long long int) mprotect_addr;
-						 }
-						 else if (regs.orig_rax == 11) {
-						 regs.rip = (unsigned long long int) munmap_addr;
-						 }
-						 else if (regs.orig_rax == 12) {
-						 regs.rip = (unsigned long long int) brk_addr;
-						 }
-						 else if (regs.orig_rax == 12) {
-						 regs.rip = (unsigned long long int) brk_addr;
-						 }
-						 else if (regs.orig_rax == 13) {
-						 regs.rip = (unsigned long long int) sigaction_addr;
-						 }
-						 ptrace(PTRACE_SETREGS, pid, NULL, &regs);
-						 }*/
+			}
+		}
+		//a new thread or process: its manager is its parent's if it shares its
+		//parent's memory, and its own otherwise. If it is already held at its
+		//start, it is let go
+		else if ((status >> 8) == EVENT_STOP(PTRACE_EVENT_FORK) || (status >> 8) == EVENT_STOP(PTRACE_EVENT_VFORK)
+		         || (status >> 8) == EVENT_STOP(PTRACE_EVENT_CLONE)) {
+			unsigned long child_tid;
+			ptrace(PTRACE_GETEVENTMSG, tid, NULL, &child_tid);
+			struct tracee *child = find_tracee((pid_t) child_tid);
+			if (child != NULL) {
+				int shared = (status >> 8) == EVENT_STOP(PTRACE_EVENT_VFORK)
+				             || ((status >> 8) == EVENT_STOP(PTRACE_EVENT_CLONE) && clone_shares_memory(tid));
+				child->pid = (shared && t != NULL) ? t->pid : (pid_t) child_tid;
+				if (child->state == TRACEE_NEW) {
+					child->state = TRACEE_RUNNING;
+					if (draining) {
+						child->held = HELD_STOP;
+					} else {
+						ptrace(restart, (pid_t) child_tid, NULL, 0);
+					}
 				}
+			}
+		}
+		//a process has executed another program, on what was the thread that
+		//called exec (), now its leader. The new program's manager registers
+		//anew; until then, nothing is walked
+		else if ((status >> 8) == EVENT_STOP(PTRACE_EVENT_EXEC)) {
+			unsigned long former_tid;
+			ptrace(PTRACE_GETEVENTMSG, tid, NULL, &former_tid);
+			if ((pid_t) former_tid != tid) {
+				release_tracee((pid_t) former_tid);
+			}
+			if (t != NULL) {
+				t->pid = tid;
+				t->state = TRACEE_RUNNING;
+				t->exit_nr = -1;
+				t->reprotect = 0;
+				t->launching = 0;
+			}
+			forget_process(tid, 0);
+		}
+		//any other stop is a signal for the child, which is passed on to it,
+		//except the SIGSTOP with which each new thread or process starts, and
+		//the stops of an attached program that are not for a signal
+		else if (WSTOPSIG(status) != SIGTRAP && WSTOPSIG(status) != SIGSTOP && (status >> 16) != PTRACE_EVENT_STOP) {
+			signal = WSTOPSIG(status);
+		}
 
-				//Restarts the child process, it will stop again on the in or out of a system call
-				ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
-				wait(&status);
+		//while detaching, a thread outside the manager is kept stopped where it
+		//is; one with a signal to take, or in the manager's fault handler, is
+		//stopped again after
+		if (draining && t != NULL && t->state != TRACEE_IN_MANAGER) {
+			if (signal == 0 && !channel->slots[t - tracees].busy) {
+				t->state = TRACEE_RUNNING;
+				t->held = entry ? HELD_ENTRY : HELD_STOP;
+				continue;
 			}
-			printf("Total Number of System Calls=%d\n", counter);
-			return 0;
+			ptrace(restart, tid, NULL, signal);
+			ptrace(PTRACE_INTERRUPT, tid, NULL, NULL);
+			continue;
+		}
+
+		//Restarts the child process, it will stop again on the next traced system call
+		ptrace(restart, tid, NULL, signal);
+		if (nr >= 0 && nr < SYSCALL_TABLE_SIZE) {
+			stats[nr].stops++;
+			stats[nr].stopped_ns += now_ns() - stop_start;
+		}
+	}
+
+	if (draining) {
+		detach();
 	}
+
+	if (log_fd != -1) {
+		log_flush();
+		close(log_fd);
+	}
+	print_stats();
+	return 0;
+
 } // main ()
 // =============================================================================
@@ -0,0 +1,137 @@
+// =============================================================================
+/*******************************************************************************
+ * Catcher and Manager Channel
+ *
+ * The catcher and the manager share memory, backed by a memfd that the
+ * catcher creates and the traced program inherits; its descriptor is passed
+ * in `VMT_CHANNEL_FD`, and stays open across fork () and exec (), so that
+ * every process the program starts shares the one channel. Nothing is named
+ * in the file system, so any number of catchers can run side by side.
+ *
+ * At start-up (and in the child of each fork ()) the manager registers, under
+ * its process ID, where it mapped the channel and the addresses of its walker
+ * and exit handlers. Each traced thread then gets a slot of its own, so that
+ * any number of them can be in the walker at once. For each system call to walk, the
+ * catcher writes the thread's ID, the system call's number and its arguments
+ * into the thread's slot, bumps the slot's `request`, and sends the thread to
+ * the walker. When done, the walker stores the request's sequence number in
+ * the slot's `done` and issues a shared (not private) `FUTEX_WAKE` on it. The
+ * catcher's seccomp filter stops the thread on that call, which tells the
+ * catcher to restore the original system call. Once that has run, the thread
+ * is sent to an exit handler, which protects again whatever the walk had to
+ * unprotect for it.
+ ******************************************************************************/
+// =============================================================================
+
+
+
+// =============================================================================
+#if !defined (_CHANNEL_H)
+#define _CHANNEL_H
+// =============================================================================
+
+
+
+// =============================================================================
+// INCLUDES
+
+#include <stdint.h>
+// =============================================================================
+
+
+
+// =============================================================================
+// MACROS
+
+// Environment variable holding the channel's file descriptor.
+#define CHANNEL_FD_ENV "VMT_CHANNEL_FD"
+
+// Environment variable, set by the catcher on each exec (), that has the new
+// program's manager append to the trace of its process instead of starting it.
+#define TRACE_APPEND_ENV "VMT_TRACE_APPEND"
+
+// Size of the channel.
+#define CHANNEL_SIZE 32768
+
+// Number of processes that can be registered at once.
+#define CHANNEL_PROCESSES 64
+
+// Number of threads that can have a slot at once.
+#define CHANNEL_SLOTS 128
+// =============================================================================
+
+
+
+// =============================================================================
+// TYPES
+
+// Contains the address of functions in the child.
+struct addr_info {
+
+	void* walker;
+	// Exit handler of a walked system call that has no other, which is passed
+	// the call's result, and protects again what the walk unprotected.
+	void* done;
+	void* brk;
+	void* mmap;
+	void* munmap;
+	void* mprotect;
+	void* sigaction;
+
+};
+
+// The registration of one process.
+struct channel_process {
+
+	// The process; 0 if the entry is free.
+	volatile uint32_t pid;
+	// Set by the manager once the rest is filled in; cleared by the catcher
+	// when the process executes another program.
+	volatile uint32_t registered;
+	// Address of the channel in the process.
+	uintptr_t self;
+	struct addr_info info;
+	// Faults recorded, counted only when the catcher attached to the process
+	// for a given number of them.
+	volatile uint64_t faults;
+
+};
+
+// The requests of one thread.
+struct channel_slot {
+
+	// The thread that has the slot; 0 if it is free.
+	volatile uint32_t tid;
+	// Sequence number of the last request posted by the catcher.
+	volatile uint32_t request;
+	// Sequence number of the last request completed by the thread; the futex
+	// word woken on completion.
+	volatile uint32_t done;
+	// The system call to walk, as the system call table describes it.
+	long nr;
+	unsigned long args[6];
+	// Bytes the walker was passed, and pages it unprotected, for the request.
+	uint64_t walked;
+	uint64_t unprotected;
+	// Set while the thread is in the manager's fault handler, when the catcher
+	// attached to the program; a thread is not left stopped there to detach.
+	volatile uint32_t busy;
+
+};
+
+// The shared memory.
+struct channel {
+
+	struct channel_process processes[CHANNEL_PROCESSES];
+	struct channel_slot slots[CHANNEL_SLOTS];
+
+};
+
+_Static_assert(sizeof(struct channel) <= CHANNEL_SIZE, "the channel does not fit in CHANNEL_SIZE");
+// =============================================================================
+
+
+
+// =============================================================================
+#endif /* _CHANNEL_H */
+// =============================================================================
@@ -0,0 +1,193 @@
+// =============================================================================
+/*******************************************************************************
+ * A test of the compressed cache's LRU queue.  Random adds, moves and removes
+ * of page numbers from a small pool are checked against a plain array kept in
+ * LRU order, then the average time of each operation is reported for a queue
+ * of the requested size.
+ ******************************************************************************/
+// =============================================================================
+
+
+
+// =============================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "comp_cache.h"
+// =============================================================================
+
+
+
+// =============================================================================
+// MACROS AND CONSTANTS
+
+/* The size of a page. */
+#define PAGE_SIZE 4096
+
+/* The number of distinct page numbers the checked operations draw from. */
+#define POOL 5000
+
+/* The base address of the page numbers. */
+#define BASE 0x00007f0000000000
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Gets a monotonic time in nanoseconds.
+ */
+static uint64_t now_ns ()
+{
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+
+} // now_ns ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Removes a page number from the reference array, if it is there.
+ *
+ * @param order  The page numbers, least recently added first.
+ * @param length The number of page numbers in the array.
+ * @param page   The page number.
+ * @return       Whether it was there.
+ */
+static bool reference_remove (uintptr_t* order, long* length, uintptr_t page)
+{
+
+  for (long i = 0; i < *length; i++) {
+    if (order[i] == page) {
+      for (long j = i; j < *length - 1; j++) {
+        order[j] = order[j + 1];
+      }
+      *length -= 1;
+      return true;
+    }
+  }
+  return false;
+
+} // reference_remove ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Checks random operations against the reference array.
+ *
+ * @param ops The number of operations.
+ */
+static void check (long ops)
+{
+
+  static uintptr_t order[POOL];
+  long length = 0;
+
+  for (long op = 0; op < ops; op++) {
+    uintptr_t page = BASE + (uintptr_t) (random() % POOL) * PAGE_SIZE;
+    if (random() % 3 != 0) {
+      assert(cc_add(page));
+      reference_remove(order, &length, page);
+      order[length++] = page;
+    } else {
+      assert(cc_remove(page) == reference_remove(order, &length, page));
+    }
+
+    assert(cc_count() == (unsigned long) length);
+    assert(cc_oldest() == ((length > 0) ? order[0] : 0));
+    assert(cc_contains(page) == (length > 0 && order[length - 1] == page));
+  }
+
+  for (long i = 0; i < length; i++) {
+    assert(cc_contains(order[i]));
+    assert(cc_remove(order[i]));
+  }
+  assert(is_empty());
+
+} // check ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Times adds of new page numbers, moves to the front and removes, for a queue
+ * of a given size.
+ *
+ * @param pages The number of page numbers in the queue.
+ */
+static void measure (long pages)
+{
+
+  uintptr_t* shuffled = malloc(pages * sizeof(uintptr_t));
+  assert(shuffled != NULL);
+  for (long i = 0; i < pages; i++) {
+    shuffled[i] = BASE + (uintptr_t) i * PAGE_SIZE;
+  }
+  for (long i = pages - 1; i > 0; i--) {
+    long j = random() % (i + 1);
+    uintptr_t temp = shuffled[i];
+    shuffled[i] = shuffled[j];
+    shuffled[j] = temp;
+  }
+
+  uint64_t start = now_ns();
+  for (long i = 0; i < pages; i++) {
+    cc_add(shuffled[i]);
+  }
+  uint64_t added = now_ns();
+  for (long i = pages - 1; i >= 0; i--) {
+    cc_add(shuffled[i]);
+  }
+  uint64_t moved = now_ns();
+  for (long i = 0; i < pages; i++) {
+    cc_remove(shuffled[i]);
+  }
+  uint64_t removed = now_ns();
+  assert(is_empty());
+
+  printf("%10ld pages:\tadd %6.1f ns\tmove %6.1f ns\tremove %6.1f ns\n", pages,
+         (double) (added - start) / pages, (double) (moved - added) / pages,
+         (double) (removed - moved) / pages);
+  free(shuffled);
+
+} // measure ()
+// =============================================================================
+
+
+
+// =============================================================================
+int main (int argc, char** argv)
+{
+
+  if (argc > 2) {
+    fprintf(stderr, "USAGE: %s [ <# pages> ]\n", argv[0]);
+    exit(1);
+  }
+  long pages = (argc == 2) ? atol(argv[1]) : 1000000;
+
+  srandom(1);
+  assert(cc_init());
+  assert(is_empty());
+
+  check(200000);
+  printf("Checked against the reference queue.\n");
+
+  measure(pages);
+
+  return 0;
+
+} // main ()
+// =============================================================================
@@ -4,6 +4,24 @@
  * coming from `manager.c`.  The mechanism will be reading in page numbers of
  * protected pages and putting them in a simple LRU queue.
  *
+ * The nodes of the queue live in segments, in the private heap (see
+ * `vmt_mman.h`), and point at each other by index, and an open-addressed index
+ * maps each page number to its node, so that no operation walks the queue.
+ * Every operation holds a spin lock, as the manager calls in from concurrent
+ * faults (with every signal blocked, so that the lock is never taken twice by
+ * one thread), and so the queue grows without copying or rehashing under it:
+ * the next segment of nodes and the next index, each twice as large, are
+ * allocated outside the lock before they are needed, and the next index is
+ * filled a few nodes at a time, by the operations that follow.
+ *
+ * A page's contents are compressed (see `lz.c`) as it joins the queue, and the
+ * compressed bytes kept in a size-class pool (see `zpool.c`), so that the
+ * manager can release the page's memory; they are decompressed back into the
+ * page as it leaves.  A page filled with one word is kept as that word alone,
+ * and never compressed.  Compression and decompression run outside the lock, on
+ * copies, since the pool may move what it holds: a background thread compacts
+ * it, under the lock, a little at a time.
+ *
  * @author Luka Duranovic <luk.duranovic@gmail.com>
  *                        <lduranovic22@amherst.edu>
  * @date   Monday, 26 July, 2021
@@ -21,8 +39,14 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <stddef.h>
-#include <sys/mman.h> // for `mmap()` and `munmap()`
-#include "compressed-caching.h"
+#include <string.h>   // for `memcpy()`
+#include <sched.h>    // for `sched_yield()`
+#include <time.h>     // for `clock_gettime()`
+#include "comp_cache.h"
+#include "lz.h"
+#include "samefill.h"
+#include "vmt_mman.h"
+#include "zpool.h"
 // =============================================================================
 
 
@@ -32,6 +56,25 @@
 
 /* The initial capacity of the LRU queue. */
 #define INITIAL_CAPACITY     1024
+
+/* The most nodes that each operation adds to the next index while the index
+ * doubles. */
+#define MOVE_NODES           8
+
+/* The multiplier that scatters page numbers across the index (Fibonacci
+ * hashing). */
+#define HASH_MULTIPLIER      0x9E3779B97F4A7C15UL
+
+/* The number of low bits of a page number that are always zero. */
+#define PAGE_SHIFT           12
+
+/* How long the compactor sleeps between passes, in nanoseconds. */
+#define COMPACT_INTERVAL_NS  100000000
+
+/* The most stored contents that the compactor moves while it holds the lock,
+ * so that faults wait on it only briefly; it drops the lock, and yields,
+ * between batches. */
+#define COMPACT_BUDGET       32
 // =============================================================================
 
 
@@ -40,428 +83,1045 @@
 // DATA MEMBERS
 
 /* The LRU queue that will be storing all the page numbers. */
-static lru_queue *queue;
+static lru_queue  queue_storage;
+static lru_queue *queue = NULL;
+
+/* The lock that every operation on the queue holds. */
+static volatile int queue_lock = 0;
+
+/* What has been stored and restored, under the lock. */
+static cc_stats stats;
+
+/* The pool that holds the stored contents, under the lock. */
+static zpool_s pool;
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Initializes the compressed caching module. Creates the LRU queue that will
- * keep track of protected pages.
+ * Takes the queue's lock.
+ */
+static void lock_queue ()
+{
+
+  while (__atomic_exchange_n(&queue_lock, 1, __ATOMIC_ACQUIRE) != 0) {
+    while (__atomic_load_n(&queue_lock, __ATOMIC_RELAXED) != 0) {
+      __builtin_ia32_pause();
+    }
+  }
+
+} // lock_queue ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Releases the queue's lock.
  */
-void cc_init ()
+static void unlock_queue ()
 {
 
-  write(1, "cc_init() is called.\n", 21);
-  create_queue();
+  __atomic_store_n(&queue_lock, 0, __ATOMIC_RELEASE);
 
-} // void comp_cache_init ()
+} // unlock_queue ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Creates a new LRU queue which will keep track of the page numbers of
- * protected pages.
+ * Gets a monotonic time in nanoseconds.
+ */
+static uint64_t now_ns ()
+{
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+
+} // now_ns ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Allocates zeroed memory for an array.
  *
- * @return          A pointer to the newly created LRU queue.
+ * @param size The size of the array, in bytes.
+ * @return     The array, or `NULL` if it could not be allocated.
  */
-void create_queue ()
+static void *map_array (size_t size)
 {
 
-  queue->capacity = INITIAL_CAPACITY;
-  // Now using `mmap` here...
-  queue           = mmap(NULL, queue->capacity * sizeof(qnode),
-      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-  queue->count    = 0;
-  queue->head     = NULL;
+  return vmt_calloc(1, size);
 
-  if (queue->capacity == NULL) {
-    write(1, "mmap faield inside 'cc_init()'!\n", 32);
-    exit(1);
+} // map_array ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Gets the node with a given index, from the segment that holds it.
+ *
+ * @param node The index of the node.
+ * @return     The node.
+ */
+static q_node *node_at (uint32_t node)
+{
+
+  if (node < INITIAL_CAPACITY) {
+    return &queue->segments[0][node];
   }
+  unsigned int  segment = 64 - __builtin_clzl(node / INITIAL_CAPACITY);
+  unsigned long first   = (unsigned long) INITIAL_CAPACITY << (segment - 1);
+  return &queue->segments[segment][node - first];
 
-} // lru_queue *create_queue ()
+} // node_at ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Double the capacity of the queue.
+ * The bucket of an index in which the search for a page number starts.
  *
- * @param queue The pointer to the queue whose space will be doubled.
+ * @param page_num The page number.
+ * @param mask     The number of buckets of the index, less one.
+ * @return         Its home bucket.
  */
-void expand_queue ()
+static unsigned long home_bucket (uintptr_t page_num, unsigned long mask)
 {
 
-  // Allocate a new, double-sized, `mmap()` region.
-  lru_queue *old_queue = queue; 
-  queue->capacity *= 2;
-  queue->storage = mmap(NULL, queue->capacity * sizeof(qnode),
-      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-  if (queue->storage == NULL) {
-    write(1, "mmap failed inside 'expand_queue()'!\n", 37);
-    exit(1);
-  }
+  uint64_t hash = (uint64_t) (page_num >> PAGE_SHIFT) * HASH_MULTIPLIER;
+  return (unsigned long) (hash >> 32) & mask;
+
+} // home_bucket ()
+// =============================================================================
+
 
-  // For each element in the old LRU queue, insert it in the new one.
-  
 
-}
+// =============================================================================
+/**
+ * Finds the bucket of an index that holds a page number.
+ *
+ * @param index    The index.
+ * @param mask     The number of its buckets, less one.
+ * @param page_num The page number to look for.
+ * @return         The bucket if the page number is in the index, or the empty
+ *                 bucket at which the search stopped otherwise.
+ */
+static unsigned long find_bucket (const uint32_t *index, unsigned long mask,
+    uintptr_t page_num)
+{
+
+  unsigned long bucket = home_bucket(page_num, mask);
+  while (index[bucket] != 0 && node_at(index[bucket] - 1)->page_num != page_num) {
+    bucket = (bucket + 1) & mask;
+  }
+  return bucket;
+
+} // find_bucket ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Attempt to find the given node in the LRU queue.
+ * Empties a bucket of an index, shifting back the entries after it that
+ * would otherwise no longer be found, so that no tombstones are needed.
  *
- * @param page_number The page number to look for.
- * @return            The node if it is in the queue. `NULL` otherwise.
+ * @param index  The index.
+ * @param mask   The number of its buckets, less one.
+ * @param bucket The bucket to empty.
  */
-q_node *find (intptr_t page_number)
+static void clear_bucket (uint32_t *index, unsigned long mask,
+    unsigned long bucket)
 {
 
-  if (!is_init()) {
-    char *message = "find() called and queue isn't initialized.\n";
-    write(1, message, 43);
-    exit(1);
+  unsigned long next = (bucket + 1) & mask;
+  while (index[next] != 0) {
+    unsigned long home = home_bucket(node_at(index[next] - 1)->page_num, mask);
+
+    // The entry moves back unless its home lies cyclically in (bucket, next].
+    bool stays = (bucket < next) ? (bucket < home && home <= next)
+                                 : (bucket < home || home <= next);
+    if (!stays) {
+      index[bucket] = index[next];
+      bucket = next;
+    }
+    next = (next + 1) & mask;
   }
+  index[bucket] = 0;
 
-  q_node *p = queue->head;
-  int counter = 0;
+} // clear_bucket ()
+// =============================================================================
 
-  while (p != NULL && p->page_num != page_number) {
-    p = p->next;
-    counter++;
+
+
+// =============================================================================
+/**
+ * Adds a few nodes to the next index, while the index doubles, in the order
+ * of the nodes, so that no operation rehashes the whole queue; once every node
+ * is in it, it replaces the index, and the old one is left to be freed outside
+ * the lock.  The lock must be held.
+ */
+static void fill_next_index ()
+{
+
+  for (int i = 0; i < MOVE_NODES && queue->next_index != NULL; i++) {
+    if (queue->moved < queue->used) {
+      q_node *n = node_at((uint32_t) queue->moved);
+      if (n->page_num != 0) {
+        queue->next_index[find_bucket(queue->next_index, queue->next_mask, n->page_num)] =
+            (uint32_t) queue->moved + 1;
+      }
+      queue->moved++;
+    } else {
+      queue->retired_index = queue->index;
+      queue->index         = queue->next_index;
+      queue->index_mask    = queue->next_mask;
+      queue->next_index    = NULL;
+      queue->grow_wanted   = true;
+    }
   }
 
-  if (p != NULL) {
-    p->index = counter;
-    return p;
+} // fill_next_index ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Starts doubling the index, with the spare one, once the queue holds page
+ * numbers for half of its buckets, and notes whether a spare should be
+ * allocated outside the lock: a segment once half of the nodes have been used,
+ * and an index once the queue holds page numbers for a quarter of the buckets.
+ * The lock must be held.
+ */
+static void check_growth ()
+{
+
+  if (queue->count > queue->index_mask / 2 && queue->next_index == NULL &&
+      queue->retired_index == NULL && queue->spare_index != NULL) {
+    queue->next_index  = queue->spare_index;
+    queue->next_mask   = 2 * queue->index_mask + 1;
+    queue->moved       = 0;
+    queue->spare_index = NULL;
   }
 
-  return NULL;
+  if ((queue->spare_segment == NULL && queue->segment_count < CC_SEGMENTS &&
+       queue->used >= queue->capacity / 2) ||
+      (queue->spare_index == NULL && queue->next_index == NULL &&
+       queue->count >= (queue->index_mask + 1) / 4)) {
+    queue->grow_wanted = true;
+  }
 
-} // int find (intptr_t)
+} // check_growth ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Adds a page number to the LRU queue.
+ * Allocates what the queue is to grow into, if it wants anything: the next
+ * segment of nodes, the next index, or both; and frees the index that a
+ * doubling left.  The allocations happen outside the lock, so that a fault
+ * never waits on them; the spares are only installed under it.  The lock must
+ * not be held.
+ */
+static void prepare_growth ()
+{
+
+  if (!__atomic_load_n(&queue->grow_wanted, __ATOMIC_RELAXED)) {
+    return;
+  }
+
+  lock_queue();
+  unsigned long segment_nodes = (queue->spare_segment == NULL &&
+                                 queue->segment_count < CC_SEGMENTS)
+                                ? queue->capacity : 0;
+  unsigned long index_buckets = (queue->spare_index == NULL &&
+                                 queue->next_index == NULL)
+                                ? 2 * (queue->index_mask + 1) : 0;
+  uint32_t *retired    = queue->retired_index;
+  queue->retired_index = NULL;
+  queue->grow_wanted   = false;
+  unlock_queue();
+
+  vmt_free(retired);
+  q_node   *segment = (segment_nodes > 0) ? vmt_malloc(segment_nodes * sizeof(q_node)) : NULL;
+  uint32_t *index   = (index_buckets > 0) ? map_array(index_buckets * sizeof(uint32_t)) : NULL;
+  if (segment == NULL && index == NULL) {
+    return;
+  }
+
+  // Another thread may have installed spares meanwhile; the queue keeps only
+  // those that still fit it.
+  lock_queue();
+  if (segment != NULL && queue->spare_segment == NULL && queue->capacity == segment_nodes) {
+    queue->spare_segment = segment;
+    segment              = NULL;
+  }
+  if (index != NULL && queue->spare_index == NULL && queue->next_index == NULL &&
+      2 * (queue->index_mask + 1) == index_buckets) {
+    queue->spare_index = index;
+    index              = NULL;
+  }
+  unlock_queue();
+
+  vmt_free(segment);
+  vmt_free(index);
+
+} // prepare_growth ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Initializes the compressed caching module. Creates the LRU queue that will
+ * keep track of protected pages.
  *
- * @param page_num The page number that needs to be added.
+ * @return `true` if the queue could be created. `false` otherwise.
  */
-void cc_add (intptr_t page_num)
+bool cc_init ()
 {
 
-  // DEBUG: Show me that `cc_add()` is getting called.
-  char *debug = "'cc_add()' is called.\n";
-  write(1, debug, 22);
+  lru_queue *created = &queue_storage;
+  *created = (lru_queue) { 0 };
+  created->capacity      = INITIAL_CAPACITY;
+  created->head          = CC_NIL;
+  created->tail          = CC_NIL;
+  created->free          = CC_NIL;
+  created->index_mask    = 2 * INITIAL_CAPACITY - 1;
+  created->segments[0]   = map_array(INITIAL_CAPACITY * sizeof(q_node));
+  created->segment_count = 1;
+  created->index         = map_array(2 * INITIAL_CAPACITY * sizeof(uint32_t));
+
+  if (created->segments[0] == NULL || created->index == NULL ||
+      !zpool_create(&pool)) {
+    write(2, "allocation failed inside 'cc_init()'!\n", 38);
+    return false;
+  }
 
-  if (!is_init()) {
-    char *message = "cc_add() is called and queue isn't initialized.\n";
-    write (1, message, 47);
-    exit(1);
+  queue = created;
+
+  // The kernel for same-filled pages is chosen now, not at the first eviction,
+  // in the handler.
+  samefill_kernel();
+  return true;
+
+} // cc_init ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Takes a free node: from the free list, or else one never used, installing
+ * the spare segment if every node of the others has been.  The lock must be
+ * held.
+ *
+ * @return The index of the node, or `CC_NIL` if there is none free and no
+ *         spare segment.
+ */
+static uint32_t alloc_node ()
+{
+
+  if (queue->free != CC_NIL) {
+    uint32_t node = queue->free;
+    queue->free = node_at(node)->next;
+    return node;
+  }
+
+  if (queue->used == queue->capacity) {
+    if (queue->spare_segment == NULL) {
+      queue->grow_wanted = true;
+      return CC_NIL;
+    }
+    queue->segments[queue->segment_count++] = queue->spare_segment;
+    queue->spare_segment = NULL;
+    queue->capacity     *= 2;
   }
+  return (uint32_t) queue->used++;
+
+} // alloc_node ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Removes a node from the queue in constant time, by relinking its
+ * neighbours.
+ *
+ * @param node The index of the node that is to be removed from the queue.
+ */
+static void disconnect_node (uint32_t node)
+{
 
-  q_node *node = find(page_num);
+  q_node *n = node_at(node);
 
-  if (node == NULL)
-    add_new(page_num);
+  if (n->prev != CC_NIL)
+    node_at(n->prev)->next = n->next;
   else
-    move_to_front(node);
+    queue->head = n->next;
 
-} // void add (intptr_t)
+  if (n->next != CC_NIL)
+    node_at(n->next)->prev = n->prev;
+  else
+    queue->tail = n->prev;
+
+} // disconnect_node ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Adds a completely new page number to the queue.
+ * Links a node in at the front of the queue.
  *
- * @param page_num The page number to add.
+ * @param node The index of the node that is to be added.
  */
-void add_new (intptr_t page_num)
+static void connect_front (uint32_t node)
 {
 
-  if (queue->head == NULL) {
-    queue->head = create_node(page_num, NULL, NULL);
-  } else {
-    queue->head = create_node(page_num, NULL, queue->head);
+  q_node *n = node_at(node);
+  n->prev = CC_NIL;
+  n->next = queue->head;
+
+  if (queue->head != CC_NIL)
+    node_at(queue->head)->prev = node;
+  else
+    queue->tail = node;
+  queue->head = node;
+
+} // connect_front ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Puts a page number at the front of the LRU queue; if it is already in the
+ * queue, it is moved there.  The lock must be held.
+ *
+ * @param page_num The page number.
+ * @return         The index of its node, or `CC_NIL` if the queue was full
+ *                 and had no spare segment to grow into.
+ */
+static uint32_t insert_front (uintptr_t page_num)
+{
+
+  fill_next_index();
+  unsigned long bucket = find_bucket(queue->index, queue->index_mask, page_num);
+  if (queue->index[bucket] != 0) {
+
+    // Move to front.
+    uint32_t node = queue->index[bucket] - 1;
+    if (queue->head != node) {
+      disconnect_node(node);
+      connect_front(node);
+    }
+    return node;
+
+  }
+
+  // Add new; the index keeps a quarter of its buckets empty, so that every
+  // search ends soon, and while it doubles, a node that the next index has
+  // passed goes in both.
+  if (queue->count >= queue->index_mask - queue->index_mask / 4) {
+    queue->grow_wanted = true;
+    return CC_NIL;
+  }
+  uint32_t node = alloc_node();
+  if (node == CC_NIL) {
+    return CC_NIL;
   }
 
-} // void add_new (intptr_t)
+  q_node *n = node_at(node);
+  n->page_num = page_num;
+  n->handle   = 0;
+  n->size     = 0;
+  n->fill     = 0;
+  connect_front(node);
+  queue->index[bucket] = node + 1;
+  if (queue->next_index != NULL && node < queue->moved) {
+    queue->next_index[find_bucket(queue->next_index, queue->next_mask, page_num)] = node + 1;
+  }
+  queue->count++;
+  check_growth();
+  return node;
+
+} // insert_front ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Moves a page number that is already in the queue to the front of the queue.
+ * Takes a page number out of the queue.  The lock must be held.
  *
- * @param node The `q_node` that holds the page number in question.
+ * @param page_num The page number.
+ * @param handle   Receives the handle of its stored contents, or 0 if there
+ *                 are none; they stay in the pool, for the caller to free.
+ * @param size     Receives their size, or `CC_FILLED_SIZE`.
+ * @param fill     Receives the word that filled the page, for that size.
+ * @return         `true` if it was in the queue. `false` otherwise.
  */
-void move_to_front (q_node *node)
+static bool take_node (uintptr_t page_num, uint32_t *handle, uint32_t *size,
+    uint64_t *fill)
 {
 
-  if (node == NULL) {
-    exit(1);
+  fill_next_index();
+  unsigned long bucket = find_bucket(queue->index, queue->index_mask, page_num);
+  uint32_t      entry  = queue->index[bucket];
+  if (entry == 0) {
+    *handle = 0;
+    *size   = 0;
+    return false;
   }
 
+  uint32_t node = entry - 1;
+  q_node  *n    = node_at(node);
+  *handle = n->handle;
+  *size   = n->size;
+  *fill   = n->fill;
+  if (*handle != 0) {
+    stats.stored_pages--;
+    stats.stored_bytes -= *size;
+  } else if (*size == CC_FILLED_SIZE) {
+    stats.stored_pages--;
+  }
+
+  clear_bucket(queue->index, queue->index_mask, bucket);
+  if (queue->next_index != NULL && node < queue->moved) {
+    clear_bucket(queue->next_index, queue->next_mask,
+                 find_bucket(queue->next_index, queue->next_mask, page_num));
+  }
   disconnect_node(node);
-  queue->head = connect_node(node, NULL, queue->head);
+  n->page_num = 0;
+  n->next     = queue->free;
+  queue->free = node;
+  queue->count--;
+  return true;
 
-} // void move_to_front (q_node *)
+} // take_node ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Removes a page number from the compressed cache.
+ * Adds a page number to the front of the LRU queue, without its contents; if
+ * it is already in the queue, it is moved there.
  *
- * @param page_num The page number that is to be removed.
+ * @param page_num The page number that needs to be added.
+ * @return         `true` if the page number is in the queue. `false` if the
+ *                 queue was full and could not grow.
  */
-void cc_remove (intptr_t page_num)
+bool cc_add (uintptr_t page_num)
 {
 
-  // DEBUG: Tell me that a page is getting removed.
-  char *message = "Calling 'cc_remove()'\n";
-  write(1, message, 22);
+  if (!is_init()) {
+    return false;
+  }
+
+  prepare_growth();
+  lock_queue();
+  uint32_t node = insert_front(page_num);
+  unlock_queue();
+  return node != CC_NIL;
+
+} // cc_add ()
+// =============================================================================
+
 
-  q_node *node = find(page_num); 
 
-  if (node == NULL) {
-    exit(1);
+// =============================================================================
+/**
+ * Compresses the contents of a page and adds it to the front of the queue
+ * with them.  A page that holds one word over and over is not compressed: it
+ * is added with the word alone.  The page must be readable, and must not
+ * change meanwhile.  A page that does not compress well enough is added
+ * without its contents.
+ *
+ * @param page_num  The page number (the address of the page).
+ * @param page_size The size of the page.
+ * @return          `CC_COMPRESSED`, `CC_ZERO_FILLED` or `CC_SAME_FILLED` if
+ *                  its contents are stored, so that its memory may be
+ *                  released. `CC_NOT_STORED` otherwise.
+ */
+int cc_store (uintptr_t page_num, size_t page_size)
+{
+
+  if (!is_init()) {
+    return CC_NOT_STORED;
   }
 
-  disconnect_node(node);
+  // Whatever the queue grows into is allocated before the lock is taken, and
+  // usually already by the compactor.
+  prepare_growth();
+
+  uint64_t fill;
+  if (samefill_check((const void *) page_num, page_size, &fill)) {
+    lock_queue();
+    uint32_t node   = insert_front(page_num);
+    bool     stored = node != CC_NIL && node_at(node)->handle == 0 &&
+                      node_at(node)->size != CC_FILLED_SIZE;
+    if (stored) {
+      node_at(node)->size = CC_FILLED_SIZE;
+      node_at(node)->fill = fill;
+      stats.stored_pages++;
+      if (fill == 0)
+        stats.zero_filled++;
+      else
+        stats.same_filled++;
+    }
+    unlock_queue();
+    return !stored ? CC_NOT_STORED : (fill == 0) ? CC_ZERO_FILLED : CC_SAME_FILLED;
+  }
+
+  uint8_t  buffer[CC_MAX_STORED];
+  uint64_t start  = now_ns();
+  size_t   length = lz_compress((const uint8_t *) page_num, page_size, buffer, sizeof(buffer));
+  uint64_t end    = now_ns();
+
+  lock_queue();
+
+  stats.compressions++;
+  stats.compress_ns += end - start;
+  stats.bytes_in    += page_size;
 
-} // void cc_remove (intptr_t)
+  uint32_t handle = 0;
+  uint32_t node   = insert_front(page_num);
+  if (node != CC_NIL && node_at(node)->handle == 0 &&
+      node_at(node)->size != CC_FILLED_SIZE && length > 0) {
+    handle = zpool_alloc(&pool, length);
+  }
+  if (handle != 0) {
+    memcpy(zpool_map(&pool, handle), buffer, length);
+    node_at(node)->handle = handle;
+    node_at(node)->size   = (uint32_t) length;
+    stats.bytes_out    += length;
+    stats.stored_pages++;
+    stats.stored_bytes += length;
+  } else {
+    stats.incompressible++;
+    stats.bytes_out += page_size;
+  }
+
+  unlock_queue();
+  return (handle != 0) ? CC_COMPRESSED : CC_NOT_STORED;
+
+} // cc_store ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Checks whether the queue has been initialized.
+ * Takes a page out of the queue, copying out its stored contents if it has
+ * them, and freeing them.
  *
- * @return `true` if the queue has been initialized. `false` otherwise.
+ * @param page_num The page number.
+ * @param buffer   Receives the stored contents, for `cc_load()`: the
+ *                 compressed bytes, or the word that filled the page.
+ * @param capacity The size of `buffer`; `CC_MAX_STORED` always suffices.
+ * @return         The size of the stored contents, `CC_FILLED_SIZE` for a
+ *                 word, or 0 if the page has none (or is not in the queue).
  */
-bool is_init ()
+size_t cc_take (uintptr_t page_num, uint8_t *buffer, size_t capacity)
 {
 
-  return queue != NULL;
+  if (!is_init()) {
+    return 0;
+  }
 
-} // bool is_init ()
+  uint32_t handle, size = 0;
+  uint64_t fill;
+  lock_queue();
+  take_node(page_num, &handle, &size, &fill);
+  if (handle != 0) {
+    memcpy(buffer, zpool_map(&pool, handle), (size < capacity) ? size : capacity);
+    zpool_free(&pool, handle, size);
+  } else if (size == CC_FILLED_SIZE) {
+    memcpy(buffer, &fill, (sizeof(fill) < capacity) ? sizeof(fill) : capacity);
+  }
+  unlock_queue();
+  return (handle != 0 || size == CC_FILLED_SIZE) ? size : 0;
+
+} // cc_take ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Checks whether the LRU queue is empty or not. It is assumed that this method
- * will be called on an initialized queue.
+ * Decompresses the stored contents of a page back into it, or fills it with
+ * its word.  The page must be writable.
  *
- * @return `true` if the queue is empty. `false` otherwise.
+ * @param page_num  The page number (the address of the page).
+ * @param page_size The size of the page.
+ * @param data      The stored contents, from `cc_take()`.
+ * @param size      Their size, or `CC_FILLED_SIZE`.
+ * @return          `true` if the page was restored whole. `false` otherwise.
  */
-bool is_empty ()
+bool cc_load (uintptr_t page_num, size_t page_size, const uint8_t *data,
+    size_t size)
 {
 
-  if (!is_init()) {
-    exit(1);
+  if (size == CC_FILLED_SIZE) {
+    uint64_t  fill;
+    uint64_t *words = (uint64_t *) page_num;
+    memcpy(&fill, data, sizeof(fill));
+    for (size_t i = 0; i < page_size / sizeof(uint64_t); i++) {
+      words[i] = fill;
+    }
+    return true;
   }
 
-  return queue->head == NULL;
+  uint64_t start  = now_ns();
+  size_t   length = lz_decompress(data, size, (uint8_t *) page_num, page_size);
+  uint64_t end    = now_ns();
 
-} // bool is_empty ()
+  lock_queue();
+  stats.decompressions++;
+  stats.decompress_ns += end - start;
+  unlock_queue();
+
+  return length == page_size;
+
+} // cc_load ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Prints the contents of the queue.
+ * Maps a region for the pool to carve zspages from, if it has no next one,
+ * outside the lock, so that storing a page rarely maps anything.
  */
-void cc_print_queue ()
+static void prepare_region ()
+{
+
+  lock_queue();
+  bool needed = zpool_needs_region(&pool);
+  unlock_queue();
+  if (!needed) {
+    return;
+  }
+
+  void *region = vmt_map_pages(ZPOOL_REGION_PAGES);
+  if (region == NULL) {
+    return;
+  }
+  lock_queue();
+  bool taken = zpool_add_region(&pool, region);
+  unlock_queue();
+  if (!taken) {
+    vmt_unmap_pages(region, ZPOOL_REGION_PAGES);
+  }
+
+} // prepare_region ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Compacts the pool of stored contents: moves them out of the emptiest
+ * zspages of each size class into the fullest, and releases the zspages
+ * emptied.
+ *
+ * @param budget The most stored contents to move.
+ * @return       The number moved; less than `budget` once the pool is as
+ *               compact as it gets.
+ */
+size_t cc_compact (size_t budget)
 {
 
   if (!is_init()) {
-    exit(1);
+    return 0;
   }
 
-  q_node *p = queue->head;
-  
-  while (p != NULL) {
-    if (p->next != NULL)
-      printf("%p -> ", p->page_num);
-    else
-      printf("%p", p->page_num);
-    p = p->next;
+  lock_queue();
+  size_t moved = zpool_compact(&pool, budget);
+  unlock_queue();
+  return moved;
+
+} // cc_compact ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * The compactor's loop, for a thread of its own: every `COMPACT_INTERVAL_NS`,
+ * allocates what the queue and the pool are to grow into, if anything, and
+ * compacts the pool a budget at a time, dropping the lock and yielding in
+ * between, until nothing moves.  The thread must have every signal blocked, so that it never
+ * takes the lock in a handler.
+ *
+ * @param arg Unused.
+ * @return    Never returns.
+ */
+void *cc_compactor (void *arg)
+{
+
+  (void) arg;
+  struct timespec interval = { 0, COMPACT_INTERVAL_NS };
+  while (true) {
+    nanosleep(&interval, NULL);
+    if (is_init()) {
+      prepare_growth();
+      prepare_region();
+    }
+    while (cc_compact(COMPACT_BUDGET) == COMPACT_BUDGET) {
+      sched_yield();
+    }
   }
-  printf("\n\n");
+  return NULL;
 
-} // void cc_print_queue ()
+} // cc_compactor ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Creates a new LRU queue node, which stores the given page number.
+ * Removes a page number from the compressed cache, dropping its stored
+ * contents.
  *
- * @param page_num The page number that is to be stored.
- * @param prev     A pointer to the previous node.
- * @param next     A pointer to the next node.
- * @return         A pointer to the newly created node.
+ * @param page_num The page number that is to be removed.
+ * @return         `true` if it was in the queue. `false` otherwise.
  */
-q_node *create_node (intptr_t page_num, q_node *prev, q_node *next)
+bool cc_remove (uintptr_t page_num)
 {
 
-  q_node *node = (q_node *)__libc_malloc(sizeof(q_node));
-  node->page_num = page_num;
-  node->prev = prev;
-  node->next = next;
+  if (!is_init()) {
+    return false;
+  }
+
+  uint32_t handle, size;
+  uint64_t fill;
+  lock_queue();
+  bool found = take_node(page_num, &handle, &size, &fill);
+  if (handle != 0) {
+    zpool_free(&pool, handle, size);
+  }
+  if (handle != 0 || size == CC_FILLED_SIZE) {
+    stats.dropped++;
+  }
+  unlock_queue();
+  return found;
+
+} // cc_remove ()
+// =============================================================================
 
-  // If necessary, adjusts the pointers for the other two nodes.
-  if (prev != NULL)
-    prev->next = node;
-  if (next != NULL)
-    next->prev = node;
 
-  return node;
 
-} // q_node *create_node (intptr_t, q_node *, q_node *)
+// =============================================================================
+/**
+ * Checks whether a page number is in the queue.
+ *
+ * @param page_num The page number to look for.
+ * @return         `true` if it is in the queue. `false` otherwise.
+ */
+bool cc_contains (uintptr_t page_num)
+{
+
+  if (!is_init()) {
+    return false;
+  }
+
+  lock_queue();
+  bool found = queue->index[find_bucket(queue->index, queue->index_mask,
+                                        page_num)] != 0;
+  unlock_queue();
+  return found;
+
+} // cc_contains ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Connect the given node to the other two.
+ * The page number at the end of the queue, which was added least recently.
  *
- * @param node The node that is to be added.
- * @param prev A pointer to the node that needs to be come before this one.
- * @param next A pointer to the node that needs to come after this one.
+ * @return The page number, or 0 if the queue is empty.
  */
-q_node *connect_node (q_node *node, q_node *prev, q_node *next)
+uintptr_t cc_oldest ()
 {
 
-  if (node == NULL) {
-    printf("ERROR: Trying to connect a NULL node.\n");
-    exit(1);
+  if (!is_init()) {
+    return 0;
   }
 
-  node->prev = prev;
-  node->next = next;
+  lock_queue();
+  uintptr_t page_num = (queue->tail != CC_NIL) ? node_at(queue->tail)->page_num : 0;
+  unlock_queue();
+  return page_num;
+
+} // cc_oldest ()
+// =============================================================================
 
-  if (prev != NULL)
-    prev->next = node;
-  if (next != NULL)
-    next->prev = node;
 
-  return node;
 
-} // void connect_node (q_node *, q_node *, q_node *)
+// =============================================================================
+/**
+ * The number of page numbers in the queue.
+ *
+ * @return The number, or 0 if the queue has not been initialized.
+ */
+unsigned long cc_count ()
+{
+
+  return is_init() ? __atomic_load_n(&queue->count, __ATOMIC_RELAXED) : 0;
+
+} // cc_count ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Removes a node from the queue in constant time, by disconnecting the
- * pointers.
+ * Checks whether the queue has been initialized.
  *
- * @param node A pointer to the node that is to be removed from the queue.
+ * @return `true` if the queue has been initialized. `false` otherwise.
  */
-q_node *disconnect_node (q_node *node)
+bool is_init ()
 {
 
-  // Keep track of the pointers that come with the node.
-  q_node *prev = node->prev;
-  q_node *next = node->next;
+  return queue != NULL;
+
+} // bool is_init ()
+// =============================================================================
 
-  // Remove the node from the list.
-  if (prev != NULL)
-    prev->next = next;
-  if (next != NULL)
-    next->prev = prev;
 
-  // Adjust the pointers of this node.
-  node->prev = NULL;
-  node->next = NULL;
 
-  return node;
+// =============================================================================
+/**
+ * Checks whether the LRU queue is empty or not.
+ *
+ * @return `true` if the queue is empty or not initialized. `false` otherwise.
+ */
+bool is_empty ()
+{
+
+  return cc_count() == 0;
 
-} // void disconnect_node (q_node *)
+} // bool is_empty ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * Run some simple tests.
+ * Copies what has been stored and restored so far.
+ *
+ * @param copy Receives the statistics.
  */
-void main (int argc, char **argv)
+void cc_get_stats (cc_stats *copy)
 {
 
-  // Hopefully initialize the queue.
-  cc_init(); 
+  if (!is_init()) {
+    *copy = (cc_stats) { 0 };
+    return;
+  }
 
-  // Sanity check: Make sure that the queue is empty now...
-  printf("%d\n", is_empty());
+  zpool_stats_s pool_stats;
+  lock_queue();
+  *copy = stats;
+  zpool_get_stats(&pool, &pool_stats);
+  unlock_queue();
+  copy->pool_bytes = pool_stats.zspage_bytes + pool_stats.spare_bytes +
+                     pool_stats.metadata_bytes;
+  copy->compacted  = pool_stats.moved;
+  copy->released   = pool_stats.released;
+
+} // cc_get_stats ()
+// =============================================================================
 
-  // Let's try printing the queue??
-  cc_print_queue();
 
-  // Add two page numbers to the queue.
-  intptr_t pn1 = 0xab1;
-  intptr_t pn2 = 0xab2;
-  intptr_t pn3 = 0xab3;
-  intptr_t pn4 = 0xab4;
-  intptr_t pn5 = 0xab5;
-  intptr_t pn6 = 0xab6;
-  intptr_t pn7 = 0xab7;
-  cc_add(pn1);
-  cc_add(pn2);
-  cc_add(pn3);
-  cc_add(pn4);
-  cc_add(pn5);
-  cc_add(pn6);
-  cc_add(pn7);
 
-  // Show me what the queue is like now...
-  cc_print_queue();
+// =============================================================================
+/**
+ * Writes a summary of what has been stored and restored.
+ *
+ * @param fd The file descriptor to write it to.
+ */
+void cc_print_stats (int fd)
+{
 
-  // Add some already-seen page numbers now.
-  cc_add(pn1);
-  cc_add(pn3);
-  cc_add(pn5);
-  cc_add(pn7);
+  cc_stats s;
+  cc_get_stats(&s);
+
+  char   line[512];
+  double ratio = (s.bytes_out > 0) ? (double) s.bytes_in / s.bytes_out : 0;
+  double overhead = (s.stored_bytes > 0)
+      ? 100.0 * ((double) s.pool_bytes - s.stored_bytes) / s.stored_bytes : 0;
+  int    length = snprintf(line, sizeof(line),
+      "compressed cache: %lu pages compressed (%lu incompressible), ratio %.2f; "
+      "%lu zero-filled and %lu same-filled (%s); "
+      "%lu stored in %lu bytes, pool %zu bytes (%.1f%% overhead, %lu moved, "
+      "%lu zspages released); %lu restored, %lu dropped; "
+      "compress %.0f ns, decompress %.0f ns on average\n",
+      s.compressions, s.incompressible, ratio, s.zero_filled, s.same_filled,
+      samefill_kernel(), s.stored_pages, s.stored_bytes,
+      s.pool_bytes, overhead, s.compacted, s.released, s.decompressions,
+      s.dropped,
+      (s.compressions > 0) ? (double) s.compress_ns / s.compressions : 0,
+      (s.decompressions > 0) ? (double) s.decompress_ns / s.decompressions : 0);
+  if (length > 0) {
+    write(fd, line, (length < (int) sizeof(line)) ? (size_t) length : sizeof(line) - 1);
+  }
+
+} // cc_print_stats ()
+// =============================================================================
 
-  // Again show me what is happening on the screen.
-  cc_print_queue();
 
-  // Remove some things from the queue.
-  cc_remove(pn1);
-  // Show me what the queue is like now.
-  cc_print_queue();
 
-  // Add some more new page numbers.
-  intptr_t pn8 = 0xab8;
-  intptr_t pn9 = 0xab9;
-  cc_add(pn8);
-  cc_add(pn9);
+// =============================================================================
+/**
+ * Drops the queue's lock in the child of a `fork()`, where the thread that
+ * held it does not exist.
+ */
+void cc_fork_child ()
+{
 
-  // Show me what the situation is now...
-  cc_print_queue();
+  queue_lock = 0;
 
-} // void main (int argc, char **argv);
+} // cc_fork_child ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Prints the contents of the queue, most recently added first.
+ */
+void cc_print_queue ()
+{
+
+  if (!is_init()) {
+    return;
+  }
+
+  lock_queue();
+  for (uint32_t i = queue->head; i != CC_NIL; i = node_at(i)->next) {
+    if (node_at(i)->next != CC_NIL)
+      printf("%p -> ", (void *) node_at(i)->page_num);
+    else
+      printf("%p", (void *) node_at(i)->page_num);
+  }
+  printf("\n\n");
+  unlock_queue();
+
+} // void cc_print_queue ()
 // =============================================================================
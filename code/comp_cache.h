@@ -3,6 +3,17 @@
  * Header file for the compressed caching functionality of the VMTRACE
  * directory.
  *
+ * The pages the manager protects when they leave its list of unprotected pages
+ * are kept in an LRU queue, most recently protected first.  The queue is a
+ * doubly-linked list threaded by index through segments of nodes that never
+ * move, with a hash index from page to node, so that adding, moving to
+ * the front and removing a page each take constant time, even as the queue
+ * grows.  Each node can also hold the
+ * page's contents, compressed, while the page's own memory is released; the
+ * compressed bytes live in a size-class pool (see `zpool.c`), which a
+ * background thread compacts.  A page that holds one word over and over (see
+ * `samefill.c`) is not compressed: the node keeps the word alone.
+ *
  * @author Luka Duranovic <luk.duranovic@gmail.com>
  *                        <lduranovic22@amherst.edu>
  * @date   Monday, 26 July, 2021
@@ -18,41 +29,153 @@
 
 
 
+// =============================================================================
+// INCLUDES
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+// =============================================================================
+
+
+
+// =============================================================================
+// MACROS AND CONSTANTS
+
+/* The index of no node: the end of the queue, or of the free list. */
+#define CC_NIL UINT32_MAX
+
+/* The most segments of nodes that the queue grows to: each holds as many as
+ * all those before it, so that node indices stay below `CC_NIL`. */
+#define CC_SEGMENTS 22
+
+/* The most bytes that a page's contents are stored in.  Pages that compress
+ * to more are not stored, since they would save too little of their page. */
+#define CC_MAX_STORED 3072
+
+/* The size that `cc_take()` gives for the contents of a page that held one
+ * word over and over; it copies out the word. */
+#define CC_FILLED_SIZE UINT32_MAX
+
+/* What `cc_store()` did with a page's contents: nothing (the page must keep
+ * its memory), compressed them, or kept the one word that filled the page,
+ * zero or another. */
+#define CC_NOT_STORED  0
+#define CC_COMPRESSED  1
+#define CC_ZERO_FILLED 2
+#define CC_SAME_FILLED 3
+// =============================================================================
+
+
+
 // =============================================================================
 // TYPES AND STRUCTURES
 
 /**
- * A single LRU queue node. It will keep track of a page number and of two
- * pointers (since we want a doubly-linked list).
+ * A single LRU queue node. It keeps track of a page number and of the indices
+ * of its neighbours (since we want a doubly-linked list).  A free node is
+ * linked into the free list through `next`, with a page number of 0.
  */
 typedef struct q_node {
 
-  // Pointers to the previous and next nodes in the queue.
-  struct q_node *next, *prev;
-
   // The actual page number that is stored in this node.
-  intptr_t page_num;
+  uintptr_t page_num;
+
+  // The indices of the previous and next nodes in the queue.
+  uint32_t prev, next;
 
-  // The position of the node in the LRU queue. */
-  int index;
+  // The handle of the page's compressed contents in the pool, and their size;
+  // a handle of 0 if they are not stored.  A size of `CC_FILLED_SIZE` means
+  // that the page held `fill` over and over instead.
+  uint32_t handle;
+  uint32_t size;
+  uint64_t fill;
 
 } q_node; // struct q_node
 
 
 
 /**
- * The LRU queue struct. It will keep track of how many page numbers are
- * currently in the queue, and it will have a predefined maximal capacity.
+ * The LRU queue struct. It keeps track of how many page numbers are currently
+ * in the queue, of the segments of nodes that hold them, and of the index that
+ * maps each of them to its node.  Nothing is copied or rehashed whole as it
+ * grows: what it grows into is allocated outside the lock, as a spare, and
+ * only installed under it.
  */
 typedef struct lru_queue {
 
   // The number of page numbers in the queue.
   unsigned long count;
 
-  // The head of the queue.
-  q_node *head;
+  // The number of nodes in the segments, and of those ever used; the nodes
+  // from `used` on are free without being in the free list.
+  unsigned long capacity, used;
+
+  // The most and the least recently added nodes, and the first free one.
+  uint32_t head, tail, free;
+
+  // The nodes, in segments: the first holds the initial capacity of them, and
+  // each of the others as many as all those before it.
+  q_node *segments[CC_SEGMENTS];
+  unsigned int segment_count;
+
+  // The index: open addressing with linear probing, each bucket holding the
+  // index of a node plus one, or 0 if it is empty; a power of two buckets, at
+  // least twice as many as there are page numbers.
+  uint32_t *index;
+  unsigned long index_mask;
+
+  // While the index doubles, the next one, twice as large, which holds the
+  // nodes below `moved`; it is filled a few nodes at each operation.
+  uint32_t *next_index;
+  unsigned long next_mask, moved;
+
+  // The next segment and the next index (twice the size of this one), once
+  // allocated outside the lock, and a finished old index to free outside it.
+  q_node *spare_segment;
+  uint32_t *spare_index;
+  uint32_t *retired_index;
+
+  // Whether a spare is missing, or an old index is to be freed.
+  bool grow_wanted;
 
 } lru_queue; // struct lru_queue
+
+
+
+/**
+ * What the compressed cache has done so far.
+ */
+typedef struct cc_stats {
+
+  // Pages compressed, of which did not compress well enough to be stored.
+  unsigned long compressions, incompressible;
+
+  // Pages stored as the one word that filled them, zero or another, without
+  // being compressed.
+  unsigned long zero_filled, same_filled;
+
+  // Bytes of the pages compressed, and of what they compressed to (the whole
+  // page for those not stored).
+  unsigned long bytes_in, bytes_out;
+
+  // Pages stored now, and their compressed bytes.
+  unsigned long stored_pages, stored_bytes;
+
+  // The memory that the pool of the stored contents holds: its zspages, the
+  // pages it keeps for more, and its metadata.
+  size_t pool_bytes;
+
+  // Stored contents moved by compaction, and zspages it released.
+  unsigned long compacted, released;
+
+  // Pages decompressed back, and stored pages dropped without it.
+  unsigned long decompressions, dropped;
+
+  // The total time spent compressing and decompressing, in nanoseconds.
+  uint64_t compress_ns, decompress_ns;
+
+} cc_stats; // struct cc_stats
 // =============================================================================
 
 
@@ -61,25 +184,38 @@ typedef struct lru_queue {
 // FUNCTION DECLARATIONS
 
 /* Initialize everything needed for compressed caching to work. */
-void cc_init ();
+bool cc_init ();
+
+/* Adds a page number to the front of the queue, moving it if it is there. */
+bool cc_add (uintptr_t);
+
+/* Compresses a page's contents, or keeps the word that fills it, and adds it
+ * to the front of the queue with them. */
+int cc_store (uintptr_t, size_t);
+
+/* Takes a page out of the queue, copying out its stored contents, if any. */
+size_t cc_take (uintptr_t, uint8_t *, size_t);
 
-/* Initializes the LRU queue. */
-void create_queue ();
+/* Decompresses stored contents back into their page. */
+bool cc_load (uintptr_t, size_t, const uint8_t *, size_t);
 
-/* Attempts to find the given page number in the queue. */
-q_node *find (intptr_t);
+/* Remove a given page number from the queue, if it is there. */
+bool cc_remove (uintptr_t);
 
-/* Adds a page number to the queue. */
-void cc_add (intptr_t);
+/* Compacts the pool of stored contents, moving at most so many of them. */
+size_t cc_compact (size_t);
 
-/* Adds a completely new page number to the queue. */
-void add_new (intptr_t);
+/* Compacts the pool every so often, forever; the start routine of a thread. */
+void *cc_compactor (void *);
 
-/* Moves a page number that is in the queue to the front of the queue.  */
-void move_to_front(q_node *);
+/* Checks whether the queue holds a page number. */
+bool cc_contains (uintptr_t);
 
-/* Remove a given page number from the queue. */
-void cc_remove (intptr_t);
+/* The least recently added page number, or 0 if the queue is empty. */
+uintptr_t cc_oldest ();
+
+/* The number of page numbers in the queue. */
+unsigned long cc_count ();
 
 /* Check whether the queue has been initialized. */
 bool is_init ();
@@ -87,22 +223,21 @@ bool is_init ();
 /* Checks whether the queue is empty. */
 bool is_empty ();
 
-/* Prints the contents of the queue at the present time. */
-void cc_print_queue ();
+/* Copies what has been stored and restored so far. */
+void cc_get_stats (cc_stats *);
 
-/* Initializes a new node given a page number that is to be stored in it. */
-q_node *create_node (intptr_t, q_node *, q_node *);
+/* Writes a summary of what has been stored and restored. */
+void cc_print_stats (int);
 
-/* Adds a node into the queue given the pointers for the `next` and `prev`
- * nodes. */
-q_node *connect_node (q_node *, q_node *, q_node *);
+/* Drops the lock that another thread held, in the child of a fork (). */
+void cc_fork_child ();
 
-/* Removes the node given a pointer to it. */
-q_node *disconnect_node (q_node *);
+/* Prints the contents of the queue at the present time. */
+void cc_print_queue ();
 // =============================================================================
 
 
 
 // =============================================================================
-#endif // compressed-caching.h
+#endif // comp_cache.h
 // =============================================================================
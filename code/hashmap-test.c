@@ -0,0 +1,270 @@
+/* =============================================================================================================================== */
+/**
+ * \file hashmap-test.c
+ * \brief A test and microbenchmark of the page hash map.
+ *
+ * First, insertions, lookups and removals are checked against what was inserted: every page is found with its permissions and
+ * flags, other pages are not, and each page is removed exactly once, including while the map grows and moves its entries.  Then,
+ * for each requested number of pages, fill a map with page-aligned keys drawn from a few dense regions (as heap and mmap pages
+ * are), and report the average time of insertions, of successful and unsuccessful lookups in random order, and of removals.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hashmap.h"
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS and CONSTANTS */
+
+/** The size of a page. */
+#define PAGE_SIZE 4096
+
+/** The number of dense regions from which the pages are drawn. */
+#define REGIONS 4
+
+/** The number of lookups to time for each measurement. */
+#define LOOKUPS 10000000
+
+/** An offset that moves a key outside of every region, for unsuccessful lookups. */
+#define MISS_OFFSET 0x0000100000000000
+
+/** The number of pages that the checked operations insert: enough for the map to grow, and so to move its entries, many times. */
+#define CHECK_PAGES 300000
+
+/** The page counts measured when none are given. */
+static const long default_counts[] = { 1000000, 10000000, 100000000 };
+
+/** The base addresses of the regions, resembling a heap and mmap areas. */
+static const page_num_t region_base[REGIONS] = {
+  0x0000555555554000, 0x00007f0000000000, 0x00007f8000000000, 0x00007ffc00000000
+};
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Get a monotonic time in nanoseconds.
+ */
+static uint64_t now_ns () {
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+} // now_ns ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  A small xorshift generator, so that `random()` does not dominate the timings.
+ */
+static uint64_t next_random (uint64_t* state) {
+
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+
+} // next_random ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  The `i`-th page of the benchmark's key set.
+ */
+static page_num_t page_at (long i, long pages) {
+
+  long per_region = (pages + REGIONS - 1) / REGIONS;
+  return region_base[i / per_region] + (page_num_t)(i % per_region) * PAGE_SIZE;
+
+} // page_at ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  The permissions (with `ENTRY_SHARED` on some) that the check gives the `i`-th page, and whether it is unprotected.
+ */
+static int perms_at (long i) {
+
+  return (int)(i % 8) | ((i % 5 == 0) ? (int)ENTRY_SHARED : 0);
+
+} // perms_at ()
+
+static bool unprotected_at (long i) {
+
+  return i % 3 == 0;
+
+} // unprotected_at ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Check that the `i`-th page is in the map, with its permissions and flags, or that it is not, and that the page just
+ *         outside of every region is not.
+ */
+static void verify (hashmap_s* map, long i, long pages, bool present) {
+
+  page_num_t       page  = page_at(i, pages);
+  hashmap_entry_s* entry = hashmap_lookup(map, page);
+  if (present) {
+    assert(entry != NULL && ENTRY_PAGE(entry) == page);
+    assert(ENTRY_PERMS(entry) == (perms_at(i) & (int)ENTRY_PERMS_MASK));
+    assert(ENTRY_GET_FLAG(entry, ENTRY_SHARED) == ((perms_at(i) & (int)ENTRY_SHARED) != 0));
+    assert(ENTRY_GET_FLAG(entry, ENTRY_UNPROTECTED) == unprotected_at(i));
+  } else {
+    assert(entry == NULL);
+  }
+  assert(hashmap_lookup(map, page + MISS_OFFSET) == NULL);
+
+} // verify ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Insert pages, checking each against a second insertion; while the map is moving its entries into a larger table, look
+ *         up and remove pages at random, some of them not yet moved; then check every page, and remove those left, each once.
+ * \param  pages The number of pages.
+ */
+static void check (long pages) {
+
+  hashmap_s map;
+  hashmap_create(&map);
+  uint64_t  state    = 0x9e3779b97f4a7c15ULL;
+  bool*     removed  = calloc(pages, sizeof(bool));
+  long      present  = 0;
+  long      migrated = 0;
+  assert(removed != NULL);
+
+  for (long i = 0; i < pages; ++i) {
+    assert(hashmap_insert(&map, ENTRY_MAKE(page_at(i, pages), perms_at(i), unprotected_at(i))));
+    assert(!hashmap_insert(&map, ENTRY_MAKE(page_at(i, pages), perms_at(i), unprotected_at(i))));
+    ++present;
+
+    if (map.old != NULL) {
+      ++migrated;
+      long j = (long)(next_random(&state) % (i + 1));
+      verify(&map, j, pages, !removed[j]);
+      if (!removed[j] && next_random(&state) % 4 == 0) {
+        assert(hashmap_remove(&map, page_at(j, pages)));
+        assert(!hashmap_remove(&map, page_at(j, pages)));
+        removed[j] = true;
+        --present;
+        verify(&map, j, pages, false);
+      }
+    }
+    assert(map.elements == (size_t)present);
+  }
+  assert(migrated > 0);
+
+  for (long i = 0; i < pages; ++i) {
+    verify(&map, i, pages, !removed[i]);
+  }
+  for (long i = 0; i < pages; ++i) {
+    assert(hashmap_remove(&map, page_at(i, pages)) == !removed[i]);
+    assert(!hashmap_remove(&map, page_at(i, pages)));
+    verify(&map, i, pages, false);
+  }
+  assert(map.elements == 0);
+  free(removed);
+
+} // check ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Run the benchmark for one map size, printing one line of results.
+ */
+static void bench (long pages) {
+
+  hashmap_s map;
+  hashmap_create(&map);
+  uint64_t  state = 0x9e3779b97f4a7c15ULL;
+  long      sum   = 0;
+
+  uint64_t start = now_ns();
+  for (long i = 0; i < pages; ++i) {
+    hashmap_entry_s entry = ENTRY_MAKE(page_at(i, pages), 3, false);
+    hashmap_insert(&map, entry);
+  }
+  double insert_ns = (double)(now_ns() - start) / pages;
+
+  start = now_ns();
+  for (long i = 0; i < LOOKUPS; ++i) {
+    hashmap_entry_s* entry = hashmap_lookup(&map, page_at(next_random(&state) % pages, pages));
+    sum += (entry != NULL);
+  }
+  double hit_ns = (double)(now_ns() - start) / LOOKUPS;
+
+  start = now_ns();
+  for (long i = 0; i < LOOKUPS; ++i) {
+    hashmap_entry_s* entry = hashmap_lookup(&map, page_at(next_random(&state) % pages, pages) + MISS_OFFSET);
+    sum += (entry != NULL);
+  }
+  double miss_ns = (double)(now_ns() - start) / LOOKUPS;
+
+  start = now_ns();
+  for (long i = 0; i < pages; i += 2) {
+    sum += hashmap_remove(&map, page_at(i, pages));
+  }
+  double remove_ns = (double)(now_ns() - start) / ((pages + 1) / 2);
+
+  printf("%12ld pages\tcapacity %12zu\tinsert %7.1f ns\thit %7.1f ns\tmiss %7.1f ns\tremove %7.1f ns\t(%ld)\n",
+         pages, map.capacity, insert_ns, hit_ns, miss_ns, remove_ns, sum);
+
+} // bench ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+int main (int argc, char** argv) {
+
+  check(CHECK_PAGES);
+  printf("Checked lookups and removals against the pages inserted, while the map grew and after.\n");
+
+  if (argc == 1) {
+    for (size_t i = 0; i < sizeof(default_counts) / sizeof(default_counts[0]); ++i) {
+      bench(default_counts[i]);
+    }
+  } else {
+    for (int i = 1; i < argc; ++i) {
+      long pages = atol(argv[i]);
+      if (pages <= 0) {
+        fprintf(stderr, "USAGE: %s [ <# pages> ... ]\n", argv[0]);
+        exit(1);
+      }
+      bench(pages);
+    }
+  }
+
+  return 0;
+
+} // main ()
+/* =============================================================================================================================== */
@@ -4,6 +4,12 @@
  * \author Scott Kaplan <sfkaplan@amherst.edu>
  * \date 2021-Jul-20
  * \brief A open addressing hashmap implementation.
+ *
+ * The table is organized in the style of a _Swiss table_: each slot has a one-byte control value that is either `CTRL_EMPTY`,
+ * `CTRL_DELETED`, or the low 7 bits of the slot's hash.  Probing examines a whole group of 16 control bytes at once (with SSE2,
+ * where available), so that most lookups touch a single group and compare a single key.  Growth is incremental: a new table is
+ * allocated and the entries of the old one are moved over a few groups at a time by later insertions and removals, so that no
+ * single call (in particular, no single call from the SIGSEGV handler) rehashes the whole map.
  */
 /* =============================================================================================================================== */
 
@@ -14,13 +20,21 @@
 
 #include <assert.h>
 #include <stdbool.h>  // true
+#include <stddef.h>   // For size_t
 #include <stdint.h>   // For uint32_t and uint64_t
-#include <stdio.h>    // For fprintf()
+#include <stdio.h>    // For printf()
 #include <strings.h>  // For bzero()
+#include <string.h>   // For memset()
 #include <stdlib.h>   // For exit()
-#include <sys/mman.h> // For mmap()/munmap()
+#include <sys/syscall.h> // For SYS_write
+#include <unistd.h>   // For syscall()
+
+#if defined (__SSE2__)
+#include <emmintrin.h> // For the SSE2 group operations.
+#endif
 
 #include "hashmap.h"
+#include "vmt_mman.h"
 /* =============================================================================================================================== */
 
 
@@ -31,131 +45,377 @@
 /** The initial capacity of the hash map's array. */
 #define INITIAL_CAPACITY 1024
 
-/** Load factor threshold. */
-#define LOAD_FACTOR_THRESHOLD 0.5
+/** The number of slots whose control bytes are examined together. */
+#define GROUP_SIZE 16
+
+/** Load factor threshold, expressed as a fraction of eighths (full and deleted slots both count). */
+#define LOAD_FACTOR_EIGHTHS 7
+
+/** The number of old-table groups moved into the new table by each insertion or removal during growth. */
+#define MIGRATE_GROUPS_PER_OP 2
+
+/** The size reserved for the table header at the start of its region; keeps the control bytes 16-byte aligned. */
+#define TABLE_HEADER_SIZE 64
+
+/** Control byte for a slot that has never held an entry. */
+#define CTRL_EMPTY   ((int8_t)-128)
+
+/** Control byte for a slot whose entry was removed (a tombstone). */
+#define CTRL_DELETED ((int8_t)-2)
 /* =============================================================================================================================== */
 
 
 
 /* =============================================================================================================================== */
 /**
- * \brief Allocate and initialize a new hash map.
- * \param hashmap The hashmap structure that serves as the entry point to the hashmap itself.
+ * \brief  Mix the bits of a page number.  Page numbers are page-aligned addresses that cluster into a few dense regions, so their
+ *         low bits are all zero and their high bits are nearly constant; a full avalanche mix (the MurmurHash3 finalizer) spreads
+ *         them across the whole word.
+ * \param  page_num The page number to mix.
+ * \return The 64-bit hash of the page number.
  */
-void hashmap_create (hashmap_s* hashmap) {
+static inline uint64_t hashmap_mix (page_num_t page_num) {
 
-  hashmap->capacity = INITIAL_CAPACITY;
-  hashmap->storage  = mmap(NULL, hashmap->capacity * sizeof(hashmap_entry_s), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-  hashmap->elements = 0;
-  if (hashmap->storage == NULL) {
-    fprintf(stderr, "ERROR: hashmap_create(): mmap failed\n");
-    exit(1);
+  uint64_t key = (uint64_t)page_num >> 12;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+
+} // hashmap_mix ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Find the slots in a group whose control byte equals a given value.
+ * \param  ctrl  The first control byte of the group (16-byte aligned).
+ * \param  value The control value to match.
+ * \return A bit mask with bit `i` set if slot `i` of the group matches.
+ */
+static inline uint32_t group_match (const int8_t* ctrl, int8_t value) {
+
+#if defined (__SSE2__)
+  __m128i group = _mm_load_si128((const __m128i*)ctrl);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP_SIZE; ++i) {
+    if (ctrl[i] == value) mask |= (1u << i);
   }
+  return mask;
+#endif
 
-} // hashmap_create ()
+} // group_match ()
 /* =============================================================================================================================== */
 
 
 
 /* =============================================================================================================================== */
 /**
- * \brief Double the capacity of a hash map.
- * \param hashmap The hashmap whose capacity will be doubled.
+ * \brief  Find the slots in a group that are empty or deleted (that is, whose control byte has its sign bit set).
+ * \param  ctrl The first control byte of the group (16-byte aligned).
+ * \return A bit mask with bit `i` set if slot `i` of the group is available.
  */
-void hashmap_expand (hashmap_s* hashmap) {
+static inline uint32_t group_match_available (const int8_t* ctrl) {
+
+#if defined (__SSE2__)
+  return (uint32_t)_mm_movemask_epi8(_mm_load_si128((const __m128i*)ctrl));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP_SIZE; ++i) {
+    if (ctrl[i] < 0) mask |= (1u << i);
+  }
+  return mask;
+#endif
+
+} // group_match_available ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Allocate a new, empty table with the given capacity.
+ * \param  capacity The number of slots; must be a power of two no smaller than a group.
+ * \return A pointer to the table header, at the start of its block.
+ */
+static hashmap_table_s* table_create (size_t capacity) {
 
-  // Allocate a new, double-sized mmap region.
-  hashmap_s old_hashmap = *hashmap;
-  hashmap->capacity *= 2;
-  hashmap->storage = mmap(NULL, hashmap->capacity * sizeof(hashmap_entry_s), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-  if (hashmap->storage == NULL) {
-    fprintf(stderr, "ERROR: hashmap_expand(): mmap failed\n");
+  size_t map_size = TABLE_HEADER_SIZE + capacity * sizeof(int8_t) + capacity * sizeof(hashmap_entry_s);
+  void*  region   = vmt_malloc(map_size);
+  if (region == NULL) {
+    syscall(SYS_write, 2, "ERROR: hashmap table_create(): vmt_malloc failed\n", 49);
     exit(1);
   }
 
-  // For each element in the old hash map, insert it in the new one.
-  for (int i = 0; i < old_hashmap.capacity; ++i) {
-    if (old_hashmap.storage[i].page_num != 0) {
-      hashmap_insert(hashmap, old_hashmap.storage[i]);
+  hashmap_table_s* table = (hashmap_table_s*)region;
+  table->capacity = capacity;
+  table->used     = 0;
+  table->map_size = map_size;
+  table->ctrl     = (int8_t*)((char*)region + TABLE_HEADER_SIZE);
+  table->slots    = (hashmap_entry_s*)(table->ctrl + capacity);
+  table->next_retired = NULL;
+  memset(table->ctrl, CTRL_EMPTY, capacity);
+
+  return table;
+
+} // table_create ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Release a table's block.
+ * \param table The table to release.
+ */
+static void table_destroy (hashmap_table_s* table) {
+
+  vmt_free(table);
+
+} // table_destroy ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Find a page number in a single table.
+ * \param  table    The table to search.
+ * \param  page_num The page number for which to search.
+ * \param  hash     The mixed hash of the page number.
+ * \return A pointer to the slot that holds the page number, if found; `NULL` otherwise.
+ */
+static hashmap_entry_s* table_find (hashmap_table_s* table, page_num_t page_num, uint64_t hash) {
+
+  size_t group_mask = table->capacity / GROUP_SIZE - 1;
+  size_t group      = (hash >> 7) & group_mask;
+  int8_t h2         = (int8_t)(hash & 0x7f);
+
+  // Probe group by group (triangular steps visit every group once when the group count is a power of two).
+  for (size_t step = 1; step <= group_mask + 1; ++step) {
+
+    const int8_t* ctrl = table->ctrl + group * GROUP_SIZE;
+
+    // Compare the key only in the slots whose control byte matches the hash's low bits.
+    for (uint32_t match = group_match(ctrl, h2); match != 0; match &= match - 1) {
+      hashmap_entry_s* entry_ptr = &table->slots[group * GROUP_SIZE + __builtin_ctz(match)];
+      if (ENTRY_PAGE(entry_ptr) == page_num) return entry_ptr;
     }
+
+    // An empty slot in this group means the page number was never placed beyond it.
+    if (group_match(ctrl, CTRL_EMPTY) != 0) return NULL;
+
+    group = (group + step) & group_mask;
+
   }
 
-  // Unmap the old hash map storage space.
-  if (munmap(old_hashmap.storage, old_hashmap.capacity * sizeof(hashmap_entry_s)) == -1) {
-    perror("ERROR: hashmap_expand(): munmap failed\n");
-    exit(1);
+  return NULL;
+
+} // table_find ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Place an entry, known not to be present, into the first available slot along its probe sequence.
+ * \param table The table into which to place the entry.
+ * \param entry The entry to place.
+ * \param hash  The mixed hash of the entry's page number.
+ */
+static void table_place (hashmap_table_s* table, hashmap_entry_s entry, uint64_t hash) {
+
+  size_t group_mask = table->capacity / GROUP_SIZE - 1;
+  size_t group      = (hash >> 7) & group_mask;
+
+  for (size_t step = 1; ; ++step) {
+
+    int8_t*  ctrl      = table->ctrl + group * GROUP_SIZE;
+    uint32_t available = group_match_available(ctrl);
+    if (available != 0) {
+      int index = __builtin_ctz(available);
+      if (ctrl[index] == CTRL_EMPTY) ++table->used;
+      ctrl[index] = (int8_t)(hash & 0x7f);
+      table->slots[group * GROUP_SIZE + index] = entry;
+      return;
+    }
+
+    // Growth keeps the table from filling, so some group must have room.
+    assert(step <= group_mask + 1);
+    group = (group + step) & group_mask;
+
   }
-  
-} // hashmap_expand ()
+
+} // table_place ()
 /* =============================================================================================================================== */
 
 
 
 /* =============================================================================================================================== */
 /**
- * \brief Print a representation of the complete contents of the hash map.
- * \param hashmap The hashmap whose contents to print.
- */ 
-void hashmap_dump (hashmap_s* hashmap) {                                                
-
-  printf("hashmap_dump:n");
-  for (int i = 0; i < hashmap->capacity; ++i) {                            
-    printf("\tmap[%4d] = { page_num = 0x%16lx", i, hashmap->storage[i].page_num); 
-    if (hashmap->storage[i].page_num != 0) {                               
-      printf(", original_perms = %d, unprotected = %B", hashmap->storage[i].original_perms, hashmap->storage[i].unprotected);
+ * \brief Mark a slot of a table as no longer holding an entry.
+ * \param table     The table that holds the slot.
+ * \param entry_ptr The slot to clear.
+ */
+static void table_erase (hashmap_table_s* table, hashmap_entry_s* entry_ptr) {
+
+  size_t  index = entry_ptr - table->slots;
+  int8_t* ctrl  = table->ctrl + (index & ~(size_t)(GROUP_SIZE - 1));
+
+  // If the group already has an empty slot, then no probe sequence continues past it, and so this slot can become empty again.
+  // Otherwise, leave a tombstone so that probing for entries placed further along still passes through this group.
+  if (group_match(ctrl, CTRL_EMPTY) != 0) {
+    table->ctrl[index] = CTRL_EMPTY;
+    --table->used;
+  } else {
+    table->ctrl[index] = CTRL_DELETED;
+  }
+  entry_ptr->word = 0;
+
+} // table_erase ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Allocate and initialize a new hash map.
+ * \param hashmap The hashmap structure that serves as the entry point to the hashmap itself.
+ */
+void hashmap_create (hashmap_s* hashmap) {
+
+  hashmap->current       = table_create(INITIAL_CAPACITY);
+  hashmap->old           = NULL;
+  hashmap->retired       = NULL;
+  hashmap->migrate_group = 0;
+  hashmap->retain_tables = false;
+  hashmap->capacity      = INITIAL_CAPACITY;
+  hashmap->elements      = 0;
+
+} // hashmap_create ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Move a bounded number of groups from the old table (if any) into the current one, releasing the old table once it has
+ *        been emptied.
+ * \param hashmap    The hashmap whose growth to advance.
+ * \param max_groups The maximum number of old-table groups to move.
+ */
+static void hashmap_migrate (hashmap_s* hashmap, size_t max_groups) {
+
+  hashmap_table_s* old = hashmap->old;
+  if (old == NULL) return;
+
+  size_t old_groups = old->capacity / GROUP_SIZE;
+  for (size_t moved = 0; moved < max_groups && hashmap->migrate_group < old_groups; ++moved) {
+
+    // Move every full slot of this group.  The old slot becomes a tombstone so that lookups, which consult the old table after
+    // the current one, never find the same page twice.
+    size_t  base = hashmap->migrate_group * GROUP_SIZE;
+    int8_t* ctrl = old->ctrl + base;
+    for (uint32_t full = ~group_match_available(ctrl) & 0xffff; full != 0; full &= full - 1) {
+      int index = __builtin_ctz(full);
+      hashmap_entry_s entry = old->slots[base + index];
+      table_place(hashmap->current, entry, hashmap_mix(ENTRY_PAGE(&entry)));
+      ctrl[index] = CTRL_DELETED;
     }
-    printf(" }\n");
+    ++hashmap->migrate_group;
+
   }
-  
-} // hashmap_dump ()
+
+  if (hashmap->migrate_group == old_groups) {
+    if (hashmap->retain_tables) {
+      old->next_retired = hashmap->retired;
+      hashmap->retired  = old;
+    } else {
+      table_destroy(old);
+    }
+    __atomic_store_n(&hashmap->old, NULL, __ATOMIC_RELEASE);
+    hashmap->migrate_group = 0;
+  }
+
+} // hashmap_migrate ()
 /* =============================================================================================================================== */
-  
+
 
 
 /* =============================================================================================================================== */
 /**
- * \brief  Hash a given page number into a given hash map.
- * \param  hashmap  The hash map into which a location is hashed.
- * \param  page_num The page number to hash into a location.
- * \return The index into the given hash map's storage at which the page number hashes.
+ * \brief Release the tables that the map has retained since it outgrew them.  Only safe once no reader can be searching them.
+ * \param hashmap The hash map whose retired tables to release.
  */
-int hashmap_hash (hashmap_s* hashmap, page_num_t page_num) {
+void hashmap_release_retired (hashmap_s* hashmap) {
+
+  while (hashmap->retired != NULL) {
+    hashmap_table_s* table = hashmap->retired;
+    hashmap->retired       = table->next_retired;
+    table_destroy(table);
+  }
 
-  // SK: This is maybe an insufficiently distributed hash, given that page numbers do cluster.
-  return page_num % hashmap->capacity;
-  
-} // hashmap_hash ()
+} // hashmap_release_retired ()
 /* =============================================================================================================================== */
 
 
 
 /* =============================================================================================================================== */
 /**
- * \brief  Find the location in the hash map where the given page number is or should be.
- * \param  hashmap  The hash map to search.
- * \param  page_num The page number for which to search.
- * \return A pointer to the entry that contains the page number, if found; a pointer to the empty entry that should contain the page
- *         number, if not found.
+ * \brief Begin growing a hash map: the current table becomes the old one, and a new table with double the capacity (or the same
+ *        capacity, if most used slots are tombstones) becomes the current one.  The entries move over incrementally.
+ * \param hashmap The hashmap to grow.
  */
-hashmap_entry_s* hashmap_find (hashmap_s* hashmap, page_num_t page_num) {
-
-  // Hash into the map.
-  int              start_index = hashmap_hash(hashmap, page_num);        // The hashed index for this page number.
-  hashmap_entry_s* start_ptr   = &(hashmap->storage[start_index]);       // Take a pointer into the array for that index.
-  hashmap_entry_s* storage_end = hashmap->storage + hashmap->capacity;   // Hold onto the end of the array, for wrap-around during
-                                                                         // linear probing.
-
-  // Search the entries (linear probing).
-  hashmap_entry_s* entry_ptr = start_ptr;
-  while (entry_ptr->page_num != page_num && entry_ptr->page_num != 0) {  // If we haven't found it or hit an empty entry...
-    if (++entry_ptr == storage_end) entry_ptr = hashmap->storage;        // Advance to the next, wrapping around if needed.
-    assert(entry_ptr != start_ptr);                                      // We should never return to the start; expansion should
-                                                                         // prevent it.
+void hashmap_expand (hashmap_s* hashmap) {
+
+  // Should a previous growth still be underway, finish it first.  (The migration rate makes this very rare.)
+  hashmap_migrate(hashmap, SIZE_MAX);
+
+  hashmap_table_s* table        = hashmap->current;
+  size_t           new_capacity = table->capacity * 2;
+  if (hashmap->elements * 8 <= table->capacity * 3) {
+    new_capacity = table->capacity;
   }
 
-  return entry_ptr;
+  // The new table is published with release stores, so that a reader that does not hold the map's lock (see shardmap.c) sees it
+  // only once it is initialized.
+  __atomic_store_n(&hashmap->old, table, __ATOMIC_RELEASE);
+  hashmap->migrate_group = 0;
+  __atomic_store_n(&hashmap->current, table_create(new_capacity), __ATOMIC_RELEASE);
+  hashmap->capacity      = new_capacity;
+
+} // hashmap_expand ()
+/* =============================================================================================================================== */
+
+
 
-} // hashmap_find ()
+/* =============================================================================================================================== */
+/**
+ * \brief Print a representation of the complete contents of the hash map.
+ * \param hashmap The hashmap whose contents to print.
+ */
+void hashmap_dump (hashmap_s* hashmap) {
+
+  printf("hashmap_dump:\n");
+  hashmap_table_s* tables[2] = { hashmap->current, hashmap->old };
+  for (int t = 0; t < 2 && tables[t] != NULL; ++t) {
+    printf("  %s table (capacity = %zu):\n", (t == 0) ? "current" : "old", tables[t]->capacity);
+    for (size_t i = 0; i < tables[t]->capacity; ++i) {
+      if (tables[t]->ctrl[i] >= 0) {
+        hashmap_entry_s* entry_ptr = &tables[t]->slots[i];
+        printf("\tmap[%4zu] = { page_num = 0x%16lx, original_perms = %d, unprotected = %d, first_touch = %d, dirty = %d }\n",
+               i, ENTRY_PAGE(entry_ptr), ENTRY_PERMS(entry_ptr), ENTRY_GET_FLAG(entry_ptr, ENTRY_UNPROTECTED),
+               ENTRY_GET_FLAG(entry_ptr, ENTRY_FIRST_TOUCH), ENTRY_GET_FLAG(entry_ptr, ENTRY_DIRTY));
+      }
+    }
+  }
+
+} // hashmap_dump ()
 /* =============================================================================================================================== */
 
 
@@ -169,10 +429,18 @@ hashmap_entry_s* hashmap_find (hashmap_s* hashmap, page_num_t page_num) {
  */
 hashmap_entry_s* hashmap_lookup (hashmap_s* hashmap, page_num_t page_num) {
 
-  // If we found it, return this entry; otherwise return NULL to indicate failure.
-  hashmap_entry_s* entry_ptr = hashmap_find(hashmap, page_num);
-  return (entry_ptr->page_num == page_num) ? entry_ptr : NULL;
-  
+  // Search the current table, and then, for entries that have not yet been moved, the old one.
+  // Each table pointer is loaded once, since a lock-free reader may race with growth.
+  uint64_t         hash      = hashmap_mix(page_num);
+  hashmap_entry_s* entry_ptr = table_find(__atomic_load_n(&hashmap->current, __ATOMIC_ACQUIRE), page_num, hash);
+  if (entry_ptr == NULL) {
+    hashmap_table_s* old = __atomic_load_n(&hashmap->old, __ATOMIC_ACQUIRE);
+    if (old != NULL) {
+      entry_ptr = table_find(old, page_num, hash);
+    }
+  }
+  return entry_ptr;
+
 } // hashmap_lookup ()
 /* =============================================================================================================================== */
 
@@ -187,26 +455,21 @@ hashmap_entry_s* hashmap_lookup (hashmap_s* hashmap, page_num_t page_num) {
  */
 bool hashmap_insert (hashmap_s* hashmap, hashmap_entry_s entry) {
 
-  // Find where the page should go.
-  hashmap_entry_s* entry_ptr = hashmap_find(hashmap, entry.page_num);
-
-  // If the slot is empty (the page isn't already in the table)...
-  bool empty_slot = (entry_ptr->page_num == 0);
-  if (empty_slot) {
-
-    // ...insert it.
-    *entry_ptr = entry;
-    ++hashmap->elements;
+  // If the page is already in the table, do nothing.
+  if (hashmap_lookup(hashmap, ENTRY_PAGE(&entry)) != NULL) {
+    return false;
+  }
 
-    // If insertion pushes the load factor past its threshold, then expand.
-    if ((double)hashmap->elements / (double)hashmap->capacity > LOAD_FACTOR_THRESHOLD) {
-      hashmap_expand(hashmap);
-    }
-    
+  // Advance any growth that is underway, and begin growing if this insertion would push the load factor past its threshold.
+  hashmap_migrate(hashmap, MIGRATE_GROUPS_PER_OP);
+  if ((hashmap->current->used + 1) * 8 > hashmap->current->capacity * LOAD_FACTOR_EIGHTHS) {
+    hashmap_expand(hashmap);
   }
 
-  // Return whether the entry was inserted.
-  return empty_slot;
+  table_place(hashmap->current, entry, hashmap_mix(ENTRY_PAGE(&entry)));
+  ++hashmap->elements;
+
+  return true;
 
 } // hashmap_insert ()
 /* =============================================================================================================================== */
@@ -219,48 +482,29 @@ bool hashmap_insert (hashmap_s* hashmap, hashmap_entry_s entry) {
  * \param  hashmap  The hash map from which to remove an entry.
  * \param  page_num The page number whose entry to remove.
  * \return whether the page was found and removed.
- * \see    https://en.wikipedia.org/w/index.php?title=Hash_table&oldid=95275577
  */
 bool hashmap_remove (hashmap_s* hashmap, page_num_t page_num) {
 
-  // Find where the page should be.
-  hashmap_entry_s* entry_ptr = hashmap_find(hashmap, page_num);
-  bool             full_slot = (entry_ptr->page_num == page_num);
+  // Find where the page is, in either table.
+  uint64_t         hash      = hashmap_mix(page_num);
+  hashmap_table_s* table     = hashmap->current;
+  hashmap_entry_s* entry_ptr = table_find(table, page_num, hash);
+  if (entry_ptr == NULL && hashmap->old != NULL) {
+    table     = hashmap->old;
+    entry_ptr = table_find(table, page_num, hash);
+  }
 
-  // If it's there...
+  // If it's there, clear its slot.
+  bool full_slot = (entry_ptr != NULL);
   if (full_slot) {
-
-    // Start (i and j) at the position that holds the given page.
-    int i = entry_ptr - hashmap->storage;
-    int j = i;
-
-    while (true) {
-
-      // Linearly probe to the next spot that could hold a page that maps to the same location as the one our page occupied.
-      j = (j + 1) % hashmap->capacity;
-
-      // If this is an empty slot, we're done.
-      if (hashmap->storage[j].page_num == 0) break;
-
-      // If the page that is in this position (j) hashes to a location that is outside of the range between i and j...
-      int k = hashmap_hash(hashmap, hashmap->storage[j].page_num);
-      if ( (j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j)) ) {
-
-	// Move the j-th entry into the i-th spot (that is, slide it closer to where it hashes to).
-	hashmap->storage[i] = hashmap->storage[j];
-
-	// Bump i up to j, closing the interval between them.
-	i = j;
-      }
-    }
-
-    // The i-th position, after this loop, is left at the last spot whose contents were bumped down, closer to their hashed
-    // position.  Mark this entry as empty now.
-    hashmap->storage[i].page_num = 0;
-    
+    table_erase(table, entry_ptr);
+    --hashmap->elements;
   }
 
+  // Removal also advances any growth that is underway.
+  hashmap_migrate(hashmap, MIGRATE_GROUPS_PER_OP);
+
   return full_slot;
- 
+
 } // hashmap_remove ()
-/* =============================================================================================================================== */
\ No newline at end of file
+/* =============================================================================================================================== */
@@ -15,24 +15,86 @@
 
 
 
+/* =============================================================================================================================== */
+/* MACROS */
+
+/** The bits of an entry that hold its page number (a page-aligned address). */
+#define ENTRY_PAGE_MASK   (~(page_num_t)0xfff)
+
+/** The bits of an entry that hold the page's original permissions (`PROT_READ | PROT_WRITE | PROT_EXEC`). */
+#define ENTRY_PERMS_MASK  ((page_num_t)0x7)
+
+/** The flag marking a page as currently unprotected (in the unprotected list). */
+#define ENTRY_UNPROTECTED ((page_num_t)0x8)
+
+/** The flag marking a page as having been touched (faulted on) at least once. */
+#define ENTRY_FIRST_TOUCH ((page_num_t)0x10)
+
+/** The flag marking a page as having been written (faulted on by a write) at least once. */
+#define ENTRY_DIRTY       ((page_num_t)0x20)
+
+/** The flag marking a page as belonging to a shared mapping, whose memory is never released when it is protected. */
+#define ENTRY_SHARED      ((page_num_t)0x40)
+
+/** Build an entry from a page number, its original permissions (with `ENTRY_SHARED` if it is shared), and whether it is unprotected. */
+#define ENTRY_MAKE(page,perms,unprotected) \
+  ((hashmap_entry_s){ ((page) & ENTRY_PAGE_MASK) | ((page_num_t)(perms) & (ENTRY_PERMS_MASK | ENTRY_SHARED)) | ((unprotected) ? ENTRY_UNPROTECTED : 0) })
+
+/** Get the page number of an entry; zero for an absent entry. */
+#define ENTRY_PAGE(ep)            ((ep)->word & ENTRY_PAGE_MASK)
+
+/** Get or set the original permissions of an entry. */
+#define ENTRY_PERMS(ep)           ((int)((ep)->word & ENTRY_PERMS_MASK))
+#define ENTRY_SET_PERMS(ep,perms) ((ep)->word = ((ep)->word & ~ENTRY_PERMS_MASK) | ((page_num_t)(perms) & ENTRY_PERMS_MASK))
+
+/** Get, set, or clear one of an entry's flags. */
+#define ENTRY_GET_FLAG(ep,flag)   (((ep)->word & (flag)) != 0)
+#define ENTRY_SET_FLAG(ep,flag)   ((ep)->word |= (flag))
+#define ENTRY_CLEAR_FLAG(ep,flag) ((ep)->word &= ~(flag))
+/* =============================================================================================================================== */
+
+
+
 /* =============================================================================================================================== */
 /* TYPES */
 
 /** The type of a page number. */
 typedef uintptr_t page_num_t;
 
-/** The structure for a single hash map entry. */
+/**
+ * The structure for a single hash map entry.  Page numbers are page-aligned, so the low 12 bits of the word are free to hold the
+ * page's original permissions and its flags (see the `ENTRY_` macros); an entry is thus 8 bytes, and a cache line holds 8 of them.
+ */
 typedef struct hashmap_entry_struct {
-  page_num_t page_num;
-  int        original_perms;
-  bool       unprotected;
+  page_num_t word;
 } hashmap_entry_s;
 
-/** The structure for an entire hash map. */
+/**
+ * One table of the hash map.  The header lives at the beginning of its own block of the private heap (see `vmt_mman.h`), and is
+ * followed by one control byte per slot and then by the slots themselves.  Control bytes are examined a group (16 slots) at a time.
+ */
+typedef struct hashmap_table_struct {
+  size_t           capacity;  // The number of slots; a power of two, and a multiple of the group size.
+  size_t           used;      // The number of slots that are full or hold a tombstone.
+  size_t           map_size;  // The size of the whole block, header included.
+  int8_t*          ctrl;      // The control bytes, one per slot.
+  hashmap_entry_s* slots;     // The entries themselves.
+  struct hashmap_table_struct* next_retired;  // The next table in the map's list of retired tables.
+} hashmap_table_s;
+
+/**
+ * The structure for an entire hash map.  While the map is growing, `old` holds the previous table, whose entries are moved into
+ * `current` a few groups at a time by each insertion or removal.  If `retain_tables` is set, emptied tables are kept on the
+ * `retired` list rather than unmapped, so that readers that do not hold the map's lock never touch unmapped memory.
+ */
 typedef struct hashmap_struct {
-  hashmap_entry_s* storage;
-  int              capacity;
-  int              elements;
+  hashmap_table_s* current;
+  hashmap_table_s* old;
+  hashmap_table_s* retired;
+  size_t           migrate_group;
+  bool             retain_tables;
+  size_t           capacity;
+  size_t           elements;
 } hashmap_s;
 /* =============================================================================================================================== */
 
@@ -45,6 +107,7 @@ void             hashmap_create (hashmap_s* hashmap);
 hashmap_entry_s* hashmap_lookup (hashmap_s* hashmap, page_num_t page_num);
 bool             hashmap_insert (hashmap_s* hashmap, hashmap_entry_s entry);
 bool             hashmap_remove (hashmap_s* hashmap, page_num_t page_num);
+void             hashmap_release_retired (hashmap_s* hashmap);
 /* =============================================================================================================================== */
 
 
@@ -52,4 +115,3 @@ bool             hashmap_remove (hashmap_s* hashmap, page_num_t page_num);
 /* =============================================================================================================================== */
 #endif /* _HASHMAP_H */
 /* =============================================================================================================================== */
-
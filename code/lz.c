@@ -0,0 +1,320 @@
+/* =============================================================================================================================== */
+/**
+ * \file lz.c
+ * \brief A small LZ77 codec for whole pages, in the manner of LZ4's block format.
+ *
+ * The compressed bytes are a run of sequences, each one a token byte, literals, and a match:
+ *
+ *     <token> [literal length bytes] <literals> <offset, 2 bytes> [match length bytes]
+ *
+ * The token's high nibble is the number of literals and its low nibble the length of the match less `MIN_MATCH`; a nibble of 15
+ * continues in the bytes that follow, each adding up to 255.  The offset counts back from the end of the output so far.  The
+ * last sequence has literals only, and ends the input.  The compressor finds matches through a table of the last position of
+ * each hashed 4-byte word, and skips ahead faster the longer it goes without one, so that incompressible pages cost little more
+ * than a copy.  Both sides use only the stack, so that the manager can call them from the SIGSEGV handler.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <stdint.h>      // For uint8_t
+#include <string.h>      // For memcpy()/memset()
+
+#include "lz.h"
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS and CONSTANTS */
+
+/** The shortest match that is worth a sequence. */
+#define MIN_MATCH     4
+
+/** The bytes at the end of the input that are always literals, so that the matcher reads whole words. */
+#define LAST_LITERALS 5
+
+/** The farthest back that a match can start. */
+#define MAX_OFFSET    65535
+
+/** The number of bits of the hash of a word, and so of positions in the table. */
+#define HASH_BITS     12
+
+/** The number of misses after which the compressor steps one byte further. */
+#define SKIP_SHIFT    6
+
+/** A nibble of 15 continues in the bytes that follow. */
+#define NIBBLE_MAX    15
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Read 4 bytes, at any alignment.
+ */
+static inline uint32_t read32 (const uint8_t* p) {
+
+  uint32_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+
+} // read32 ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Read 8 bytes, at any alignment.
+ */
+static inline uint64_t read64 (const uint8_t* p) {
+
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+
+} // read64 ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Hash a word to a position in the table (Knuth's multiplicative hash).
+ */
+static inline uint32_t hash (uint32_t word) {
+
+  return (word * 2654435761u) >> (32 - HASH_BITS);
+
+} // hash ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Write the bytes that continue a length whose nibble was 15.
+ * \param  op     Where to write them.
+ * \param  end    The end of the output.
+ * \param  length The length less 15.
+ * \return Where the next byte goes, or `NULL` if they do not fit.
+ */
+static uint8_t* put_length (uint8_t* op, const uint8_t* end, size_t length) {
+
+  while (length >= 255) {
+    if (op >= end) {
+      return NULL;
+    }
+    *op++  = 255;
+    length = length - 255;
+  }
+  if (op >= end) {
+    return NULL;
+  }
+  *op++ = (uint8_t) length;
+  return op;
+
+} // put_length ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Write one sequence.
+ * \param  op       Where to write it.
+ * \param  end      The end of the output.
+ * \param  literals The literals.
+ * \param  count    The number of literals.
+ * \param  offset   How far back the match starts; 0 for the last sequence, which has no match.
+ * \param  match    The length of the match.
+ * \return Where the next sequence goes, or `NULL` if this one does not fit.
+ */
+static uint8_t* put_sequence (uint8_t* op, const uint8_t* end, const uint8_t* literals, size_t count, size_t offset, size_t match) {
+
+  if (op >= end) {
+    return NULL;
+  }
+  uint8_t* token = op++;
+  *token = (uint8_t) (((count < NIBBLE_MAX) ? count : NIBBLE_MAX) << 4);
+  if (count >= NIBBLE_MAX && (op = put_length(op, end, count - NIBBLE_MAX)) == NULL) {
+    return NULL;
+  }
+  if ((size_t) (end - op) < count) {
+    return NULL;
+  }
+  memcpy(op, literals, count);
+  op = op + count;
+
+  if (offset == 0) {
+    return op;
+  }
+  if (end - op < 2) {
+    return NULL;
+  }
+  *op++ = (uint8_t) offset;
+  *op++ = (uint8_t) (offset >> 8);
+  size_t extra = match - MIN_MATCH;
+  *token = *token | (uint8_t) ((extra < NIBBLE_MAX) ? extra : NIBBLE_MAX);
+  if (extra >= NIBBLE_MAX) {
+    op = put_length(op, end, extra - NIBBLE_MAX);
+  }
+  return op;
+
+} // put_sequence ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+size_t lz_compress (const uint8_t* in, size_t length, uint8_t* out, size_t capacity) {
+
+  if (length > LZ_MAX_INPUT) {
+    return 0;
+  }
+
+  uint16_t table[1 << HASH_BITS];
+  memset(table, 0, sizeof(table));
+
+  const uint8_t* ip     = in;
+  const uint8_t* anchor = in;
+  const uint8_t* limit  = (length > LAST_LITERALS) ? in + length - LAST_LITERALS : in;
+  const uint8_t* end    = out + capacity;
+  uint8_t*       op     = out;
+
+  while (ip + MIN_MATCH <= limit) {
+    uint32_t       word = read32(ip);
+    uint32_t       h    = hash(word);
+    const uint8_t* ref  = in + table[h];
+    table[h] = (uint16_t) (ip - in);
+
+    if (ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != word) {
+      ip = ip + 1 + ((ip - anchor) >> SKIP_SHIFT);
+      continue;
+    }
+
+    //extends the match a word at a time, and the first differing byte is found from the words' difference
+    size_t         offset    = ip - ref;
+    const uint8_t* match_end = ip + MIN_MATCH;
+    ref = ref + MIN_MATCH;
+    uint64_t difference = 0;
+    while (match_end + sizeof(uint64_t) <= limit && (difference = read64(match_end) ^ read64(ref)) == 0) {
+      match_end = match_end + sizeof(uint64_t);
+      ref       = ref + sizeof(uint64_t);
+    }
+    if (difference != 0) {
+      match_end = match_end + (__builtin_ctzll(difference) >> 3);
+    } else {
+      while (match_end < limit && *match_end == *ref) {
+        match_end++;
+        ref++;
+      }
+    }
+
+    op = put_sequence(op, end, anchor, ip - anchor, offset, match_end - ip);
+    if (op == NULL) {
+      return 0;
+    }
+    ip     = match_end;
+    anchor = ip;
+  }
+
+  op = put_sequence(op, end, anchor, in + length - anchor, 0, 0);
+  return (op == NULL) ? 0 : (size_t) (op - out);
+
+} // lz_compress ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Read the bytes that continue a length whose nibble was 15.
+ * \param  ip     Where they start; moved past them.
+ * \param  end    The end of the input.
+ * \param  length The length so far; the bytes are added to it.
+ * \return Whether the input held them.
+ */
+static int get_length (const uint8_t** ip, const uint8_t* end, size_t* length) {
+
+  uint8_t byte;
+  do {
+    if (*ip >= end) {
+      return 0;
+    }
+    byte    = *(*ip)++;
+    *length = *length + byte;
+  } while (byte == 255);
+  return 1;
+
+} // get_length ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+size_t lz_decompress (const uint8_t* in, size_t length, uint8_t* out, size_t capacity) {
+
+  const uint8_t* ip   = in;
+  const uint8_t* iend = in + length;
+  uint8_t*       op   = out;
+  uint8_t*       oend = out + capacity;
+
+  while (ip < iend) {
+    uint8_t token = *ip++;
+
+    size_t count = token >> 4;
+    if (count == NIBBLE_MAX && get_length(&ip, iend, &count) == 0) {
+      return 0;
+    }
+    if (count > (size_t) (iend - ip) || count > (size_t) (oend - op)) {
+      return 0;
+    }
+    memcpy(op, ip, count);
+    op = op + count;
+    ip = ip + count;
+
+    //The last sequence has no match
+    if (ip == iend) {
+      break;
+    }
+
+    if (iend - ip < 2) {
+      return 0;
+    }
+    size_t offset = (size_t) ip[0] | ((size_t) ip[1] << 8);
+    ip = ip + 2;
+    size_t match = (token & NIBBLE_MAX) + MIN_MATCH;
+    if ((token & NIBBLE_MAX) == NIBBLE_MAX && get_length(&ip, iend, &match) == 0) {
+      return 0;
+    }
+    if (offset == 0 || offset > (size_t) (op - out) || match > (size_t) (oend - op)) {
+      return 0;
+    }
+
+    //A match may overlap its own output (a run), so it is copied forward, a word at a time when it is far enough back
+    const uint8_t* ref = op - offset;
+    if (offset >= sizeof(uint64_t)) {
+      size_t i = 0;
+      for (; i + sizeof(uint64_t) <= match; i = i + sizeof(uint64_t)) {
+        memcpy(op + i, ref + i, sizeof(uint64_t));
+      }
+      for (; i < match; i++) {
+        op[i] = ref[i];
+      }
+    } else {
+      for (size_t i = 0; i < match; i++) {
+        op[i] = ref[i];
+      }
+    }
+    op = op + match;
+  }
+
+  return (size_t) (op - out);
+
+} // lz_decompress ()
+/* =============================================================================================================================== */
@@ -0,0 +1,63 @@
+/* =============================================================================================================================== */
+/**
+ * \file lz.h
+ * \brief A small LZ77 codec for whole pages, in the manner of LZ4's block format.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#if !defined (_LZ_H)
+#define _LZ_H
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <stddef.h>
+#include <stdint.h>
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS */
+
+/** The largest input that lz_compress () takes; offsets are 16 bits. */
+#define LZ_MAX_INPUT 65536
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* FUNCTIONS */
+
+/**
+ * \brief  Compress a buffer.
+ * \param  in       The buffer to compress; at most `LZ_MAX_INPUT` bytes.
+ * \param  length   Its length.
+ * \param  out      The buffer that receives the compressed bytes.
+ * \param  capacity The size of `out`.
+ * \return The length of the compressed bytes, or 0 if they do not fit in `capacity`.
+ */
+size_t lz_compress (const uint8_t* in, size_t length, uint8_t* out, size_t capacity);
+
+/**
+ * \brief  Decompress a buffer that lz_compress () produced.
+ * \param  in       The compressed bytes.
+ * \param  length   Their length.
+ * \param  out      The buffer that receives the original bytes.
+ * \param  capacity The size of `out`.
+ * \return The length of the original bytes, or 0 if the input is malformed or does not fit in `capacity`.
+ */
+size_t lz_decompress (const uint8_t* in, size_t length, uint8_t* out, size_t capacity);
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#endif /* _LZ_H */
+/* =============================================================================================================================== */
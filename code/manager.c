@@ -54,11 +54,25 @@
 #include <sys/ptrace.h>
 #include <sys/user.h>
 #include <signal.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <limits.h>
+#include <link.h>
 #include "hashset.h"
 #include "hashmap.h"
+#include "shardmap.h"
+#include "radix.h"
+#include "tracebuf.h"
+#include "syscall_table.h"
+#include "syscall_filter.h"
+#include "channel.h"
+#include "stats.h"
 
 //Left commented since compressed-caching has not been completely implemeneted yet
-//#include "compressed-caching.h"
+#include "capture.h"
+#include "comp_cache.h"
+#include "vmt_mman.h"
 
 #ifdef _MSC_VER
 #include <intrin.h>
@@ -74,21 +88,49 @@
 
 /** Aligns pointer to the beginning of page */
 #define PAGE_BASE(p) ((void *)((intptr_t)p & ~0xfff))
-/* =============================================================================================================================== */
 
+/** Bit of the page fault error code that is set when the faulting access was a write. */
+#define PAGE_FAULT_WRITE 0x2
+
+/** Number of page locks; a power of two. */
+#define PAGE_LOCKS 1024
+
+/** The lock that serializes changes to a page's protection, shared by every page that maps to the same stripe. */
+#define PAGE_LOCK(p) (&page_locks[((uintptr_t)(p) >> 12) & (PAGE_LOCKS - 1)])
+
+/** Most pages of a range whose protection is changed together, under their locks; fewer than PAGE_LOCKS, so that no two
+ *  share a lock. */
+#define RANGE_PAGES 128
+
+/** Most ranges of the program's memory that are tracked when the catcher attaches. */
+#define ATTACH_RUNS 4096
+
+/** Most ranges of pages left alone when the catcher attaches: the data segments of the loaded objects, and a few more. */
+#define ATTACH_KEEP 1024
+
+/** Size of the buffer in which /proc/self/maps is read, a line at a time. */
+#define MAPS_BUFFER 4096
+
+/** Most pages of a mapping with no access that is taken for a guard page, below a thread's stack. */
+#define GUARD_PAGES 16
 
+/** Pages around the thread pointer of the thread that attaches, which hold its TLS, and which are left alone. */
+#define TLS_PAGES 16
 
+/** Most runs of pages that one thread keeps unprotected past the window, while a system call uses them. */
+#define HELD_RUNS 16
+
+/** Most ranges that one system call writes as many bytes of as it returns, which it marks dirty once it has returned. */
+#define RETURNED_RANGES 16
+
+/** Adds to a counter of the calling thread's row of the statistics page. */
+#define STATS_ADD(field, n) (own_stats()->field += (n))
 /* =============================================================================================================================== */
-/* Global Variables */
 
-/** Character array used to write pointer address. */
-static char hex[37] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A',
-	'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L',
-	'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W',
-	'X', 'Y', 'Z'};
 
-/** String that holds pointer address. */
-static char buffer[17];
+
+/* =============================================================================================================================== */
+/* Global Variables */
 
 /** Address of main function in benchmark program. */
 static int (*main_orig) (int, char **, char **);
@@ -99,8 +141,16 @@ extern void *__libc_malloc(size_t size);
 /** Original write function. */
 typeof(&write) write_orig;
 
-/** Integer variable that contains the most recent pointer array element added. */
-static int current_index = 0;
+/** Original functions of the other wrappers, resolved once by resolve_originals (), so that no wrapper, nor the handler,
+ *  calls dlsym (), which may allocate and take the dynamic linker's lock. */
+static typeof(&sigaction) sigaction_orig;
+static typeof(&pthread_create) pthread_create_orig;
+static typeof(&clone) clone_orig;
+static int (*libc_start_main_orig) (int (*) (int, char **, char **), int, char **, int (*) (int, char **, char **),
+                                    void (*) (void), void (*) (void), void *);
+
+/** Integer variable that contains the next pointer array element to replace; advanced atomically by each fault. */
+static unsigned int current_index = 0;
 
 /** Pointer array that tracks pages used. */
 static void ** ptr_list;
@@ -108,8 +158,8 @@ static void ** ptr_list;
 /** Integer variable used to direct output into csv file. */
 static int file_addr;
 
-/** Size of a page. */
-static int pagesize;
+/** Size of a page, as the kernel gives it when the manager is loaded. */
+static size_t pagesize;
 
 /** Size of array containing unprotected pages. */
 static int SIZE;
@@ -117,28 +167,16 @@ static int SIZE;
 /** Flag that sets to 1 when the benchmark program is run, makes sure we are not protecting pages before we run the program we want to trace.  */
 static int trace_flag = 0;
 
-/** Dummy variable to make sure walk stuct does not get optimized out. */
-char *dummy;
-
-/** For sending information between this and the parent syscall catcher. */
-static int shared_fd;
-static void* shared;
-
-/** Struct for sending data on addresses of functions. **/
-struct addr_info {
-	void* walker;
-	void* brk;
-	void* mmap;
-	void* munmap;
-	void* mprotect;
-	void* sigaction;
-};
+/** For sending information between this and the parent syscall catcher; 'NULL' when there is no catcher. */
+static struct channel* channel = NULL;
 
-/** Struct for storing data on what to walk. */
-struct walker_info {
-	void* ptr;
-	int length;
-};
+/** The calling thread's slot in the channel, once it has been looked up. */
+static __thread struct channel_slot* slot __attribute__((tls_model("initial-exec"))) = NULL;
+
+/** The calling thread's TID, once it has been asked for; and the flag that sets in a TLS which a thread that clone () started
+ *  with no TLS of its own shares, where no TID is cached then (see own_tid ()). */
+static __thread uint32_t thread_tid __attribute__((tls_model("initial-exec"))) = 0;
+static __thread bool tls_shared __attribute__((tls_model("initial-exec"))) = false;
 
 /** Handler function of input program's signal handler */
 static void handler (int, siginfo_t*, void*);
@@ -146,6 +184,21 @@ static void handler (int, siginfo_t*, void*);
 /** Handler function of input program's signal handler */
 static void handler2 (int);
 
+/** Standard mprotect call used exclusively in manager, defined below. */
+int internal_mprotect(void *addr, size_t len, int prot);
+
+/** Locking of the pages of a range, defined below. */
+static void lock_page(void* page);
+static void unlock_page(void* page);
+static size_t lock_pages(uintptr_t pages[], size_t count);
+static void unlock_pages(uintptr_t pages[], size_t count, size_t first);
+
+/** The calling thread's slot in the channel, defined below. */
+struct channel_slot* channel_slot();
+
+/** The calling thread's row of the statistics page, defined below. */
+static struct stats_row* own_stats();
+
 /** Variables to hold handler functions  */
 static typeof(&handler) orig_sigsegv_handler = NULL;
 
@@ -154,12 +207,218 @@ static typeof(&handler2) orig_sigsegv_handler2 = NULL;
 /** Global sigaction struct  */
 static struct sigaction sa;
 
-/** Hashmap object used to create a hashmap */
-static hashmap_s hashmap;
+/** Sharded hashmap of page metadata, safe for concurrent faults on different threads */
+static shardmap_s shardmap;
+
+/** Locks held while a page's protection status and its actual protection are changed together. */
+static shardmap_lock_t page_locks[PAGE_LOCKS];
+
+/** Radix table used instead of the hashmap when VMT_METADATA is "radix". */
+static radix_s radix;
+
+/** Flag that selects the radix table as the page metadata store. */
+static bool use_radix = false;
+
+/** Flag that compresses the pages evicted from the list into the compressed cache, when VMT_COMPRESS is set. */
+static bool use_cc = false;
+
+/** Protection key that a page has while restore_page () writes its contents back; every other thread is denied it, and
+ *  faults on the page meanwhile.  '-1' where the CPU or the kernel has no protection keys. */
+static int restore_key = -1;
+
+/** Flag that annotates the pages evicted from the list in the trace, when VMT_CAPTURE is set; and their snapshots. */
+static bool use_capture = false;
+static capture_s capture;
+
+/** Flag that sets once the page metadata store is created; no page is protected before. */
+static bool metadata_ready = false;
+
+/** Trace of faults, kept in one stream per thread and merged by time into the csv file. */
+static tracebuf_s trace;
+
+/** The calling thread's trace stream, once it has one. */
+static __thread tracebuf_stream_s* trace_stream __attribute__((tls_model("initial-exec"))) = NULL;
+
+/** Key whose destructor closes a thread's trace stream when the thread exits. */
+static pthread_key_t trace_key;
+
+/** Struct for passing a new thread's start function and argument to the wrapper that sets up its trace stream. */
+struct thread_start_info {
+	void* (*start)(void*);
+	int (*fn)(void*);
+	void* arg;
+};
+
+/** A run of consecutive pages. */
+struct page_run {
+	uintptr_t start;
+	size_t pages;
+};
+
+/** Ranges of pages that find_program_memory () leaves alone, as vmt_attach () gathers them. */
+struct keep_ranges {
+	struct page_run* ranges;
+	size_t count;
+	size_t size;
+};
+
+/** A mapping of this process, as /proc/self/maps gives it. */
+struct mapping {
+	uintptr_t start;
+	uintptr_t end;
+	char perms[5];
+	bool anonymous;
+	bool heap;
+	bool manager;   // The manager's own, named by vmt_mman.h, guards included
+};
+
+/** Pages that the calling thread unprotected for its current system call, as runs.  They are held out of the window until
+ *  the call is done, so that faults on other threads cannot evict and protect them under it; then as many as the window
+ *  holds go into it, and the rest are protected again. */
+static __thread struct page_run held[HELD_RUNS] __attribute__((tls_model("initial-exec")));
+static __thread int held_count __attribute__((tls_model("initial-exec"))) = 0;
+
+/** Ranges, in order, that the calling thread's current system call writes as many bytes of as it returns (SYSCALL_OUT_RETURN),
+ *  such as read ()'s buffer, or readv ()'s.  Their pages are marked dirty once the call has returned, as far as it wrote. */
+static __thread struct returned_range {
+	uintptr_t start;
+	size_t length;
+} returned[RETURNED_RANGES] __attribute__((tls_model("initial-exec")));
+static __thread int returned_count __attribute__((tls_model("initial-exec"))) = 0;
+
+/** Bytes that the calling thread walked, and pages it unprotected, for its current system call. */
+static __thread size_t syscall_bytes __attribute__((tls_model("initial-exec"))) = 0;
+static __thread size_t syscall_unprotected __attribute__((tls_model("initial-exec"))) = 0;
+
+/** Depth of the manager's own code on the calling thread.  The exit handlers leave alone what is mapped meanwhile, which
+ *  is the manager's memory rather than the program's. */
+static __thread int manager_depth __attribute__((tls_model("initial-exec"))) = 0;
+
+/** Depth of the calling thread's critical sections with every signal blocked, and the mask that the outermost one restores
+ *  (see block_signals ()). */
+static __thread int blocked_depth __attribute__((tls_model("initial-exec"))) = 0;
+static __thread uint64_t blocked_mask __attribute__((tls_model("initial-exec"))) = 0;
+
+/** Faults raised by the manager's own code, which should never touch a traced page, and the address of the first; reported
+ *  at exit (see trace_finish ()). */
+static unsigned long manager_faults = 0;
+static void* manager_fault_address = NULL;
+
+/** The statistics page: the exported one when VMT_STATS is set, and a private one otherwise, which is counted in all the same;
+ *  the calling thread's row of it; and the name of the exported page. */
+static struct stats_page local_stats;
+static struct stats_page* stats = &local_stats;
+static __thread struct stats_row* stats_row __attribute__((tls_model("initial-exec"))) = NULL;
+static char stats_name[32];
+
+/** End of the program's data segment, as last seen by brk_handler (). */
+static uintptr_t program_break = 0;
+
+/** Name of the csv file: VMT_TRACENAME, or the name the catcher gave when it attached. */
+static char trace_name[PATH_MAX];
+
+/** This process's entry in the channel, once it has registered. */
+static struct channel_process* registration = NULL;
+
+/** Number of faults after which tracing stops, when the catcher attached for that many; '0' for no limit. */
+static unsigned long fault_limit = 0;
+
+/** Flag that sets when the catcher attached to the running program, rather than starting it. */
+static bool attached = false;
+
+/** Flag that sets once the trace has been written out, so that it is written once. */
+static bool trace_finished = false;
+
+/** The process whose trace this is; the child of a vfork (), which shares its memory, is not. */
+static pid_t trace_pid = 0;
+
+/** SIGSEGV action of the program when the catcher attached; put back when it detaches. */
+static struct sigaction attached_sa;
+
+/** Flag that selects the in-process seccomp mode (VMT_MODE is "seccomp"), which needs no catcher. */
+static bool use_seccomp = false;
+
+/** Sigaction struct of the SIGSYS handler used in seccomp mode. */
+static struct sigaction sys_sa;
+
+/** Issues a system call from the one address that the seccomp filter always lets through, vmt_syscall_allowed. */
+long vmt_syscall(long nr, long arg1, long arg2, long arg3, long arg4, long arg5, long arg6);
+extern char vmt_syscall_allowed[];
 /*===============================================================================*/
 
 
 
+/* =============================================================================================================================== */
+/**
+ * Body of vmt_syscall (): moves the arguments from the function calling convention to the system call one (the sixth
+ * argument is on the stack), and returns the kernel's result as is, without setting errno.
+ */
+__asm__ (
+	".text\n"
+	".globl vmt_syscall\n"
+	".hidden vmt_syscall\n"
+	".type vmt_syscall, @function\n"
+	"vmt_syscall:\n"
+	"	movq %rdi, %rax\n"
+	"	movq %rsi, %rdi\n"
+	"	movq %rdx, %rsi\n"
+	"	movq %rcx, %rdx\n"
+	"	movq %r8, %r10\n"
+	"	movq %r9, %r8\n"
+	"	movq 8(%rsp), %r9\n"
+	"	syscall\n"
+	".globl vmt_syscall_allowed\n"
+	".hidden vmt_syscall_allowed\n"
+	"vmt_syscall_allowed:\n"
+	"	ret\n"
+	".size vmt_syscall, . - vmt_syscall\n"
+);
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Make a system call through vmt_syscall (), with nothing of libc in between, as libc's wrappers may not be safe in
+ *        the handler; the result is as the wrapper's would be.
+ * \param nr Number of the system call.
+ * \return Result of the call; '-1' on error, with errno set.
+ */
+static long raw_syscall(long nr, long arg1, long arg2, long arg3, long arg4) {
+	long result = vmt_syscall(nr, arg1, arg2, arg3, arg4, 0, 0);
+
+	if (result < 0 && result > -4096) {
+		errno = (int) -result;
+		return -1;
+	}
+	return result;
+} // raw_syscall ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Find a page's entry in the selected metadata store.
+ * \param address A given page.
+ * \param entry Where to copy the page's entry.
+ * \return 'true' if the page is tracked; 'false' otherwise.
+ */
+bool lookup_page(void* address, hashmap_entry_s* entry) {
+	if (use_radix == true) {
+		hashmap_entry_s *entry_ptr = radix_lookup(&radix, (page_num_t) PAGE_BASE(address));
+		if (entry_ptr == NULL) {
+			return false;
+		}
+		entry->word = __atomic_load_n(&entry_ptr->word, __ATOMIC_RELAXED);
+		return true;
+	}
+	return shardmap_lookup(&shardmap, (page_num_t) PAGE_BASE(address), entry);
+} // lookup_page ()
+/* =============================================================================================================================== */
+
+
+
 /* =============================================================================================================================== */
 /**
  * \brief Add page to the hashmap.
@@ -169,16 +428,138 @@ static hashmap_s hashmap;
  * \return 'true' if page was added into hashmap; 'false' if attempted add failed.
  */
 bool add_page(void* address, int permissions, bool isunprotected) {
-	hashmap_entry_s entry;
-	entry.page_num = (page_num_t) address;
-	entry.original_perms = permissions;
-	entry.unprotected = isunprotected;
-	return hashmap_insert(&hashmap, entry);
+	hashmap_entry_s entry = ENTRY_MAKE((page_num_t) address, permissions, isunprotected);
+	bool added = (use_radix == true) ? radix_insert(&radix, entry) : shardmap_insert(&shardmap, entry);
+	if (added == true) {
+		STATS_ADD(tracked, 1);
+	}
+	return added;
 } // add_page ()
 /* =============================================================================================================================== */
 
 
 
+/* =============================================================================================================================== */
+/**
+ * \brief Remove page from the metadata store.
+ * \param address A given page.
+ * \return 'true' if page was removed; 'false' if it was not tracked.
+ */
+bool remove_page(void* address) {
+	if (use_cc == true) {
+		cc_remove((uintptr_t) address);
+	}
+	bool removed = (use_radix == true) ? radix_remove(&radix, (page_num_t) address) : shardmap_remove(&shardmap, (page_num_t) address);
+	if (removed == true) {
+		STATS_ADD(tracked, -1);
+	}
+	return removed;
+} // remove_page ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Add protected pages to the metadata store, from the start of a range up to the first page that is already tracked.
+ * \param start First page of the range.
+ * \param pages Number of pages in the range.
+ * \param permissions Record the pages' protection flags.
+ * \return Number of pages added; these, and only these, are the caller's to protect.
+ */
+size_t add_page_range(uintptr_t start, size_t pages, int permissions) {
+	if (use_radix == true) {
+		size_t added = radix_insert_range(&radix, start, pages, permissions, false);
+		STATS_ADD(tracked, (int64_t) added);
+		return added;
+	}
+
+	size_t added = 0;
+	while (added < pages && add_page((void*) (start + added * pagesize), permissions, false) == true) {
+		added = added + 1;
+	}
+	return added;
+} // add_page_range ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Remove the pages of a range that are tracked from the metadata store, once the range is unmapped.
+ *        Pages in the unprotected list stay tracked, under their locks, so that the list never holds a page twice: were one
+ *        dropped, and its address mapped and claimed again by another thread, evicting the older element would protect the
+ *        page under the newer one.  Such a page is protected, and so retired, when it is evicted.
+ * \param start First page of the range.
+ * \param pages Number of pages in the range.
+ * \return Number of pages removed.
+ */
+size_t remove_page_range(uintptr_t start, size_t pages) {
+	size_t page_size = pagesize;
+	uintptr_t locked[RANGE_PAGES];
+	hashmap_entry_s entry;
+	size_t removed = 0;
+
+	for (size_t done = 0; done < pages; done = done + RANGE_PAGES) {
+		size_t count = (pages - done < RANGE_PAGES) ? pages - done : RANGE_PAGES;
+		for (size_t i = 0; i < count; i++) {
+			locked[i] = start + (done + i) * page_size;
+		}
+
+		//removes each run of pages that are not in the unprotected list
+		size_t first = lock_pages(locked, count);
+		size_t run = 0;
+		for (size_t i = 0; i <= count; i++) {
+			if (i < count && !(lookup_page((void*) locked[i], &entry) == true && ENTRY_GET_FLAG(&entry, ENTRY_UNPROTECTED))) {
+				continue;
+			}
+			if (i > run && use_radix == true) {
+				removed = removed + radix_remove_range(&radix, locked[run], i - run);
+				for (size_t j = run; j < i && use_cc == true; j++) {
+					cc_remove(locked[j]);
+				}
+			}
+			for (size_t j = run; j < i && use_radix == false; j++) {
+				if (remove_page((void*) locked[j]) == true) {
+					removed = removed + 1;
+				}
+			}
+			run = i + 1;
+		}
+		unlock_pages(locked, count, first);
+	}
+	if (use_radix == true) {
+		STATS_ADD(tracked, -(int64_t) removed);
+	}
+	return removed;
+} // remove_page_range ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Atomically change a page's permissions and flags.
+ * \param address A given page.
+ * \param must_clear Flags that must be clear for the change to be made.
+ * \param set Bits to set in the page's entry.
+ * \param clear Bits to clear in the page's entry.
+ * \param result If not 'NULL', receives the page's entry after the call; its page is zero if the page is not tracked.
+ * \return 'true' if the page was changed; 'false' if it is not tracked or a 'must_clear' flag was set.
+ */
+bool update_page(void* address, page_num_t must_clear, page_num_t set, page_num_t clear, hashmap_entry_s* result) {
+	if (result != NULL) {
+		result->word = 0;
+	}
+	if (use_radix == true) {
+		return radix_update(&radix, (page_num_t) PAGE_BASE(address), must_clear, set, clear, result);
+	}
+	return shardmap_update(&shardmap, (page_num_t) PAGE_BASE(address), must_clear, set, clear, result);
+} // update_page ()
+/* =============================================================================================================================== */
+
+
+
 /* =============================================================================================================================== */
 /**
  * \brief Set the page's permissions and protection status.
@@ -189,17 +570,23 @@ bool add_page(void* address, int permissions, bool isunprotected) {
  * \param use_protection Check if the page needs its protection status updated.
  */
 void change_page_info(void *address, int permissions, bool use_permissions, bool isunprotected, bool use_protection) {
-	hashmap_entry_s *entry = hashmap_lookup(&hashmap, (page_num_t) PAGE_BASE(address));
+	page_num_t set = 0;
+	page_num_t clear = 0;
 
-	if (entry != NULL) {
-		if (use_permissions == true) {
-			entry->original_perms = permissions;
-		}
+	if (use_permissions == true) {
+		set = set | ((page_num_t) permissions & ENTRY_PERMS_MASK);
+		clear = clear | ENTRY_PERMS_MASK;
+	}
 
-		if (use_protection == true) {
-			entry->unprotected = isunprotected;
+	if (use_protection == true) {
+		if (isunprotected == true) {
+			set = set | ENTRY_UNPROTECTED;
+		} else {
+			clear = clear | ENTRY_UNPROTECTED;
 		}
 	}
+
+	update_page(address, 0, set, clear, NULL);
 } // change_page_info ()
 /* =============================================================================================================================== */
 
@@ -213,9 +600,9 @@ void change_page_info(void *address, int permissions, bool use_permissions, bool
  *         not in hashmap or protected.
  */
 bool is_page_unprotected(void* address) {
-	hashmap_entry_s *entry = hashmap_lookup(&hashmap, (page_num_t) PAGE_BASE(address));
+	hashmap_entry_s entry;
 
-	if (entry!= NULL && entry->unprotected == true) {
+	if (lookup_page(address, &entry) == true && ENTRY_GET_FLAG(&entry, ENTRY_UNPROTECTED)) {
 		return true;
 	}
 
@@ -235,6 +622,11 @@ bool is_page_unprotected(void* address) {
  * \return '0' if call was sucessful; '-1' if error occured during call.
  */
 int sigaction(int signum, const struct sigaction *act, struct sigaction *oldact) {
+	//In seccomp mode, the SIGSYS handler must stay ours
+	if (signum == SIGSYS && use_seccomp == true && &sys_sa != act) {
+		return 0;
+	}
+
 	if (signum == SIGSEGV && &sa != act) {
 		if (act->sa_flags == SA_SIGINFO) {
 			orig_sigsegv_handler2 = NULL;
@@ -244,8 +636,7 @@ int sigaction(int signum, const struct sigaction *act, struct sigaction *oldact)
 			orig_sigsegv_handler2 = act->sa_handler;
 		}
 	} else {
-		typeof(&sigaction) orig = dlsym(RTLD_NEXT, "sigaction");
-		return orig(signum, act, oldact);
+		return sigaction_orig(signum, act, oldact);
 	}
 } // sigaction ()
 /* =============================================================================================================================== */
@@ -254,25 +645,53 @@ int sigaction(int signum, const struct sigaction *act, struct sigaction *oldact)
 
 /* =============================================================================================================================== */
 /**
- * \brief Wrapper mprotect that takes in a page's original permissions and calls
- *        original mprotect () only if page is currently unprotected.
+ * \brief Wrapper mprotect that records the new permissions of the tracked pages of a range, and applies them to those
+ *        that are unprotected and to the untracked ones; protected pages keep no access until they fault.  Each run of
+ *        pages is changed under the pages' locks, so that a fault on another thread cannot unprotect or reprotect one of
+ *        them in between.
  * \param addr Starting page-aligned address of the memory region being protected.
  * \param len Length of the address range.
  * \param prot Desired memory protection of mapping.
  * \return '0' if call was sucessful; '-1' if error occured during call.
  */
 int mprotect(void *addr, size_t len, int prot) {
-	change_page_info(addr, prot, true, false, false);
-	typeof(&mprotect) orig = dlsym(RTLD_NEXT, "mprotect");
-	if (is_page_unprotected(addr) == true) {
-		write(1, "page is in unprotected list\n", 28);
-		hashmap_entry_s *temp = hashmap_lookup(&hashmap, (page_num_t) PAGE_BASE(addr));
-		if (temp == NULL) {
-			//write_orig(1, "failure in wraper mprotect()\n", 30);
-			exit(1);
+	uintptr_t page_size = pagesize;
+	uintptr_t pages[RANGE_PAGES];
+	int perms[RANGE_PAGES];
+	hashmap_entry_s entry;
+	size_t total = (len + page_size - 1) / page_size;
+
+	if (metadata_ready == false || ((uintptr_t) addr & (page_size - 1)) != 0) {
+		return internal_mprotect(addr, len, prot);
+	}
+
+	for (size_t done = 0; done < total; done = done + RANGE_PAGES) {
+		size_t count = (total - done < RANGE_PAGES) ? total - done : RANGE_PAGES;
+		for (size_t i = 0; i < count; i++) {
+			pages[i] = (uintptr_t) addr + (done + i) * page_size;
 		}
 
-		return orig(addr, len, temp->original_perms);
+		size_t first = lock_pages(pages, count);
+		for (size_t i = 0; i < count; i++) {
+			update_page((void*) pages[i], 0, (page_num_t) prot & ENTRY_PERMS_MASK, ENTRY_PERMS_MASK, &entry);
+			perms[i] = (ENTRY_PAGE(&entry) != 0 && !ENTRY_GET_FLAG(&entry, ENTRY_UNPROTECTED)) ? PROT_NONE : prot;
+		}
+
+		//one call per run of pages of equal permissions; the first that fails ends the call, as the kernel's would
+		int result = 0;
+		size_t start = 0;
+		for (size_t i = 1; i <= count && result == 0; i++) {
+			if (i == count || perms[i] != perms[start]) {
+				result = internal_mprotect((void*) pages[start], (i - start) * page_size, perms[start]);
+				start = i;
+			}
+		}
+		int error = errno;
+		unlock_pages(pages, count, first);
+		if (result == -1) {
+			errno = error;
+			return -1;
+		}
 	}
 
 	return 0;
@@ -283,20 +702,29 @@ int mprotect(void *addr, size_t len, int prot) {
 
 /* =============================================================================================================================== */
 /**
- * \brief Standard mprotect call used exclusively in manager.
+ * \brief Standard mprotect call used exclusively in manager.  It is made as pkey_mprotect () with no key, which does the
+ *        same, so that the catcher, which stops the program on mprotect () to see its permissions, does not stop on the
+ *        manager's own; mprotect () is the fallback on kernels without it.  Both are made with raw_syscall (), so that the
+ *        handler can make them.  Once there is a restore key, the default key is given instead, which a page that
+ *        restore_page () gave the restore key gets back.
  * \param addr Starting page-aligned address of the memory region being protected.
  * \param len Length of the address range.
  * \param prot Desired memory protection of mapping.
  * \return '0' if call was sucessful; '-1' if error occured during call.
  */
 int internal_mprotect(void *addr, size_t len, int prot) {
-	static typeof(&mprotect) orig = NULL;
+	static bool no_pkeys = false;
 
-	if (orig == NULL) {
-		orig = dlsym(RTLD_NEXT, "mprotect");
+	STATS_ADD(mprotects, 1);
+	if (no_pkeys == false) {
+		long result = raw_syscall(SYS_pkey_mprotect, (long) addr, (long) len, prot, (restore_key == -1) ? -1 : 0);
+		if (result == 0 || errno != ENOSYS) {
+			return (int) result;
+		}
+		no_pkeys = true;
 	}
 
-	return orig(addr, len, prot);
+	return (int) raw_syscall(SYS_mprotect, (long) addr, (long) len, prot, 0);
 } // internal_mprotect ()
 /* =============================================================================================================================== */
 
@@ -320,254 +748,1486 @@ void initialize_array(void* array[], int size) {
 
 /* =============================================================================================================================== */
 /**
- * \brief Write a pointer address as a string
- * \param buffer String that holds converted pointer address
- * \param value  Pointer address casted as an integer
+ * \brief Find the calling thread's trace stream, creating it if the thread does not have one yet.
+ *        Threads created with clone () and no TLS of their own share the TLS of their creator, so the cached stream is
+ *        only used if its TID is the caller's.
+ * \return The calling thread's stream.
  */
-void convert(char * buffer, uint64_t value) {
-	//Performs bit operations to insert proper characters into string buffer
-	for (int i = 0; i < 16; i++) {
-		uint64_t bits = (value >> (60 - i*4)) & 0xf;
-		char c = hex[bits];
-		buffer[i] = c;
+tracebuf_stream_s* current_stream() {
+	uint32_t tid = (uint32_t) raw_syscall(SYS_gettid, 0, 0, 0, 0);
+
+	if (trace_stream == NULL || trace_stream->tid != tid) {
+		trace_stream = tracebuf_find(&trace, tid);
+		if (trace_stream == NULL) {
+			trace_stream = tracebuf_open(&trace);
+		}
 	}
-	buffer[16] = '\n';
-} // convert ()
+
+	return trace_stream;
+} // current_stream ()
 /* =============================================================================================================================== */
 
 
 
 /* =============================================================================================================================== */
 /**
- * \brief Add page to array and reprotect page when it will be replaced in array.
- * \param ptr Page.
- * \param array Array whose elements are pages.
- * \param index Pointer to index that keeps track of latest added page in array.
- * \param size Size of array.
+ * \brief Find the calling thread's row of the statistics page, claiming a free one if the thread has none yet.  Once every row is
+ *        taken, the thread counts in the retired row.  Threads created with clone () and no TLS of their own count in their
+ *        creator's row.
+ * \return The calling thread's row.
  */
-void add_ptr_to_list(void* ptr, void* array[], int* index, int size) {
-	void* page_based_pointer = PAGE_BASE(ptr);
-	//Checks if pointer is already in array
-	/*
-		 if (hashset_is_member(set, page_based_pointer) == 1) {
-		 write(file_addr, "Seg fault at page already in table", 34);
-		 exit(0);
-		 }
-		 */
-
-	if (is_page_unprotected(page_based_pointer) == true) {
-		write_orig(1, "Seg fault at page already in table", 34);
-		exit(0);
+static struct stats_row* own_stats() {
+	if (stats_row == NULL) {
+		uint32_t tid = (uint32_t) raw_syscall(SYS_gettid, 0, 0, 0, 0);
+		stats_row = &stats->retired;
+		for (int i = 0; i < STATS_ROWS; i++) {
+			uint32_t expected = 0;
+			if (__atomic_compare_exchange_n(&stats->rows[i].tid, &expected, tid, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				stats_row = &stats->rows[i];
+				break;
+			}
+		}
 	}
+	return stats_row;
+} // own_stats ()
+/* =============================================================================================================================== */
 
-	//Checks if element is not null
-	if (array[*index] != NULL) {
 
-		//Replaces element and keeps track of old pointer
-		void* old_ptr = array[*index];
 
-		//Protects old pointer element
-		if (internal_mprotect(old_ptr, sysconf(_SC_PAGE_SIZE), PROT_NONE) == -1) {
-			write(file_addr, "mprotect() failed to protect when added to ptr\n", 48);
-			exit(1);
-		}
+/* =============================================================================================================================== */
+/**
+ * \brief Add the counters of a row into another, which several threads may add into at once.
+ * \param into The row added into.
+ * \param row The row added.
+ */
+static void stats_fold(struct stats_row* into, const struct stats_row* row) {
+	__atomic_fetch_add(&into->faults, row->faults, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&into->evictions, row->evictions, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&into->mprotects, row->mprotects, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&into->walks, row->walks, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&into->tracked, row->tracked, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&into->window, row->window, __ATOMIC_RELAXED);
+} // stats_fold ()
+/* =============================================================================================================================== */
 
-		//change location of page in hashmap
-		change_page_info(old_ptr, -1, false, false, true);
 
-		// Adds the pointer to the compressed caching mechanism.
-		// cc_add((intptr_t) old_ptr);
 
+/* =============================================================================================================================== */
+/**
+ * \brief Give up the calling thread's row of the statistics page as the thread exits, adding its counts into the retired row.
+ */
+static void stats_release() {
+	struct stats_row* row = stats_row;
+	stats_row = NULL;
+	if (row == NULL || row == &stats->retired) {
+		return;
 	}
+	stats_fold(&stats->retired, row);
+	row->faults = 0;
+	row->evictions = 0;
+	row->mprotects = 0;
+	row->walks = 0;
+	row->tracked = 0;
+	row->window = 0;
+	__atomic_store_n(&row->tid, 0, __ATOMIC_RELEASE);
+} // stats_release ()
+/* =============================================================================================================================== */
 
-	//Add pointer to array
-	array[*index] = page_based_pointer;
-
-	//Increases index by one
-	*index = *index + 1;
 
-	//change location of page in hashmap
-	change_page_info(page_based_pointer, -1, false, true, true);
 
-	//Reset index to beginning of array
-	if (*index == size) {
-		*index = 0;
+/* =============================================================================================================================== */
+/**
+ * \brief Export the statistics page of this process under its process ID (see stats.h), in place of the page counted in so
+ *        far, whose counts it starts with.  A page left under that name by the program that executed this one is unlinked
+ *        rather than reused, so that a viewer still reading it never finds it cut short.  Counting goes on in the page
+ *        counted in so far if the new one cannot be made.
+ * \return '0' if the page was exported; '-1' otherwise.
+ */
+static int stats_export() {
+	char name[sizeof(stats_name)];
+	snprintf(name, sizeof(name), STATS_NAME_FORMAT, (int) getpid());
+	shm_unlink(name);
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		return -1;
+	}
+	struct stats_page* page = (ftruncate(fd, STATS_SIZE) == -1) ? MAP_FAILED :
+	                          mmap(NULL, STATS_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (page == MAP_FAILED) {
+		shm_unlink(name);
+		return -1;
 	}
 
+	//The threads of the page counted in so far are gone, or about to count here; their counts are retired
+	stats_fold(&page->retired, &stats->retired);
+	for (int i = 0; i < STATS_ROWS; i++) {
+		stats_fold(&page->retired, &stats->rows[i]);
+	}
+	page->pid = (uint32_t) getpid();
+	page->window_size = (uint64_t) SIZE;
+	page->trace_bytes = stats->trace_bytes;
 
-} // add_ptr_to_list ()
+	if (stats != &local_stats) {
+		munmap(stats, STATS_SIZE);
+	}
+	stats = page;
+	stats_row = NULL;
+	memcpy(stats_name, name, sizeof(stats_name));
+	return 0;
+} // stats_export ()
 /* =============================================================================================================================== */
 
 
 
 /* =============================================================================================================================== */
 /**
- * \brief Signal handler that catches 'SIGSEGV' signals to unprotect/protect pages.
- * \param mysignal Number of signal that caused invocation of handler.
- * \param si Pointer to 'siginfo_t', a struct that contains more info about signal.
- * \param arg Pointer to 'ucontext_t' struct that contains signal context info.
+ * \brief Run in the child of a fork () when the statistics page is exported: the child counts in a page of its own, which starts
+ *        with its parent's counts.
  */
-static void handler(int mysignal, siginfo_t *si, void* arg) {
+static void stats_fork_child() {
+	manager_depth++;
+	stats_export();
+	manager_depth--;
+} // stats_fork_child ()
+/* =============================================================================================================================== */
 
-	//Gets pagesize
-	pagesize = sysconf(_SC_PAGE_SIZE);
 
-	//Writes address where signal was caught into csv file
-	//write(file_addr, "Segmentation fault occured at address: ", 39);
-	convert(buffer,(uint64_t) PAGE_BASE(si->si_addr));
-	write_orig(file_addr, buffer, 17);
-  write_orig(file_addr, "one\n", 4);
 
-	//Adds pointer to pointer array
-	if (trace_flag == 1) {
-		//Code to call input program's signal handler if it exists
-		if (is_page_unprotected(si->si_addr) == true) {
-			if (!(orig_sigsegv_handler == NULL && orig_sigsegv_handler2 == NULL)) {
-				if (orig_sigsegv_handler != NULL) {
-					orig_sigsegv_handler(mysignal, si, arg);
-				} else {
-					orig_sigsegv_handler2(mysignal);
-				}
-			}
+/* =============================================================================================================================== */
+/**
+ * \brief Protect a page that leaves the list, under its page lock.  With VMT_COMPRESS, a readable private page is first made
+ *        read-only, so that no thread changes it meanwhile, and compressed into the compressed cache, and its memory is
+ *        released; other pages join the cache's queue without their contents.  A page that holds one word over and over is
+ *        kept as that word, uncompressed, and traced as such.  With VMT_CAPTURE, a readable page is first copied, to be
+ *        annotated in the trace in the background.
+ * \param page The page.
+ * \param entry The page's metadata.
+ * \return '0' if the page was protected; '-1' otherwise, with errno set.
+ */
+static int evict_page(void* page, hashmap_entry_s* entry) {
+	size_t page_size = pagesize;
+	bool readable = (ENTRY_PERMS(entry) & PROT_READ) != 0;
 
-			write_orig(1, "Segmentation Fault due to no signal handler\n", 44);
-			exit(1);
+	if (use_cc == true) {
+		if (readable == false || ENTRY_GET_FLAG(entry, ENTRY_SHARED)) {
+			cc_add((uintptr_t) page);
 		} else {
-
-			add_ptr_to_list(PAGE_BASE(si->si_addr), ptr_list, &current_index, SIZE);
-			hashmap_entry_s *entry_temp = hashmap_lookup(&hashmap, (page_num_t) PAGE_BASE(si->si_addr));
-			if (entry_temp == NULL) {
-				write(1, "lookup failure in handler()\n", 28);
-				exit(0);
+			if (internal_mprotect(page, page_size, PROT_READ) == -1) {
+				return -1;
 			}
-
-
-			//Unprotects page
-			if (internal_mprotect(PAGE_BASE(si->si_addr), pagesize, entry_temp->original_perms) == -1) {
-				write(file_addr, "mprotect() did not sucessfully protect in handler()\n", 52);
-				exit(0);
+			if (use_capture == true) {
+				capture_page(&capture, page);
+			}
+			int stored = cc_store((uintptr_t) page, page_size);
+			if (trace_flag == 1 && (stored == CC_ZERO_FILLED || stored == CC_SAME_FILLED)) {
+				tracebuf_append(&trace, current_stream(), (uintptr_t) page,
+				                (stored == CC_ZERO_FILLED) ? TRACEBUF_ZERO_PAGE : TRACEBUF_SAME_FILLED);
 			}
 
-			// Removes page from the compressed cache.
-			// cc_remove((intptr_t) PAGE_BASE(si->si_addr));
+			//The memory is released once the page is protected, or another thread could read it as zeros in between
+			if (internal_mprotect(page, page_size, PROT_NONE) == -1) {
+				return -1;
+			}
+			if (stored != CC_NOT_STORED) {
+				raw_syscall(SYS_madvise, (long) page, (long) page_size, MADV_DONTNEED, 0);
+			}
+			return 0;
 		}
-	} else {
+	}
 
-		if (internal_mprotect(PAGE_BASE(si->si_addr), pagesize, PROT_WRITE | PROT_READ) == -1) {
-			write(file_addr, "mprotect() did not sucessfully protect in handler()\n", 52);
-			exit(0);
-		}
+	if (use_capture == true && readable == true) {
+		capture_page(&capture, page);
 	}
 
-} // handler ()
+	return internal_mprotect(page, page_size, PROT_NONE);
+} // evict_page ()
 /* =============================================================================================================================== */
 
 
 
 /* =============================================================================================================================== */
 /**
- * \brief Allocate memory with original malloc call and protect allocated space.
- * \param size Amount of memory requested.
+ * \brief Read and write the calling thread's rights to the protection keys (PKRU), two bits per key: access and write disabled.
  */
-void* malloc (size_t size) {
-
-	//Calls original malloc
-	void* ptr = __libc_malloc(size);
+static inline uint32_t read_pkru() {
+	uint32_t pkru;
+	__asm__ volatile (".byte 0x0f, 0x01, 0xee" : "=a" (pkru) : "c" (0) : "rdx");
+	return pkru;
+} // read_pkru ()
+
+static inline void write_pkru(uint32_t pkru) {
+	__asm__ volatile (".byte 0x0f, 0x01, 0xef" : : "a" (pkru), "c" (0), "d" (0) : "memory");
+} // write_pkru ()
+/* =============================================================================================================================== */
 
-	if (trace_flag == 0) {
-		return ptr;
-	}
 
-	//Determines number of pages to mprotect()
-	int base = (intptr_t) ptr;
-	int limit = base + size -1;
-	int numpages = (limit>>12) - (base>>12) + 1;
 
-	//Checks if page is in list of unprotected, if not protect
-	void* new_ptr = PAGE_BASE(ptr);
-	while (numpages > 0) {
-		//Add page to hashmap (will integrate into code later)
-		if (is_page_unprotected(new_ptr) == false) {
-			if (add_page(PAGE_BASE(new_ptr), PROT_READ | PROT_WRITE, false) == false) {
-				write_orig(1, "add_page() failed in malloc\n", 28);
-				exit(0);
-			}
+/* =============================================================================================================================== */
+/**
+ * \brief Bring back the contents of a page that the compressed cache holds, under its page lock, before it is unprotected:
+ *        the page is made writable, and the contents decompressed into it.  The caller then gives the page its permissions.
+ *        With the restore key, the page is writable by this thread alone meanwhile; other threads, which would otherwise
+ *        see it half-written, and have their own writes to it overwritten, fault and wait on its lock.
+ * \param page The page.
+ * \return '0' if the page holds its contents; '-1' if it could not be made writable, with errno set.
+ */
+static int restore_page(void* page) {
+	size_t page_size = pagesize;
+	uint8_t data[CC_MAX_STORED];
+	size_t size = (use_cc == true) ? cc_take((uintptr_t) page, data, sizeof(data)) : 0;
+	bool loaded;
+
+	if (size == 0) {
+		return 0;
+	}
+	if (restore_key != -1) {
+		if (raw_syscall(SYS_pkey_mprotect, (long) page, (long) page_size, PROT_READ | PROT_WRITE, restore_key) == -1) {
+			return -1;
 		}
-
-
-		if (internal_mprotect(PAGE_BASE(new_ptr), sysconf(_SC_PAGE_SIZE) , PROT_NONE) == -1) {
-			write(file_addr, "mprotect failed in malloc()\n", 29);
-			exit(0);
+		uint32_t pkru = read_pkru();
+		write_pkru(pkru & ~(3U << (2 * restore_key)));
+		loaded = cc_load((uintptr_t) page, page_size, data, size);
+		write_pkru(pkru);
+	} else {
+		if (internal_mprotect(page, page_size, PROT_READ | PROT_WRITE) == -1) {
+			return -1;
 		}
+		loaded = cc_load((uintptr_t) page, page_size, data, size);
+	}
+	if (loaded == false) {
+		write(file_addr, "compressed page is corrupt in restore_page()\n", 46);
+		exit(1);
+	}
+	return 0;
+} // restore_page ()
+/* =============================================================================================================================== */
 
 
 
-		// Adds the newly-protected page to the compressed cache.
-		// cc_add((intptr_t) new_ptr);
-
-		new_ptr = new_ptr + sysconf(_SC_PAGE_SIZE);
-		numpages = numpages - 1;
-
+/* =============================================================================================================================== */
+/**
+ * \brief Start routine of the manager's own threads, which compact the compressed cache's pool and annotate evicted pages.
+ *        They count as the manager throughout, so that the memory they map and unmap is not taken for the program's.
+ *        A thread whose function returns does not exit, but sleeps until the process ends: on exit, glibc frees what it
+ *        allocated for the thread with the program's malloc (), whose pages may be protected, with every signal blocked.
+ * \param info_ptr Struct thread_start_info holding the thread's function and its argument.
+ * \return Never returns.
+ */
+static void* manager_thread_start(void* info_ptr) {
+	struct thread_start_info* info = info_ptr;
+	manager_depth++;
+	info->start(info->arg);
+	while (true) {
+		pause();
 	}
-
-	return ptr;
-} // malloc ()
+	return NULL;
+} // manager_thread_start ()
 /* =============================================================================================================================== */
 
 
 
 /* =============================================================================================================================== */
 /**
- * \brief Called by parent system catcher, reads in data from the shared file on
- *        which addresses to walk.
+ * \brief Start one of the manager's own threads, with every signal blocked, so that it never takes a lock of the manager in a
+ *        handler, and with the next pthread_create (), so that it has no trace stream of the program's.
+ * \param info Its function and argument; must outlive the thread.
+ * \return '0' if the thread started; an error number otherwise.
  */
-void walk_struct() {
+static int start_manager_thread(struct thread_start_info* info) {
+	pthread_t thread;
+	sigset_t all, old;
+
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	int ret = pthread_create_orig(&thread, NULL, manager_thread_start, info);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (ret == 0) {
+		pthread_detach(thread);
+	}
+	return ret;
+} // start_manager_thread ()
+/* =============================================================================================================================== */
 
-	//walks struct, faulting on protected pages
-	//if a string, walk to end
-	//if struct, walk the specified length
 
-	struct walker_info* wi_ptr = (struct walker_info*) shared;
-	for(int i = 0; i < 6; i++) {
-		int size = wi_ptr[i].length;
-		if(size == 0) {
-			break;
-		}
-		if (wi_ptr[i].ptr != NULL) {
-			//string
-			if (size == -1) {
-				char *ptr = wi_ptr[i].ptr;
-				while (*ptr != '\0') {
-					ptr = ptr + 1;
-				}
-				//struct
-			} else {
-				void *ptr = wi_ptr[i].ptr;
-				while(size > 0) {
-					dummy = ptr;
-					ptr = ptr + 1;
-					size = size - 1;
+
+/* =============================================================================================================================== */
+/**
+ * \brief Start the manager's own threads: the one that flushes the trace, and those that VMT_COMPRESS and VMT_CAPTURE call for.
+ */
+static void start_manager_threads() {
+	static struct thread_start_info flusher_info = { .start = tracebuf_run, .arg = &trace };
+	static struct thread_start_info compactor_info = { .start = cc_compactor };
+	static struct thread_start_info capture_info = { .start = capture_run, .arg = &capture };
+
+	start_manager_thread(&flusher_info);
+	if (use_cc == true) {
+		start_manager_thread(&compactor_info);
+	}
+	if (use_capture == true) {
+		start_manager_thread(&capture_info);
+	}
+} // start_manager_threads ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Add page to array and reprotect page when it will be replaced in array.
+ *        Safe to call from concurrent faults: each call claims its own element.
+ * \param ptr Page.
+ * \param array Array whose elements are pages.
+ * \param index Pointer to index that keeps track of next element to replace in array.
+ * \param size Size of array.
+ */
+void add_ptr_to_list(void* ptr, void* array[], unsigned int* index, int size) {
+	void* page_based_pointer = PAGE_BASE(ptr);
+
+	//Claims the next element and swaps the page into it
+	unsigned int slot = __atomic_fetch_add(index, 1, __ATOMIC_RELAXED) % size;
+	void* old_ptr = __atomic_exchange_n(&array[slot], page_based_pointer, __ATOMIC_ACQ_REL);
+	if (old_ptr == NULL) {
+		STATS_ADD(window, 1);
+	}
+
+	//Checks if element is not null
+	if (old_ptr != NULL) {
+
+		//Protects old pointer element and changes its location in hashmap, under its page lock; a page that has been unmapped
+		//since is no longer tracked, and is left alone, and one that was unmapped while in the list is retired now
+		hashmap_entry_s entry;
+		lock_page(old_ptr);
+		if (update_page(old_ptr, 0, 0, ENTRY_UNPROTECTED, &entry) == true) {
+			STATS_ADD(evictions, 1);
+			if (evict_page(old_ptr, &entry) == -1) {
+				if (errno != ENOMEM) {
+					write(file_addr, "mprotect() failed to protect when added to ptr\n", 48);
+					exit(1);
+				}
+				remove_page(old_ptr);
+			}
+		}
+		unlock_page(old_ptr);
+
+	}
+
+} // add_ptr_to_list ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Signal handler that catches 'SIGSEGV' signals to unprotect/protect pages.
+ *        Runs with every signal blocked, so that it never interrupts a thread holding a lock it needs.
+ * \param mysignal Number of signal that caused invocation of handler.
+ * \param si Pointer to 'siginfo_t', a struct that contains more info about signal.
+ * \param arg Pointer to 'ucontext_t' struct that contains signal context info.
+ */
+static void handler(int mysignal, siginfo_t *si, void* arg) {
+
+	blocked_depth++;
+	bool from_manager = (manager_depth > 0);
+	manager_depth++;
+	STATS_ADD(faults, 1);
+	if (from_manager == true) {
+		void* expected = NULL;
+		__atomic_fetch_add(&manager_faults, 1, __ATOMIC_RELAXED);
+		__atomic_compare_exchange_n(&manager_fault_address, &expected, si->si_addr, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	}
+
+	//Tells the catcher, when it attached, that this thread must not be left stopped here when it detaches
+	struct channel_slot* busy_slot = (attached == true && channel != NULL) ? channel_slot() : NULL;
+	if (busy_slot != NULL) {
+		busy_slot->busy = 1;
+	}
+
+	//Adds pointer to pointer array
+	if (trace_flag == 1) {
+		void* page = PAGE_BASE(si->si_addr);
+
+		//Records address where signal was caught in this thread's trace stream
+		tracebuf_append(&trace, current_stream(), (uintptr_t) page, TRACEBUF_FAULT);
+
+		//When the catcher attached for a number of faults, tracing stops once they are recorded
+		if (fault_limit != 0 && registration != NULL && __atomic_add_fetch(&registration->faults, 1, __ATOMIC_RELAXED) >= fault_limit) {
+			trace_flag = 0;
+		}
+
+		bool is_write = (((ucontext_t*) arg)->uc_mcontext.gregs[REG_ERR] & PAGE_FAULT_WRITE) != 0;
+
+		//Claims the page: marks it unprotected, records the first touch of the page and whether this access was a write, and
+		//unprotects it, all under its page lock
+		hashmap_entry_s entry_temp;
+		lock_page(page);
+		page_num_t set = ENTRY_UNPROTECTED | ENTRY_FIRST_TOUCH | (is_write ? ENTRY_DIRTY : 0);
+		bool claimed = update_page(page, ENTRY_UNPROTECTED, set, 0, &entry_temp);
+		if (claimed == true && (restore_page(page) == -1 || internal_mprotect(page, pagesize, ENTRY_PERMS(&entry_temp)) == -1)) {
+			write(file_addr, "mprotect() did not sucessfully protect in handler()\n", 52);
+			exit(0);
+		}
+		unlock_page(page);
+
+		if (ENTRY_PAGE(&entry_temp) == 0) {
+			if (from_manager == true) {
+				write_orig(2, "lookup failure in handler(): the manager's own code faulted, on a guard page or past its memory\n", 96);
+			}
+			write(1, "lookup failure in handler()\n", 28);
+			exit(0);
+		}
+
+		if (claimed == true) {
+			add_ptr_to_list(page, ptr_list, &current_index, SIZE);
+		} else {
+			//Another thread unprotected the page after this fault was raised; the access is retried unless it violates the page's
+			//own permissions, in which case it belongs to the input program's signal handler if it exists
+			int perms = ENTRY_PERMS(&entry_temp);
+			if ((perms & PROT_READ) == 0 || (is_write == true && (perms & PROT_WRITE) == 0)) {
+				if (!(orig_sigsegv_handler == NULL && orig_sigsegv_handler2 == NULL)) {
+					if (orig_sigsegv_handler != NULL) {
+						orig_sigsegv_handler(mysignal, si, arg);
+					} else {
+						orig_sigsegv_handler2(mysignal);
+					}
+				}
+
+				write_orig(1, "Segmentation Fault due to no signal handler\n", 44);
+				exit(1);
+			}
+		}
+	} else {
+
+		//Tracing is over; the page is only unprotected, once the compressed cache gave back its contents
+		void* page = PAGE_BASE(si->si_addr);
+		lock_page(page);
+		if (restore_page(page) == -1 || internal_mprotect(page, pagesize, PROT_WRITE | PROT_READ) == -1) {
+			write(file_addr, "mprotect() did not sucessfully protect in handler()\n", 52);
+			exit(0);
+		}
+		unlock_page(page);
+	}
+
+	if (busy_slot != NULL) {
+		busy_slot->busy = 0;
+	}
+
+	//The size of the trace goes to the statistics page as it grows, which is only when a flush has written to it
+	uint64_t trace_bytes = trace.written;
+	if (stats->trace_bytes != trace_bytes) {
+		stats->trace_bytes = trace_bytes;
+	}
+	manager_depth--;
+	blocked_depth--;
+
+} // handler ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Start tracking the pages of a range, and protect them.
+ *        Pages that are already tracked are left alone, whether protected or in the unprotected list; the rest are added and
+ *        protected one contiguous run at a time.  Only the pages this call added are protected, so that a concurrent malloc ()
+ *        on another thread sharing a page never protects a page this one has already handed out.  Pages are added and
+ *        protected under their locks, so that a system call on that other thread cannot claim and unprotect one in between.
+ * \param first_page First page of the range.
+ * \param pages Number of pages in the range.
+ * \param permissions The pages' own protection flags, with ENTRY_SHARED if the range is shared.
+ */
+void protect_new_range(uintptr_t first_page, size_t pages, int permissions) {
+	size_t page_size = pagesize;
+	uintptr_t locked[RANGE_PAGES];
+	size_t done = 0;
+	while (done < pages) {
+		uintptr_t run_start = first_page + done * page_size;
+		size_t count = (pages - done < RANGE_PAGES) ? pages - done : RANGE_PAGES;
+		for (size_t i = 0; i < count; i++) {
+			locked[i] = run_start + i * page_size;
+		}
+
+		size_t first = lock_pages(locked, count);
+		size_t added = add_page_range(run_start, count, permissions);
+		if (added > 0 && internal_mprotect((void*) run_start, added * page_size, PROT_NONE) == -1) {
+			write(file_addr, "mprotect failed in protect_new_range()\n", 40);
+			exit(0);
+		}
+		unlock_pages(locked, count, first);
+
+		//Skips the tracked page that ended the run, if it did not end at the lock limit
+		done = done + added + ((added < count) ? 1 : 0);
+	}
+} // protect_new_range ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Allocate memory with original malloc call and protect allocated space.
+ * \param size Amount of memory requested.
+ */
+void* malloc (size_t size) {
+
+	//Calls original malloc
+	void* ptr = __libc_malloc(size);
+
+	if (trace_flag == 0 || ptr == NULL) {
+		return ptr;
+	}
+
+	manager_depth++;
+
+	//Determines range of pages to mprotect()
+	uintptr_t first_page = (uintptr_t) PAGE_BASE(ptr);
+	uintptr_t end_page = (uintptr_t) PAGE_BASE(((char*) ptr + size - 1)) + pagesize;
+
+	protect_new_range(first_page, (end_page - first_page) / pagesize, PROT_READ | PROT_WRITE);
+
+	manager_depth--;
+	return ptr;
+} // malloc ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Closes a thread's trace stream as it exits, so that its records are merged, and gives up its arena of the
+ *        manager's heap.
+ * \param stream The thread's stream.
+ */
+static void thread_finish(void* stream) {
+	manager_depth++;
+	tracebuf_close(&trace, stream);
+	trace_stream = NULL;
+	stats_release();
+	vmt_thread_exit();
+	manager_depth--;
+} // thread_finish ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Start routine of every thread created with pthread_create (); opens the thread's trace stream and calls the
+ *        thread's own start routine.
+ * \param info_ptr Struct thread_start_info holding the start routine and its argument.
+ * \return Return value of the start routine.
+ */
+static void* thread_start(void* info_ptr) {
+	struct thread_start_info info = *(struct thread_start_info*) info_ptr;
+	manager_depth++;
+	vmt_free(info_ptr);
+
+	trace_stream = tracebuf_open(&trace);
+	pthread_setspecific(trace_key, trace_stream);
+	manager_depth--;
+
+	return info.start(info.arg);
+} // thread_start ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Wrapper pthread_create that gives each new thread its own trace stream.
+ * \param thread Receives the ID of the new thread.
+ * \param attr Attributes of the new thread.
+ * \param start Start routine of the new thread.
+ * \param arg Argument of the start routine.
+ * \return '0' if call was sucessful; an error number otherwise.
+ */
+int pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start)(void *), void *arg) {
+	if (trace_flag == 0) {
+		return pthread_create_orig(thread, attr, start, arg);
+	}
+
+	//From the manager's own heap, since malloc () would protect it
+	manager_depth++;
+	struct thread_start_info* info = vmt_malloc(sizeof(struct thread_start_info));
+	manager_depth--;
+	if (info == NULL) {
+		return EAGAIN;
+	}
+	info->start = start;
+	info->arg = arg;
+
+	int ret = pthread_create_orig(thread, attr, thread_start, info);
+	if (ret != 0) {
+		manager_depth++;
+		vmt_free(info);
+		manager_depth--;
+	}
+	return ret;
+} // pthread_create ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Function run by every thread created with clone () that shares our memory; runs the thread's own function with
+ *        a trace stream of its own, and closes the stream when the function returns (which ends the thread).  The thread
+ *        may have no TLS of its own, so it keeps its stream out of trace_stream.
+ * \param info_ptr Struct thread_start_info holding the function and its argument.
+ * \return Return value of the function.
+ */
+static int clone_start(void* info_ptr) {
+	struct thread_start_info info = *(struct thread_start_info*) info_ptr;
+	manager_depth++;
+	vmt_unmap_pages(info_ptr, 1);
+	tracebuf_stream_s* stream = tracebuf_open(&trace);
+	manager_depth--;
+
+	int ret = info.fn(info.arg);
+
+	manager_depth++;
+	tracebuf_close(&trace, stream);
+	//A creator's TLS shared with the thread may have cached the stream, which a flush is now free to release
+	if (trace_stream == stream) {
+		trace_stream = NULL;
+	}
+	manager_depth--;
+
+	return ret;
+} // clone_start ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Wrapper clone that gives each new thread (a child sharing our memory) its own trace stream.
+ *        Children that do not share memory are separate processes, and are passed through untouched.
+ * \param fn Function run by the child.
+ * \param stack Stack of the child.
+ * \param flags Clone flags.
+ * \param arg Argument of the function.
+ * \return TID of the child; '-1' if error occured during call.
+ */
+int clone(int (*fn)(void *), void *stack, int flags, void *arg, ...) {
+	//The optional arguments are always passed on; the kernel ignores those that the flags do not call for
+	va_list ap;
+	va_start(ap, arg);
+	pid_t *ptid = va_arg(ap, pid_t*);
+	void *tls = va_arg(ap, void*);
+	pid_t *ctid = va_arg(ap, pid_t*);
+	va_end(ap);
+
+	//A child with no TLS of its own runs on ours, so that neither of them can cache its TID there
+	if ((flags & (CLONE_VM | CLONE_SETTLS)) == CLONE_VM) {
+		tls_shared = true;
+	}
+
+	if (trace_flag == 0 || (flags & CLONE_VM) == 0) {
+		return clone_orig(fn, stack, flags, arg, ptid, tls, ctid);
+	}
+
+	//A page of the manager's rather than a block of its heap: the child may run on its parent's TLS, and so its arena
+	manager_depth++;
+	struct thread_start_info* info = vmt_map_pages(1);
+	manager_depth--;
+	if (info == NULL) {
+		errno = EAGAIN;
+		return -1;
+	}
+	info->fn = fn;
+	info->arg = arg;
+
+	int ret = clone_orig(clone_start, stack, flags, info, ptid, tls, ctid);
+	if (ret == -1) {
+		manager_depth++;
+		vmt_unmap_pages(info, 1);
+		manager_depth--;
+	}
+	return ret;
+} // clone ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Writes every thread's remaining trace records, in time order, and closes the csv file.  Registered with
+ *        atexit (), so that it also runs when the program calls exit () rather than returning from main ().
+ */
+static void trace_finish() {
+	//Faults from here on only unprotect
+	trace_flag = 0;
+	if (trace_finished == true) {
+		return;
+	}
+	trace_finished = true;
+	manager_depth++;
+
+	//The snapshots not yet annotated are annotated here, in this thread's stream
+	if (use_capture == true) {
+		capture_stop(&capture, current_stream());
+	}
+
+	tracebuf_flush(&trace, true);
+	tracebuf_end(&trace);
+	write(file_addr, "End\n", 4);
+	close(file_addr);
+	if (use_cc == true) {
+		cc_print_stats(STDERR_FILENO);
+	}
+	if (use_capture == true) {
+		char line[128];
+		int length = snprintf(line, sizeof(line), "capture: %lu pages annotated, %lu evicted with the ring full\n",
+		                      (unsigned long) capture.captured, (unsigned long) capture.dropped);
+		write(STDERR_FILENO, line, length);
+	}
+
+	//The statistics page is finished, and removed; a viewer that has it mapped reads it to the end
+	stats->trace_bytes = trace.written;
+	stats->finished = 1;
+	if (stats != &local_stats) {
+		shm_unlink(stats_name);
+	}
+
+	//Self-check: the manager's state is kept apart from the traced pages, so its own code should never have faulted
+	unsigned long faults = __atomic_load_n(&manager_faults, __ATOMIC_RELAXED);
+	if (faults != 0) {
+		char line[128];
+		int length = snprintf(line, sizeof(line), "manager: %lu faults raised by the manager's own code, the first at %p\n", faults,
+		                      __atomic_load_n(&manager_fault_address, __ATOMIC_RELAXED));
+		write(STDERR_FILENO, line, length);
+	}
+	manager_depth--;
+} // trace_finish ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Replace _exit () to write out the trace first, as exit () does through atexit (): a process that ends this way (as a
+ *        shell does, or the child of a fork () whose exec () failed) would otherwise lose the records not yet flushed.  The
+ *        child of a vfork () shares its parent's memory, and with it the trace, which it leaves alone.
+ * \param status Exit status.
+ */
+void _exit(int status) {
+	if (trace_pid == getpid()) {
+		trace_finish();
+	}
+	raw_syscall(SYS_exit_group, status, 0, 0, 0);
+	__builtin_unreachable();
+} // _exit ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Replace _Exit (), which is _exit () by another name.
+ * \param status Exit status.
+ */
+void _Exit(int status) {
+	_exit(status);
+} // _Exit ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Block every signal on the calling thread, for one of the manager's critical sections, so that the handler never
+ *        interrupts a thread holding a lock that it needs.  Sections nest, and only the outermost one changes the mask,
+ *        with a single system call; the handler, which runs with every signal blocked, counts as one.
+ */
+static void block_signals() {
+	if (blocked_depth == 0) {
+		uint64_t all = ~0UL;
+		raw_syscall(SYS_rt_sigprocmask, SIG_BLOCK, (long) &all, (long) &blocked_mask, sizeof(all));
+	}
+	blocked_depth++;
+} // block_signals ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief End a critical section begun by block_signals (); the outermost one restores the signal mask.
+ */
+static void unblock_signals() {
+	blocked_depth--;
+	if (blocked_depth == 0) {
+		raw_syscall(SYS_rt_sigprocmask, SIG_SETMASK, (long) &blocked_mask, 0, sizeof(blocked_mask));
+	}
+} // unblock_signals ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Acquire a page's lock, with every signal blocked until unlock_page ().
+ * \param page The page.
+ */
+static void lock_page(void* page) {
+	block_signals();
+	shardmap_lock(PAGE_LOCK(page));
+} // lock_page ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Release a page's lock acquired by lock_page ().
+ * \param page The page.
+ */
+static void unlock_page(void* page) {
+	shardmap_unlock(PAGE_LOCK(page));
+	unblock_signals();
+} // unlock_page ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Acquire the locks of a list of pages, in the order of the locks, so that two threads doing so never deadlock.
+ *        Every signal stays blocked until unlock_pages ().
+ * \param pages Page addresses, ascending, spanning fewer than PAGE_LOCKS pages so that no two share a lock.
+ * \param count Number of pages.
+ * \return Index of the page whose lock was acquired first; unlock_pages () needs it.
+ */
+static size_t lock_pages(uintptr_t pages[], size_t count) {
+	//The locks of ascending pages ascend, except where their stripe wraps around to zero
+	size_t first = 0;
+	for (size_t i = 1; i < count; i++) {
+		if (PAGE_LOCK(pages[i]) < PAGE_LOCK(pages[i - 1])) {
+			first = i;
+		}
+	}
+
+	block_signals();
+	for (size_t n = 0; n < count; n++) {
+		shardmap_lock(PAGE_LOCK(pages[(first + n) % count]));
+	}
+	return first;
+} // lock_pages ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Release the locks acquired by lock_pages (), and restore the signal mask.
+ * \param pages Page addresses passed to lock_pages ().
+ * \param count Number of pages.
+ * \param first Index returned by lock_pages ().
+ */
+static void unlock_pages(uintptr_t pages[], size_t count, size_t first) {
+	for (size_t n = count; n > 0; n--) {
+		shardmap_unlock(PAGE_LOCK(pages[(first + n - 1) % count]));
+	}
+	unblock_signals();
+} // unlock_pages ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Change the protection of a list of pages with one mprotect () call for each run of consecutive pages of equal
+ *        permissions.  Pages of a run that the program has unmapped since are retired from the metadata store; the caller
+ *        holds their locks.
+ * \param pages Page addresses, ascending.
+ * \param perms Protection of each page.
+ * \param count Number of pages.
+ * \return '0' if every call succeeded; '-1' otherwise.
+ */
+static int protect_runs(uintptr_t pages[], int perms[], size_t count) {
+	size_t page_size = pagesize;
+	size_t start = 0;
+	for (size_t i = 1; i <= count; i++) {
+		if (i == count || pages[i] != pages[i - 1] + page_size || perms[i] != perms[start]) {
+			if (internal_mprotect((void*) pages[start], (i - start) * page_size, perms[start]) == -1) {
+				if (errno != ENOMEM) {
+					return -1;
+				}
+				//part of the run is unmapped; its pages are redone one at a time
+				for (size_t j = start; j < i; j++) {
+					if (internal_mprotect((void*) pages[j], page_size, perms[j]) == -1) {
+						if (errno != ENOMEM) {
+							return -1;
+						}
+						remove_page((void*) pages[j]);
+					}
+				}
+			}
+			start = i;
+		}
+	}
+	return 0;
+} // protect_runs ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Hold a page unprotected, out of the window, until the current system call is done, adding it to the last held
+ *        run if it follows it.
+ * \param page The page.
+ * \return 'true' if the page was held; 'false' if every run is taken.
+ */
+static bool hold_page(uintptr_t page) {
+	size_t page_size = pagesize;
+	if (held_count > 0) {
+		struct page_run* last = &held[held_count - 1];
+		if (last->start + last->pages * page_size == page) {
+			last->pages = last->pages + 1;
+			return true;
+		}
+	}
+	if (held_count == HELD_RUNS) {
+		return false;
+	}
+	held[held_count].start = page;
+	held[held_count].pages = 1;
+	held_count = held_count + 1;
+	return true;
+} // hold_page ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Unprotect every protected page of a range of memory that a system call is passed, without faulting: the pages
+ *        are found in the page metadata, marked unprotected, unprotected with one mprotect () per run of pages, traced as
+ *        system call accesses, and put in the window.  Pages past the window's size are kept unprotected outside it, until
+ *        syscall_done ().  Untracked pages are never protected, and are skipped, so that a length larger than the memory
+ *        behind it (such as the count of a read () near the end of a buffer) is harmless.
+ * \param ptr Start of the range.
+ * \param length Size of the range.
+ * \param is_write Whether the kernel writes the range.
+ */
+void unprotect_range(const void* ptr, size_t length, bool is_write) {
+	if (ptr == NULL || length == 0 || metadata_ready == false) {
+		return;
+	}
+
+	//the end is clamped so that it cannot wrap around
+	uintptr_t page_size = pagesize;
+	uintptr_t start = (uintptr_t) ptr;
+	uintptr_t end = (length - 1 > UINTPTR_MAX - start) ? UINTPTR_MAX : start + length - 1;
+	uintptr_t last = (uintptr_t) PAGE_BASE(end);
+	syscall_bytes = syscall_bytes + (end - start + 1);
+	uintptr_t pages[RANGE_PAGES];
+	uintptr_t claimed_pages[RANGE_PAGES];
+	int perms[RANGE_PAGES];
+	hashmap_entry_s entry;
+
+	for (uintptr_t chunk = (uintptr_t) PAGE_BASE(start); chunk <= last; chunk = chunk + RANGE_PAGES * page_size) {
+		uintptr_t chunk_last = (last - chunk < RANGE_PAGES * page_size) ? last : chunk + (RANGE_PAGES - 1) * page_size;
+
+		//finds the pages that look protected, without locks
+		size_t count = 0;
+		for (uintptr_t page = chunk; page <= chunk_last; page = page + page_size) {
+			if (lookup_page((void*) page, &entry) == true && !ENTRY_GET_FLAG(&entry, ENTRY_UNPROTECTED)) {
+				pages[count] = page;
+				count = count + 1;
+			}
+		}
+
+		if (count > 0) {
+			//claims them under their locks, as a fault would, and unprotects the ones claimed
+			size_t first = lock_pages(pages, count);
+			size_t claimed = 0;
+			page_num_t set = ENTRY_UNPROTECTED | ENTRY_FIRST_TOUCH | (is_write ? ENTRY_DIRTY : 0);
+			for (size_t i = 0; i < count; i++) {
+				if (update_page((void*) pages[i], ENTRY_UNPROTECTED, set, 0, &entry) == true) {
+					if (restore_page((void*) pages[i]) == -1) {
+						write(file_addr, "mprotect() did not sucessfully unprotect in unprotect_range()\n", 62);
+						exit(0);
+					}
+					claimed_pages[claimed] = pages[i];
+					perms[claimed] = ENTRY_PERMS(&entry);
+					claimed = claimed + 1;
+				}
+			}
+			if (protect_runs(claimed_pages, perms, claimed) == -1) {
+				write(file_addr, "mprotect() did not sucessfully unprotect in unprotect_range()\n", 62);
+				exit(0);
+			}
+			unlock_pages(pages, count, first);
+
+			//traces them, and holds them unprotected until the call is done; once every run is taken, the rest go in the window
+			syscall_unprotected = syscall_unprotected + claimed;
+			for (size_t i = 0; i < claimed; i++) {
+				if (trace_flag == 1) {
+					tracebuf_append(&trace, current_stream(), claimed_pages[i], TRACEBUF_SYSCALL);
+				}
+				if (hold_page(claimed_pages[i]) == false) {
+					add_ptr_to_list((void*) claimed_pages[i], ptr_list, &current_index, SIZE);
+				}
+			}
+		}
+
+		if (chunk_last == last) {
+			break;
+		}
+	}
+} // unprotect_range ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Ends the calling thread's current system call, as far as the window is concerned: puts the pages held for it
+ *        in the window, as many as it holds, and protects the rest again, with one mprotect () per run.
+ */
+void syscall_done() {
+	size_t page_size = pagesize;
+	uintptr_t pages[RANGE_PAGES];
+	uintptr_t protect_pages[RANGE_PAGES];
+	int perms[RANGE_PAGES];
+	hashmap_entry_s entry;
+	size_t listed = 0;
+
+	for (int r = 0; r < held_count; r++) {
+		for (size_t done = 0; done < held[r].pages; done = done + RANGE_PAGES) {
+			size_t count = (held[r].pages - done < RANGE_PAGES) ? held[r].pages - done : RANGE_PAGES;
+			for (size_t i = 0; i < count; i++) {
+				pages[i] = held[r].start + (done + i) * page_size;
+			}
+
+			//the first pages go in the window, outside the locks, as adding one can protect another
+			size_t list = ((size_t) SIZE - listed < count) ? (size_t) SIZE - listed : count;
+			for (size_t i = 0; i < list; i++) {
+				add_ptr_to_list((void*) pages[i], ptr_list, &current_index, SIZE);
+			}
+			listed = listed + list;
+			if (list == count) {
+				continue;
+			}
+
+			size_t first = lock_pages(pages + list, count - list);
+			size_t protect = 0;
+			for (size_t i = list; i < count; i++) {
+				if (update_page((void*) pages[i], 0, 0, ENTRY_UNPROTECTED, &entry) == true) {
+					//with VMT_COMPRESS, each page is compressed on its own as it is protected
+					if (use_cc == true) {
+						if (evict_page((void*) pages[i], &entry) == -1) {
+							if (errno != ENOMEM) {
+								write(file_addr, "mprotect() failed to protect in syscall_done()\n", 47);
+								exit(1);
+							}
+							remove_page((void*) pages[i]);
+						}
+						continue;
+					}
+					protect_pages[protect] = pages[i];
+					perms[protect] = PROT_NONE;
+					protect = protect + 1;
+				}
+			}
+			if (protect_runs(protect_pages, perms, protect) == -1) {
+				write(file_addr, "mprotect() failed to protect in syscall_done()\n", 47);
+				exit(1);
+			}
+			unlock_pages(pages + list, count - list, first);
+		}
+	}
+
+	held_count = 0;
+	returned_count = 0;
+	syscall_bytes = 0;
+	syscall_unprotected = 0;
+} // syscall_done ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Unprotects memory passed to a system call.
+ * \param ptr Start of the memory.
+ * \param length '-1' if it is a string, up to its end; its size otherwise.
+ * \param is_write Whether the kernel writes the memory.
+ */
+void walk_pointer(const void* ptr, long length, bool is_write) {
+	if (ptr == NULL || metadata_ready == false) {
+		return;
+	}
+
+	//string: unprotects it a page at a time, until the page that holds its end
+	if (length == -1) {
+		uintptr_t page_size = pagesize;
+		const char* str = ptr;
+		while (true) {
+			size_t rest = page_size - ((uintptr_t) str & (page_size - 1));
+			unprotect_range(str, rest, is_write);
+			if (memchr(str, '\0', rest) != NULL) {
+				return;
+			}
+			str = str + rest;
+		}
+	}
+
+	if (length > 0) {
+		unprotect_range(ptr, (size_t) length, is_write);
+	}
+} // walk_pointer ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Unprotects memory that a system call writes as many bytes of as it returns, and keeps it until the call has
+ *        returned, for syscall_returned () to mark dirty as far as it wrote.  Should every range be taken, it is marked
+ *        dirty whole, as memory that the call writes up to its size is.
+ * \param ptr Start of the memory.
+ * \param length Size of the memory.
+ */
+static void walk_returned(const void* ptr, size_t length) {
+	if (ptr == NULL || length == 0) {
+		return;
+	}
+	if (returned_count == RETURNED_RANGES) {
+		walk_pointer(ptr, (long) length, true);
+		return;
+	}
+	returned[returned_count].start = (uintptr_t) ptr;
+	returned[returned_count].length = length;
+	returned_count = returned_count + 1;
+	walk_pointer(ptr, (long) length, false);
+} // walk_returned ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Marks dirty the pages that the calling thread's current system call wrote of its SYSCALL_OUT_RETURN ranges: as many
+ *        bytes as it returned, taken from the ranges in order.  A call that failed wrote none.
+ * \param result Result of the call.
+ */
+static void syscall_returned(long result) {
+	size_t rest = (result > 0) ? (size_t) result : 0;
+
+	for (int r = 0; r < returned_count && rest > 0; r++) {
+		size_t length = (returned[r].length < rest) ? returned[r].length : rest;
+		uintptr_t end = returned[r].start + length - 1;
+		uintptr_t last = (uintptr_t) PAGE_BASE(end);
+		for (uintptr_t page = (uintptr_t) PAGE_BASE(returned[r].start); page <= last; page = page + pagesize) {
+			update_page((void*) page, 0, ENTRY_DIRTY, 0, NULL);
+		}
+		rest = rest - length;
+	}
+	returned_count = 0;
+} // syscall_returned ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Walks an array of iovecs, and the buffer of each.
+ * \param iov The array.
+ * \param count Number of iovecs.
+ * \param out Whether the kernel writes the buffers: SYSCALL_OUT_NONE, SYSCALL_OUT_SIZE, or SYSCALL_OUT_RETURN, as many bytes
+ *        as it returns, in order.
+ */
+void walk_iovec(const struct iovec* iov, size_t count, int out) {
+	if (iov == NULL || count > SIZE_MAX / sizeof(struct iovec)) {
+		return;
+	}
+	walk_pointer(iov, count * sizeof(struct iovec), false);
+	for (size_t i = 0; i < count; i++) {
+		if (out == SYSCALL_OUT_RETURN) {
+			walk_returned(iov[i].iov_base, iov[i].iov_len);
+		} else {
+			walk_pointer(iov[i].iov_base, iov[i].iov_len, out != SYSCALL_OUT_NONE);
+		}
+	}
+} // walk_iovec ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Walks a msghdr, and its name, control buffer and iovecs.
+ * \param msg The msghdr.
+ * \param is_write Whether the kernel writes them (receiving, rather than sending).
+ */
+void walk_msghdr(const struct msghdr* msg, bool is_write) {
+	if (msg == NULL) {
+		return;
+	}
+	walk_pointer(msg, sizeof(struct msghdr), is_write);
+	walk_pointer(msg->msg_name, msg->msg_namelen, is_write);
+	walk_pointer(msg->msg_control, msg->msg_controllen, is_write);
+	walk_iovec(msg->msg_iov, msg->msg_iovlen, is_write ? SYSCALL_OUT_SIZE : SYSCALL_OUT_NONE);
+} // walk_msghdr ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Walks the memory that a system call may touch, following the system call table.
+ * \param nr System call number; numbers past the table are not walked.
+ * \param args The system call's arguments.
+ */
+void walk_syscall(long nr, const unsigned long args[6]) {
+	if (nr < 0 || nr >= SYSCALL_TABLE_SIZE) {
+		return;
+	}
+
+	for (int i = 0; i < 6; i++) {
+		const struct syscall_arg* rule = &syscall_table[nr][i];
+		const void* ptr = (const void*) args[i];
+		unsigned long units = args[rule->arg];
+		bool is_write = (rule->out != SYSCALL_OUT_NONE);
+
+		switch (rule->kind) {
+			case SYSCALL_ARG_STRING:
+				walk_pointer(ptr, -1, is_write);
+				break;
+			case SYSCALL_ARG_STRINGS:
+				//argv and envp may be NULL, which execve () takes as empty
+				if (ptr == NULL) {
+					break;
+				}
+				for (char* const* strings = ptr; ; strings = strings + 1) {
+					walk_pointer(strings, sizeof(char*), false);
+					if (*strings == NULL) {
+						break;
+					}
+					walk_pointer(*strings, -1, false);
+				}
+				break;
+			case SYSCALL_ARG_FIXED:
+				walk_pointer(ptr, rule->size, is_write);
+				break;
+			case SYSCALL_ARG_LENGTH:
+				if (units > (unsigned long) (LONG_MAX - rule->extra) / rule->size) {
+					break;
+				}
+				if (rule->out == SYSCALL_OUT_RETURN) {
+					walk_returned(ptr, units * rule->size + rule->extra);
+				} else {
+					walk_pointer(ptr, units * rule->size + rule->extra, is_write);
+				}
+				break;
+			case SYSCALL_ARG_LENGTH_AT:
+				if (units != 0) {
+					walk_pointer((const void*) units, sizeof(socklen_t), is_write);
+					walk_pointer(ptr, *(const socklen_t*) units, is_write);
 				}
+				break;
+			case SYSCALL_ARG_BITS:
+				walk_pointer(ptr, (units / 64 + (units % 64 != 0)) * sizeof(long), is_write);
+				break;
+			case SYSCALL_ARG_PAGES:
+				walk_pointer(ptr, units / pagesize + (units % pagesize != 0), is_write);
+				break;
+			case SYSCALL_ARG_IOVEC:
+				walk_iovec(ptr, units, rule->out);
+				break;
+			case SYSCALL_ARG_MSGHDR:
+				walk_msghdr(ptr, is_write);
+				break;
+			case SYSCALL_ARG_MMSGHDR:
+				if (ptr != NULL && units <= SIZE_MAX / sizeof(struct mmsghdr)) {
+					walk_pointer(ptr, units * sizeof(struct mmsghdr), is_write);
+					for (unsigned long m = 0; m < units; m++) {
+						walk_msghdr(&((const struct mmsghdr*) ptr)[m].msg_hdr, is_write);
+					}
+				}
+				break;
+		}
+	}
+} // walk_syscall ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Get the calling thread's TID, with no call into libc.  It is cached in the thread's TLS, unless another thread shares
+ *        that TLS; the child of a fork () forgets it (see fork_child ()).
+ * \return The calling thread's TID.
+ */
+static uint32_t own_tid() {
+	if (tls_shared == true) {
+		return (uint32_t) raw_syscall(SYS_gettid, 0, 0, 0, 0);
+	}
+	if (thread_tid == 0) {
+		thread_tid = (uint32_t) raw_syscall(SYS_gettid, 0, 0, 0, 0);
+	}
+	return thread_tid;
+} // own_tid ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Find the calling thread's slot in the channel, which the parent system catcher fills in before it sends the
+ *        thread to the walker or an exit handler.  As in current_stream (), the cached slot is only used if its TID is the
+ *        caller's.
+ * \return The calling thread's slot.
+ */
+struct channel_slot* channel_slot() {
+	uint32_t tid = own_tid();
+
+	if (slot == NULL || slot->tid != tid) {
+		for (int i = 0; i < CHANNEL_SLOTS; i++) {
+			if (__atomic_load_n(&channel->slots[i].tid, __ATOMIC_ACQUIRE) == tid) {
+				slot = &channel->slots[i];
+				break;
 			}
 		}
 	}
-	//send signal to parent that walking is done
-	kill(getppid(), SIGUSR2);
+
+	return slot;
+} // channel_slot ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Tells the parent system catcher that the calling thread's latest request is done; the catcher stops us on the
+ *        wake, and sends us back to the system call that it interrupted, so this never returns.
+ */
+void channel_complete() {
+	struct channel_slot* own = channel_slot();
+	__atomic_store_n(&own->done, own->request, __ATOMIC_RELEASE);
+	raw_syscall(SYS_futex, (long) &own->done, FUTEX_WAKE, INT_MAX, 0);
+} // channel_complete ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Called by parent system catcher, reads in data from the channel on
+ *        which addresses to walk.
+ */
+void walk_struct() {
+
+	//the system call of the previous request has run by now
+	syscall_done();
+
+	//unprotects what the system call is passed, as the table describes it
+	struct channel_slot* own = channel_slot();
+	STATS_ADD(walks, 1);
+	walk_syscall(own->nr, own->args);
+	own->walked = syscall_bytes;
+	own->unprotected = syscall_unprotected;
+
+	//the program that this one executes appends to its trace, so everything recorded so far is written first
+	if (own->nr == SYS_execve || own->nr == SYS_execveat) {
+		tracebuf_flush(&trace, true);
+	}
+	//tell parent that walking is done
+	channel_complete();
 } // walk_struct ()
 /* =============================================================================================================================== */
 
 
 
-//these functions are to be filled out later to handle virtualization
-//check documentation for more info
 /* =============================================================================================================================== */
 /**
- * \brief Brk () wrapper that uses 'mprotect ()' to protect added data segment.
- * \param old_ptr Address that specifies end of data segment.
- * \param new_ptr Address that specifies new end of data segment.
+ * \brief Whether seccomp mode traps a system call: true if the system call table walks any of its arguments, except for
+ *        write (), whose wrapper walks its buffer (and the manager's own trace writes are made with every signal blocked,
+ *        when a trap would be fatal); rt_sigprocmask (), since a mask set in a signal handler is undone when the
+ *        handler returns; and futex (), which is frequent, and often made with every signal blocked.
+ * \param nr System call number.
+ * \return '1' if the call is trapped; '0' otherwise.
+ */
+static int is_trapped(int nr) {
+	if (nr == __NR_write || nr == __NR_rt_sigprocmask || nr == __NR_futex) {
+		return 0;
+	}
+	return syscall_walks(nr);
+} // is_trapped ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Seccomp mode's SIGSYS handler: walks the pointer arguments of the trapped system call, then makes the call
+ *        from vmt_syscall (), which the filter lets through, and returns its result as the trapped call's.
+ * \param signum Signal number (SIGSYS).
+ * \param si Signal information, holding the system call number.
+ * \param arg Context of the trapped call, holding its arguments.
  */
-void brk_handler(void *old_ptr, void *new_ptr) {
-	kill(getppid(), SIGUSR1);
+static void sys_handler(int signum, siginfo_t *si, void* arg) {
+	(void) signum;
+	greg_t* regs = ((ucontext_t*) arg)->uc_mcontext.gregs;
+	int nr = si->si_syscall;
+	unsigned long args[6] = { regs[REG_RDI], regs[REG_RSI], regs[REG_RDX], regs[REG_R10], regs[REG_R8], regs[REG_R9] };
+
+	STATS_ADD(walks, 1);
+	walk_syscall(nr, args);
+
+	regs[REG_RAX] = vmt_syscall(nr, args[0], args[1], args[2], args[3], args[4], args[5]);
+	syscall_returned(regs[REG_RAX]);
+	syscall_done();
+} // sys_handler ()
+/* =============================================================================================================================== */
+
+
+
+//Exit handlers: the catcher sends the program here once one of these system calls has succeeded, with its arguments and
+//result (or, for munmap (), before it runs).  Memory that the manager maps for itself is left alone.
+/* =============================================================================================================================== */
+/**
+ * \brief Exit handler of a walked system call with no other: marks dirty what the call wrote, as far as its result tells, and
+ *        protects again what the walk unprotected for the call, as soon as it has run, so that the program's own accesses to
+ *        that memory fault, and are traced, from here on.
+ * \param result Result of the call.
+ */
+void done_handler(long result) {
+	syscall_returned(result);
+	syscall_done();
+	channel_complete();
+} // done_handler ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Exit handler of brk (): tracks and protects the pages by which the data segment grew, or retires those by which
+ *        it shrank.
+ * \param requested Address that was asked for.
+ * \param new_ptr New end of data segment, as returned.
+ */
+void brk_handler(void *requested, void *new_ptr) {
+	(void) requested;
+	uintptr_t page_size = pagesize;
+	uintptr_t old_end = (program_break + page_size - 1) & ~(page_size - 1);
+	uintptr_t new_end = ((uintptr_t) new_ptr + page_size - 1) & ~(page_size - 1);
+
+	if (manager_depth == 0 && program_break != 0) {
+		if (new_end > old_end && trace_flag == 1) {
+			protect_new_range(old_end, (new_end - old_end) / page_size, PROT_READ | PROT_WRITE);
+		} else if (new_end < old_end) {
+			remove_page_range(new_end, (old_end - new_end) / page_size);
+		}
+	}
+	program_break = (uintptr_t) new_ptr;
+
+	channel_complete();
 } // brk_handler ()
 /* =============================================================================================================================== */
 
@@ -575,13 +2235,28 @@ void brk_handler(void *old_ptr, void *new_ptr) {
 
 /* =============================================================================================================================== */
 /**
- * \brief Mmap () wrapper that uses 'mprotect ()' to protect allocated memory.
- * \param ptr Starting address for new mapping.
+ * \brief Exit handler of mmap (): tracks and protects the program's new anonymous mappings.  Stacks are left alone, as
+ *        the fault handler cannot run on a protected stack, and so are mappings with no access, which are reservations.
+ * \param ptr Starting address of the new mapping.
  * \param size The length of mapping.
- * \param prot Desired memory protection of mapping.
+ * \param prot Protection of the mapping.
+ * \param flags Flags of the mapping.
  */
-void mmap_handler(void *ptr, size_t size, int prot) {
-	kill(getppid(), SIGUSR1);
+void mmap_handler(void *ptr, size_t size, int prot, int flags) {
+	uintptr_t page_size = pagesize;
+	size_t pages = (size + page_size - 1) / page_size;
+
+	if (manager_depth == 0) {
+		//a fixed mapping replaces whatever was there
+		if ((flags & MAP_FIXED) != 0) {
+			remove_page_range((uintptr_t) ptr, pages);
+		}
+		if (trace_flag == 1 && (flags & MAP_ANONYMOUS) != 0 && (flags & (MAP_STACK | MAP_GROWSDOWN)) == 0 && prot != PROT_NONE) {
+			protect_new_range((uintptr_t) ptr, pages, prot | (((flags & MAP_SHARED) != 0) ? ENTRY_SHARED : 0));
+		}
+	}
+
+	channel_complete();
 } // mmap_handler ()
 /* =============================================================================================================================== */
 
@@ -589,12 +2264,20 @@ void mmap_handler(void *ptr, size_t size, int prot) {
 
 /* =============================================================================================================================== */
 /**
- * \brief Munmap () wrapper uses 'mprotect ()' to unprotect space before freeing.
- * \param ptr  Starting page-aligned address of the memory region being removed.
+ * \brief Entry handler of munmap (): retires the metadata of the pages about to be unmapped, so that it does not grow
+ *        without bound in programs that map and unmap memory over and over.  It runs before the call, as once the pages are
+ *        unmapped another thread may map memory at the same address and track it.
+ * \param ptr  Starting page-aligned address of the memory region removed.
  * \param size Length of the address range.
  */
 void munmap_handler(void *ptr, size_t size) {
-	kill(getppid(), SIGUSR1);
+	uintptr_t page_size = pagesize;
+
+	if (manager_depth == 0) {
+		remove_page_range((uintptr_t) ptr, (size + page_size - 1) / page_size);
+	}
+
+	channel_complete();
 } // munmap_handler ()
 /* =============================================================================================================================== */
 
@@ -602,13 +2285,50 @@ void munmap_handler(void *ptr, size_t size) {
 
 /* =============================================================================================================================== */
 /**
- * \brief Mprotect () wrapper records original protection permissions when called.
- * \param ptr Starting page-aligned address of the memory region being protected.
+ * \brief Exit handler of mprotect (): records the new permissions of the tracked pages of the range, and protects again
+ *        those that are protected, which the call just made accessible.
+ * \param ptr Starting page-aligned address of the memory region.
  * \param size Length of the address range.
- * \param prot Desired memory protection of mapping.
+ * \param prot New protection of the region.
  */
 void mprotect_handler(void *ptr, size_t size, int prot) {
-	kill(getppid(), SIGUSR1);
+	uintptr_t page_size = pagesize;
+	uintptr_t pages[RANGE_PAGES];
+	uintptr_t protect_pages[RANGE_PAGES];
+	int perms[RANGE_PAGES];
+	hashmap_entry_s entry;
+	size_t total = (size + page_size - 1) / page_size;
+
+	for (size_t done = 0; manager_depth == 0 && done < total; done = done + RANGE_PAGES) {
+		size_t count = 0;
+		for (size_t i = done; i < total && i < done + RANGE_PAGES; i++) {
+			if (lookup_page((void*) ((uintptr_t) ptr + i * page_size), &entry) == true) {
+				pages[count] = (uintptr_t) ptr + i * page_size;
+				count = count + 1;
+			}
+		}
+		if (count == 0) {
+			continue;
+		}
+
+		size_t first = lock_pages(pages, count);
+		size_t protect = 0;
+		for (size_t i = 0; i < count; i++) {
+			update_page((void*) pages[i], 0, (page_num_t) prot & ENTRY_PERMS_MASK, ENTRY_PERMS_MASK, &entry);
+			if (ENTRY_PAGE(&entry) != 0 && !ENTRY_GET_FLAG(&entry, ENTRY_UNPROTECTED)) {
+				protect_pages[protect] = pages[i];
+				perms[protect] = PROT_NONE;
+				protect = protect + 1;
+			}
+		}
+		if (protect_runs(protect_pages, perms, protect) == -1) {
+			write(file_addr, "mprotect() failed to protect in mprotect_handler()\n", 51);
+			exit(1);
+		}
+		unlock_pages(pages, count, first);
+	}
+
+	channel_complete();
 } // mprotect_handler ()
 /* =============================================================================================================================== */
 
@@ -616,12 +2336,30 @@ void mprotect_handler(void *ptr, size_t size, int prot) {
 
 /* =============================================================================================================================== */
 /**
- * \brief Sigaction () wrapper that records benchmark program's signal handler.
+ * \brief Exit handler of rt_sigaction (): a SIGSEGV handler installed without the sigaction () wrapper (by the C library
+ *        itself, as signal () does) is recorded as the program's, and the manager's handler is put back.
  * \param signum Specifies signal type.
- * \param sigaction act Sigaction structure that contains sigaction handler.
+ * \param act The new action, in the kernel's layout; 'NULL' if there is none.
  */
-void sigaction_handler(int signum, struct sigaction act) {
-	kill(getppid(), SIGUSR1);
+void sigaction_handler(int signum, const struct syscall_kernel_sigaction* act) {
+	if (signum == SIGSEGV && act != NULL && act->handler != (void*) handler) {
+		if (act->handler == (void*) SIG_DFL || act->handler == (void*) SIG_IGN) {
+			orig_sigsegv_handler = NULL;
+			orig_sigsegv_handler2 = NULL;
+		} else if ((act->flags & SA_SIGINFO) != 0) {
+			orig_sigsegv_handler2 = NULL;
+			orig_sigsegv_handler = act->handler;
+		} else {
+			orig_sigsegv_handler = NULL;
+			orig_sigsegv_handler2 = act->handler;
+		}
+
+		sigaction_orig(SIGSEGV, &sa, NULL);
+	}
+
+	//the walk of the call may have unprotected the actions, which are protected again now that they are read
+	syscall_done();
+	channel_complete();
 } // sigaction_handler ()
 /* =============================================================================================================================== */
 
@@ -636,20 +2374,482 @@ void sigaction_handler(int signum, struct sigaction act) {
  * \return '0' if string was successfully written; '-1' if write () call failed.
  */
 ssize_t write(int fd, const void *buf, size_t count) {
-	//throws a warning but is fine
-	char *ptr = (char*) buf;
-	size_t size = count;
-	while (size > 0) {
-		dummy = ptr;
-		ptr = ptr + 1;
-		size = size - 1;
+	manager_depth++;
+	walk_pointer(buf, (long) count, false);
+	manager_depth--;
+
+	//Calls standard write()
+	ssize_t result = write_orig(fd, buf, count);
+	manager_depth++;
+	syscall_done();
+	manager_depth--;
+	return result;
+} // write ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Creates the csv file named by VMT_TRACENAME.  Under the parent system catcher, which may trace several processes,
+ *        each process has its own, with its process ID before the extension ("foo.csv" becomes "foo.1234.csv"); a program
+ *        that a process executes appends to the file of the process (the catcher sets VMT_TRACE_APPEND for it).
+ * \return The file descriptor of the csv file.
+ */
+static int open_trace() {
+	char *FILENAME = trace_name;
+	if (channel == NULL) {
+		return open(FILENAME, O_RDWR | O_CREAT | O_TRUNC, S_IRWXU);
+	}
+
+	char name[PATH_MAX + 16];
+	char *dot = strrchr(FILENAME, '.');
+	char *slash = strrchr(FILENAME, '/');
+	if (dot == NULL || (slash != NULL && dot < slash)) {
+		snprintf(name, sizeof(name), "%s.%d", FILENAME, getpid());
+	} else {
+		snprintf(name, sizeof(name), "%.*s.%d%s", (int) (dot - FILENAME), FILENAME, getpid(), dot);
 	}
+	int append = (getenv(TRACE_APPEND_ENV) != NULL) ? O_APPEND : O_TRUNC;
+	return open(name, O_RDWR | O_CREAT | O_CLOEXEC | append, S_IRWXU);
+} // open_trace ()
+/* =============================================================================================================================== */
 
-	//Calls standard open()
-	typeof(&write) orig = dlsym(RTLD_NEXT, "write");
 
-	return orig(fd, buf, count);
-} // write ()
+
+/* =============================================================================================================================== */
+/**
+ * \brief Registers this process with the parent system catcher: where it mapped the channel, and the addresses of the
+ *        walker and the exit handlers.  The catcher starts walking the process's system calls once it is registered.
+ */
+static void channel_register() {
+	pid_t pid = getpid();
+	struct channel_process* process = NULL;
+
+	//takes the process's own entry if it has one (as after exec ()), or else a free one
+	for (int i = 0; i < CHANNEL_PROCESSES && process == NULL; i++) {
+		if (channel->processes[i].pid == (uint32_t) pid) {
+			process = &channel->processes[i];
+		}
+	}
+	for (int i = 0; i < CHANNEL_PROCESSES && process == NULL; i++) {
+		uint32_t free_pid = 0;
+		if (__atomic_compare_exchange_n(&channel->processes[i].pid, &free_pid, (uint32_t) pid, false, __ATOMIC_ACQ_REL,
+		                                __ATOMIC_RELAXED)) {
+			process = &channel->processes[i];
+		}
+	}
+	if (process == NULL) {
+		write(2, "vmtrace: no room in the channel; system calls are not walked\n", 61);
+		return;
+	}
+
+	process->self = (uintptr_t) channel;
+	process->info.walker = walk_struct;
+	process->info.done = done_handler;
+	process->info.brk = brk_handler;
+	process->info.mmap = mmap_handler;
+	process->info.munmap = munmap_handler;
+	process->info.mprotect = mprotect_handler;
+	process->info.sigaction = sigaction_handler;
+	process->faults = 0;
+	__atomic_store_n(&process->registered, 1, __ATOMIC_RELEASE);
+	registration = process;
+} // channel_register ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Run in the child of a fork () under the parent system catcher.  The child is its own process, with only the
+ *        thread that forked: the page locks that other threads held are dropped, and the child traces into a file of its
+ *        own, starting with a fresh stream, and registers with the catcher.  The manager's own threads start again.
+ */
+static void fork_child() {
+	//Nothing to do once the catcher has detached
+	if (channel == NULL) {
+		return;
+	}
+	manager_depth++;
+	thread_tid = 0;
+	for (int i = 0; i < PAGE_LOCKS; i++) {
+		page_locks[i] = 0;
+	}
+	vmt_fork_child();
+	//The child's only thread is this one, so no reader can be in the tables that the map has outgrown
+	if (use_radix == false) {
+		shardmap_release_retired(&shardmap);
+	}
+	cc_fork_child();
+	if (use_capture == true) {
+		capture_fork_child(&capture);
+	}
+
+	file_addr = open_trace();
+	tracebuf_create(&trace, file_addr);
+	trace_pid = getpid();
+	trace_stream = tracebuf_open(&trace);
+	pthread_setspecific(trace_key, trace_stream);
+
+	channel_register();
+
+	//The manager's own threads did not fork with it
+	start_manager_threads();
+	manager_depth--;
+} // fork_child ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Reads the next mapping of this process from /proc/self/maps.
+ * \param maps File descriptor of /proc/self/maps.
+ * \param buffer Buffer of MAPS_BUFFER bytes holding what has been read and not yet parsed.
+ * \param length Number of bytes in the buffer.
+ * \param mapping Where to store the mapping.
+ * \return 'true' if a mapping was read; 'false' at the end of the file.
+ */
+static bool read_mapping(int maps, char buffer[], size_t* length, struct mapping* mapping) {
+	char* newline;
+	while ((newline = memchr(buffer, '\n', *length)) == NULL) {
+		ssize_t got = (*length < MAPS_BUFFER) ? read(maps, buffer + *length, MAPS_BUFFER - *length) : -1;
+		if (got <= 0) {
+			return false;
+		}
+		*length = *length + got;
+	}
+	*newline = '\0';
+
+	//"start-end perms offset dev inode name", where the name of an anonymous mapping is empty
+	char* cursor = buffer;
+	mapping->start = strtoul(cursor, &cursor, 16);
+	mapping->end = strtoul(cursor + 1, &cursor, 16);
+	memcpy(mapping->perms, cursor + 1, 4);
+	mapping->perms[4] = '\0';
+	strtoul(cursor + 5, &cursor, 16);
+	cursor = strchr(cursor + 1, ' ');
+	unsigned long inode = strtoul(cursor, &cursor, 10);
+	while (*cursor == ' ') {
+		cursor++;
+	}
+	mapping->anonymous = (inode == 0 && *cursor == '\0');
+	mapping->heap = (strcmp(cursor, "[heap]") == 0);
+	mapping->manager = (strcmp(cursor, "[anon:" VMT_REGION_NAME "]") == 0);
+
+	size_t consumed = newline + 1 - buffer;
+	memmove(buffer, newline + 1, *length - consumed);
+	*length = *length - consumed;
+	return true;
+} // read_mapping ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Adds a range of pages to those left alone, in ascending order; if there is no room left, it is dropped.
+ * \param keep The ranges.
+ * \param start First page of the range.
+ * \param pages Number of pages.
+ */
+static void keep_range(struct keep_ranges* keep, uintptr_t start, size_t pages) {
+	if (keep->count == keep->size) {
+		return;
+	}
+	size_t at = keep->count;
+	while (at > 0 && keep->ranges[at - 1].start > start) {
+		keep->ranges[at] = keep->ranges[at - 1];
+		at = at - 1;
+	}
+	keep->ranges[at].start = start;
+	keep->ranges[at].pages = pages;
+	keep->count = keep->count + 1;
+} // keep_range ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Called by dl_iterate_phdr () for each loaded object: adds the object's writable segments, data and bss, to the
+ *        ranges left alone.
+ * \param info The object's program headers, and where it is loaded.
+ * \param size Size of the information.
+ * \param data The ranges.
+ * \return '0', to go on to the next object.
+ */
+static int keep_object_data(struct dl_phdr_info* info, size_t size, void* data) {
+	struct keep_ranges* keep = data;
+	(void) size;
+
+	for (int i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr)* segment = &info->dlpi_phdr[i];
+		if (segment->p_type != PT_LOAD || (segment->p_flags & PF_W) == 0) {
+			continue;
+		}
+		uintptr_t address = info->dlpi_addr + segment->p_vaddr;
+		uintptr_t start = (uintptr_t) PAGE_BASE(address);
+		uintptr_t end = (address + segment->p_memsz + pagesize - 1) & ~(pagesize - 1);
+		keep_range(keep, start, (end - start) / pagesize);
+	}
+	return 0;
+} // keep_object_data ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Find the memory that a running program allocated before the catcher attached: its heap, and its private anonymous
+ *        mappings that it can read and write.  Left alone are the anonymous mappings that directly follow a guard page (a
+ *        thread's stack, or one cached for a new thread), those that hold a thread's stack pointer, the pages of the given
+ *        ranges (among them the loaded objects' data segments, whose bss the kernel may have merged with the program's own
+ *        memory), and the manager's own mappings, which are named (see vmt_mman.h), and whose guard pages are not a stack's.
+ * \param runs Where to store the memory found, as runs of pages.
+ * \param size Most runs to store.
+ * \param stacks Stack pointers of the program's threads, ending with '0'.
+ * \param keep Ranges of pages left alone, in ascending order.
+ * \param keep_count Number of ranges.
+ * \return Number of runs stored.
+ */
+static size_t find_program_memory(struct page_run runs[], size_t size, const uintptr_t stacks[], struct page_run keep[],
+                                  size_t keep_count) {
+	char buffer[MAPS_BUFFER];
+	size_t length = 0;
+	struct mapping mapping;
+	struct mapping previous = { 0 };
+	size_t count = 0;
+
+	int maps = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+	while (maps != -1 && count < size && read_mapping(maps, buffer, &length, &mapping) == true) {
+		bool found = (strcmp(mapping.perms, "rw-p") == 0 && (mapping.anonymous == true || mapping.heap == true));
+		if (mapping.anonymous == true && previous.end == mapping.start && strcmp(previous.perms, "---p") == 0
+		    && previous.end - previous.start <= GUARD_PAGES * (uintptr_t) pagesize && previous.manager == false) {
+			found = false;
+		}
+		for (size_t i = 0; stacks != NULL && stacks[i] != 0; i++) {
+			if (stacks[i] >= mapping.start && stacks[i] < mapping.end) {
+				found = false;
+			}
+		}
+
+		//stores what is left of the mapping around the ranges left alone
+		uintptr_t start = mapping.start;
+		for (size_t i = 0; found == true && i <= keep_count && count < size; i++) {
+			uintptr_t end = mapping.end;
+			if (i < keep_count) {
+				uintptr_t keep_end = keep[i].start + keep[i].pages * pagesize;
+				if (keep_end <= start || keep[i].start >= end) {
+					continue;
+				}
+				end = (keep[i].start > start) ? keep[i].start : start;
+				if (end > start) {
+					runs[count].start = start;
+					runs[count].pages = (end - start) / pagesize;
+					count = count + 1;
+				}
+				start = (keep_end < mapping.end) ? keep_end : mapping.end;
+				if (start == mapping.end) {
+					break;
+				}
+			} else if (end > start) {
+				runs[count].start = start;
+				runs[count].pages = (end - start) / pagesize;
+				count = count + 1;
+			}
+		}
+		previous = mapping;
+	}
+	if (maps != -1) {
+		close(maps);
+	}
+	return count;
+} // find_program_memory ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Entry point of the parent system catcher when it attaches to a running program: the catcher loads the manager
+ *        with dlopen () and calls this, with every thread of the program stopped.  It sets up what main_hook () does for a
+ *        program started with the manager, and tracks and protects the memory the program has already allocated, as
+ *        find_program_memory () finds it.  The program's own calls to malloc () are not wrapped; the memory it maps and its
+ *        heap's growth are tracked by the exit handlers.
+ * \param channel_path Path by which to open the channel.
+ * \param name Name of the csv file.
+ * \param size Number of pages kept unprotected.
+ * \param metadata Page metadata store, "hashmap" or "radix"; 'NULL' for the default.
+ * \param faults Number of faults after which tracing stops; '0' for no limit.
+ * \param stacks Stack pointers of the program's threads, ending with '0'.
+ * \return '0' once the program is traced; '-1' if the channel or the trace cannot be opened.
+ */
+int vmt_attach(const char* channel_path, const char* name, int size, const char* metadata, unsigned long faults,
+               const uintptr_t stacks[]) {
+	manager_depth++;
+	program_break = (uintptr_t) sbrk(0);
+
+	//Finds the program's memory before the manager maps its own.  The threads' stacks, the TLS of this one (the other
+	//threads' is on their stacks), which the handler uses, and the loaded objects' data segments (the manager's among them,
+	//loaded just now, whose bss may have merged with the program's memory below it) are left alone
+	size_t runs_size = (ATTACH_RUNS + ATTACH_KEEP) * sizeof(struct page_run);
+	struct page_run* runs = mmap(NULL, runs_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (runs == MAP_FAILED) {
+		manager_depth--;
+		return -1;
+	}
+	uintptr_t thread_pointer;
+	__asm__ ("movq %%fs:0, %0" : "=r" (thread_pointer));
+	struct keep_ranges keep = { runs + ATTACH_RUNS, 0, ATTACH_KEEP };
+	keep_range(&keep, (uintptr_t) runs, runs_size / pagesize);
+	keep_range(&keep, (uintptr_t) PAGE_BASE(thread_pointer) - TLS_PAGES * pagesize, TLS_PAGES + 2);
+	dl_iterate_phdr(keep_object_data, &keep);
+	size_t count = find_program_memory(runs, ATTACH_RUNS, stacks, keep.ranges, keep.count);
+
+	//Maps the channel, through the catcher's descriptor
+	int channel_fd = open(channel_path, O_RDWR | O_CLOEXEC);
+	channel = (channel_fd == -1) ? MAP_FAILED : mmap(NULL, CHANNEL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, channel_fd, 0);
+	if (channel_fd != -1) {
+		close(channel_fd);
+	}
+	snprintf(trace_name, sizeof(trace_name), "%s", name);
+	if (channel == MAP_FAILED || (file_addr = open_trace()) == -1) {
+		if (channel != MAP_FAILED) {
+			munmap(channel, CHANNEL_SIZE);
+		}
+		channel = NULL;
+		munmap(runs, runs_size);
+		manager_depth--;
+		return -1;
+	}
+
+	SIZE = size;
+	ptr_list = vmt_calloc(SIZE, sizeof(void*));
+	initialize_array(ptr_list, SIZE);
+
+	//Every thread gets its stream as it first faults
+	tracebuf_create(&trace, file_addr);
+	trace_pid = getpid();
+	pthread_key_create(&trace_key, thread_finish);
+	atexit(trace_finish);
+
+	use_radix = (metadata != NULL && strcmp(metadata, "radix") == 0);
+	if (use_radix == true) {
+		radix_create(&radix);
+	} else {
+		shardmap_create(&shardmap);
+	}
+	metadata_ready = true;
+
+	//Handles faults from here on; the program's own handler gets those that are not the manager's
+	sa.sa_flags = SA_SIGINFO;
+	sigfillset(&sa.sa_mask);
+	sa.sa_sigaction = handler;
+	sigaction_orig(SIGSEGV, &sa, &attached_sa);
+	if ((attached_sa.sa_flags & SA_SIGINFO) != 0) {
+		orig_sigsegv_handler = attached_sa.sa_sigaction;
+	} else if (attached_sa.sa_handler != SIG_DFL && attached_sa.sa_handler != SIG_IGN) {
+		orig_sigsegv_handler2 = attached_sa.sa_handler;
+	}
+
+	fault_limit = faults;
+	attached = true;
+	channel_register();
+	pthread_atfork(NULL, NULL, fork_child);
+
+	trace_flag = 1;
+	for (size_t i = 0; i < count; i++) {
+		protect_new_range(runs[i].start, runs[i].pages, PROT_READ | PROT_WRITE);
+	}
+	munmap(runs, runs_size);
+
+	manager_depth--;
+	return 0;
+} // vmt_attach ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Entry point of the parent system catcher when it detaches from a program it attached to, which it calls with
+ *        every thread stopped outside the manager.  Writes out the trace, gives every page that is still protected its own
+ *        permissions back, and puts back the program's SIGSEGV handler.  The manager stays loaded, but does nothing more.
+ */
+void vmt_detach() {
+	manager_depth++;
+	trace_finish();
+
+	//The protected pages are in the mappings with no access; each run of them with the same permissions is unprotected at once
+	char buffer[MAPS_BUFFER];
+	size_t length = 0;
+	struct mapping mapping;
+	hashmap_entry_s entry;
+	int maps = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+	while (maps != -1 && read_mapping(maps, buffer, &length, &mapping) == true) {
+		if (strcmp(mapping.perms, "---p") != 0) {
+			continue;
+		}
+		uintptr_t run_start = 0;
+		int run_perms = 0;
+		for (uintptr_t page = mapping.start; page <= mapping.end; page = page + pagesize) {
+			bool is_protected = (page < mapping.end && lookup_page((void*) page, &entry) == true
+			                     && !ENTRY_GET_FLAG(&entry, ENTRY_UNPROTECTED));
+			if (run_start != 0 && (is_protected == false || ENTRY_PERMS(&entry) != run_perms)) {
+				internal_mprotect((void*) run_start, page - run_start, run_perms);
+				run_start = 0;
+			}
+			if (is_protected == true && run_start == 0) {
+				run_start = page;
+				run_perms = ENTRY_PERMS(&entry);
+			}
+		}
+	}
+	if (maps != -1) {
+		close(maps);
+	}
+
+	//Puts back the program's handler, as it last installed it
+	struct sigaction program_sa = attached_sa;
+	if (orig_sigsegv_handler != NULL) {
+		program_sa.sa_sigaction = orig_sigsegv_handler;
+		program_sa.sa_flags = program_sa.sa_flags | SA_SIGINFO;
+	} else if (orig_sigsegv_handler2 != NULL) {
+		program_sa.sa_handler = orig_sigsegv_handler2;
+		program_sa.sa_flags = program_sa.sa_flags & ~SA_SIGINFO;
+	}
+	sigaction_orig(SIGSEGV, &program_sa, NULL);
+
+	//Leaves the channel; it stays mapped, as a thread the catcher stopped early in the handler may still mark its slot
+	attached = false;
+	if (registration != NULL) {
+		__atomic_store_n(&registration->registered, 0, __ATOMIC_RELEASE);
+		__atomic_store_n(&registration->pid, 0, __ATOMIC_RELEASE);
+		registration = NULL;
+	}
+	channel = NULL;
+	manager_depth--;
+} // vmt_detach ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Resolve the original functions that the wrappers call, and the page size, once, as the manager is loaded: before the
+ *        program starts, or as the catcher attaches.  Neither the handler nor the wrappers call dlsym () or sysconf () then.
+ */
+__attribute__((constructor))
+static void resolve_originals() {
+	pagesize = sysconf(_SC_PAGE_SIZE);
+	write_orig = dlsym(RTLD_NEXT, "write");
+	sigaction_orig = dlsym(RTLD_NEXT, "sigaction");
+	pthread_create_orig = dlsym(RTLD_NEXT, "pthread_create");
+	clone_orig = dlsym(RTLD_NEXT, "clone");
+	libc_start_main_orig = dlsym(RTLD_NEXT, "__libc_start_main");
+} // resolve_originals ()
 /* =============================================================================================================================== */
 
 
@@ -666,60 +2866,106 @@ ssize_t write(int fd, const void *buf, size_t count) {
  */
 int main_hook(int argc, char **argv, char **envp)
 {
-	//Sets up custom write for handler
-	write_orig = dlsym(RTLD_NEXT, "write");
-
-	//Opens and writes to a shared file to send address of walk and handler functions to parent
-	shared_fd = open("shared.data", O_RDWR, S_IRWXU);
-	shared = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, shared_fd, 0);
-
-	//The following segment of commented code seems to cause seg faults and write () calls to not print so    it's left out of manager for now.
-	/*
-		 struct addr_info* info = (struct addr_info*) shared;
-		 info->walker = walk_struct;
-		 info->brk = brk_handler;
-		 info->mmap = mmap_handler;
-		 info->munmap = munmap_handler;
-		 info->mprotect = mprotect_handler;
-		 info->sigaction = sigaction_handler;
-
-		 kill(getppid(), SIGUSR1);
-		 */
+	//The data segment grows from here, as far as the exit handler of brk () is concerned
+	program_break = (uintptr_t) sbrk(0);
+
+	//Maps the channel to the parent system catcher, if there is one; the descriptor stays open, so that the programs this
+	//one executes map it too
+	char *CHANNEL_FD = getenv(CHANNEL_FD_ENV);
+	if (CHANNEL_FD != NULL) {
+		int channel_fd = atoi(CHANNEL_FD);
+		channel = mmap(NULL, CHANNEL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, channel_fd, 0);
+		if (channel == MAP_FAILED) {
+			channel = NULL;
+		}
+	}
 
+	//Every signal is blocked while the handler runs (see shardmap.c)
 	sa.sa_flags = SA_SIGINFO;
-	sigemptyset(&sa.sa_mask);
+	sigfillset(&sa.sa_mask);
 	sa.sa_sigaction = handler;
 	sigaction(SIGSEGV, &sa, NULL);
 
-	//Get size of hash and array
+	//In seccomp mode (VMT_MODE is "seccomp"), system calls are trapped and walked here instead of by the catcher.  SIGSYS
+	//is not blocked while its handler runs, so that a handler of another signal that interrupts a walk may be trapped too
+	char *MODE = getenv("VMT_MODE");
+	use_seccomp = (MODE != NULL && strcmp(MODE, "seccomp") == 0);
+	if (use_seccomp == true) {
+		sys_sa.sa_flags = SA_SIGINFO | SA_NODEFER | SA_RESTART;
+		sigemptyset(&sys_sa.sa_mask);
+		sys_sa.sa_sigaction = sys_handler;
+		sigaction(SIGSYS, &sys_sa, NULL);
+	}
+
+	//Get size of array, which is kept in the manager's heap, apart from the program's memory, rather than on this stack
 	SIZE = atoi(getenv("VMT_SIZE"));
-	void* ptr_arr[SIZE];
-	ptr_list = ptr_arr;
+	ptr_list = vmt_calloc(SIZE, sizeof(void*));
+	if (ptr_list == NULL) {
+		write_orig(2, "pointer array could not be allocated\n", 37);
+		exit(1);
+	}
 
-	// Initializes compressed cache.
-	// cc_init();
+	//Exports the statistics page, for vmtrace-top to read while the program runs (VMT_STATS is set); the child of a fork ()
+	//exports its own
+	if (getenv(STATS_ENV) != NULL && stats_export() == 0) {
+		pthread_atfork(NULL, NULL, stats_fork_child);
+	}
 
-	//Get the file name
-	char *FILENAME = getenv("VMT_TRACENAME");
+	//Compresses the pages evicted from the list into the compressed cache, and releases their memory (VMT_COMPRESS is set)
+	use_cc = (getenv("VMT_COMPRESS") != NULL && cc_init() == true);
+	if (use_cc == true) {
+		restore_key = (int) raw_syscall(SYS_pkey_alloc, 0, PKEY_DISABLE_ACCESS, 0, 0);
+	}
 
 	// Create the output file
-	file_addr = open(FILENAME, O_RDWR | O_CREAT | O_TRUNC, S_IRWXU);
+	snprintf(trace_name, sizeof(trace_name), "%s", getenv("VMT_TRACENAME"));
+	file_addr = open_trace();
+
+	//Sets up the trace, with a stream for this thread; other threads get theirs as they start
+	tracebuf_create(&trace, file_addr);
+	trace_pid = getpid();
+	pthread_key_create(&trace_key, thread_finish);
+	trace_stream = tracebuf_open(&trace);
+	atexit(trace_finish);
+
+	//Starts the manager's own threads: one compacts the compressed cache's pool, and one annotates the pages evicted in the
+	//trace (VMT_CAPTURE is set), from the snapshots taken as they are evicted
+	use_capture = (getenv("VMT_CAPTURE") != NULL && capture_create(&capture, &trace) == true);
+	start_manager_threads();
 
 	//Intialize array
 	initialize_array(ptr_list, SIZE);
 
+	//Initalize the page metadata store selected by VMT_METADATA ("hashmap" by default, or "radix")
+	char *METADATA = getenv("VMT_METADATA");
+	use_radix = (METADATA != NULL && strcmp(METADATA, "radix") == 0);
+	if (use_radix == true) {
+		radix_create(&radix);
+	} else {
+		shardmap_create(&shardmap);
+	}
+	metadata_ready = true;
+
+	//Traps the system calls that pass pointers from here on; the filter also binds any program this one executes, which
+	//has no handler for SIGSYS, so exec () is not supported in this mode
+	if (use_seccomp == true && syscall_filter_install(is_trapped, SECCOMP_RET_TRAP, (uintptr_t) vmt_syscall_allowed, NULL) == -1) {
+		write(2, "seccomp filter could not be installed\n", 38);
+		exit(1);
+	}
+
+	//Sends the address of walk and handler functions to parent; it starts walking system calls once they are registered.
+	//The child of a fork () registers again, with a trace of its own
+	if (channel != NULL) {
+		channel_register();
+		pthread_atfork(NULL, NULL, fork_child);
+	}
+
 	//Tells malloc to start protecting pages
 	trace_flag = 1;
 
-	//Initalize hashmap
-	hashmap_create(&hashmap);
-
 	//Calls main() in benchmark program
 	int ret = main_orig(argc, argv, envp);
 
-	write(file_addr, "End\n", 4);
-	close(file_addr);
-
 	return ret;
 } // main_hook ()
 /* =============================================================================================================================== */
@@ -749,10 +2995,7 @@ int main_hook(int argc, char **argv, char **envp)
 {
 	main_orig = main;
 
-	//Calls orignal __libc_start_main
-	typeof(&__libc_start_main) orig = dlsym(RTLD_NEXT, "__libc_start_main");
-
-	//Calls on main_hook
-	return orig(main_hook, argc, argv , init,  fini, rtld_fini, stack_end);
+	//Calls orignal __libc_start_main, on main_hook
+	return libc_start_main_orig(main_hook, argc, argv , init,  fini, rtld_fini, stack_end);
 } // __libc_start_main ()
 /* =============================================================================================================================== */
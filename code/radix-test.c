@@ -0,0 +1,346 @@
+/* =============================================================================================================================== */
+/**
+ * \file radix-test.c
+ * \brief A test and benchmark of the radix table against the hash map as page metadata stores.
+ *
+ * First, random range insertions, protection changes and removals on one radix table are checked against the same operations
+ * done a page at a time on a second radix table and on a hash map (which grows as they go): each returns the same count, and
+ * every page of the window that they cover has the same entry, or none, in all three.  Then, for each requested number of pages,
+ * fill each store with page-aligned keys drawn from a few dense regions, and report the
+ * average time of insertions, of successful and unsuccessful lookups in random order, and of marking whole regions protected (one
+ * range operation for the radix table, a lookup per page for the hash map).
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hashmap.h"
+#include "radix.h"
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS and CONSTANTS */
+
+/** The size of a page. */
+#define PAGE_SIZE 4096
+
+/** The number of dense regions from which the pages are drawn. */
+#define REGIONS 4
+
+/** The number of lookups to time for each measurement. */
+#define LOOKUPS 10000000
+
+/** An offset that moves a key outside of every region, for unsuccessful lookups. */
+#define MISS_OFFSET 0x0000100000000000
+
+/** The pages that the checked operations cover: three leaves' worth, from before a leaf boundary, so that ranges cross them. */
+#define CHECK_PAGES (3 * RADIX_FANOUT)
+#define CHECK_FIRST (0x00007f0000000000 - 100 * PAGE_SIZE)
+
+/** The number of checked operations. */
+#define CHECK_OPS   1000
+
+/** The page counts measured when none are given. */
+static const long default_counts[] = { 1000000, 10000000, 50000000 };
+
+/** The base addresses of the regions, resembling a heap and mmap areas. */
+static const page_num_t region_base[REGIONS] = {
+  0x0000555555554000, 0x00007f0000000000, 0x00007f8000000000, 0x00007ffc00000000
+};
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Get a monotonic time in nanoseconds.
+ */
+static uint64_t now_ns () {
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+} // now_ns ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  A small xorshift generator, so that `random()` does not dominate the timings.
+ */
+static uint64_t next_random (uint64_t* state) {
+
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+
+} // next_random ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  The `i`-th page of the benchmark's key set.
+ */
+static page_num_t page_at (long i, long pages) {
+
+  long per_region = (pages + REGIONS - 1) / REGIONS;
+  return region_base[i / per_region] + (page_num_t)(i % per_region) * PAGE_SIZE;
+
+} // page_at ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Check that a page has the same entry, or none, in the radix table updated by ranges, in the one updated a page at a
+ *         time, and in the hash map, and that the page just outside of the window is in none of them.
+ * \return Whether the page is present.
+ */
+static bool verify (radix_s* ranged, radix_s* single, hashmap_s* map, page_num_t page) {
+
+  hashmap_entry_s* expected = hashmap_lookup(map, page);
+  hashmap_entry_s* entries[] = { radix_lookup(ranged, page), radix_lookup(single, page) };
+  for (int i = 0; i < 2; ++i) {
+    if (expected == NULL) {
+      assert(entries[i] == NULL);
+    } else {
+      assert(entries[i] != NULL && entries[i]->word == expected->word && ENTRY_PAGE(entries[i]) == page);
+    }
+    assert(radix_lookup((i == 0) ? ranged : single, page + MISS_OFFSET) == NULL);
+  }
+  assert(hashmap_lookup(map, page + MISS_OFFSET) == NULL);
+  return expected != NULL;
+
+} // verify ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Apply random range operations to one radix table, and the same operations a page at a time to a second one and to a
+ *         hash map, checking that they agree after each; then remove every page, each once.
+ * \param  ops The number of operations.
+ */
+static void check (long ops) {
+
+  radix_s   ranged;
+  radix_s   single;
+  hashmap_s map;
+  radix_create(&ranged);
+  radix_create(&single);
+  hashmap_create(&map);
+  uint64_t  state = 0x9e3779b97f4a7c15ULL;
+
+  for (long op = 0; op < ops; ++op) {
+    size_t     first = next_random(&state) % CHECK_PAGES;
+    size_t     pages = 1 + next_random(&state) % (CHECK_PAGES - first);
+    page_num_t start = CHECK_FIRST + first * PAGE_SIZE;
+    int        perms = (int)(next_random(&state) % 8) | ((op % 5 == 0) ? (int)ENTRY_SHARED : 0);
+    bool       flag  = next_random(&state) % 2 == 0;
+    size_t     count = 0;
+
+    switch (next_random(&state) % 3) {
+    case 0:
+      // Insert up to the first page already present.
+      while (count < pages && radix_insert(&single, ENTRY_MAKE(start + count * PAGE_SIZE, perms, flag))) {
+        assert(hashmap_insert(&map, ENTRY_MAKE(start + count * PAGE_SIZE, perms, flag)));
+        ++count;
+      }
+      assert(radix_insert_range(&ranged, start, pages, perms, flag) == count);
+      break;
+    case 1:
+      for (size_t i = 0; i < pages; ++i) {
+        hashmap_entry_s* entry = hashmap_lookup(&map, start + i * PAGE_SIZE);
+        bool             found = radix_update(&single, start + i * PAGE_SIZE, 0, flag ? ENTRY_UNPROTECTED : 0,
+                                              flag ? 0 : ENTRY_UNPROTECTED, NULL);
+        assert(found == (entry != NULL));
+        if (entry != NULL) {
+          if (flag) {
+            ENTRY_SET_FLAG(entry, ENTRY_UNPROTECTED);
+          } else {
+            ENTRY_CLEAR_FLAG(entry, ENTRY_UNPROTECTED);
+          }
+          ++count;
+        }
+      }
+      assert(radix_update_range(&ranged, start, pages, flag) == count);
+      break;
+    default:
+      for (size_t i = 0; i < pages; ++i) {
+        bool found = radix_remove(&single, start + i * PAGE_SIZE);
+        assert(hashmap_remove(&map, start + i * PAGE_SIZE) == found);
+        count += found;
+      }
+      assert(radix_remove_range(&ranged, start, pages) == count);
+      assert(radix_remove_range(&ranged, start, pages) == 0);
+      break;
+    }
+
+    size_t present = 0;
+    for (size_t i = 0; i < CHECK_PAGES; ++i) {
+      present += verify(&ranged, &single, &map, CHECK_FIRST + i * PAGE_SIZE);
+    }
+    assert(ranged.elements == present && single.elements == present && map.elements == present);
+  }
+
+  for (size_t i = 0; i < CHECK_PAGES; ++i) {
+    page_num_t page  = CHECK_FIRST + i * PAGE_SIZE;
+    bool       found = hashmap_remove(&map, page);
+    assert(radix_remove(&single, page) == found && radix_remove_range(&ranged, page, 1) == found);
+    assert(!radix_remove(&single, page) && radix_remove_range(&ranged, page, 1) == 0 && !hashmap_remove(&map, page));
+  }
+  assert(ranged.elements == 0 && single.elements == 0 && map.elements == 0);
+
+} // check ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Print one line of results.
+ */
+static void report (const char* store, long pages, double insert_ns, double hit_ns, double miss_ns, double range_ns, long sum) {
+
+  printf("%-8s%12ld pages\tinsert %7.1f ns\thit %7.1f ns\tmiss %7.1f ns\trange %7.2f ns/page\t(%ld)\n",
+         store, pages, insert_ns, hit_ns, miss_ns, range_ns, sum);
+
+} // report ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Run the benchmark for the hash map at one size.
+ */
+static void bench_hashmap (long pages) {
+
+  hashmap_s map;
+  hashmap_create(&map);
+  uint64_t  state = 0x9e3779b97f4a7c15ULL;
+  long      sum   = 0;
+
+  uint64_t start = now_ns();
+  for (long i = 0; i < pages; ++i) {
+    hashmap_entry_s entry = ENTRY_MAKE(page_at(i, pages), 3, false);
+    hashmap_insert(&map, entry);
+  }
+  double insert_ns = (double)(now_ns() - start) / pages;
+
+  start = now_ns();
+  for (long i = 0; i < LOOKUPS; ++i) {
+    sum += (hashmap_lookup(&map, page_at(next_random(&state) % pages, pages)) != NULL);
+  }
+  double hit_ns = (double)(now_ns() - start) / LOOKUPS;
+
+  start = now_ns();
+  for (long i = 0; i < LOOKUPS; ++i) {
+    sum += (hashmap_lookup(&map, page_at(next_random(&state) % pages, pages) + MISS_OFFSET) != NULL);
+  }
+  double miss_ns = (double)(now_ns() - start) / LOOKUPS;
+
+  start = now_ns();
+  for (long i = 0; i < pages; ++i) {
+    hashmap_entry_s* entry = hashmap_lookup(&map, page_at(i, pages));
+    ENTRY_CLEAR_FLAG(entry, ENTRY_UNPROTECTED);
+  }
+  double range_ns = (double)(now_ns() - start) / pages;
+
+  report("hashmap", pages, insert_ns, hit_ns, miss_ns, range_ns, sum);
+
+} // bench_hashmap ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Run the benchmark for the radix table at one size.
+ */
+static void bench_radix (long pages) {
+
+  radix_s  radix;
+  radix_create(&radix);
+  uint64_t state = 0x9e3779b97f4a7c15ULL;
+  long     sum   = 0;
+
+  uint64_t start = now_ns();
+  for (long i = 0; i < pages; ++i) {
+    hashmap_entry_s entry = ENTRY_MAKE(page_at(i, pages), 3, false);
+    radix_insert(&radix, entry);
+  }
+  double insert_ns = (double)(now_ns() - start) / pages;
+
+  start = now_ns();
+  for (long i = 0; i < LOOKUPS; ++i) {
+    sum += (radix_lookup(&radix, page_at(next_random(&state) % pages, pages)) != NULL);
+  }
+  double hit_ns = (double)(now_ns() - start) / LOOKUPS;
+
+  start = now_ns();
+  for (long i = 0; i < LOOKUPS; ++i) {
+    sum += (radix_lookup(&radix, page_at(next_random(&state) % pages, pages) + MISS_OFFSET) != NULL);
+  }
+  double miss_ns = (double)(now_ns() - start) / LOOKUPS;
+
+  start = now_ns();
+  long per_region = (pages + REGIONS - 1) / REGIONS;
+  for (int r = 0; r < REGIONS; ++r) {
+    radix_update_range(&radix, region_base[r], per_region, false);
+  }
+  double range_ns = (double)(now_ns() - start) / pages;
+
+  report("radix", pages, insert_ns, hit_ns, miss_ns, range_ns, sum);
+
+} // bench_radix ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+int main (int argc, char** argv) {
+
+  check(CHECK_OPS);
+  printf("Checked range operations on the radix table against single-page ones, and against the hash map.\n");
+
+  if (argc == 1) {
+    for (size_t i = 0; i < sizeof(default_counts) / sizeof(default_counts[0]); ++i) {
+      bench_hashmap(default_counts[i]);
+      bench_radix(default_counts[i]);
+    }
+  } else {
+    for (int i = 1; i < argc; ++i) {
+      long pages = atol(argv[i]);
+      if (pages <= 0) {
+        fprintf(stderr, "USAGE: %s [ <# pages> ... ]\n", argv[0]);
+        exit(1);
+      }
+      bench_hashmap(pages);
+      bench_radix(pages);
+    }
+  }
+
+  return 0;
+
+} // main ()
+/* =============================================================================================================================== */
@@ -0,0 +1,386 @@
+/* =============================================================================================================================== */
+/**
+ * \file radix.c
+ * \brief A direct-mapped, multi-level radix table of page entries, shaped like a software page table.
+ *
+ * A page number (a page-aligned address) is split into three 12-bit indices, one per level, exactly as the hardware splits a
+ * virtual address.  A lookup is thus three dependent loads and no hashing or probing.  Because the traced pages are dense within a
+ * few regions, the nodes that are mapped are nearly full, and operations on a range of pages walk each leaf sequentially.
+ *
+ * The table is safe for concurrent use without locks.  Nodes are never unmapped once published, and are published with a
+ * compare-and-swap (a thread that loses the race unmaps its own node and uses the winner's).  Each entry is a single word, so
+ * insertion is a compare-and-swap from zero, and updates and removals are compare-and-swap loops on the entry itself.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <stdbool.h>  // true
+#include <stddef.h>   // For size_t
+#include <stdint.h>   // For uintptr_t
+#include <stdlib.h>   // For exit()
+#include <sys/syscall.h> // For SYS_write
+#include <unistd.h>   // For syscall()
+
+#include "hashmap.h"
+#include "radix.h"
+#include "vmt_mman.h"
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS and CONSTANTS */
+
+/** The number of low-order address bits that are the offset within a page. */
+#define PAGE_SHIFT 12
+
+/** The mask that extracts one level's index from a virtual page number. */
+#define LEVEL_MASK (RADIX_FANOUT - 1)
+
+/** Extract the root, interior, and leaf indices from a virtual page number. */
+#define ROOT_INDEX(vpn)     (((vpn) >> (2 * RADIX_LEVEL_BITS)) & LEVEL_MASK)
+#define INTERIOR_INDEX(vpn) (((vpn) >> RADIX_LEVEL_BITS) & LEVEL_MASK)
+#define LEAF_INDEX(vpn)     ((vpn) & LEVEL_MASK)
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Allocate a new, zeroed node, in the private heap.
+ * \param  size The size of the node, in bytes.
+ * \return A pointer to the node.
+ */
+static void* radix_map_node (size_t size) {
+
+  void* node = vmt_calloc(1, size);
+  if (node == NULL) {
+    syscall(SYS_write, 2, "ERROR: radix_map_node(): vmt_calloc failed\n", 43);
+    exit(1);
+  }
+  return node;
+
+} // radix_map_node ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Map a new node and install it into an empty slot.  Should another thread install a node there first, the new node is
+ *         unmapped and the other thread's node is used instead.
+ * \param  slot    The slot into which to install the node.
+ * \param  size    The size of the node, in bytes.
+ * \param  counter If not `NULL`, a count to increment when this thread's node is the one installed.
+ * \return A pointer to the node that occupies the slot.
+ */
+static void* radix_publish_node (void** slot, size_t size, size_t* counter) {
+
+  void* node     = radix_map_node(size);
+  void* expected = NULL;
+  if (__atomic_compare_exchange_n(slot, &expected, node, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    if (counter != NULL) {
+      __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+    }
+    return node;
+  }
+
+  vmt_free(node);
+  return expected;
+
+} // radix_publish_node ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Find the leaf node that covers a given virtual page number.
+ * \param  radix  The radix table to search.
+ * \param  vpn    The virtual page number.
+ * \param  create Whether to map the interior and leaf nodes if they are absent.
+ * \return A pointer to the leaf's first entry; `NULL` if the leaf is absent (and not created), or if the page number lies outside
+ *         of the range that the table covers.
+ */
+static hashmap_entry_s* radix_leaf (radix_s* radix, uintptr_t vpn, bool create) {
+
+  if ((vpn >> RADIX_VPN_BITS) != 0) return NULL;
+
+  hashmap_entry_s** interior = __atomic_load_n(&radix->root[ROOT_INDEX(vpn)], __ATOMIC_ACQUIRE);
+  if (interior == NULL) {
+    if (!create) return NULL;
+    interior = radix_publish_node((void**)&radix->root[ROOT_INDEX(vpn)], RADIX_FANOUT * sizeof(hashmap_entry_s*), NULL);
+  }
+
+  hashmap_entry_s* leaf = __atomic_load_n(&interior[INTERIOR_INDEX(vpn)], __ATOMIC_ACQUIRE);
+  if (leaf == NULL) {
+    if (!create) return NULL;
+    leaf = radix_publish_node((void**)&interior[INTERIOR_INDEX(vpn)], RADIX_FANOUT * sizeof(hashmap_entry_s), &radix->leaves);
+  }
+
+  return leaf;
+
+} // radix_leaf ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Allocate and initialize a new radix table.
+ * \param radix The radix structure that serves as the entry point to the table itself.
+ */
+void radix_create (radix_s* radix) {
+
+  radix->root     = radix_map_node(RADIX_FANOUT * sizeof(hashmap_entry_s**));
+  radix->leaves   = 0;
+  radix->elements = 0;
+
+} // radix_create ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Find a given page number's entry in the radix table.
+ * \param  radix    The radix table on which to perform the lookup.
+ * \param  page_num The page number for which to search.
+ * \return A pointer to the entry if the page number is present; `NULL` otherwise.
+ */
+hashmap_entry_s* radix_lookup (radix_s* radix, page_num_t page_num) {
+
+  uintptr_t        vpn  = page_num >> PAGE_SHIFT;
+  hashmap_entry_s* leaf = radix_leaf(radix, vpn, false);
+  if (leaf == NULL) return NULL;
+
+  hashmap_entry_s* entry_ptr = &leaf[LEAF_INDEX(vpn)];
+  return ((__atomic_load_n(&entry_ptr->word, __ATOMIC_RELAXED) & ENTRY_PAGE_MASK) == page_num) ? entry_ptr : NULL;
+
+} // radix_lookup ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Insert a new page's information into the radix table.
+ * \param  radix The radix table into which to insert the new entry.
+ * \param  entry The page number and associated information to insert.
+ * \return `true` if the page was inserted; `false` if it had already been present (or lies outside of the covered range).
+ */
+bool radix_insert (radix_s* radix, hashmap_entry_s entry) {
+
+  uintptr_t        vpn  = ENTRY_PAGE(&entry) >> PAGE_SHIFT;
+  hashmap_entry_s* leaf = radix_leaf(radix, vpn, true);
+  if (leaf == NULL) return false;
+
+  page_num_t expected = 0;
+  if (!__atomic_compare_exchange_n(&leaf[LEAF_INDEX(vpn)].word, &expected, entry.word, false, __ATOMIC_RELEASE,
+                                   __ATOMIC_RELAXED)) {
+    return false;
+  }
+
+  __atomic_fetch_add(&radix->elements, 1, __ATOMIC_RELAXED);
+  return true;
+
+} // radix_insert ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Remove a page's entry from the radix table.  The leaf node itself stays mapped.
+ * \param  radix    The radix table from which to remove an entry.
+ * \param  page_num The page number whose entry to remove.
+ * \return whether the page was found and removed.
+ */
+bool radix_remove (radix_s* radix, page_num_t page_num) {
+
+  hashmap_entry_s* entry_ptr = radix_lookup(radix, page_num);
+  if (entry_ptr == NULL) return false;
+
+  page_num_t word = __atomic_load_n(&entry_ptr->word, __ATOMIC_RELAXED);
+  do {
+    if ((word & ENTRY_PAGE_MASK) != page_num) return false;
+  } while (!__atomic_compare_exchange_n(&entry_ptr->word, &word, 0, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  __atomic_fetch_sub(&radix->elements, 1, __ATOMIC_RELAXED);
+  return true;
+
+} // radix_remove ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Atomically change the permission and flag bits of a page's entry.
+ * \param  radix      The radix table to update.
+ * \param  page_num   The page number whose entry to update.
+ * \param  must_clear Bits that must be clear in the entry for the update to proceed.
+ * \param  set        Bits to set (within the low 12 bits of the entry).
+ * \param  clear      Bits to clear (within the low 12 bits of the entry).
+ * \param  result     If not `NULL`, where to copy the entry as it is after the call.
+ * \return `true` if the entry was updated; `false` if the page is absent, or if a `must_clear` bit was set.
+ */
+bool radix_update (radix_s* radix, page_num_t page_num, page_num_t must_clear, page_num_t set, page_num_t clear,
+                   hashmap_entry_s* result) {
+
+  hashmap_entry_s* entry_ptr = radix_lookup(radix, page_num);
+  if (entry_ptr == NULL) return false;
+
+  page_num_t word = __atomic_load_n(&entry_ptr->word, __ATOMIC_RELAXED);
+  page_num_t new_word;
+  do {
+    if ((word & ENTRY_PAGE_MASK) != page_num) return false;
+    if ((word & must_clear) != 0) {
+      if (result != NULL) result->word = word;
+      return false;
+    }
+    new_word = (word & ~(clear & ~ENTRY_PAGE_MASK)) | (set & ~ENTRY_PAGE_MASK);
+  } while (!__atomic_compare_exchange_n(&entry_ptr->word, &word, new_word, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  if (result != NULL) result->word = new_word;
+  return true;
+
+} // radix_update ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Insert entries for a contiguous range of pages, all with the same permissions and protection status, stopping at the
+ *         first page that is already present.  The caller thus knows exactly which pages it inserted (and so may protect), even
+ *         while other threads insert overlapping ranges.
+ * \param  radix          The radix table into which to insert.
+ * \param  first_page     The first page (page-aligned address) of the range.
+ * \param  pages          The number of pages in the range.
+ * \param  original_perms The permissions to record for each new page.
+ * \param  unprotected    The protection status to record for each new page.
+ * \return The number of pages, from the start of the range, that were newly inserted.
+ */
+size_t radix_insert_range (radix_s* radix, page_num_t first_page, size_t pages, int original_perms, bool unprotected) {
+
+  uintptr_t vpn      = first_page >> PAGE_SHIFT;
+  size_t    inserted = 0;
+  while (pages > 0) {
+
+    // Handle the part of the range that falls within this leaf.
+    hashmap_entry_s* leaf = radix_leaf(radix, vpn, true);
+    if (leaf == NULL) break;
+    size_t index = LEAF_INDEX(vpn);
+    size_t count = RADIX_FANOUT - index;
+    if (count > pages) count = pages;
+
+    for (size_t i = index; i < index + count; ++i) {
+      page_num_t expected = 0;
+      page_num_t word     = ENTRY_MAKE((vpn + (i - index)) << PAGE_SHIFT, original_perms, unprotected).word;
+      if (!__atomic_compare_exchange_n(&leaf[i].word, &expected, word, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        __atomic_fetch_add(&radix->elements, inserted, __ATOMIC_RELAXED);
+        return inserted;
+      }
+      ++inserted;
+    }
+
+    vpn   += count;
+    pages -= count;
+
+  }
+
+  __atomic_fetch_add(&radix->elements, inserted, __ATOMIC_RELAXED);
+  return inserted;
+
+} // radix_insert_range ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Set the protection status of every present page within a contiguous range.
+ * \param  radix       The radix table to update.
+ * \param  first_page  The first page (page-aligned address) of the range.
+ * \param  pages       The number of pages in the range.
+ * \param  unprotected The protection status to record.
+ * \return The number of present pages that were updated.
+ */
+size_t radix_update_range (radix_s* radix, page_num_t first_page, size_t pages, bool unprotected) {
+
+  uintptr_t vpn     = first_page >> PAGE_SHIFT;
+  size_t    updated = 0;
+  while (pages > 0) {
+
+    size_t index = LEAF_INDEX(vpn);
+    size_t count = RADIX_FANOUT - index;
+    if (count > pages) count = pages;
+
+    // Absent leaves hold no pages; skip over them entirely.
+    hashmap_entry_s* leaf = radix_leaf(radix, vpn, false);
+    if (leaf != NULL) {
+      for (size_t i = index; i < index + count; ++i) {
+        page_num_t word = __atomic_load_n(&leaf[i].word, __ATOMIC_RELAXED);
+        page_num_t new_word;
+        do {
+          if ((word & ENTRY_PAGE_MASK) == 0) break;
+          new_word = unprotected ? (word | ENTRY_UNPROTECTED) : (word & ~ENTRY_UNPROTECTED);
+        } while (!__atomic_compare_exchange_n(&leaf[i].word, &word, new_word, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+        if ((word & ENTRY_PAGE_MASK) != 0) ++updated;
+      }
+    }
+
+    vpn   += count;
+    pages -= count;
+
+  }
+
+  return updated;
+
+} // radix_update_range ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Remove the entries of every present page within a contiguous range.
+ * \param  radix      The radix table from which to remove.
+ * \param  first_page The first page (page-aligned address) of the range.
+ * \param  pages      The number of pages in the range.
+ * \return The number of pages that were removed.
+ */
+size_t radix_remove_range (radix_s* radix, page_num_t first_page, size_t pages) {
+
+  uintptr_t vpn     = first_page >> PAGE_SHIFT;
+  size_t    removed = 0;
+  while (pages > 0) {
+
+    size_t index = LEAF_INDEX(vpn);
+    size_t count = RADIX_FANOUT - index;
+    if (count > pages) count = pages;
+
+    hashmap_entry_s* leaf = radix_leaf(radix, vpn, false);
+    if (leaf != NULL) {
+      for (size_t i = index; i < index + count; ++i) {
+        if (__atomic_exchange_n(&leaf[i].word, 0, __ATOMIC_RELAXED) & ENTRY_PAGE_MASK) {
+          ++removed;
+        }
+      }
+    }
+
+    vpn   += count;
+    pages -= count;
+
+  }
+
+  __atomic_fetch_sub(&radix->elements, removed, __ATOMIC_RELAXED);
+  return removed;
+
+} // radix_remove_range ()
+/* =============================================================================================================================== */
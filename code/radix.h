@@ -0,0 +1,67 @@
+/* =============================================================================================================================== */
+/**
+ * \file radix.h
+ * \brief A direct-mapped, multi-level radix table of page entries, shaped like a software page table.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#if !defined (_RADIX_H)
+#define _RADIX_H
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS */
+
+/** The number of page number bits consumed by each level of the table. */
+#define RADIX_LEVEL_BITS 12
+
+/** The number of slots in each node of the table. */
+#define RADIX_FANOUT     (1 << RADIX_LEVEL_BITS)
+
+/** The number of virtual page number bits covered by the three levels (48-bit addresses with 4 KB pages). */
+#define RADIX_VPN_BITS   (3 * RADIX_LEVEL_BITS)
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* TYPES */
+
+/**
+ * The structure for an entire radix table.  The root node is allocated with the table; interior and leaf nodes are mapped lazily,
+ * the first time that a page within their range is inserted.  Entries use the same type, and the same convention (a zero
+ * page number marks an absent entry), as the hash map.  Every operation may run concurrently with any other.
+ */
+typedef struct radix_struct {
+  hashmap_entry_s*** root;
+  size_t             leaves;
+  size_t             elements;
+} radix_s;
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* FUNCTIONS */
+
+void             radix_create       (radix_s* radix);
+hashmap_entry_s* radix_lookup       (radix_s* radix, page_num_t page_num);
+bool             radix_insert       (radix_s* radix, hashmap_entry_s entry);
+bool             radix_remove       (radix_s* radix, page_num_t page_num);
+bool             radix_update       (radix_s* radix, page_num_t page_num, page_num_t must_clear, page_num_t set, page_num_t clear,
+                                     hashmap_entry_s* result);
+size_t           radix_insert_range (radix_s* radix, page_num_t first_page, size_t pages, int original_perms, bool unprotected);
+size_t           radix_update_range (radix_s* radix, page_num_t first_page, size_t pages, bool unprotected);
+size_t           radix_remove_range (radix_s* radix, page_num_t first_page, size_t pages);
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#endif /* _RADIX_H */
+/* =============================================================================================================================== */
@@ -0,0 +1,175 @@
+/* =============================================================================================================================== */
+/**
+ * \file samefill-test.c
+ * \brief A test of the same-filled page kernels.  Each kernel the CPU has is checked on zero pages, pages of a random word, and
+ *        such pages with one byte changed anywhere; then the speed of each is reported, in GB/s, over same-filled pages (which
+ *        it reads whole) and over pages that differ in their last byte, both from memory and from one page in the cache.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "samefill.h"
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS and CONSTANTS */
+
+/** The size of a page. */
+#define PAGE_SIZE 4096
+
+/** The number of pages that the speed is measured over: 64 MB, more than the caches hold. */
+#define PAGES 16384
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* TYPES */
+
+/** A kernel, with its name. */
+typedef struct kernel_struct {
+  const char* name;
+  bool        (*check) (const void* buffer, size_t size, uint64_t* word);
+} kernel_s;
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Get a monotonic time in nanoseconds.
+ */
+static uint64_t now_ns () {
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+
+} // now_ns ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Fill a page with a word.
+ */
+static void fill (uint64_t* page, uint64_t word) {
+
+  for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+    page[i] = word;
+  }
+
+} // fill ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Check a kernel on zero pages, pages of random words, and both with each byte changed in turn.
+ */
+static void check (kernel_s* kernel, uint64_t* page) {
+
+  for (int trial = 0; trial < 64; trial++) {
+    uint64_t fill_word = (trial == 0) ? 0 : ((uint64_t) random() << 32) ^ (uint64_t) random();
+    uint64_t word      = ~fill_word;
+    fill(page, fill_word);
+    assert(kernel->check(page, PAGE_SIZE, &word) && word == fill_word);
+
+    for (size_t byte = 0; byte < PAGE_SIZE; byte++) {
+      uint8_t* bytes = (uint8_t*) page;
+      bytes[byte] ^= (uint8_t) (1 + random() % 255);
+      assert(!kernel->check(page, PAGE_SIZE, &word));
+      fill(page, fill_word);
+    }
+  }
+
+} // check ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Report the speed of a kernel over `PAGES` pages, in GB/s.
+ * \param  pages    The pages.
+ * \param  distinct Whether the pages are distinct, or all the first one, which stays in the cache.
+ * \param  expect   What the kernel should find of each page.
+ */
+static double measure (kernel_s* kernel, uint64_t* pages, bool distinct, bool expect) {
+
+  uint64_t best = UINT64_MAX;
+  for (int round = 0; round < 5; round++) {
+    uint64_t start = now_ns();
+    for (size_t p = 0; p < PAGES; p++) {
+      uint64_t word;
+      uint64_t* page = pages + (distinct ? p : 0) * (PAGE_SIZE / sizeof(uint64_t));
+      assert(kernel->check(page, PAGE_SIZE, &word) == expect);
+    }
+    uint64_t elapsed = now_ns() - start;
+    best = (elapsed < best) ? elapsed : best;
+  }
+  return (double) PAGES * PAGE_SIZE / best;
+
+} // measure ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+int main (void) {
+
+  kernel_s kernels[3];
+  int      count = 0;
+  kernels[count++] = (kernel_s) { "scalar", samefill_scalar };
+#if defined (__x86_64__)
+  kernels[count++] = (kernel_s) { "sse2", samefill_sse2 };
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernels[count++] = (kernel_s) { "avx2", samefill_avx2 };
+  }
+#endif
+
+  uint64_t* page  = aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+  uint64_t* pages = aligned_alloc(PAGE_SIZE, (size_t) PAGES * PAGE_SIZE);
+  assert(page != NULL && pages != NULL);
+
+  srandom(1);
+  for (int k = 0; k < count; k++) {
+    check(&kernels[k], page);
+  }
+  printf("Checked %d kernels; samefill_check () uses %s.\n", count, samefill_kernel());
+
+  for (int k = 0; k < count; k++) {
+    for (int distinct = 1; distinct >= 0; distinct--) {
+      memset(pages, 0, (size_t) PAGES * PAGE_SIZE);
+      printf("%-6s %-9s zero pages %6.2f GB/s, ", kernels[k].name, distinct ? "memory:" : "cache:",
+             measure(&kernels[k], pages, distinct, true));
+      for (size_t p = 0; p < PAGES; p++) {
+        ((uint8_t*) pages)[(p + 1) * PAGE_SIZE - 1] = 1;
+      }
+      printf("pages that differ at the end %6.2f GB/s\n", measure(&kernels[k], pages, distinct, false));
+    }
+  }
+
+  free(pages);
+  free(page);
+  return 0;
+
+} // main ()
+/* =============================================================================================================================== */
@@ -0,0 +1,189 @@
+/* =============================================================================================================================== */
+/**
+ * \file samefill.c
+ * \brief Find pages that hold one 8-byte word over and over (most often zero), which need not be compressed to be stored.
+ *
+ * Each kernel compares the buffer against its first word, `SAMEFILL_BLOCK` bytes at a time, and stops at the first block that
+ * differs, so that a page of ordinary data costs a block or two, and a same-filled page one pass at the speed of the cache.
+ * The AVX2 kernel is compiled for that target alone and chosen at the first call, if the CPU has it; SSE2 is always there on
+ * x86-64.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <stdint.h>      // For uint64_t
+
+#if defined (__x86_64__)
+#include <immintrin.h>   // For the SSE2 and AVX2 intrinsics
+#endif
+
+#include "samefill.h"
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS and CONSTANTS */
+
+/** The number of words in a block. */
+#define BLOCK_WORDS (SAMEFILL_BLOCK / sizeof(uint64_t))
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* TYPES */
+
+/** A kernel. */
+typedef bool (*samefill_kernel_t) (const void* buffer, size_t size, uint64_t* word);
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* GLOBALS */
+
+/** The kernel that samefill_check () uses, once chosen, and its name. */
+static samefill_kernel_t kernel      = NULL;
+static const char*       kernel_name = NULL;
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+bool samefill_scalar (const void* buffer, size_t size, uint64_t* word) {
+
+  const uint64_t* words = buffer;
+  uint64_t        first = words[0];
+
+  for (size_t i = 0; i < size / sizeof(uint64_t); i = i + BLOCK_WORDS) {
+    uint64_t differ = 0;
+    for (size_t j = 0; j < BLOCK_WORDS; j++) {
+      differ = differ | (words[i + j] ^ first);
+    }
+    if (differ != 0) {
+      return false;
+    }
+  }
+
+  *word = first;
+  return true;
+
+} // samefill_scalar ()
+/* =============================================================================================================================== */
+
+
+
+#if defined (__x86_64__)
+/* =============================================================================================================================== */
+bool samefill_sse2 (const void* buffer, size_t size, uint64_t* word) {
+
+  const __m128i* vectors = buffer;
+  uint64_t       first   = *(const uint64_t*) buffer;
+  __m128i        fill    = _mm_set1_epi64x((long long) first);
+
+  for (size_t i = 0; i < size / sizeof(__m128i); i = i + SAMEFILL_BLOCK / sizeof(__m128i)) {
+    __m128i differ = _mm_or_si128(_mm_or_si128(_mm_xor_si128(_mm_loadu_si128(vectors + i),     fill),
+                                               _mm_xor_si128(_mm_loadu_si128(vectors + i + 1), fill)),
+                                  _mm_or_si128(_mm_xor_si128(_mm_loadu_si128(vectors + i + 2), fill),
+                                               _mm_xor_si128(_mm_loadu_si128(vectors + i + 3), fill)));
+    differ = _mm_or_si128(differ,
+                          _mm_or_si128(_mm_or_si128(_mm_xor_si128(_mm_loadu_si128(vectors + i + 4), fill),
+                                                    _mm_xor_si128(_mm_loadu_si128(vectors + i + 5), fill)),
+                                       _mm_or_si128(_mm_xor_si128(_mm_loadu_si128(vectors + i + 6), fill),
+                                                    _mm_xor_si128(_mm_loadu_si128(vectors + i + 7), fill))));
+    //All bytes are zero only if every word matched
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(differ, _mm_setzero_si128())) != 0xffff) {
+      return false;
+    }
+  }
+
+  *word = first;
+  return true;
+
+} // samefill_sse2 ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+__attribute__((target("avx2")))
+bool samefill_avx2 (const void* buffer, size_t size, uint64_t* word) {
+
+  const __m256i* vectors = buffer;
+  uint64_t       first   = *(const uint64_t*) buffer;
+  __m256i        fill    = _mm256_set1_epi64x((long long) first);
+
+  for (size_t i = 0; i < size / sizeof(__m256i); i = i + SAMEFILL_BLOCK / sizeof(__m256i)) {
+    __m256i differ = _mm256_or_si256(_mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(vectors + i),     fill),
+                                                     _mm256_xor_si256(_mm256_loadu_si256(vectors + i + 1), fill)),
+                                     _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(vectors + i + 2), fill),
+                                                     _mm256_xor_si256(_mm256_loadu_si256(vectors + i + 3), fill)));
+    if (_mm256_testz_si256(differ, differ) == 0) {
+      return false;
+    }
+  }
+
+  *word = first;
+  return true;
+
+} // samefill_avx2 ()
+/* =============================================================================================================================== */
+#endif
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Choose the kernel for this CPU.  Two threads that choose at once choose the same.
+ */
+static void choose_kernel (void) {
+
+#if defined (__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernel_name = "avx2";
+    __atomic_store_n(&kernel, samefill_avx2, __ATOMIC_RELEASE);
+  } else {
+    kernel_name = "sse2";
+    __atomic_store_n(&kernel, samefill_sse2, __ATOMIC_RELEASE);
+  }
+#else
+  kernel_name = "scalar";
+  __atomic_store_n(&kernel, samefill_scalar, __ATOMIC_RELEASE);
+#endif
+
+} // choose_kernel ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+bool samefill_check (const void* buffer, size_t size, uint64_t* word) {
+
+  samefill_kernel_t chosen = __atomic_load_n(&kernel, __ATOMIC_ACQUIRE);
+  if (chosen == NULL) {
+    choose_kernel();
+    chosen = kernel;
+  }
+  return chosen(buffer, size, word);
+
+} // samefill_check ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+const char* samefill_kernel (void) {
+
+  if (__atomic_load_n(&kernel, __ATOMIC_ACQUIRE) == NULL) {
+    choose_kernel();
+  }
+  return kernel_name;
+
+} // samefill_kernel ()
+/* =============================================================================================================================== */
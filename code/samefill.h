@@ -0,0 +1,69 @@
+/* =============================================================================================================================== */
+/**
+ * \file samefill.h
+ * \brief Find pages that hold one 8-byte word over and over (most often zero), which need not be compressed to be stored.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#if !defined (_SAMEFILL_H)
+#define _SAMEFILL_H
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS */
+
+/** The multiple of which a buffer's size must be; a page always is. */
+#define SAMEFILL_BLOCK 128
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* FUNCTIONS */
+
+/**
+ * \brief  Check whether a buffer holds one word over and over, with the fastest kernel that the CPU has: AVX2 or SSE2 on x86-64,
+ *         and plain words elsewhere.  Safe to call from a signal handler.
+ * \param  buffer The buffer; 8-byte aligned.
+ * \param  size   Its size; a multiple of `SAMEFILL_BLOCK`.
+ * \param  word   Receives the word, if the buffer is filled with it.
+ * \return Whether the buffer is filled with one word.
+ */
+bool samefill_check (const void* buffer, size_t size, uint64_t* word);
+
+/**
+ * \brief  Name the kernel that samefill_check () uses.
+ * \return "avx2", "sse2" or "scalar".
+ */
+const char* samefill_kernel (void);
+
+/**
+ * \brief  The kernels themselves, as samefill_check (), for testing and measuring them; only those that the CPU has may be called.
+ */
+bool samefill_scalar (const void* buffer, size_t size, uint64_t* word);
+#if defined (__x86_64__)
+bool samefill_sse2   (const void* buffer, size_t size, uint64_t* word);
+bool samefill_avx2   (const void* buffer, size_t size, uint64_t* word);
+#endif
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#endif /* _SAMEFILL_H */
+/* =============================================================================================================================== */
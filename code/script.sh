@@ -4,9 +4,11 @@ printf "Beginning script\n"
 
 gcc -ggdb little_loop.c -o little_loop
 #gcc -ggdb manager.c compressed-caching.c hashmap.c -o manager.so -fPIC -shared -ldl
-gcc -ggdb safeio.c manager.c hashmap.c -o manager.so -fPIC -shared -ldl
-gcc -ggdb safeio.c catcher.c -o catcher
+gcc -ggdb safeio.c manager.c hashmap.c shardmap.c radix.c tracebuf.c syscall_filter.c comp_cache.c lz.c zpool.c samefill.c capture.c vmt_mman.c -o manager.so -fPIC -shared -ldl -lpthread
+gcc -ggdb safeio.c catcher.c syscall_filter.c -o catcher -ldl
+gcc -ggdb vmtrace-top.c -o vmtrace-top
 #gcc -ggdb thread_test.c -o thread_test -lpthread
+#gcc -ggdb attach_test.c -o attach_test
 export VMT_TRACENAME="foo.csv"
 export VMT_SIZE="1024"
 
@@ -0,0 +1,318 @@
+/* =============================================================================================================================== */
+/**
+ * \file shardmap.c
+ * \brief A concurrent page map made of independently locked shards of the hash map.
+ *
+ * Each page number belongs to one shard, chosen by its hash, and each shard is an ordinary hash map.  Writers (insertions,
+ * removals, and updates of an entry's flags) take the shard's spin lock, so that threads faulting on pages of different shards
+ * never contend.  Readers take no lock at all: a lookup reads the shard's sequence counter, searches the map, copies the entry,
+ * and retries if the counter shows that a writer changed the shard's structure in the meantime.  The shards' maps retain the
+ * tables that they outgrow, so that a reader that is racing with growth never touches unmapped memory.  Since each table is half
+ * the size of the next, what they retain is less than the current tables take; it is released only where no other thread can
+ * be reading, in the child of a fork (), and is otherwise held until the process exits.
+ *
+ * The locks are plain spin locks.  A writer must have every signal blocked for as long as it holds one, so that the SIGSEGV
+ * handler can never interrupt the thread that holds the lock that it is about to take; the manager blocks them once for each of
+ * its critical sections, around the page locks under which it makes every change, and the handler runs with them blocked.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <sched.h>    // For sched_yield()
+#include <stdbool.h>  // true
+#include <stddef.h>   // For size_t
+#include <stdint.h>   // For uint64_t
+
+#include "hashmap.h"
+#include "shardmap.h"
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS and CONSTANTS */
+
+/** The multiplier (2^64 divided by the golden ratio) that spreads page numbers across the shards. */
+#define SHARD_MULTIPLIER 0x9e3779b97f4a7c15ULL
+
+/** The number of times to spin before yielding the processor to the (possibly preempted) lock holder. */
+#define SPINS_BEFORE_YIELD 64
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Find the shard to which a page number belongs.
+ * \param  map      The sharded map.
+ * \param  page_num The page number.
+ * \return A pointer to the shard.
+ */
+static inline shardmap_shard_s* shardmap_shard (shardmap_s* map, page_num_t page_num) {
+
+  uint64_t hash = (uint64_t)(page_num >> 12) * SHARD_MULTIPLIER;
+  return &map->shards[hash >> (64 - SHARDMAP_SHARD_BITS)];
+
+} // shardmap_shard ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Wait briefly for another thread: spin for a while, and then, since the thread being waited on may have been preempted
+ *        (or there may be more threads than processors), yield.
+ * \param spins The number of times the caller has waited so far; incremented.
+ */
+static inline void shardmap_backoff (unsigned int* spins) {
+
+  if (++*spins < SPINS_BEFORE_YIELD) {
+    __builtin_ia32_pause();
+  } else {
+    sched_yield();
+  }
+
+} // shardmap_backoff ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Acquire a spin lock.  The caller has every signal blocked.
+ * \param lock The lock to acquire.
+ */
+void shardmap_lock (shardmap_lock_t* lock) {
+
+  // Test-and-test-and-set: spin on plain reads, so that waiting threads do not keep stealing the lock's cache line.
+  unsigned int spins = 0;
+  while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE) != 0) {
+    while (__atomic_load_n(lock, __ATOMIC_RELAXED) != 0) {
+      shardmap_backoff(&spins);
+    }
+  }
+
+} // shardmap_lock ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Release a spin lock.
+ * \param lock The lock to release.
+ */
+void shardmap_unlock (shardmap_lock_t* lock) {
+
+  __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+
+} // shardmap_unlock ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Begin a change to a shard's structure: take its lock, and make its sequence counter odd.
+ */
+static inline void shard_write_begin (shardmap_shard_s* shard) {
+
+  shardmap_lock(&shard->lock);
+  __atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+} // shard_write_begin ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief End a change to a shard's structure: make its sequence counter even again, and release its lock.
+ */
+static inline void shard_write_end (shardmap_shard_s* shard) {
+
+  __atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELEASE);
+  shardmap_unlock(&shard->lock);
+
+} // shard_write_end ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Allocate and initialize a new sharded map.
+ * \param map The sharded map to initialize.
+ */
+void shardmap_create (shardmap_s* map) {
+
+  for (int i = 0; i < SHARDMAP_SHARDS; ++i) {
+    hashmap_create(&map->shards[i].map);
+    map->shards[i].map.retain_tables = true;
+    map->shards[i].lock              = 0;
+    map->shards[i].seq               = 0;
+  }
+
+} // shardmap_create ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Find a page number's entry, without taking any lock.
+ * \param  map      The sharded map to search.
+ * \param  page_num The page number for which to search.
+ * \param  entry    Where to copy the entry, if it is found.
+ * \return `true` if the page number was found; `false` otherwise.
+ */
+bool shardmap_lookup (shardmap_s* map, page_num_t page_num, hashmap_entry_s* entry) {
+
+  shardmap_shard_s* shard = shardmap_shard(map, page_num);
+  unsigned int      spins = 0;
+  while (true) {
+
+    // Wait out any writer that is changing the shard's structure.
+    uint64_t seq = __atomic_load_n(&shard->seq, __ATOMIC_ACQUIRE);
+    if ((seq & 1) != 0) {
+      shardmap_backoff(&spins);
+      continue;
+    }
+
+    hashmap_entry_s* entry_ptr = hashmap_lookup(&shard->map, page_num);
+    bool             found     = (entry_ptr != NULL);
+    if (found) {
+      entry->word = __atomic_load_n(&entry_ptr->word, __ATOMIC_RELAXED);
+    }
+
+    // If no writer changed the structure meanwhile, then the result is consistent.
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&shard->seq, __ATOMIC_RELAXED) == seq) {
+      return found;
+    }
+
+  }
+
+} // shardmap_lookup ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Insert a new page's information.
+ * \param  map   The sharded map into which to insert.
+ * \param  entry The page number and associated information to insert.
+ * \return `true` if the page was inserted; `false` if it had already been present.
+ */
+bool shardmap_insert (shardmap_s* map, hashmap_entry_s entry) {
+
+  shardmap_shard_s* shard = shardmap_shard(map, ENTRY_PAGE(&entry));
+  shard_write_begin(shard);
+  bool inserted = hashmap_insert(&shard->map, entry);
+  shard_write_end(shard);
+  return inserted;
+
+} // shardmap_insert ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Remove a page's entry.
+ * \param  map      The sharded map from which to remove.
+ * \param  page_num The page number whose entry to remove.
+ * \return whether the page was found and removed.
+ */
+bool shardmap_remove (shardmap_s* map, page_num_t page_num) {
+
+  shardmap_shard_s* shard = shardmap_shard(map, page_num);
+  shard_write_begin(shard);
+  bool removed = hashmap_remove(&shard->map, page_num);
+  shard_write_end(shard);
+  return removed;
+
+} // shardmap_remove ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Atomically change the permission and flag bits of a page's entry.  The entry stays where it is, so the shard's sequence
+ *         counter is left alone, and concurrent readers see either the old word or the new one.
+ * \param  map        The sharded map to update.
+ * \param  page_num   The page number whose entry to update.
+ * \param  must_clear Bits that must be clear in the entry for the update to proceed.
+ * \param  set        Bits to set (within the low 12 bits of the entry).
+ * \param  clear      Bits to clear (within the low 12 bits of the entry).
+ * \param  result     If not `NULL`, where to copy the entry as it is after the call.
+ * \return `true` if the entry was updated; `false` if the page is absent, or if a `must_clear` bit was set.
+ */
+bool shardmap_update (shardmap_s* map, page_num_t page_num, page_num_t must_clear, page_num_t set, page_num_t clear,
+                      hashmap_entry_s* result) {
+
+  shardmap_shard_s* shard = shardmap_shard(map, page_num);
+  shardmap_lock(&shard->lock);
+
+  bool             updated   = false;
+  hashmap_entry_s* entry_ptr = hashmap_lookup(&shard->map, page_num);
+  if (entry_ptr != NULL) {
+    page_num_t word = entry_ptr->word;
+    if ((word & must_clear) == 0) {
+      word    = (word & ~(clear & ~ENTRY_PAGE_MASK)) | (set & ~ENTRY_PAGE_MASK);
+      __atomic_store_n(&entry_ptr->word, word, __ATOMIC_RELAXED);
+      updated = true;
+    }
+    if (result != NULL) {
+      result->word = word;
+    }
+  }
+
+  shardmap_unlock(&shard->lock);
+  return updated;
+
+} // shardmap_update ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Count the entries in all of the shards.  The count is exact only when no writer is active.
+ * \param  map The sharded map.
+ * \return The number of entries.
+ */
+size_t shardmap_elements (shardmap_s* map) {
+
+  size_t elements = 0;
+  for (int i = 0; i < SHARDMAP_SHARDS; ++i) {
+    elements += __atomic_load_n(&map->shards[i].map.elements, __ATOMIC_RELAXED);
+  }
+  return elements;
+
+} // shardmap_elements ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Release the tables that the shards' maps have retained.  Only safe once no other thread can be reading the map, as in
+ *        the child of a fork ().
+ * \param map The sharded map.
+ */
+void shardmap_release_retired (shardmap_s* map) {
+
+  for (int i = 0; i < SHARDMAP_SHARDS; ++i) {
+    hashmap_release_retired(&map->shards[i].map);
+  }
+
+} // shardmap_release_retired ()
+/* =============================================================================================================================== */
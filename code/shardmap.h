@@ -0,0 +1,70 @@
+/* =============================================================================================================================== */
+/**
+ * \file shardmap.h
+ * \brief A concurrent page map made of independently locked shards of the hash map.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#if !defined (_SHARDMAP_H)
+#define _SHARDMAP_H
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS */
+
+/** The number of bits of a page's hash that select its shard, and thus the number of shards. */
+#define SHARDMAP_SHARD_BITS 6
+#define SHARDMAP_SHARDS     (1 << SHARDMAP_SHARD_BITS)
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* TYPES */
+
+/** A spin lock.  Zero when free. */
+typedef volatile uint32_t shardmap_lock_t;
+
+/**
+ * One shard: a hash map guarded by a lock for writers, and by a sequence counter that lets readers proceed without the lock.  The
+ * counter is odd while a writer is changing the shard's structure (inserting, removing, or moving entries between tables).
+ */
+typedef struct shardmap_shard_struct {
+  hashmap_s         map;
+  shardmap_lock_t   lock;
+  volatile uint64_t seq;
+} __attribute__((aligned(64))) shardmap_shard_s;
+
+/** The structure for an entire sharded map. */
+typedef struct shardmap_struct {
+  shardmap_shard_s shards[SHARDMAP_SHARDS];
+} shardmap_s;
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* FUNCTIONS */
+
+void   shardmap_create   (shardmap_s* map);
+bool   shardmap_lookup   (shardmap_s* map, page_num_t page_num, hashmap_entry_s* entry);
+bool   shardmap_insert   (shardmap_s* map, hashmap_entry_s entry);
+bool   shardmap_remove   (shardmap_s* map, page_num_t page_num);
+bool   shardmap_update   (shardmap_s* map, page_num_t page_num, page_num_t must_clear, page_num_t set, page_num_t clear,
+                          hashmap_entry_s* result);
+size_t shardmap_elements (shardmap_s* map);
+void   shardmap_release_retired (shardmap_s* map);
+void   shardmap_lock     (shardmap_lock_t* lock);
+void   shardmap_unlock   (shardmap_lock_t* lock);
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#endif /* _SHARDMAP_H */
+/* =============================================================================================================================== */
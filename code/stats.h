@@ -0,0 +1,109 @@
+// =============================================================================
+/*******************************************************************************
+ * Live Statistics Page
+ *
+ * With `VMT_STATS` set, the manager keeps its counters in a small shared
+ * memory object, `/vmtrace-stats.<pid>` (under /dev/shm), that `vmtrace-top`
+ * maps read-only to show live rates while the program runs. Each thread claims
+ * a row of its own and bumps its counters there with plain increments, so that
+ * counting costs the tracee no atomic operations and no shared cache lines; the
+ * viewer sums the rows. A thread that exits adds its row into `retired` and
+ * gives the row up. Rows are read as they stand: a sum may be off by what a
+ * thread adds while it is read, or count an exiting thread's row twice for a
+ * moment. Once every row is taken, further threads count in `retired`, less
+ * exactly.
+ *
+ * `tracked` and `window` are gauges kept as counters: each thread adds the
+ * pages it puts into the metadata store (the hash map or radix table) or the
+ * window of unprotected pages, less those it takes out, so that their sums are
+ * the store's load and the window's occupancy.
+ *
+ * Each program that the process executes starts the page afresh. The child of
+ * a fork () gets a page of its own, which starts with its parent's counts.
+ * The page is removed when the process exits, after `finished` is set.
+ ******************************************************************************/
+// =============================================================================
+
+
+
+// =============================================================================
+#if !defined (_STATS_H)
+#define _STATS_H
+// =============================================================================
+
+
+
+// =============================================================================
+// INCLUDES
+
+#include <stdint.h>
+// =============================================================================
+
+
+
+// =============================================================================
+// MACROS
+
+// Environment variable that has the manager export its statistics.
+#define STATS_ENV "VMT_STATS"
+
+// Name of a process's statistics page, given its process ID.
+#define STATS_NAME_FORMAT "/vmtrace-stats.%d"
+
+// Size of the page.
+#define STATS_SIZE 16384
+
+// Number of threads that can have a row at once.
+#define STATS_ROWS 128
+// =============================================================================
+
+
+
+// =============================================================================
+// TYPES
+
+// The counters of one thread.
+struct stats_row {
+
+	// The thread that has the row; 0 if it is free.
+	volatile uint32_t tid;
+	// Faults taken by the SIGSEGV handler.
+	volatile uint64_t faults;
+	// Pages protected as they left the window.
+	volatile uint64_t evictions;
+	// Calls of mprotect () (or pkey_mprotect ()) by the manager.
+	volatile uint64_t mprotects;
+	// System calls walked, at the catcher's request or trapped by seccomp.
+	volatile uint64_t walks;
+	// Pages added to the metadata store, less those removed.
+	volatile int64_t tracked;
+	// Pages added to the window, less those taken out.
+	volatile int64_t window;
+
+} __attribute__((aligned(64)));
+
+// The shared memory.
+struct stats_page {
+
+	// The process.
+	uint32_t pid;
+	// Set once the process has finished tracing, just before the page is
+	// removed.
+	volatile uint32_t finished;
+	// Pages that the window holds.
+	uint64_t window_size;
+	// Bytes written to the trace file.
+	volatile uint64_t trace_bytes;
+	struct stats_row retired;
+	struct stats_row rows[STATS_ROWS];
+
+};
+
+_Static_assert(sizeof(struct stats_page) <= STATS_SIZE, "the statistics page does not fit in STATS_SIZE");
+// =============================================================================
+
+
+
+// =============================================================================
+#endif /* _STATS_H */
+// =============================================================================
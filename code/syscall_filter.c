@@ -0,0 +1,156 @@
+// =============================================================================
+/*******************************************************************************
+ * System Call Filter
+ *
+ * The filter checks the architecture, then the instruction pointer (if the
+ * caller allows system calls from one address, such as a trampoline that
+ * re-issues trapped calls), then the one system call chosen by the value of an
+ * argument (if any), and then finds the system call number with a binary
+ * search over runs of numbers that are all chosen or all not chosen. A lookup
+ * takes a logarithmic number of tests rather than one per system call.
+ ******************************************************************************/
+// =============================================================================
+
+
+
+// =============================================================================
+// INCLUDES
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include "syscall_table.h"
+#include "syscall_filter.h"
+// =============================================================================
+
+
+
+// =============================================================================
+// MACROS
+
+// Most instructions in a filter: a test and a return per run of system calls,
+// plus the architecture and instruction pointer checks.
+#define MAX_FILTER (2 * SYSCALL_TABLE_SIZE + 16)
+
+// Largest forward jump in a BPF conditional jump.
+#define MAX_JUMP 255
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Emits the part of the filter that classifies system call numbers, given the
+ * sorted starts of the runs of numbers that are all chosen or all not chosen.
+ * Every test is a jump forward over the lower half of the runs.
+ *
+ * @return The number of instructions emitted, or `-1` if a jump is too long.
+ */
+static int emit_search (struct sock_filter* filter, const int* runs, int first, int last,
+                        int (*chosen) (int nr), unsigned int action) {
+
+	if (first == last) {
+		int is_chosen = (runs[first] < SYSCALL_TABLE_SIZE && chosen(runs[first]));
+		filter[0] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, is_chosen ? action : SECCOMP_RET_ALLOW);
+		return 1;
+	}
+
+	int middle = (first + last + 1) / 2;
+	int lower = emit_search(filter + 1, runs, first, middle - 1, chosen, action);
+	if (lower == -1 || lower > MAX_JUMP) {
+		return -1;
+	}
+	int upper = emit_search(filter + 1 + lower, runs, middle, last, chosen, action);
+	if (upper == -1) {
+		return -1;
+	}
+
+	filter[0] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, runs[middle], lower, 0);
+	return 1 + lower + upper;
+
+} // emit_search ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Installs, in the calling thread, a seccomp filter that returns `action` for
+ * every x86-64 system call for which `chosen` is true, and lets all others run.
+ * The filter is inherited by threads and processes created afterward, and
+ * across `execve`. System calls past the table are never chosen.
+ *
+ * @param allowed_ip If not `0`, system calls made from this address (the one
+ *                   after the `syscall` instruction) always run.
+ * @param also       If not `NULL`, a system call that is also given `action`,
+ *                   but only when its argument has the given value.
+ * @return `0` on success; `-1`, with `errno` set, if the filter could not be
+ *         installed.
+ */
+int syscall_filter_install (int (*chosen) (int nr), unsigned int action, uintptr_t allowed_ip,
+                            const struct syscall_filter_arg* also) {
+
+	struct sock_filter filter[MAX_FILTER];
+	int length = 0;
+
+	// Only x86-64 system calls are described by the table; other architectures
+	// are let through.
+	filter[length++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch));
+	filter[length++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 1, 0);
+	filter[length++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+
+	// The instruction pointer is 64 bits wide, and is compared a half at a time.
+	if (allowed_ip != 0) {
+		filter[length++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, instruction_pointer));
+		filter[length++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t) allowed_ip, 0, 3);
+		filter[length++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, instruction_pointer) + 4);
+		filter[length++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t) (allowed_ip >> 32), 0, 1);
+		filter[length++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+	}
+
+	// x32 system calls are let through as well.
+	filter[length++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr));
+	filter[length++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, __X32_SYSCALL_BIT, 0, 1);
+	filter[length++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+
+	if (also != NULL) {
+		filter[length++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, also->nr, 0, 4);
+		filter[length++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, args[also->arg]));
+		filter[length++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, also->value, 0, 1);
+		filter[length++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, action);
+		filter[length++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+	}
+
+	// Split the numbers into runs that are all chosen or all not chosen; the
+	// last run covers every number past the table.
+	int runs[SYSCALL_TABLE_SIZE + 1];
+	int num_runs = 0;
+	for (int nr = 0; nr <= SYSCALL_TABLE_SIZE; nr++) {
+		int is_chosen = (nr < SYSCALL_TABLE_SIZE && chosen(nr));
+		int was_chosen = (nr > 0 && chosen(nr - 1));
+		if (nr == 0 || is_chosen != was_chosen) {
+			runs[num_runs++] = nr;
+		}
+	}
+	int search = emit_search(filter + length, runs, 0, num_runs - 1, chosen, action);
+	if (search == -1) {
+		errno = E2BIG;
+		return -1;
+	}
+	length += search;
+
+	struct sock_fprog program = { .len = (unsigned short) length, .filter = filter };
+	if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == -1) {
+		return -1;
+	}
+	return (int) syscall(__NR_seccomp, SECCOMP_SET_MODE_FILTER, 0, &program);
+
+} // syscall_filter_install ()
+// =============================================================================
@@ -0,0 +1,55 @@
+// =============================================================================
+/*******************************************************************************
+ * System Call Filter
+ *
+ * Builds and installs a seccomp filter that gives one action to the system
+ * calls chosen by the caller, and lets every other system call run.
+ ******************************************************************************/
+// =============================================================================
+
+
+
+// =============================================================================
+#if !defined (_SYSCALL_FILTER_H)
+#define _SYSCALL_FILTER_H
+// =============================================================================
+
+
+
+// =============================================================================
+// INCLUDES
+
+#include <stdint.h>
+#include <linux/seccomp.h>
+// =============================================================================
+
+
+
+// =============================================================================
+// TYPES
+
+// A system call chosen only when one of its arguments has a given value (the
+// low 32 bits of the argument are compared).
+struct syscall_filter_arg {
+
+	int nr;
+	int arg;
+	uint32_t value;
+
+};
+// =============================================================================
+
+
+
+// =============================================================================
+// FUNCTIONS
+
+int syscall_filter_install (int (*chosen) (int nr), unsigned int action, uintptr_t allowed_ip,
+                            const struct syscall_filter_arg* also);
+// =============================================================================
+
+
+
+// =============================================================================
+#endif /* _SYSCALL_FILTER_H */
+// =============================================================================
@@ -0,0 +1,72 @@
+// =============================================================================
+/*******************************************************************************
+ * System Call Event Log
+ *
+ * Layout of the binary log that the catcher writes when `VMT_SYSCALL_LOG`
+ * names a file: a plain array of records in the order of the events, with no
+ * header. Times are CLOCK_MONOTONIC, in nanoseconds, as in the manager's
+ * trace, so that the two can be lined up.
+ ******************************************************************************/
+// =============================================================================
+
+
+
+// =============================================================================
+#if !defined (_SYSCALL_LOG_H)
+#define _SYSCALL_LOG_H
+// =============================================================================
+
+
+
+// =============================================================================
+// INCLUDES
+
+#include <stdint.h>
+// =============================================================================
+
+
+
+// =============================================================================
+// MACROS
+
+// Environment variable naming the log file.
+#define SYSCALL_LOG_ENV "VMT_SYSCALL_LOG"
+// =============================================================================
+
+
+
+// =============================================================================
+// TYPES
+
+// What happened.
+enum syscall_log_event {
+
+	// A thread stopped on entry to a system call; `value` is its first
+	// argument.
+	SYSCALL_LOG_STOP = 0,
+	// The catcher sent the thread to the walker; `value` is the request's
+	// sequence number.
+	SYSCALL_LOG_WALK,
+	// The walker completed; `value` is the number of bytes it walked.
+	SYSCALL_LOG_DONE,
+
+};
+
+// One event.
+struct syscall_log_record {
+
+	uint64_t time;
+	uint64_t value;
+	uint32_t tid;
+	int32_t nr;
+	uint32_t event;
+	uint32_t unused;
+
+};
+// =============================================================================
+
+
+
+// =============================================================================
+#endif /* _SYSCALL_LOG_H */
+// =============================================================================
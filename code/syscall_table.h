@@ -0,0 +1,484 @@
+// =============================================================================
+/*******************************************************************************
+ * System Call Table
+ *
+ * Describes the pointer arguments of every x86-64 system call, so that memory
+ * passed to the kernel can be walked (and its pages unprotected) before the
+ * call. Shared by the catcher, which has the manager walk over ptrace, and by
+ * the manager's in-process seccomp mode.
+ *
+ * Rows are indexed by the `__NR_` constants, and sizes are taken with `sizeof`
+ * from the C library and kernel UAPI headers, so both follow the headers that
+ * the tools are built against. Each argument has a rule that says how many
+ * bytes the kernel may touch: a fixed size, a length or element count held in
+ * another argument (or behind a pointer in another argument), a string, or a
+ * structure that is followed to the buffers it points to (`iovec`, `msghdr`,
+ * `mmsghdr`). Information found on "https://filippo.io/linux-syscall-table/"
+ * and in the kernel's `SYSCALL_DEFINE`s.
+ *
+ * Arguments that are not walked: pointers that the kernel only stores (such as
+ * `set_tid_address`), pointers whose type depends on another argument (such
+ * as `ioctl`, `fcntl` and `prctl`), and the arguments of `clone`, `clone3`,
+ * `fork` and `vfork`, which cannot be re-issued from a walker.
+ *
+ * Users must define `_GNU_SOURCE` before any include, for `struct statx` and
+ * `struct file_handle`.
+ ******************************************************************************/
+// =============================================================================
+
+
+
+// =============================================================================
+#if !defined (_SYSCALL_TABLE_H)
+#define _SYSCALL_TABLE_H
+// =============================================================================
+
+
+
+// =============================================================================
+// INCLUDES
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <mqueue.h>
+#include <sys/epoll.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/sem.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include <sys/time.h>
+#include <sys/timex.h>
+#include <sys/times.h>
+#include <sys/uio.h>
+#include <sys/utsname.h>
+#include <utime.h>
+#include <asm/ldt.h>
+#include <linux/aio_abi.h>
+#include <linux/capability.h>
+#include <linux/futex.h>
+#include <linux/io_uring.h>
+#include <linux/kexec.h>
+#include <linux/openat2.h>
+#include <linux/perf_event.h>
+// =============================================================================
+
+
+
+// =============================================================================
+// MACROS
+
+// Number of rows in the table; system call numbers past it are never walked.
+#define SYSCALL_TABLE_SIZE 512
+// =============================================================================
+
+
+
+// =============================================================================
+// TYPES
+
+// How an argument is walked.
+enum syscall_arg_kind {
+
+	// Not walked.
+	SYSCALL_ARG_NONE = 0,
+	// A string, walked up to its end.
+	SYSCALL_ARG_STRING,
+	// A `NULL`-terminated array of strings (`argv`, `envp`).
+	SYSCALL_ARG_STRINGS,
+	// `size` bytes.
+	SYSCALL_ARG_FIXED,
+	// `size` bytes for each unit of argument `arg`, plus `extra` bytes.
+	SYSCALL_ARG_LENGTH,
+	// As many bytes as the `socklen_t` to which argument `arg` points.
+	SYSCALL_ARG_LENGTH_AT,
+	// A bit mask of as many bits as argument `arg`, in whole `long`s.
+	SYSCALL_ARG_BITS,
+	// One byte for each page of the length in argument `arg`.
+	SYSCALL_ARG_PAGES,
+	// Argument `arg` `struct iovec`s, and the buffer of each.
+	SYSCALL_ARG_IOVEC,
+	// A `struct msghdr`, and its name, control buffer and `iovec`s.
+	SYSCALL_ARG_MSGHDR,
+	// Argument `arg` `struct mmsghdr`s, each followed like a `msghdr`.
+	SYSCALL_ARG_MMSGHDR,
+
+};
+
+// Whether the kernel writes what an argument points to.
+enum syscall_arg_out {
+
+	// Only read.
+	SYSCALL_OUT_NONE = 0,
+	// Written, up to its whole size.
+	SYSCALL_OUT_SIZE,
+	// Written, as many bytes as the call returns (such as `read`).
+	SYSCALL_OUT_RETURN,
+
+};
+
+// The rule for one argument.
+struct syscall_arg {
+
+	unsigned char kind;
+	unsigned char arg;
+	unsigned char out;
+	unsigned short extra;
+	unsigned int size;
+
+};
+
+// Layout of `struct sigaction` as the kernel takes it.
+struct syscall_kernel_sigaction {
+
+	void* handler;
+	unsigned long flags;
+	void* restorer;
+	uint64_t mask;
+
+};
+
+// Layout of `struct ustat`, which the C library no longer declares.
+struct syscall_ustat {
+
+	int f_tfree;
+	unsigned long f_tinode;
+	char f_fname[6];
+	char f_fpack[6];
+
+};
+
+// Layout of `struct sched_attr`, whose header clashes with the C library's
+// `struct sched_param`.
+struct syscall_sched_attr {
+
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+	uint32_t sched_util_min;
+	uint32_t sched_util_max;
+
+};
+
+// The signal mask argument of `pselect6` and `io_pgetevents`.
+struct syscall_sigset_arg {
+
+	const void* sigset;
+	size_t size;
+
+};
+// =============================================================================
+
+
+
+// =============================================================================
+// SYSTEM CALL TABLE
+
+// Shorthand for the rules; `OUT` or `OUT_RETURN` may follow the last argument.
+#define STRING               { .kind = SYSCALL_ARG_STRING }
+#define STRINGS              { .kind = SYSCALL_ARG_STRINGS }
+#define FIXED(s, ...)        { .kind = SYSCALL_ARG_FIXED, .size = (s), __VA_ARGS__ }
+#define LENGTH(a, ...)       { .kind = SYSCALL_ARG_LENGTH, .arg = (a), .size = 1, __VA_ARGS__ }
+#define ARRAY(a, s, ...)     { .kind = SYSCALL_ARG_LENGTH, .arg = (a), .size = (s), __VA_ARGS__ }
+#define LENGTH_AT(a, ...)    { .kind = SYSCALL_ARG_LENGTH_AT, .arg = (a), __VA_ARGS__ }
+#define BITS(a, ...)         { .kind = SYSCALL_ARG_BITS, .arg = (a), __VA_ARGS__ }
+#define PAGES(a, ...)        { .kind = SYSCALL_ARG_PAGES, .arg = (a), __VA_ARGS__ }
+#define IOVEC(a, ...)        { .kind = SYSCALL_ARG_IOVEC, .arg = (a), __VA_ARGS__ }
+#define MSGHDR(...)          { .kind = SYSCALL_ARG_MSGHDR, __VA_ARGS__ }
+#define MMSGHDR(a, ...)      { .kind = SYSCALL_ARG_MMSGHDR, .arg = (a), __VA_ARGS__ }
+#define NONE                 { .kind = SYSCALL_ARG_NONE }
+#define OUT                  .out = SYSCALL_OUT_SIZE
+#define OUT_RETURN           .out = SYSCALL_OUT_RETURN
+
+/**
+ * The rules for each system call's six arguments, by system call number.
+ * System calls that are not listed take no pointers that can be walked.
+ */
+static const struct syscall_arg syscall_table[SYSCALL_TABLE_SIZE][6] = {
+
+	[__NR_read]                   = { NONE, LENGTH(2, OUT_RETURN) },
+	[__NR_write]                  = { NONE, LENGTH(2) },
+	[__NR_open]                   = { STRING },
+	[__NR_stat]                   = { STRING, FIXED(sizeof(struct stat), OUT) },
+	[__NR_fstat]                  = { NONE, FIXED(sizeof(struct stat), OUT) },
+	[__NR_lstat]                  = { STRING, FIXED(sizeof(struct stat), OUT) },
+	[__NR_poll]                   = { ARRAY(1, sizeof(struct pollfd), OUT) },
+	[__NR_rt_sigaction]           = { NONE, FIXED(sizeof(struct syscall_kernel_sigaction)), FIXED(sizeof(struct syscall_kernel_sigaction), OUT) },
+	[__NR_rt_sigprocmask]         = { NONE, LENGTH(3), LENGTH(3, OUT) },
+	[__NR_pread64]                = { NONE, LENGTH(2, OUT_RETURN) },
+	[__NR_pwrite64]               = { NONE, LENGTH(2) },
+	[__NR_readv]                  = { NONE, IOVEC(2, OUT_RETURN) },
+	[__NR_writev]                 = { NONE, IOVEC(2) },
+	[__NR_access]                 = { STRING },
+	[__NR_pipe]                   = { FIXED(2 * sizeof(int), OUT) },
+	[__NR_select]                 = { NONE, FIXED(sizeof(fd_set), OUT), FIXED(sizeof(fd_set), OUT), FIXED(sizeof(fd_set), OUT), FIXED(sizeof(struct timeval), OUT) },
+	[__NR_mincore]                = { NONE, NONE, PAGES(1, OUT) },
+	[__NR_shmctl]                 = { NONE, NONE, FIXED(sizeof(struct shmid_ds), OUT) },
+	[__NR_nanosleep]              = { FIXED(sizeof(struct timespec)), FIXED(sizeof(struct timespec), OUT) },
+	[__NR_getitimer]              = { NONE, FIXED(sizeof(struct itimerval), OUT) },
+	[__NR_setitimer]              = { NONE, FIXED(sizeof(struct itimerval)), FIXED(sizeof(struct itimerval), OUT) },
+	[__NR_sendfile]               = { NONE, NONE, FIXED(sizeof(off_t), OUT) },
+	[__NR_connect]                = { NONE, LENGTH(2) },
+	[__NR_accept]                 = { NONE, LENGTH_AT(2, OUT), FIXED(sizeof(socklen_t), OUT) },
+	[__NR_sendto]                 = { NONE, LENGTH(2), NONE, NONE, LENGTH(5) },
+	[__NR_recvfrom]               = { NONE, LENGTH(2, OUT_RETURN), NONE, NONE, LENGTH_AT(5, OUT), FIXED(sizeof(socklen_t), OUT) },
+	[__NR_sendmsg]                = { NONE, MSGHDR() },
+	[__NR_recvmsg]                = { NONE, MSGHDR(OUT) },
+	[__NR_bind]                   = { NONE, LENGTH(2) },
+	[__NR_getsockname]            = { NONE, LENGTH_AT(2, OUT), FIXED(sizeof(socklen_t), OUT) },
+	[__NR_getpeername]            = { NONE, LENGTH_AT(2, OUT), FIXED(sizeof(socklen_t), OUT) },
+	[__NR_socketpair]             = { NONE, NONE, NONE, FIXED(2 * sizeof(int), OUT) },
+	[__NR_setsockopt]             = { NONE, NONE, NONE, LENGTH(4) },
+	[__NR_getsockopt]             = { NONE, NONE, NONE, LENGTH_AT(4, OUT), FIXED(sizeof(socklen_t), OUT) },
+	[__NR_execve]                 = { STRING, STRINGS, STRINGS },
+	[__NR_wait4]                  = { NONE, FIXED(sizeof(int), OUT), NONE, FIXED(sizeof(struct rusage), OUT) },
+	[__NR_uname]                  = { FIXED(sizeof(struct utsname), OUT) },
+	[__NR_semop]                  = { NONE, ARRAY(2, sizeof(struct sembuf)) },
+	[__NR_msgsnd]                 = { NONE, LENGTH(2, .extra = sizeof(long)) },
+	[__NR_msgrcv]                 = { NONE, LENGTH(2, .extra = sizeof(long), OUT) },
+	[__NR_msgctl]                 = { NONE, NONE, FIXED(sizeof(struct msqid_ds), OUT) },
+	[__NR_truncate]               = { STRING },
+	[__NR_getdents]               = { NONE, LENGTH(2, OUT_RETURN) },
+	[__NR_getcwd]                 = { LENGTH(1, OUT_RETURN) },
+	[__NR_chdir]                  = { STRING },
+	[__NR_rename]                 = { STRING, STRING },
+	[__NR_mkdir]                  = { STRING },
+	[__NR_rmdir]                  = { STRING },
+	[__NR_creat]                  = { STRING },
+	[__NR_link]                   = { STRING, STRING },
+	[__NR_unlink]                 = { STRING },
+	[__NR_symlink]                = { STRING, STRING },
+	[__NR_readlink]               = { STRING, LENGTH(2, OUT_RETURN) },
+	[__NR_chmod]                  = { STRING },
+	[__NR_chown]                  = { STRING },
+	[__NR_lchown]                 = { STRING },
+	[__NR_gettimeofday]           = { FIXED(sizeof(struct timeval), OUT), FIXED(sizeof(struct timezone), OUT) },
+	[__NR_getrlimit]              = { NONE, FIXED(sizeof(struct rlimit), OUT) },
+	[__NR_getrusage]              = { NONE, FIXED(sizeof(struct rusage), OUT) },
+	[__NR_sysinfo]                = { FIXED(sizeof(struct sysinfo), OUT) },
+	[__NR_times]                  = { FIXED(sizeof(struct tms), OUT) },
+	[__NR_syslog]                 = { NONE, LENGTH(2, OUT_RETURN) },
+	[__NR_getgroups]              = { NONE, ARRAY(0, sizeof(gid_t), OUT) },
+	[__NR_setgroups]              = { NONE, ARRAY(0, sizeof(gid_t)) },
+	[__NR_getresuid]              = { FIXED(sizeof(uid_t), OUT), FIXED(sizeof(uid_t), OUT), FIXED(sizeof(uid_t), OUT) },
+	[__NR_getresgid]              = { FIXED(sizeof(gid_t), OUT), FIXED(sizeof(gid_t), OUT), FIXED(sizeof(gid_t), OUT) },
+	[__NR_capget]                 = { FIXED(sizeof(struct __user_cap_header_struct)), FIXED(_LINUX_CAPABILITY_U32S_3 * sizeof(struct __user_cap_data_struct), OUT) },
+	[__NR_capset]                 = { FIXED(sizeof(struct __user_cap_header_struct)), FIXED(_LINUX_CAPABILITY_U32S_3 * sizeof(struct __user_cap_data_struct)) },
+	[__NR_rt_sigpending]          = { LENGTH(1, OUT) },
+	[__NR_rt_sigtimedwait]        = { LENGTH(3), FIXED(sizeof(siginfo_t), OUT), FIXED(sizeof(struct timespec)) },
+	[__NR_rt_sigqueueinfo]        = { NONE, NONE, FIXED(sizeof(siginfo_t)) },
+	[__NR_rt_sigsuspend]          = { LENGTH(1) },
+	[__NR_sigaltstack]            = { FIXED(sizeof(stack_t)), FIXED(sizeof(stack_t), OUT) },
+	[__NR_utime]                  = { STRING, FIXED(sizeof(struct utimbuf)) },
+	[__NR_mknod]                  = { STRING },
+	[__NR_uselib]                 = { STRING },
+	[__NR_ustat]                  = { NONE, FIXED(sizeof(struct syscall_ustat), OUT) },
+	[__NR_statfs]                 = { STRING, FIXED(sizeof(struct statfs), OUT) },
+	[__NR_fstatfs]                = { NONE, FIXED(sizeof(struct statfs), OUT) },
+	[__NR_sched_setparam]         = { NONE, FIXED(sizeof(struct sched_param)) },
+	[__NR_sched_getparam]         = { NONE, FIXED(sizeof(struct sched_param), OUT) },
+	[__NR_sched_setscheduler]     = { NONE, NONE, FIXED(sizeof(struct sched_param)) },
+	[__NR_sched_rr_get_interval]  = { NONE, FIXED(sizeof(struct timespec), OUT) },
+	[__NR_modify_ldt]             = { NONE, LENGTH(2, OUT_RETURN) },
+	[__NR_pivot_root]             = { STRING, STRING },
+	[__NR_adjtimex]               = { FIXED(sizeof(struct timex), OUT) },
+	[__NR_setrlimit]              = { NONE, FIXED(sizeof(struct rlimit)) },
+	[__NR_chroot]                 = { STRING },
+	[__NR_acct]                   = { STRING },
+	[__NR_settimeofday]           = { FIXED(sizeof(struct timeval)), FIXED(sizeof(struct timezone)) },
+	[__NR_mount]                  = { STRING, STRING, STRING },
+	[__NR_umount2]                = { STRING },
+	[__NR_swapon]                 = { STRING },
+	[__NR_swapoff]                = { STRING },
+	[__NR_sethostname]            = { LENGTH(1) },
+	[__NR_setdomainname]          = { LENGTH(1) },
+	[__NR_init_module]            = { LENGTH(1), NONE, STRING },
+	[__NR_delete_module]          = { STRING },
+	[__NR_quotactl]               = { NONE, STRING },
+	[__NR_setxattr]               = { STRING, STRING, LENGTH(3) },
+	[__NR_lsetxattr]              = { STRING, STRING, LENGTH(3) },
+	[__NR_fsetxattr]              = { NONE, STRING, LENGTH(3) },
+	[__NR_getxattr]               = { STRING, STRING, LENGTH(3, OUT_RETURN) },
+	[__NR_lgetxattr]              = { STRING, STRING, LENGTH(3, OUT_RETURN) },
+	[__NR_fgetxattr]              = { NONE, STRING, LENGTH(3, OUT_RETURN) },
+	[__NR_listxattr]              = { STRING, LENGTH(2, OUT_RETURN) },
+	[__NR_llistxattr]             = { STRING, LENGTH(2, OUT_RETURN) },
+	[__NR_flistxattr]             = { NONE, LENGTH(2, OUT_RETURN) },
+	[__NR_removexattr]            = { STRING, STRING },
+	[__NR_lremovexattr]           = { STRING, STRING },
+	[__NR_fremovexattr]           = { NONE, STRING },
+	[__NR_time]                   = { FIXED(sizeof(time_t), OUT) },
+	[__NR_futex]                  = { FIXED(sizeof(uint32_t)) },
+	[__NR_sched_setaffinity]      = { NONE, NONE, LENGTH(1) },
+	[__NR_sched_getaffinity]      = { NONE, NONE, LENGTH(1, OUT) },
+	[__NR_set_thread_area]        = { FIXED(sizeof(struct user_desc), OUT) },
+	[__NR_io_setup]               = { NONE, FIXED(sizeof(aio_context_t), OUT) },
+	[__NR_io_getevents]           = { NONE, NONE, NONE, ARRAY(2, sizeof(struct io_event), OUT), FIXED(sizeof(struct timespec)) },
+	[__NR_io_submit]              = { NONE, NONE, ARRAY(1, sizeof(struct iocb*)) },
+	[__NR_io_cancel]              = { NONE, FIXED(sizeof(struct iocb)), FIXED(sizeof(struct io_event), OUT) },
+	[__NR_get_thread_area]        = { FIXED(sizeof(struct user_desc), OUT) },
+	[__NR_lookup_dcookie]         = { NONE, LENGTH(2, OUT_RETURN) },
+	[__NR_getdents64]             = { NONE, LENGTH(2, OUT_RETURN) },
+	[__NR_semtimedop]             = { NONE, ARRAY(2, sizeof(struct sembuf)), NONE, FIXED(sizeof(struct timespec)) },
+	[__NR_timer_create]           = { NONE, FIXED(sizeof(struct sigevent)), FIXED(sizeof(timer_t), OUT) },
+	[__NR_timer_settime]          = { NONE, NONE, FIXED(sizeof(struct itimerspec)), FIXED(sizeof(struct itimerspec), OUT) },
+	[__NR_timer_gettime]          = { NONE, FIXED(sizeof(struct itimerspec), OUT) },
+	[__NR_clock_settime]          = { NONE, FIXED(sizeof(struct timespec)) },
+	[__NR_clock_gettime]          = { NONE, FIXED(sizeof(struct timespec), OUT) },
+	[__NR_clock_getres]           = { NONE, FIXED(sizeof(struct timespec), OUT) },
+	[__NR_clock_nanosleep]        = { NONE, NONE, FIXED(sizeof(struct timespec)), FIXED(sizeof(struct timespec), OUT) },
+	[__NR_epoll_wait]             = { NONE, ARRAY(2, sizeof(struct epoll_event), OUT) },
+	[__NR_epoll_ctl]              = { NONE, NONE, NONE, FIXED(sizeof(struct epoll_event)) },
+	[__NR_utimes]                 = { STRING, FIXED(2 * sizeof(struct timeval)) },
+	[__NR_mbind]                  = { NONE, NONE, NONE, BITS(4) },
+	[__NR_set_mempolicy]          = { NONE, BITS(2) },
+	[__NR_get_mempolicy]          = { FIXED(sizeof(int), OUT), BITS(2, OUT) },
+	[__NR_mq_open]                = { STRING, NONE, NONE, FIXED(sizeof(struct mq_attr)) },
+	[__NR_mq_unlink]              = { STRING },
+	[__NR_mq_timedsend]           = { NONE, LENGTH(2), NONE, NONE, FIXED(sizeof(struct timespec)) },
+	[__NR_mq_timedreceive]        = { NONE, LENGTH(2, OUT_RETURN), NONE, FIXED(sizeof(unsigned int), OUT), FIXED(sizeof(struct timespec)) },
+	[__NR_mq_notify]              = { NONE, FIXED(sizeof(struct sigevent)) },
+	[__NR_mq_getsetattr]          = { NONE, FIXED(sizeof(struct mq_attr)), FIXED(sizeof(struct mq_attr), OUT) },
+	[__NR_kexec_load]             = { NONE, NONE, ARRAY(1, sizeof(struct kexec_segment)) },
+	[__NR_waitid]                 = { NONE, NONE, FIXED(sizeof(siginfo_t), OUT), NONE, FIXED(sizeof(struct rusage), OUT) },
+	[__NR_add_key]                = { STRING, STRING, LENGTH(3) },
+	[__NR_request_key]            = { STRING, STRING, STRING },
+	[__NR_inotify_add_watch]      = { NONE, STRING },
+	[__NR_migrate_pages]          = { NONE, NONE, BITS(1), BITS(1) },
+	[__NR_openat]                 = { NONE, STRING },
+	[__NR_mkdirat]                = { NONE, STRING },
+	[__NR_mknodat]                = { NONE, STRING },
+	[__NR_fchownat]               = { NONE, STRING },
+	[__NR_futimesat]              = { NONE, STRING, FIXED(2 * sizeof(struct timeval)) },
+	[__NR_newfstatat]             = { NONE, STRING, FIXED(sizeof(struct stat), OUT) },
+	[__NR_unlinkat]               = { NONE, STRING },
+	[__NR_renameat]               = { NONE, STRING, NONE, STRING },
+	[__NR_linkat]                 = { NONE, STRING, NONE, STRING },
+	[__NR_symlinkat]              = { STRING, NONE, STRING },
+	[__NR_readlinkat]             = { NONE, STRING, LENGTH(3, OUT_RETURN) },
+	[__NR_fchmodat]               = { NONE, STRING },
+	[__NR_faccessat]              = { NONE, STRING },
+	[__NR_pselect6]               = { NONE, FIXED(sizeof(fd_set), OUT), FIXED(sizeof(fd_set), OUT), FIXED(sizeof(fd_set), OUT), FIXED(sizeof(struct timespec), OUT), FIXED(sizeof(struct syscall_sigset_arg)) },
+	[__NR_ppoll]                  = { ARRAY(1, sizeof(struct pollfd), OUT), NONE, FIXED(sizeof(struct timespec), OUT), LENGTH(4) },
+	[__NR_get_robust_list]        = { NONE, FIXED(sizeof(void*), OUT), FIXED(sizeof(size_t), OUT) },
+	[__NR_splice]                 = { NONE, FIXED(sizeof(loff_t), OUT), NONE, FIXED(sizeof(loff_t), OUT) },
+	[__NR_vmsplice]               = { NONE, IOVEC(2) },
+	[__NR_move_pages]             = { NONE, NONE, ARRAY(1, sizeof(void*)), ARRAY(1, sizeof(int)), ARRAY(1, sizeof(int), OUT) },
+	[__NR_utimensat]              = { NONE, STRING, FIXED(2 * sizeof(struct timespec)) },
+	[__NR_epoll_pwait]            = { NONE, ARRAY(2, sizeof(struct epoll_event), OUT), NONE, NONE, LENGTH(5) },
+	[__NR_signalfd]               = { NONE, LENGTH(2) },
+	[__NR_timerfd_settime]        = { NONE, NONE, FIXED(sizeof(struct itimerspec)), FIXED(sizeof(struct itimerspec), OUT) },
+	[__NR_timerfd_gettime]        = { NONE, FIXED(sizeof(struct itimerspec), OUT) },
+	[__NR_accept4]                = { NONE, LENGTH_AT(2, OUT), FIXED(sizeof(socklen_t), OUT) },
+	[__NR_signalfd4]              = { NONE, LENGTH(2) },
+	[__NR_pipe2]                  = { FIXED(2 * sizeof(int), OUT) },
+	[__NR_preadv]                 = { NONE, IOVEC(2, OUT_RETURN) },
+	[__NR_pwritev]                = { NONE, IOVEC(2) },
+	[__NR_rt_tgsigqueueinfo]      = { NONE, NONE, NONE, FIXED(sizeof(siginfo_t)) },
+	[__NR_perf_event_open]        = { FIXED(sizeof(struct perf_event_attr)) },
+	[__NR_recvmmsg]               = { NONE, MMSGHDR(2, OUT), NONE, NONE, FIXED(sizeof(struct timespec), OUT) },
+	[__NR_fanotify_mark]          = { NONE, NONE, NONE, NONE, STRING },
+	[__NR_prlimit64]              = { NONE, NONE, FIXED(sizeof(struct rlimit)), FIXED(sizeof(struct rlimit), OUT) },
+	[__NR_name_to_handle_at]      = { NONE, STRING, FIXED(sizeof(struct file_handle) + MAX_HANDLE_SZ, OUT), FIXED(sizeof(int), OUT) },
+	[__NR_open_by_handle_at]      = { NONE, FIXED(sizeof(struct file_handle) + MAX_HANDLE_SZ) },
+	[__NR_clock_adjtime]          = { NONE, FIXED(sizeof(struct timex), OUT) },
+	[__NR_sendmmsg]               = { NONE, MMSGHDR(2) },
+	[__NR_getcpu]                 = { FIXED(sizeof(unsigned int), OUT), FIXED(sizeof(unsigned int), OUT) },
+	[__NR_process_vm_readv]       = { NONE, IOVEC(2, OUT_RETURN), NONE, ARRAY(4, sizeof(struct iovec)) },
+	[__NR_process_vm_writev]      = { NONE, IOVEC(2), NONE, ARRAY(4, sizeof(struct iovec)) },
+	[__NR_finit_module]           = { NONE, STRING },
+	[__NR_sched_setattr]          = { NONE, FIXED(sizeof(struct syscall_sched_attr)) },
+	[__NR_sched_getattr]          = { NONE, LENGTH(2, OUT) },
+	[__NR_renameat2]              = { NONE, STRING, NONE, STRING },
+	[__NR_getrandom]              = { LENGTH(1, OUT_RETURN) },
+	[__NR_memfd_create]           = { STRING },
+	[__NR_kexec_file_load]        = { NONE, NONE, NONE, LENGTH(2) },
+	[__NR_bpf]                    = { NONE, LENGTH(2, OUT) },
+	[__NR_execveat]               = { NONE, STRING, STRINGS, STRINGS },
+	[__NR_copy_file_range]        = { NONE, FIXED(sizeof(loff_t), OUT), NONE, FIXED(sizeof(loff_t), OUT) },
+	[__NR_preadv2]                = { NONE, IOVEC(2, OUT_RETURN) },
+	[__NR_pwritev2]               = { NONE, IOVEC(2) },
+	[__NR_statx]                  = { NONE, STRING, NONE, NONE, FIXED(sizeof(struct statx), OUT) },
+	[__NR_io_pgetevents]          = { NONE, NONE, NONE, ARRAY(2, sizeof(struct io_event), OUT), FIXED(sizeof(struct timespec)), FIXED(sizeof(struct syscall_sigset_arg)) },
+#if defined (__NR_pidfd_send_signal)
+	[__NR_pidfd_send_signal]      = { NONE, NONE, FIXED(sizeof(siginfo_t)) },
+	[__NR_io_uring_setup]         = { NONE, FIXED(sizeof(struct io_uring_params), OUT) },
+	[__NR_io_uring_enter]         = { NONE, NONE, NONE, NONE, LENGTH(5) },
+	[__NR_open_tree]              = { NONE, STRING },
+	[__NR_move_mount]             = { NONE, STRING, NONE, STRING },
+	[__NR_fsopen]                 = { STRING },
+	[__NR_fsconfig]               = { NONE, NONE, STRING },
+	[__NR_fspick]                 = { NONE, STRING },
+#endif
+#if defined (__NR_openat2)
+	[__NR_openat2]                = { NONE, STRING, LENGTH(3) },
+	[__NR_faccessat2]             = { NONE, STRING },
+	[__NR_process_madvise]        = { NONE, ARRAY(2, sizeof(struct iovec)) },
+	[__NR_epoll_pwait2]           = { NONE, ARRAY(2, sizeof(struct epoll_event), OUT), NONE, FIXED(sizeof(struct timespec)), LENGTH(5) },
+	[__NR_mount_setattr]          = { NONE, STRING, NONE, LENGTH(4) },
+	[__NR_landlock_create_ruleset] = { LENGTH(1) },
+#endif
+#if defined (__NR_futex_waitv)
+	[__NR_futex_waitv]            = { ARRAY(1, sizeof(struct futex_waitv)), NONE, NONE, FIXED(sizeof(struct timespec)) },
+#endif
+
+};
+
+#undef STRING
+#undef STRINGS
+#undef FIXED
+#undef LENGTH
+#undef ARRAY
+#undef LENGTH_AT
+#undef BITS
+#undef PAGES
+#undef IOVEC
+#undef MSGHDR
+#undef MMSGHDR
+#undef NONE
+#undef OUT
+#undef OUT_RETURN
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Whether any argument of a system call is walked. Numbers past the table, and
+ * negative ones, are not.
+ */
+static inline int syscall_walks (long nr) {
+
+	if (nr < 0 || nr >= SYSCALL_TABLE_SIZE) {
+		return 0;
+	}
+	for (int i = 0; i < 6; i++) {
+		if (syscall_table[nr][i].kind != SYSCALL_ARG_NONE) {
+			return 1;
+		}
+	}
+	return 0;
+
+} // syscall_walks ()
+// =============================================================================
+
+
+
+// =============================================================================
+#endif /* _SYSCALL_TABLE_H */
+// =============================================================================
@@ -0,0 +1,190 @@
+// =============================================================================
+/**
+ * A stress benchmark for concurrent faults.  Each thread touches random pages
+ * of one shared, malloc()'d array, so that under the manager, threads fault
+ * on the same pages and evict each other's pages from the unprotected list at
+ * the same time.  Every thread increments its own word on each page it
+ * touches, and at the end the array is checked against each thread's private
+ * count, so that a lost write (or a crash) reveals a race.  The array is
+ * allocated once and never freed, since the manager does not yet see pages
+ * being unmapped.  Run it under the manager alone, with a small window to
+ * force evictions:
+ *
+ *   LD_PRELOAD=./manager.so VMT_TRACENAME=t.csv VMT_SIZE=16 ./thread_test
+ */
+// =============================================================================
+
+
+
+// =============================================================================
+// INCLUDES
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+// =============================================================================
+
+
+
+// =============================================================================
+// MACROS AND CONSTANTS
+
+/** The size of a page. */
+#define PAGE_SIZE 4096
+
+/** The most threads; each owns one cache line of every page. */
+#define MAX_THREADS 64
+
+/** The number of words between the counters of two threads. */
+#define WORDS_PER_THREAD (PAGE_SIZE / sizeof(uint64_t) / MAX_THREADS)
+
+/** The number of pages in the shared array. */
+#define PAGES 4096
+
+/** The number of pages touched by each thread. */
+#define TOUCHES 10000
+
+/** The thread counts measured when none are given. */
+static const int default_threads[] = { 8, 16, 32, 64 };
+// =============================================================================
+
+
+
+// =============================================================================
+// TYPES
+
+/** The arguments and result of one thread. */
+typedef struct thread_arg_struct {
+  pthread_t thread;
+  int       id;
+  uint64_t* array;
+  uint64_t  touches;
+} thread_arg_s;
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Get a monotonic time in nanoseconds.
+ */
+static uint64_t now_ns ()
+{
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+} // now_ns ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Touch random pages, incrementing this thread's word on each.
+ * \param  arg The thread's `thread_arg_s`.
+ */
+static void* touch_pages (void* arg)
+{
+
+  thread_arg_s* t     = arg;
+  uint64_t      state = 0x9e3779b97f4a7c15ULL * (t->id + 1);
+  for (int i = 0; i < TOUCHES; ++i) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    size_t page = state % PAGES;
+    t->array[page * (PAGE_SIZE / sizeof(uint64_t)) + t->id * WORDS_PER_THREAD] += 1;
+    t->touches += 1;
+  }
+  return NULL;
+
+} // touch_pages ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Run one measurement with a given number of threads.
+ * \param  array   The shared array.
+ * \param  threads The number of threads.
+ * \return Whether every thread's writes were all found in the array.
+ */
+static int run (uint64_t* array, int threads)
+{
+
+  for (size_t i = 0; i < PAGES * (PAGE_SIZE / sizeof(uint64_t)); ++i) {
+    array[i] = 0;
+  }
+
+  thread_arg_s args[MAX_THREADS];
+  uint64_t     start = now_ns();
+  for (int i = 0; i < threads; ++i) {
+    args[i] = (thread_arg_s){ .id = i, .array = array, .touches = 0 };
+    if (pthread_create(&args[i].thread, NULL, touch_pages, &args[i]) != 0) {
+      fprintf(stderr, "ERROR: pthread_create failed\n");
+      exit(1);
+    }
+  }
+  for (int i = 0; i < threads; ++i) {
+    pthread_join(args[i].thread, NULL);
+  }
+  uint64_t elapsed = now_ns() - start;
+
+  // Every thread's count must be found, in full, in its words of the array.
+  int ok = 1;
+  for (int i = 0; i < threads; ++i) {
+    uint64_t sum = 0;
+    for (size_t page = 0; page < PAGES; ++page) {
+      sum += array[page * (PAGE_SIZE / sizeof(uint64_t)) + i * WORDS_PER_THREAD];
+    }
+    if (sum != args[i].touches) {
+      printf("thread %d: expected %lu, found %lu\n", i, args[i].touches, sum);
+      ok = 0;
+    }
+  }
+
+  uint64_t touches = (uint64_t)threads * TOUCHES;
+  printf("%3d threads: %10lu touches %8.2f ms %10.1f touches/ms %s\n",
+         threads, touches, elapsed / 1e6, touches / (elapsed / 1e6), ok ? "ok" : "LOST WRITES");
+
+  return ok;
+
+} // run ()
+// =============================================================================
+
+
+
+// =============================================================================
+int main (int argc, char** argv)
+{
+
+  uint64_t* array = malloc(PAGES * PAGE_SIZE);
+  if (array == NULL) {
+    fprintf(stderr, "ERROR: malloc failed\n");
+    return 1;
+  }
+
+  int ok = 1;
+  if (argc == 1) {
+    for (size_t i = 0; i < sizeof(default_threads) / sizeof(default_threads[0]); ++i) {
+      ok &= run(array, default_threads[i]);
+    }
+  } else {
+    for (int i = 1; i < argc; ++i) {
+      int threads = atoi(argv[i]);
+      if (threads < 1 || threads > MAX_THREADS) {
+        fprintf(stderr, "USAGE: %s [<threads> ...], each from 1 to %d\n", argv[0], MAX_THREADS);
+        return 1;
+      }
+      ok &= run(array, threads);
+    }
+  }
+  return ok ? 0 : 1;
+
+} // main ()
+// =============================================================================
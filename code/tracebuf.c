@@ -0,0 +1,697 @@
+/* =============================================================================================================================== */
+/**
+ * \file tracebuf.c
+ * \brief Per-thread trace streams, merged into one time-ordered trace file when flushed.
+ *
+ * Each thread appends the accesses that it traces to its own stream, so that threads faulting at the same time never contend for
+ * the trace file or for a shared buffer.  Every record carries a CLOCK_MONOTONIC timestamp, the thread's TID, and the CPU on which
+ * it ran.  A flush k-way merges the chunks of every stream by timestamp and writes them as lines of text:
+ *
+ *     <page, 16 hex digits>,<tid>,<cpu>,<time in ns>,<kind>
+ *
+ * An annotation of a page adds what it compressed to, whether it held one word over and over, and the hash of its contents:
+ *
+ *     <page, 16 hex digits>,<tid>,<cpu>,<time in ns>,C,<compressed size>,<0|1>,<hash, 16 hex digits>
+ *
+ * Appending is all that the SIGSEGV handler does here: it takes no lock, makes no system call (the CPU comes from RDTSCP, and the
+ * time from the vDSO), and opens the spare chunk that the flushing thread left the stream when a chunk fills; it allocates one
+ * only when there is no spare.  Flushes are made by a thread of their own (see `tracebuf_run()`), often enough that a process that
+ * ends without exit () (through _exit (), or exit_group from another thread) loses at most the records of its last
+ * `TRACEBUF_FLUSH_INTERVAL_NS`, and by the final flush.  In attach mode, where the manager starts no thread, the handler still
+ * allocates a thread's stream at its first fault and every chunk that it opens, and flushes whenever it seals one.  Memory comes from
+ * the private heap (see `vmt_mman.h`), output goes through raw `write()` system calls, and the only lock (the flush lock) is
+ * merely tried, except by the final flush.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#define _GNU_SOURCE
+
+#include <cpuid.h>       // For __get_cpuid()
+#include <sched.h>       // For sched_yield()
+#include <stdbool.h>     // true
+#include <stddef.h>      // For size_t
+#include <stdint.h>      // For uint64_t
+#include <stdlib.h>      // For exit()
+#include <sys/syscall.h> // For SYS_gettid, SYS_getcpu and SYS_write
+#include <time.h>        // For clock_gettime()
+#include <unistd.h>      // For syscall()
+
+#include "tracebuf.h"
+#include "vmt_mman.h"
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS and CONSTANTS */
+
+/** The longest line that a record can produce. */
+#define MAX_LINE 96
+
+/** The bit of CPUID leaf 0x80000001's EDX that marks RDTSCP, and the bits of its TSC_AUX in which Linux keeps the CPU. */
+#define CPUID_RDTSCP (1U << 27)
+#define TSC_AUX_CPU  0xfff
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* DATA */
+
+/** Whether the CPU has RDTSCP, through which records read their CPU without a system call. */
+static bool use_rdtscp = false;
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* TYPES */
+
+/** A position within one sorted run of records, during a merge. */
+typedef struct cursor_struct {
+  tracebuf_record_s* next;
+  tracebuf_record_s* end;
+} cursor_s;
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Allocate zeroed memory, or exit if none is available.
+ * \param  size The number of bytes to allocate.
+ * \return A pointer to the memory.
+ */
+static void* tracebuf_map (size_t size) {
+
+  void* region = vmt_calloc(1, size);
+  if (region == NULL) {
+    syscall(SYS_write, 2, "ERROR: tracebuf_map(): vmt_calloc failed\n", 41);
+    exit(1);
+  }
+  return region;
+
+} // tracebuf_map ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Get the current CLOCK_MONOTONIC time in nanoseconds.
+ */
+static inline uint64_t tracebuf_now () {
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+} // tracebuf_now ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Get the CPU on which the calling thread is running: from the TSC_AUX that RDTSCP reads, where Linux keeps it, or else
+ *         from getcpu.
+ * \return The CPU, or -1 if it cannot be had.
+ */
+static inline int32_t tracebuf_cpu () {
+
+  if (use_rdtscp) {
+    unsigned int aux;
+    __builtin_ia32_rdtscp(&aux);
+    return (int32_t)(aux & TSC_AUX_CPU);
+  }
+  unsigned int cpu;
+  return (syscall(SYS_getcpu, &cpu, NULL, NULL) == 0) ? (int32_t)cpu : -1;
+
+} // tracebuf_cpu ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Take the chunk that a stream opens next: its spare, or else a new one.
+ */
+static tracebuf_chunk_s* tracebuf_next_chunk (tracebuf_stream_s* stream) {
+
+  tracebuf_chunk_s* spare = __atomic_exchange_n(&stream->spare, NULL, __ATOMIC_ACQUIRE);
+  return (spare != NULL) ? spare : tracebuf_map(sizeof(tracebuf_chunk_s));
+
+} // tracebuf_next_chunk ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Push a full (or final) chunk onto the trace's list of sealed chunks.
+ */
+static void tracebuf_seal (tracebuf_s* trace, tracebuf_chunk_s* chunk) {
+
+  tracebuf_chunk_s* head = __atomic_load_n(&trace->sealed, __ATOMIC_RELAXED);
+  do {
+    chunk->next = head;
+  } while (!__atomic_compare_exchange_n(&trace->sealed, &head, chunk, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+} // tracebuf_seal ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Format one record as a line of text.
+ * \param  line   Where to write the line; at least `MAX_LINE` bytes.
+ * \param  record The record to format.
+ * \return The length of the line, its newline included.
+ */
+static size_t tracebuf_format (char* line, tracebuf_record_s* record) {
+
+  static const char hex[] = "0123456789ABCDEF";
+  char*             p     = line;
+
+  for (int i = 0; i < 16; ++i) {
+    *p++ = hex[(record->page >> (60 - i * 4)) & 0xf];
+  }
+
+  // A CPU of -1 means that it could not be had.
+  uint64_t fields[3] = { record->tid, (record->cpu < 0) ? (uint64_t)-(int64_t)record->cpu : (uint64_t)record->cpu, record->time };
+  for (int f = 0; f < 3; ++f) {
+    char     digits[20];
+    int      n     = 0;
+    uint64_t value = fields[f];
+    do {
+      digits[n++] = '0' + value % 10;
+      value      /= 10;
+    } while (value != 0);
+    *p++ = ',';
+    if (f == 1 && record->cpu < 0) *p++ = '-';
+    while (n > 0) *p++ = digits[--n];
+  }
+  *p++ = ',';
+  *p++ = "FSZWC"[(record->kind <= TRACEBUF_CAPTURE) ? record->kind : TRACEBUF_FAULT];
+
+  if (record->kind == TRACEBUF_CAPTURE) {
+    char     digits[10];
+    int      n     = 0;
+    uint32_t value = record->size & ~TRACEBUF_CAPTURE_FILLED;
+    do {
+      digits[n++] = '0' + value % 10;
+      value      /= 10;
+    } while (value != 0);
+    *p++ = ',';
+    while (n > 0) *p++ = digits[--n];
+    *p++ = ',';
+    *p++ = ((record->size & TRACEBUF_CAPTURE_FILLED) != 0) ? '1' : '0';
+    *p++ = ',';
+    for (int i = 0; i < 16; ++i) {
+      *p++ = hex[(record->hash >> (60 - i * 4)) & 0xf];
+    }
+  }
+  *p++ = '\n';
+
+  return p - line;
+
+} // tracebuf_format ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Write the whole of a buffer to the trace file, and count it.  Only the holder of the flush lock writes.
+ */
+static void tracebuf_write (tracebuf_s* trace, const char* buffer, size_t length) {
+
+  if (trace->fd < 0) return;
+  while (length > 0) {
+    long written = syscall(SYS_write, trace->fd, buffer, length);
+    if (written <= 0) return;
+    buffer += written;
+    length -= written;
+    trace->written = trace->written + written;
+  }
+
+} // tracebuf_write ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Restore the heap property of a min-heap of cursors (ordered by the time of each cursor's next record), downward from a
+ *        given position.
+ */
+static void tracebuf_sift (cursor_s* heap, size_t size, size_t i) {
+
+  while (true) {
+    size_t least = i;
+    size_t left  = 2 * i + 1;
+    size_t right = left + 1;
+    if (left  < size && heap[left].next->time  < heap[least].next->time) least = left;
+    if (right < size && heap[right].next->time < heap[least].next->time) least = right;
+    if (least == i) return;
+    cursor_s temp = heap[i];
+    heap[i]       = heap[least];
+    heap[least]   = temp;
+    i             = least;
+  }
+
+} // tracebuf_sift ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Initialize a trace whose lines are written to a given file.
+ * \param trace The trace to initialize.
+ * \param fd    The file descriptor of the trace file.
+ */
+void tracebuf_create (tracebuf_s* trace, int fd) {
+
+  trace->fd             = fd;
+  trace->streams        = NULL;
+  trace->retired        = NULL;
+  trace->readers        = 0;
+  trace->sealed         = NULL;
+  trace->flush_lock     = 0;
+  trace->running        = false;
+  trace->held           = NULL;
+  trace->held_count     = 0;
+  trace->held_size      = 0;
+  trace->floor          = 0;
+  trace->flushes        = 0;
+  trace->written        = 0;
+
+  unsigned int eax, ebx, ecx, edx;
+  use_rdtscp = __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) != 0 && (edx & CPUID_RDTSCP) != 0;
+
+} // tracebuf_create ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Create a stream for the calling thread.
+ * \param  trace The trace to which the stream belongs.
+ * \return The new stream.
+ */
+tracebuf_stream_s* tracebuf_open (tracebuf_s* trace) {
+
+  tracebuf_stream_s* stream = tracebuf_map(sizeof(tracebuf_stream_s));
+  stream->open   = tracebuf_map(sizeof(tracebuf_chunk_s));
+  stream->oldest = UINT64_MAX;
+  stream->tid    = (uint32_t)syscall(SYS_gettid);
+  stream->live   = true;
+
+  tracebuf_stream_s* head = __atomic_load_n(&trace->streams, __ATOMIC_RELAXED);
+  do {
+    stream->next = head;
+  } while (!__atomic_compare_exchange_n(&trace->streams, &head, stream, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  return stream;
+
+} // tracebuf_open ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Find the live stream of a given thread.  The caller counts among the trace's readers meanwhile, so that no stream that
+ *         it may reach is freed under it.
+ * \param  trace The trace to search.
+ * \param  tid   The thread's TID.
+ * \return The stream, if there is one; `NULL` otherwise.
+ */
+tracebuf_stream_s* tracebuf_find (tracebuf_s* trace, uint32_t tid) {
+
+  tracebuf_stream_s* found = NULL;
+  __atomic_fetch_add(&trace->readers, 1, __ATOMIC_SEQ_CST);
+  for (tracebuf_stream_s* stream = __atomic_load_n(&trace->streams, __ATOMIC_SEQ_CST); stream != NULL; stream = stream->next) {
+    if (stream->tid == tid && stream->live) {
+      found = stream;
+      break;
+    }
+  }
+  __atomic_fetch_sub(&trace->readers, 1, __ATOMIC_RELEASE);
+  return found;
+
+} // tracebuf_find ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Append a record to the calling thread's stream.  Should the stream's chunk fill, it is sealed, for the flushing thread,
+ *        and the stream's spare chunk opened.  Where no thread flushes (in attach mode), the calling thread flushes instead, once
+ *        for each chunk that it seals.
+ */
+static void tracebuf_record (tracebuf_s* trace, tracebuf_stream_s* stream, uintptr_t page, uint32_t kind, uint32_t size,
+                             uint64_t hash) {
+
+  tracebuf_chunk_s* chunk = stream->open;
+  bool              flush = false;
+
+  // Publish a bound on this record's time before taking it, so that a concurrent flush never writes a younger record first.  The
+  // bound is lifted once the record is in the chunk, and the chunk, if full, sealed.
+  __atomic_store_n(&stream->oldest, tracebuf_now(), __ATOMIC_SEQ_CST);
+
+  tracebuf_record_s* record = &chunk->records[chunk->count];
+  record->time = tracebuf_now();
+  record->page = page;
+  record->tid  = stream->tid;
+  record->cpu  = tracebuf_cpu();
+  record->kind = kind;
+  record->size = size;
+  record->hash = hash;
+  __atomic_store_n(&chunk->count, chunk->count + 1, __ATOMIC_RELEASE);
+
+  // Seal a full chunk before replacing it, so that a flush that finds the new chunk open also finds the old one sealed.
+  if (chunk->count == TRACEBUF_CHUNK_RECORDS) {
+    tracebuf_chunk_s* open = tracebuf_next_chunk(stream);
+    tracebuf_seal(trace, chunk);
+    __atomic_store_n(&stream->open, open, __ATOMIC_RELEASE);
+    flush = !__atomic_load_n(&trace->running, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&stream->oldest, UINT64_MAX, __ATOMIC_SEQ_CST);
+  if (flush) {
+    tracebuf_flush(trace, false);
+  }
+
+} // tracebuf_record ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Append an access to the calling thread's stream.
+ * \param trace  The trace.
+ * \param stream The calling thread's stream.
+ * \param page   The page accessed.
+ * \param kind   How it was accessed: `TRACEBUF_FAULT` or `TRACEBUF_SYSCALL`; or `TRACEBUF_ZERO_PAGE` or `TRACEBUF_SAME_FILLED`
+ *               for a page evicted with one word in it.
+ */
+void tracebuf_append (tracebuf_s* trace, tracebuf_stream_s* stream, uintptr_t page, uint32_t kind) {
+
+  tracebuf_record(trace, stream, page, kind, 0, 0);
+
+} // tracebuf_append ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Append an annotation of an evicted page to the calling thread's stream.
+ * \param trace  The trace.
+ * \param stream The calling thread's stream.
+ * \param page   The page.
+ * \param size   What its contents compressed to, with `TRACEBUF_CAPTURE_FILLED` set if they were one word over and over.
+ * \param hash   The hash of its contents.
+ */
+void tracebuf_annotate (tracebuf_s* trace, tracebuf_stream_s* stream, uintptr_t page, uint32_t size, uint64_t hash) {
+
+  tracebuf_record(trace, stream, page, TRACEBUF_CAPTURE, size, hash);
+
+} // tracebuf_annotate ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Close the calling thread's stream as the thread exits, sealing its open chunk (even empty, since a flush may be reading
+ *        it; the flush that merges it frees it), and freeing its spare; the flushing thread leaves none to a stream that is not
+ *        live.  The stream is left with no open chunk, for a flush to unlink and free it; the caller must not use it again.
+ * \param trace  The trace.
+ * \param stream The calling thread's stream.
+ */
+void tracebuf_close (tracebuf_s* trace, tracebuf_stream_s* stream) {
+
+  __atomic_store_n(&stream->live, false, __ATOMIC_SEQ_CST);
+  vmt_free(__atomic_exchange_n(&stream->spare, NULL, __ATOMIC_SEQ_CST));
+  tracebuf_seal(trace, stream->open);
+  __atomic_store_n(&stream->oldest, UINT64_MAX, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&stream->open, NULL, __ATOMIC_SEQ_CST);
+
+} // tracebuf_close ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Unlink the closed streams (those with no open chunk), whose last chunks are sealed, and free those unlinked so far if
+ *        no thread is walking the streams without the flush lock, as no thread that starts to can reach them.  Only the holder
+ *        of the flush lock unlinks; new streams are only ever pushed in front of the first.
+ * \param trace The trace.
+ */
+static void tracebuf_reap (tracebuf_s* trace) {
+
+  tracebuf_stream_s* volatile* link   = &trace->streams;
+  tracebuf_stream_s*           stream = __atomic_load_n(link, __ATOMIC_ACQUIRE);
+  while (stream != NULL) {
+    tracebuf_stream_s* next = stream->next;
+    if (__atomic_load_n(&stream->open, __ATOMIC_ACQUIRE) != NULL) {
+      link   = &stream->next;
+      stream = next;
+      continue;
+    }
+
+    // The first stream may have had new ones pushed in front of it; then the list is walked again from them.
+    if (link == &trace->streams) {
+      tracebuf_stream_s* first = stream;
+      if (!__atomic_compare_exchange_n(link, &first, next, false, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE)) {
+        stream = first;
+        continue;
+      }
+    } else {
+      __atomic_store_n(link, next, __ATOMIC_SEQ_CST);
+    }
+    stream->retired = trace->retired;
+    trace->retired  = stream;
+    stream          = next;
+  }
+
+  if (trace->retired != NULL && __atomic_load_n(&trace->readers, __ATOMIC_SEQ_CST) == 0) {
+    while (trace->retired != NULL) {
+      tracebuf_stream_s* retired = trace->retired;
+      trace->retired             = retired->retired;
+      vmt_free(retired);
+    }
+  }
+
+} // tracebuf_reap ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Merge the chunks (and the records held by the previous flush) by time, and write every record older than the record
+ *        that any live stream is appending.  An ordinary flush gives up at once if another thread is flushing.
+ * \param trace The trace to flush.
+ * \param final Whether this is the last flush: every record is written, and the caller waits for any other flush to finish.
+ */
+void tracebuf_flush (tracebuf_s* trace, bool final) {
+
+  if (final) {
+    while (__atomic_exchange_n(&trace->flush_lock, 1, __ATOMIC_ACQUIRE) != 0) {
+      sched_yield();
+    }
+  } else if (__atomic_exchange_n(&trace->flush_lock, 1, __ATOMIC_ACQUIRE) != 0) {
+    return;
+  }
+  uint64_t flush = ++trace->flushes;
+
+  // Find the time before which every record has been published.  This must precede finding the open chunks, which must precede
+  // taking the sealed ones, so that a record older than this bound is in one or the other.
+  uint64_t           watermark = (final) ? UINT64_MAX : tracebuf_now();
+  tracebuf_stream_s* streams   = __atomic_load_n(&trace->streams, __ATOMIC_SEQ_CST);
+  size_t             opened    = 0;
+  for (tracebuf_stream_s* stream = streams; stream != NULL; stream = stream->next) {
+    uint64_t oldest = __atomic_load_n(&stream->oldest, __ATOMIC_SEQ_CST);
+    if (!final && oldest < watermark) watermark = oldest;
+    if (__atomic_load_n(&stream->open, __ATOMIC_ACQUIRE) != NULL) ++opened;
+  }
+
+  // A stream closed since it was counted has no open chunk any more, and none has one again.
+  tracebuf_chunk_s** open = (opened > 0) ? tracebuf_map(opened * sizeof(tracebuf_chunk_s*)) : NULL;
+  size_t             i    = 0;
+  for (tracebuf_stream_s* stream = streams; stream != NULL && i < opened; stream = stream->next) {
+    tracebuf_chunk_s* chunk = __atomic_load_n(&stream->open, __ATOMIC_ACQUIRE);
+    if (chunk != NULL) open[i++] = chunk;
+  }
+  opened = i;
+
+  tracebuf_chunk_s* chunks = __atomic_exchange_n(&trace->sealed, NULL, __ATOMIC_ACQUIRE);
+  size_t            runs   = 1 + opened;
+  size_t            total  = trace->held_count;
+  for (tracebuf_chunk_s* chunk = chunks; chunk != NULL; chunk = chunk->next) {
+    total += chunk->count - chunk->flushed;
+    ++runs;
+  }
+
+  // Gather every sorted run (each chunk is in time order, as is the held buffer) into a heap of cursors.  Of an open chunk, only
+  // the records older than the watermark are merged, so none of them need be held; a chunk sealed since it was found open is
+  // merged whole, once.
+  size_t    heap_bytes = runs * sizeof(cursor_s);
+  cursor_s* heap       = tracebuf_map(heap_bytes);
+  size_t    size       = 0;
+  if (trace->held_count > 0) {
+    heap[size++] = (cursor_s){ trace->held, trace->held + trace->held_count };
+  }
+  for (tracebuf_chunk_s* chunk = chunks; chunk != NULL; chunk = chunk->next) {
+    if (chunk->count > chunk->flushed) heap[size++] = (cursor_s){ chunk->records + chunk->flushed, chunk->records + chunk->count };
+    chunk->flushed = chunk->count;
+    chunk->merged  = flush;
+  }
+  for (i = 0; i < opened; ++i) {
+    tracebuf_chunk_s* chunk = open[i];
+    if (chunk->merged == flush) continue;
+    size_t count = __atomic_load_n(&chunk->count, __ATOMIC_ACQUIRE);
+    size_t first = chunk->flushed;
+    while (chunk->flushed < count && chunk->records[chunk->flushed].time < watermark) {
+      ++chunk->flushed;
+    }
+    if (chunk->flushed > first) heap[size++] = (cursor_s){ chunk->records + first, chunk->records + chunk->flushed };
+  }
+  for (i = size; i-- > 0; ) {
+    tracebuf_sift(heap, size, i);
+  }
+
+  // Write records in time order up to the watermark, and hold the rest.
+  tracebuf_record_s* held       = (total > 0) ? tracebuf_map(total * sizeof(tracebuf_record_s)) : NULL;
+  size_t             held_count = 0;
+  size_t             out_length = 0;
+  uint64_t           youngest   = 0;
+  while (size > 0) {
+    tracebuf_record_s* record = heap[0].next++;
+    if (record->time < trace->floor) {
+      // Already written by a final flush.
+    } else if (record->time < watermark) {
+      if (out_length + MAX_LINE > TRACEBUF_OUT_SIZE) {
+        tracebuf_write(trace, trace->out, out_length);
+        out_length = 0;
+      }
+      out_length += tracebuf_format(trace->out + out_length, record);
+      if (final) youngest = record->time;
+    } else {
+      held[held_count++] = *record;
+    }
+    if (heap[0].next == heap[0].end) {
+      heap[0] = heap[--size];
+    }
+    tracebuf_sift(heap, size, 0);
+  }
+  tracebuf_write(trace, trace->out, out_length);
+
+  // Release what has been merged.
+  vmt_free(heap);
+  if (open != NULL) {
+    vmt_free(open);
+  }
+  if (trace->held != NULL) {
+    vmt_free(trace->held);
+  }
+  while (chunks != NULL) {
+    tracebuf_chunk_s* next = chunks->next;
+    vmt_free(chunks);
+    chunks = next;
+  }
+  trace->held       = held;
+  trace->held_count = held_count;
+  trace->held_size  = total;
+  if (final && youngest >= trace->floor) {
+    trace->floor = youngest + 1;
+  }
+  tracebuf_reap(trace);
+
+  __atomic_store_n(&trace->flush_lock, 0, __ATOMIC_RELEASE);
+
+} // tracebuf_flush ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief Leave a spare chunk to every live stream that has none.  A stream closed meanwhile frees its spare itself, unless it
+ *        took it before the spare was left; then the spare is taken back here.  As in `tracebuf_find()`, the caller counts among
+ *        the trace's readers, so that no stream is freed under it.
+ */
+static void tracebuf_refill (tracebuf_s* trace) {
+
+  __atomic_fetch_add(&trace->readers, 1, __ATOMIC_SEQ_CST);
+  for (tracebuf_stream_s* stream = __atomic_load_n(&trace->streams, __ATOMIC_ACQUIRE); stream != NULL; stream = stream->next) {
+    if (!__atomic_load_n(&stream->live, __ATOMIC_SEQ_CST) || __atomic_load_n(&stream->spare, __ATOMIC_RELAXED) != NULL) continue;
+    tracebuf_chunk_s* spare = tracebuf_map(sizeof(tracebuf_chunk_s));
+    tracebuf_chunk_s* none  = NULL;
+    if (!__atomic_compare_exchange_n(&stream->spare, &none, spare, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+      vmt_free(spare);
+    } else if (!__atomic_load_n(&stream->live, __ATOMIC_SEQ_CST)) {
+      vmt_free(__atomic_exchange_n(&stream->spare, NULL, __ATOMIC_SEQ_CST));
+    }
+  }
+  __atomic_fetch_sub(&trace->readers, 1, __ATOMIC_RELEASE);
+
+} // tracebuf_refill ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Leave every stream a spare chunk and flush the trace, every `TRACEBUF_FLUSH_INTERVAL_NS`, until the trace ends; the
+ *         start routine of the thread that does so.
+ * \param  arg The trace.
+ * \return `NULL`, once the trace has ended.
+ */
+void* tracebuf_run (void* arg) {
+
+  tracebuf_s*     trace    = arg;
+  struct timespec interval = { 0, TRACEBUF_FLUSH_INTERVAL_NS };
+
+  __atomic_store_n(&trace->running, true, __ATOMIC_RELAXED);
+  while (__atomic_load_n(&trace->fd, __ATOMIC_RELAXED) >= 0) {
+    tracebuf_refill(trace);
+    nanosleep(&interval, NULL);
+    tracebuf_flush(trace, false);
+  }
+  return NULL;
+
+} // tracebuf_run ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief End a trace after its final flush: wait for any flush still writing, and have those that follow write nothing, so that
+ *        the caller may close the file.
+ * \param trace The trace.
+ */
+void tracebuf_end (tracebuf_s* trace) {
+
+  while (__atomic_exchange_n(&trace->flush_lock, 1, __ATOMIC_ACQUIRE) != 0) {
+    sched_yield();
+  }
+  __atomic_store_n(&trace->fd, -1, __ATOMIC_RELAXED);
+  __atomic_store_n(&trace->flush_lock, 0, __ATOMIC_RELEASE);
+
+} // tracebuf_end ()
+/* =============================================================================================================================== */
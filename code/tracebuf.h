@@ -0,0 +1,137 @@
+/* =============================================================================================================================== */
+/**
+ * \file tracebuf.h
+ * \brief Per-thread trace streams, merged into one time-ordered trace file when flushed.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#if !defined (_TRACEBUF_H)
+#define _TRACEBUF_H
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS */
+
+/** The number of records in each chunk of a stream. */
+#define TRACEBUF_CHUNK_RECORDS 4096
+
+/** How often the flushing thread flushes the trace, in nanoseconds; it bounds what is lost if the process ends without exit (),
+ *  and how many sealed chunks await a flush, since only that thread and the final flush flush, but in attach mode. */
+#define TRACEBUF_FLUSH_INTERVAL_NS 10000000
+
+/** The size of the buffer into which a flush formats its lines. */
+#define TRACEBUF_OUT_SIZE      65536
+
+/** How a traced page was accessed: by a fault, or by the kernel, for a system call that was passed it. */
+#define TRACEBUF_FAULT         0
+#define TRACEBUF_SYSCALL       1
+
+/** A page evicted with one word over and over in it, and so stored as that word: zero, or another word. */
+#define TRACEBUF_ZERO_PAGE     2
+#define TRACEBUF_SAME_FILLED   3
+
+/** An annotation of an evicted page: what it compressed to, and the hash of its contents. */
+#define TRACEBUF_CAPTURE       4
+
+/** Set in the size of an annotation when the page held one word over and over. */
+#define TRACEBUF_CAPTURE_FILLED 0x80000000u
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* TYPES */
+
+/** One traced access, or one annotation. */
+typedef struct tracebuf_record_struct {
+  uint64_t  time;  // CLOCK_MONOTONIC, in nanoseconds.
+  uintptr_t page;  // The page accessed.
+  uint64_t  hash;  // For an annotation, the hash of the page's contents.
+  uint32_t  tid;   // The thread that accessed it.
+  int32_t   cpu;   // The CPU on which the thread was running, as RDTSCP (or else getcpu) gives it.
+  uint32_t  kind;  // TRACEBUF_FAULT, TRACEBUF_SYSCALL, TRACEBUF_ZERO_PAGE, TRACEBUF_SAME_FILLED or TRACEBUF_CAPTURE.
+  uint32_t  size;  // For an annotation, the page's compressed size, perhaps with TRACEBUF_CAPTURE_FILLED.
+} tracebuf_record_s;
+
+/**
+ * A fixed-size block of records, filled by one thread.  Once full (or once its thread exits), a chunk is sealed: it moves to the
+ * trace's list of chunks awaiting the next flush, and is never written again.  Flushes also write the records of a chunk that is
+ * still open, as they age, and count them in `flushed`, so that they are not written again.
+ */
+typedef struct tracebuf_chunk_struct {
+  struct tracebuf_chunk_struct* next;
+  volatile size_t               count;
+  size_t                        flushed;  // Records already written, by the holder of the flush lock.
+  uint64_t                      merged;   // The last flush to merge the chunk.
+  tracebuf_record_s             records[TRACEBUF_CHUNK_RECORDS];
+} tracebuf_chunk_s;
+
+/**
+ * One thread's stream.  Only its thread appends to it.  `oldest` is a bound on the time of the record that the thread is appending
+ * (`UINT64_MAX` when it is not appending); no record of this stream that a flush has not yet seen is older.  `spare` is the chunk
+ * that the stream opens when its open one fills, left there by the flushing thread, so that the SIGSEGV handler need not allocate
+ * one.  A closed stream has no open chunk; a flush then unlinks it, and frees it once no thread can be walking the list past it.
+ */
+typedef struct tracebuf_stream_struct {
+  struct tracebuf_stream_struct* volatile next;
+  struct tracebuf_stream_struct*          retired;  // The next stream unlinked and not yet freed, by the holder of the flush lock.
+  tracebuf_chunk_s* volatile              open;
+  tracebuf_chunk_s* volatile              spare;
+  volatile uint64_t                       oldest;
+  uint32_t                                tid;
+  volatile bool                           live;
+} tracebuf_stream_s;
+
+/**
+ * An entire trace.  Streams and sealed chunks are kept on lock-free lists.  A flush merges the sealed chunks and the open ones by
+ * time, and writes the records older than every live stream's `oldest`; younger records are held, already merged, for the next
+ * flush, so that the file is written in time order.  A final flush writes every record; `floor` is then the time of the youngest
+ * record written, plus one, and no older record is written again, should the trace go on (as when the exec () before which it was
+ * flushed fails).  Once the trace has ended, `fd` is -1, and flushes write nothing.
+ * `readers` counts the threads walking the streams without the flush lock (see `tracebuf_find()`); a stream that a flush unlinks
+ * while any may be on it is kept on `retired` until none is.
+ */
+typedef struct tracebuf_struct {
+  int                         fd;
+  tracebuf_stream_s* volatile streams;
+  tracebuf_stream_s*          retired;
+  volatile uint32_t           readers;
+  tracebuf_chunk_s* volatile  sealed;
+  volatile uint32_t           flush_lock;
+  volatile bool               running;  // Whether a thread flushes the trace (see `tracebuf_run()`).
+  tracebuf_record_s*          held;
+  size_t                      held_count;
+  size_t                      held_size;
+  uint64_t                    floor;
+  uint64_t                    flushes;  // Flushes so far.
+  volatile uint64_t           written;  // Bytes written to the file.
+  char                        out[TRACEBUF_OUT_SIZE];
+} tracebuf_s;
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* FUNCTIONS */
+
+void               tracebuf_create (tracebuf_s* trace, int fd);
+tracebuf_stream_s* tracebuf_open   (tracebuf_s* trace);
+tracebuf_stream_s* tracebuf_find   (tracebuf_s* trace, uint32_t tid);
+void               tracebuf_append (tracebuf_s* trace, tracebuf_stream_s* stream, uintptr_t page, uint32_t kind);
+void               tracebuf_annotate (tracebuf_s* trace, tracebuf_stream_s* stream, uintptr_t page, uint32_t size, uint64_t hash);
+void               tracebuf_close  (tracebuf_s* trace, tracebuf_stream_s* stream);
+void               tracebuf_flush  (tracebuf_s* trace, bool final);
+void*              tracebuf_run    (void* trace);
+void               tracebuf_end    (tracebuf_s* trace);
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#endif /* _TRACEBUF_H */
+/* =============================================================================================================================== */
@@ -1,10 +1,37 @@
 #include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "vmt_mman.h"
 
 
 
+// The first fit allocator, measured against the default.
+void* ff_malloc  (size_t size);
+void  ff_free    (void* ptr);
+void* ff_realloc (void* ptr, size_t size);
+
+
+
+// Whether to print each list operation.
+static bool verbose = false;
+
+
+
+// An allocator to measure.
+typedef struct allocator {
+  const char* name;
+  void*       (*malloc)  (size_t size);
+  void        (*free)    (void* ptr);
+  void*       (*realloc) (void* ptr, size_t size);
+} allocator_s;
+
+
+
 typedef struct link {
   int          value;
   struct link* next;
@@ -45,7 +72,9 @@ void insert (list_s* list, int value) {
   sentinel->next = link;
   list->length  += 1;
 
-  printf("insert:\tvalue = %d\tlink = %p\n", value, link);
+  if (verbose) {
+    printf("insert:\tvalue = %d\tlink = %p\n", value, link);
+  }
   
 } // insert ()
 
@@ -66,7 +95,9 @@ int delete (list_s* list, int index) {
   link_s* target = current->next;
   int     value  = target->value;
   current->next  = target->next;
-  printf("delete:\tvalue = %d\tlink = %p\n", value, target);
+  if (verbose) {
+    printf("delete:\tvalue = %d\tlink = %p\n", value, target);
+  }
   vmt_free(target);
   list->length -= 1;
 
@@ -76,10 +107,321 @@ int delete (list_s* list, int index) {
 
 
 
+uint64_t now_ns () {
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+} // now_ns ()
+
+
+
+// A block size: mostly small, as the manager's metadata is, with the odd page
+// or run of pages.  Each thread draws from its own random state.
+size_t random_size (unsigned int* state) {
+
+  int kind = rand_r(state) % 100;
+  if (kind < 80) {
+    return 8 + rand_r(state) % 248;
+  } else if (kind < 97) {
+    return 256 + rand_r(state) % 3840;
+  } else if (kind < 99) {
+    return 4096 + rand_r(state) % 61440;
+  } else {
+    return 65536 + rand_r(state) % 458752;
+  }
+
+} // random_size ()
+
+
+
+// Fill a block with a pattern that depends on its slot, or check that it still
+// holds the pattern.
+void stamp (uint8_t* block, size_t size, int slot) {
+
+  block[0]        = (uint8_t)slot;
+  block[size / 2] = (uint8_t)(slot >> 8);
+  block[size - 1] = (uint8_t)(slot ^ 0x5a);
+
+} // stamp ()
+
+
+
+bool stamped (uint8_t* block, size_t size, int slot) {
+
+  return (block[0]        == (uint8_t)slot        &&
+	  block[size / 2] == (uint8_t)(slot >> 8) &&
+	  block[size - 1] == (uint8_t)(slot ^ 0x5a));
+
+} // stamped ()
+
+
+
+// Allocate and free blocks of one size in pairs, as a thread's per-event
+// metadata is.  Report millions of pairs per second, the best of 5 rounds.
+double pairs (allocator_s* a, int ops, size_t size) {
+
+  uint64_t best = UINT64_MAX;
+  for (int round = 0; round < 5; ++round) {
+    uint64_t start = now_ns();
+    for (int op = 0; op < ops; ++op) {
+      void* block = a->malloc(size);
+      assert(block != NULL);
+      *(volatile char*)block = 1;
+      a->free(block);
+    }
+    uint64_t elapsed = now_ns() - start;
+    best = (elapsed < best) ? elapsed : best;
+  }
+  return (double)ops * 1000 / best;
+
+} // pairs ()
+
+
+
+// Keep a working set of blocks of random sizes, replacing one at random each
+// operation, and checking that each block kept its contents until freed.
+// Report millions of operations per second, and count the failed allocations.
+double churn (allocator_s* a, int ops, int slots, int seed, int* failures) {
+
+  uint8_t** blocks = calloc(slots, sizeof(uint8_t*));
+  size_t*   sizes  = calloc(slots, sizeof(size_t));
+  assert(blocks != NULL && sizes != NULL);
+
+  unsigned int state = seed;
+  *failures = 0;
+  uint64_t start = now_ns();
+  for (int op = 0; op < ops; ++op) {
+    int slot = rand_r(&state) % slots;
+    if (blocks[slot] != NULL) {
+      assert(stamped(blocks[slot], sizes[slot], slot));
+      a->free(blocks[slot]);
+    }
+    sizes[slot]  = random_size(&state);
+    blocks[slot] = a->malloc(sizes[slot]);
+    if (blocks[slot] == NULL) {
+      *failures += 1;
+    } else {
+      stamp(blocks[slot], sizes[slot], slot);
+    }
+  }
+  double rate = (double)ops * 1000 / (now_ns() - start);
+
+  for (int slot = 0; slot < slots; ++slot) {
+    if (blocks[slot] != NULL) {
+      assert(stamped(blocks[slot], sizes[slot], slot));
+      a->free(blocks[slot]);
+    }
+  }
+  free(sizes);
+  free(blocks);
+  return rate;
+
+} // churn ()
+
+
+
+// Grow blocks a little at a time, as a growing table is, and check that each
+// keeps its contents.  Report millions of reallocations per second, and how
+// many of them left the block in place.
+double growth (allocator_s* a, int ops, int slots, int* in_place) {
+
+  uint8_t** blocks = calloc(slots, sizeof(uint8_t*));
+  size_t*   sizes  = calloc(slots, sizeof(size_t));
+  assert(blocks != NULL && sizes != NULL);
+
+  *in_place = 0;
+  uint64_t start = now_ns();
+  for (int op = 0; op < ops; ++op) {
+    int slot = op % slots;
+    if (sizes[slot] >= 262144) {
+      a->free(blocks[slot]);
+      blocks[slot] = NULL;
+      sizes[slot]  = 0;
+    }
+    size_t   size  = sizes[slot] + 64 + random() % 1024;
+    uint8_t* block = a->realloc(blocks[slot], size);
+    assert(block != NULL);
+    if (blocks[slot] != NULL) {
+      assert(stamped(block, sizes[slot], slot));
+      *in_place += (block == blocks[slot]);
+    }
+    blocks[slot] = block;
+    sizes[slot]  = size;
+    stamp(block, size, slot);
+  }
+  double rate = (double)ops * 1000 / (now_ns() - start);
+
+  for (int slot = 0; slot < slots; ++slot) {
+    a->free(blocks[slot]);
+  }
+  free(sizes);
+  free(blocks);
+  return rate;
+
+} // growth ()
+
+
+
+// The number of threads in the threaded runs.
+#define THREADS 4
+
+// The number of blocks in flight between a producer and its consumer.
+#define RING 256
+
+
+
+// One thread's share of a threaded run.
+typedef struct worker {
+  allocator_s*     a;
+  int              ops;
+  int              seed;
+  int              failures;
+  uint8_t*         ring[RING];
+} worker_s;
+
+
+
+void* churn_worker (void* worker_ptr) {
+
+  worker_s* w = worker_ptr;
+  churn(w->a, w->ops, 1024, w->seed, &w->failures);
+  return NULL;
+
+} // churn_worker ()
+
+
+
+// Allocate blocks and pass them to a consumer, through a ring, to be freed.
+void* produce (void* worker_ptr) {
+
+  worker_s*    w     = worker_ptr;
+  unsigned int state = w->seed;
+  for (int op = 0; op < w->ops; ++op) {
+    while (__atomic_load_n(&w->ring[op % RING], __ATOMIC_ACQUIRE) != NULL) {
+      sched_yield();
+    }
+    size_t   size  = 8 + rand_r(&state) % 248;
+    uint8_t* block = w->a->malloc(size);
+    assert(block != NULL);
+    block[0]        = (uint8_t)op;
+    block[size - 1] = (uint8_t)op;
+    __atomic_store_n(&w->ring[op % RING], block, __ATOMIC_RELEASE);
+  }
+  return NULL;
+
+} // produce ()
+
+
+
+void consume (worker_s* w) {
+
+  for (int op = 0; op < w->ops; ++op) {
+    uint8_t* block;
+    while ((block = __atomic_load_n(&w->ring[op % RING], __ATOMIC_ACQUIRE)) == NULL) {
+      sched_yield();
+    }
+    assert(block[0] == (uint8_t)op);
+    __atomic_store_n(&w->ring[op % RING], NULL, __ATOMIC_RELEASE);
+    w->a->free(block);
+  }
+
+} // consume ()
+
+
+
+void* consume_worker (void* worker_ptr) {
+
+  consume(worker_ptr);
+  return NULL;
+
+} // consume_worker ()
+
+
+
+// Run `THREADS` threads at once, either each churning its own working set, or
+// in pairs of a producer and a consumer that frees what the producer
+// allocates.  Report millions of operations per second, over all threads.
+double threaded (allocator_s* a, int ops, int seed, bool remote, int* failures) {
+
+  worker_s* workers = calloc(THREADS, sizeof(worker_s));
+  pthread_t threads[THREADS];
+  assert(workers != NULL);
+
+  uint64_t start = now_ns();
+  for (int t = 0; t < THREADS; ++t) {
+    workers[t].a    = a;
+    workers[t].ops  = ops;
+    workers[t].seed = seed + t;
+    void* (*start_routine) (void*) = churn_worker;
+    if (remote) {
+      start_routine = (t % 2 == 0) ? produce : consume_worker;
+    }
+    worker_s* w = remote ? &workers[t - t % 2] : &workers[t];
+    pthread_create(&threads[t], NULL, start_routine, w);
+  }
+  *failures = 0;
+  for (int t = 0; t < THREADS; ++t) {
+    pthread_join(threads[t], NULL);
+    *failures += workers[t].failures;
+  }
+  double rate = (double)ops * (remote ? THREADS / 2 : THREADS) * 1000 / (now_ns() - start);
+
+  free(workers);
+  return rate;
+
+} // threaded ()
+
+
+
+void benchmark (int ops, int seed) {
+
+  allocator_s allocators[] = {
+    { "sf",   vmt_malloc, vmt_free, vmt_realloc },
+    { "ff",   ff_malloc,  ff_free,  ff_realloc  },
+    { "libc", malloc,     free,     realloc     }
+  };
+
+  printf("\n%-6s %12s %12s %12s %14s %14s\n",
+	 "", "pairs 32 B", "pairs 200 B", "churn", "realloc", "in place");
+  for (size_t i = 0; i < sizeof(allocators) / sizeof(allocator_s); ++i) {
+    allocator_s* a = &allocators[i];
+    int failures, in_place;
+    double small  = pairs(a, ops, 32);
+    double medium = pairs(a, ops, 200);
+    double mixed  = churn(a, ops, 4096, seed, &failures);
+    double grown  = growth(a, ops / 4, 64, &in_place);
+    printf("%-6s %8.2f M/s %8.2f M/s %8.2f M/s %10.2f M/s %13.1f%%",
+	   a->name, small, medium, mixed, grown, 100.0 * in_place / (ops / 4));
+    if (failures > 0) {
+      printf("  (%d allocations failed)", failures);
+    }
+    printf("\n");
+  }
+
+  // The first fit allocator is not safe for threads.
+  printf("\n%-6s %18s %18s\n", "", "churn, 4 threads", "remote frees");
+  for (size_t i = 0; i < sizeof(allocators) / sizeof(allocator_s); ++i) {
+    allocator_s* a = &allocators[i];
+    int failures;
+    if (a->malloc == ff_malloc) {
+      continue;
+    }
+    double mixed  = threaded(a, ops, seed, false, &failures);
+    double remote = threaded(a, ops, seed, true, &failures);
+    printf("%-6s %14.2f M/s %14.2f M/s\n", a->name, mixed, remote);
+  }
+  printf("sf footprint after the runs: %zu KB\n", vmt_footprint() / 1024);
+
+} // benchmark ()
+
+
+
 void usage_and_exit (char* invocation)
 {
 
-  fprintf(stderr, "USAGE: %s <# ops> [ <seed> ]\n", invocation);
+  fprintf(stderr, "USAGE: %s [ -v ] <# ops> [ <seed> ]\n", invocation);
   exit(1);
   
 } // usage_and_exit ()
@@ -90,11 +432,17 @@ int main (int argc, char** argv)
 {
 
   // Parse command line args.  Set the random seed, if requested.
+  if (argc >= 2 && strcmp(argv[1], "-v") == 0) {
+    verbose  = true;
+    argv    += 1;
+    argc    -= 1;
+  }
   if (! (2 <= argc && argc <= 3) ) usage_and_exit(argv[0]);
   int ops = atoi(argv[1]);
   if (ops <= 0) usage_and_exit(argv[0]);
+  int seed = 1;
   if (argc == 3) {
-    int seed = atoi(argv[2]);
+    seed = atoi(argv[2]);
     if (seed == 0) usage_and_exit(argv[0]);
     srandom(seed);
   }
@@ -132,6 +480,8 @@ int main (int argc, char** argv)
   assert(big_buffer != NULL);
   printf("big_buffer = %p\n", big_buffer);
   vmt_free(big_buffer);
+
+  benchmark(ops, seed);
   
   return 0;
    
@@ -14,12 +14,18 @@
 // =============================================================================
 // INCLUDES
 
+#define _GNU_SOURCE // for `mremap()`
+
 #include <errno.h>   // errno used by perror()
 #include <stdbool.h> // true & false
+#include <stdint.h>  // uintptr_t
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>   // memset
 #include <sys/mman.h> // mmap() & munmap()
+#include <sys/prctl.h> // PR_SET_VMA
+#include <sys/syscall.h> // SYS_mmap, SYS_munmap, SYS_mremap & SYS_prctl
+#include <unistd.h>   // sysconf()
 
 #include "safeio.h"   // DEBUG() & ERROR()
 #include "vmt_mman.h"
@@ -41,8 +47,22 @@
 /** The virtual address space reserved for the heap. */
 #define HEAP_SIZE MB(64)
 
-/** The size of a single page on this system. */
-#define PAGE_SIZE sysconf(_SC_PAGESIZE)
+/** The size of a single page on this system, as `vmt_cache_page_size()` read it. */
+#define PAGE_SIZE vmt_page_size
+
+/** The size of the inaccessible guard on either side of each mapped region. */
+#define GUARD_SIZE PAGE_SIZE
+
+/** For mapping only where nothing is mapped yet, where the headers predate it (Linux 4.17). */
+#if !defined (MAP_FIXED_NOREPLACE)
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+/** For naming anonymous regions, where the headers predate it (Linux 5.17). */
+#if !defined (PR_SET_VMA)
+#define PR_SET_VMA           0x53564d41
+#define PR_SET_VMA_ANON_NAME 0
+#endif
 
 /** Whether to emit debugging message. */
 #define VMT_DEBUG true
@@ -138,29 +158,143 @@ static header_s* free_list_head      = NULL;
 
 /** The head of the allocated list. */
 static header_s* allocated_list_head = NULL;
+
+/** The bytes mapped for large blocks, outside the heap. */
+static size_t large_bytes = 0;
+
+/** The size of a page, read once, as the allocator is loaded. */
+static size_t vmt_page_size = 0;
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief Read the page size once, as the allocator is loaded, so that neither
+ *        the allocators nor the manager's signal handlers, which may allocate,
+ *        call `sysconf()`.
+ */
+__attribute__((constructor))
+static void vmt_cache_page_size ()
+{
+
+  vmt_page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+} // vmt_cache_page_size ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Make a system call with the `syscall` instruction, and nothing of
+ *         libc, whose wrappers may not be safe in a signal handler.  The
+ *         mapping calls below are made this way, since a handler that finds no
+ *         block at hand maps one.
+ * \param  nr The number of the system call.
+ * \return The result of the call, as libc's wrapper gives it: `-1`, with
+ *         `errno` set, on failure.
+ */
+static long vmt_raw_syscall (long nr, long arg1, long arg2, long arg3, long arg4, long arg5, long arg6)
+{
+
+  register long r10 __asm__ ("r10") = arg4;
+  register long r8  __asm__ ("r8")  = arg5;
+  register long r9  __asm__ ("r9")  = arg6;
+  long          result;
+  __asm__ volatile ("syscall"
+		    : "=a" (result)
+		    : "a" (nr), "D" (arg1), "S" (arg2), "d" (arg3), "r" (r10), "r" (r8), "r" (r9)
+		    : "rcx", "r11", "memory");
+  if (result < 0 && result > -4096) {
+    errno = (int)-result;
+    return -1;
+  }
+  return result;
+
+} // vmt_raw_syscall ()
+
+static void* sys_mmap (void* addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+
+  long result = vmt_raw_syscall(SYS_mmap, (long)addr, (long)length, prot, flags, fd, offset);
+  return (result == -1) ? MAP_FAILED : (void*)result;
+
+} // sys_mmap ()
+
+static int sys_munmap (void* addr, size_t length)
+{
+
+  return (int)vmt_raw_syscall(SYS_munmap, (long)addr, (long)length, 0, 0, 0, 0);
+
+} // sys_munmap ()
+
+static void* sys_mremap (void* old_addr, size_t old_size, size_t new_size, int flags, void* new_addr)
+{
+
+  long result = vmt_raw_syscall(SYS_mremap, (long)old_addr, (long)old_size, (long)new_size, flags, (long)new_addr, 0);
+  return (result == -1) ? MAP_FAILED : (void*)result;
+
+} // sys_mremap ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief Name a region `VMT_REGION_NAME` in `/proc/<pid>/maps`, so that
+ *        VMTrace, and whoever reads the maps, can tell it from the program's.
+ *        Kernels without names for anonymous regions leave it unnamed.
+ * \param ptr  The start of the region.
+ * \param size Its size.
+ */
+static void vmt_name_region (void* ptr, size_t size)
+{
+
+  vmt_raw_syscall(SYS_prctl, PR_SET_VMA, PR_SET_VMA_ANON_NAME, (long)ptr, (long)size, (long)VMT_REGION_NAME, 0);
+
+} // vmt_name_region ()
 // =============================================================================
 
 
 
 // =============================================================================
 /**
- * \brief  Allocate a block by mapping its own private region.
- * \param  size The number of bytes to allocate.
+ * \brief  Allocate a block by mapping its own private region, between two
+ *         guard pages that no access is allowed to, so that running off either
+ *         end of it faults at once rather than landing in other memory.
+ * \param  size The number of bytes to allocate; a multiple of the page size.
  * \return A pointer to the mapped space; `NULL` if the mapping fails.
  */
 static void* ff_map_region (size_t size)
 {
 
-  // Allocate virtual address space in which the heap will reside. Make it
-  // un-shared and not backed by any file (_anonymous_ space).
-  void* region_ptr = mmap(NULL,
-			  HEAP_SIZE,
-			  PROT_READ | PROT_WRITE,
-			  MAP_PRIVATE | MAP_ANONYMOUS,
-			  -1,
-			  0);
+  // Reserve the region and its guards, inaccessible, then map the space
+  // between the guards over them.  It is un-shared and not backed by any file
+  // (_anonymous_ space).
+  char* reserved = sys_mmap(NULL,
+			    size + 2 * GUARD_SIZE,
+			    PROT_NONE,
+			    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+			    -1,
+			    0);
+  if (reserved == MAP_FAILED) {
+    return NULL;
+  }
+
+  void* region_ptr = sys_mmap(reserved + GUARD_SIZE,
+			      size,
+			      PROT_READ | PROT_WRITE,
+			      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+			      -1,
+			      0);
+  if (region_ptr == MAP_FAILED) {
+    sys_munmap(reserved, size + 2 * GUARD_SIZE);
+    return NULL;
+  }
+  vmt_name_region(reserved, size + 2 * GUARD_SIZE);
   
-  return (region_ptr == MAP_FAILED) ? NULL : region_ptr;
+  return region_ptr;
   
 } // ff_map_region ()
 // =============================================================================
@@ -171,7 +305,7 @@ static void* ff_map_region (size_t size)
 static void ff_unmap_region (void* ptr, size_t size)
 {
 
-  if (munmap(ptr, size) == -1) {
+  if (sys_munmap((char*)ptr - GUARD_SIZE, size + 2 * GUARD_SIZE) == -1) {
     perror("Failed munmap() of region");
   }
   
@@ -180,6 +314,144 @@ static void ff_unmap_region (void* ptr, size_t size)
 
 
 
+// =============================================================================
+/**
+ * \brief  Resize a region that `ff_map_region()` mapped, in place.  A region
+ *         shrinks by turning the page past its new end into its guard, and
+ *         unmapping the rest.  It grows if the address space past its guard is
+ *         free: that is claimed, inaccessible (with `MAP_FIXED_NOREPLACE`, so
+ *         that no other mapping is replaced, nor another thread's claim raced),
+ *         and the old guard and the claim but for its last page, which is the
+ *         new guard, are mapped over.  `mremap()` without `MREMAP_MAYMOVE`
+ *         cannot grow it, as the guard is in its way.
+ * \param  ptr      The region.
+ * \param  old_size Its size.
+ * \param  new_size The new size; a multiple of the page size.
+ * \return Whether the region has the new size; if not, it is left as it was.
+ */
+static bool ff_resize_region (void* ptr, size_t old_size, size_t new_size)
+{
+
+  char* region = ptr;
+  if (new_size == old_size) {
+    return true;
+  }
+
+  if (new_size < old_size) {
+    if (sys_mmap(region + new_size,
+		 GUARD_SIZE,
+		 PROT_NONE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+		 -1,
+		 0) == MAP_FAILED) {
+      return false;
+    }
+    sys_munmap(region + new_size + GUARD_SIZE, old_size - new_size);
+    return true;
+  }
+
+  // Kernels that predate `MAP_FIXED_NOREPLACE` take the address as a hint, and
+  // may map elsewhere.
+  char* claim = sys_mmap(region + old_size + GUARD_SIZE,
+			 new_size - old_size,
+			 PROT_NONE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE,
+			 -1,
+			 0);
+  if (claim == MAP_FAILED) {
+    return false;
+  }
+  if (claim != region + old_size + GUARD_SIZE ||
+      sys_mmap(region + old_size,
+	       new_size - old_size,
+	       PROT_READ | PROT_WRITE,
+	       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+	       -1,
+	       0) == MAP_FAILED) {
+    sys_munmap(claim, new_size - old_size);
+    return false;
+  }
+  vmt_name_region(region + old_size, new_size - old_size + GUARD_SIZE);
+  return true;
+
+} // ff_resize_region ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Resize a region that `ff_map_region()` mapped, where it cannot be
+ *         resized in place: its pages are moved, without copying, into a new
+ *         region of the new size, and the old region is unmapped.
+ * \param  ptr      The region.
+ * \param  old_size Its size.
+ * \param  new_size The new size; a multiple of the page size.
+ * \return A pointer to the new region; `NULL` if it cannot be mapped, in which
+ *         case the old region is left as it was.
+ */
+static void* ff_remap_region (void* ptr, size_t old_size, size_t new_size)
+{
+
+  void* region_ptr = ff_map_region(new_size);
+  if (region_ptr == NULL) {
+    return NULL;
+  }
+
+  size_t kept = (old_size < new_size) ? old_size : new_size;
+  if (sys_mremap(ptr, kept, kept, MREMAP_MAYMOVE | MREMAP_FIXED, region_ptr) == MAP_FAILED) {
+    ff_unmap_region(region_ptr, new_size);
+    return NULL;
+  }
+  ff_unmap_region(ptr, old_size);
+
+  return region_ptr;
+
+} // ff_remap_region ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Map, or unmap, a run of pages, without guards.  Runs hold the pages
+ *         of the pool of compressed pages, mapped by the thousand, where a pair
+ *         of guards apiece would make each run a mapping of its own, and soon
+ *         exhaust the mappings that a process may have; the pool keeps its
+ *         objects within their runs.
+ * \param  size The size of the run; a multiple of the page size.
+ * \return A pointer to the run; `NULL` if the mapping fails.
+ */
+static void* ff_map_run (size_t size)
+{
+
+  void* run_ptr = sys_mmap(NULL,
+		           size,
+		           PROT_READ | PROT_WRITE,
+		           MAP_PRIVATE | MAP_ANONYMOUS,
+		           -1,
+		           0);
+  if (run_ptr == MAP_FAILED) {
+    return NULL;
+  }
+  vmt_name_region(run_ptr, size);
+
+  return run_ptr;
+
+} // ff_map_run ()
+
+static void ff_unmap_run (void* ptr, size_t size)
+{
+
+  if (sys_munmap(ptr, size) == -1) {
+    perror("Failed munmap() of run");
+  }
+
+} // ff_unmap_run ()
+// =============================================================================
+
+
+
 // =============================================================================
 /**
  * \brief Initialize the allocator by mmap'ing a private heap to manage.
@@ -193,7 +465,7 @@ void ff_init ()
     // Map a space to serve as the private heap to be managed.  Failure here is
     // fatal.
     void* heap = ff_map_region(HEAP_SIZE);
-    if (heap == MAP_FAILED) {
+    if (heap == NULL) {
       ERROR("Could not map heap region");
     }
 
@@ -239,7 +511,11 @@ void* ff_malloc (size_t size)
     size_t    block_size  = size + header_size;
     size_t    total_size  = block_size + PAGE_PAD(block_size);
     header_s* header_ptr  = ff_map_region(total_size);
+    if (header_ptr == NULL) {
+      return NULL;
+    }
     void*     region      = (void*)(header_ptr + 1);
+    large_bytes          += total_size;
 
     // Note that for large blocks, we store the total size in the header so that
     // we can properly unmap the space when it is freed.
@@ -354,6 +630,7 @@ void ff_free (void* ptr) {
 
   // Is this a large block that was allocated in its own mapped space?
   if (GET_FLAG(header_ptr, HEADER_LARGE)) {
+    large_bytes -= header_ptr->size;
     ff_unmap_region(header_ptr, header_ptr->size);
     return;
   }
@@ -425,7 +702,7 @@ void* ff_calloc (size_t nmemb, size_t size)
  * \return     A pointer to the resultant block, which may be `ptr` itself, or
  *             may be a newly allocated block.
  */
-void* realloc (void* ptr, size_t size) {
+void* ff_realloc (void* ptr, size_t size) {
 
   // Special case: If there is no original block, then just allocate the new one
   // of the given size.
@@ -439,19 +716,24 @@ void* realloc (void* ptr, size_t size) {
     return NULL;
   }
 
-  // Get the current block size from its header.
+  // Get the current block size from its header.  A large block's header holds
+  // the size of its whole region, header included.
   header_s* header_ptr = BLOCK_TO_HEADER(ptr);
+  size_t    block_size = header_ptr->size;
+  if (GET_FLAG(header_ptr, HEADER_LARGE)) {
+    block_size -= sizeof(header_s);
+  }
 
   // If the new size isn't an increase, then just return the original block as-is.
-  if (size <= header_ptr->size) {
+  if (size <= block_size) {
     return ptr;
   }
 
   // The new size is an increase.  Allocate the new, larger block, copy the
   // contents of the old into it, and free the old.
-  void* new_block_ptr = malloc(size);
+  void* new_block_ptr = ff_malloc(size);
   if (new_block_ptr != NULL) {
-    memcpy(new_block_ptr, ptr, header_ptr->size);
+    memcpy(new_block_ptr, ptr, block_size);
     ff_free(ptr);
   }
     
@@ -459,3 +741,1113 @@ void* realloc (void* ptr, size_t size) {
   
 } // ff_realloc()
 // ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Report the memory that the allocator holds: the part of the heap that has
+ * been handed out at some point (free blocks included), and the regions mapped
+ * for large blocks.
+ *
+ * \return The number of bytes.
+ */
+size_t ff_footprint ()
+{
+
+  return (size_t)(free_addr - start_addr) + large_bytes;
+
+} // ff_footprint ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Map a run of whole pages, outside the heap, for callers that manage memory
+ * a page at a time (such as the pool of compressed pages).  Unlike a large
+ * block, the run has no header, so it starts on a page boundary and takes no
+ * more pages than asked for, nor guard pages.
+ *
+ * \param pages The number of pages.
+ * \return      A pointer to the first page, if successful; `NULL` if not.
+ */
+void* ff_map_pages (size_t pages)
+{
+
+  void* region = ff_map_run(pages * PAGE_SIZE);
+  if (region != NULL) {
+    large_bytes += pages * PAGE_SIZE;
+  }
+  return region;
+
+} // ff_map_pages ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Unmap a run of pages that `ff_map_pages()` mapped.
+ *
+ * \param ptr   A pointer to the first page.
+ * \param pages The number of pages.
+ */
+void ff_unmap_pages (void* ptr, size_t pages)
+{
+
+  large_bytes -= pages * PAGE_SIZE;
+  ff_unmap_run(ptr, pages * PAGE_SIZE);
+
+} // ff_unmap_pages ()
+// ==============================================================================
+
+
+
+
+
+
+// ==============================================================================
+/**
+ * Nothing to do in the child of a `fork()`, or as a thread exits: this
+ * allocator takes no lock, and keeps nothing per thread.
+ */
+void ff_fork_child ()
+{
+
+} // ff_fork_child ()
+
+void ff_thread_exit ()
+{
+
+} // ff_thread_exit ()
+// ==============================================================================
+
+
+
+// =============================================================================
+/*******************************************************************************
+ * SEGREGATED FIT
+ *
+ * The heap is carved into _chunks_, each led by a two-word header: the size of
+ * the chunk before it (valid only while that chunk is free) and its own size,
+ * whose low bits hold flags.  The chunk's block follows the header.
+ *
+ * - Small chunks (up to `SF_SMALL_MAX` bytes) are kept, once freed, in one list
+ *   per 16-byte size class, and handed out again as they are; both take O(1).
+ *   They stay marked _in use_, so that they are never coalesced.
+ *
+ * - Larger chunks are coalesced with their free neighbours when freed, using
+ *   the sizes in the headers, and kept in bins of 4 per power of two (which
+ *   also take the small remainders of splitting them).  A bitmap
+ *   of the bins that are not empty finds the smallest that must fit a request
+ *   in one step.  What is left of a chunk after an allocation goes back to the
+ *   bins.
+ *
+ * - Chunks that no bin can serve are split off the _top_ of the heap, the part
+ *   never yet used.  Blocks of `SF_MAP_THRESHOLD` bytes or more are mapped on
+ *   their own, taking only the pages they need, and unmapped when freed.
+ *
+ * Each thread has an _arena_ of its own, holding all of the above, so that no
+ * operation takes a lock.  An arena's heap is a series of _segments_, aligned
+ * blocks of `SF_SEGMENT_SIZE` bytes handed out, in order, from one reserved
+ * region; each segment starts with a pointer to the arena that owns it.  A
+ * block freed by a thread other than its owner is pushed onto the owner's
+ * _remote_ stack, with one compare-and-swap, and the owner frees it for real
+ * at its next allocation, taking the whole stack at once.  A thread's first
+ * allocation adopts an arena left by a thread that has exited, if there is one,
+ * and otherwise makes one in a new segment.
+ *
+ * Nothing here takes a lock or calls more than `mmap()`, so that the signal
+ * handlers of the manager may allocate.  A handler that interrupts its thread
+ * in the middle of an operation on the arena maps what it allocates on its own,
+ * and defers what it frees to the remote stack.
+ ******************************************************************************/
+// =============================================================================
+
+
+
+// =============================================================================
+// SEGREGATED FIT: MACROS AND CONSTANTS
+
+/** The virtual address space reserved for the heap; used only as it is needed. */
+#define SF_HEAP_SIZE GB(4)
+
+/** The size, and the alignment, of a segment. */
+#define SF_SEGMENT_SIZE MB(1)
+
+/** The room taken at the start of a segment by the pointer to its arena. */
+#define SF_SEGMENT_HEADER SF_ALIGN
+
+/** The alignment of every chunk and block, and the granularity of sizes. */
+#define SF_ALIGN 16
+
+/** The smallest chunk: a header and a free chunk's two list pointers. */
+#define SF_MIN_CHUNK 32
+
+/** The largest small chunk. */
+#define SF_SMALL_MAX 1024
+
+/** The number of small size classes: one per `SF_ALIGN` bytes. */
+#define SF_SMALL_CLASSES (SF_SMALL_MAX / SF_ALIGN)
+
+/** The size of the smallest chunk that is mapped on its own. */
+#define SF_MAP_THRESHOLD KB(128)
+
+/** The number of bins for free chunks: 4 per power of two. */
+#define SF_BINS 52
+
+/** The flags in a chunk's size: in use, the previous chunk in use, mapped. */
+#define SF_INUSE      1
+#define SF_PREV_INUSE 2
+#define SF_MAPPED     4
+#define SF_FLAGS      (SF_ALIGN - 1)
+
+/** The size of a chunk, without its flags. */
+#define SF_SIZE(cp) ((cp)->head & ~(size_t)SF_FLAGS)
+
+/** The chunk at a given offset from another. */
+#define SF_AT(cp,offset) ((sf_chunk_s*)((uintptr_t)(cp) + (offset)))
+
+/** Given a pointer to a chunk, obtain a `void*` pointer to its block. */
+#define SF_CHUNK_TO_BLOCK(cp) ((void*)((uintptr_t)(cp) + SF_HEADER_SIZE))
+
+/** Given a pointer to a block, obtain a `sf_chunk_s*` pointer to its chunk. */
+#define SF_BLOCK_TO_CHUNK(bp) ((sf_chunk_s*)((uintptr_t)(bp) - SF_HEADER_SIZE))
+
+/** The size of a chunk's header. */
+#define SF_HEADER_SIZE (2 * sizeof(size_t))
+
+/** The segment that holds a chunk. */
+#define SF_SEGMENT(cp) ((uintptr_t)(cp) & ~(uintptr_t)(SF_SEGMENT_SIZE - 1))
+
+/** The arena that owns the segment that holds a chunk. */
+#define SF_OWNER(cp) (*(sf_arena_s**)SF_SEGMENT(cp))
+// =============================================================================
+
+
+
+// =============================================================================
+// SEGREGATED FIT: TYPES AND STRUCTURES
+
+/**
+ * A chunk.  The list pointers overlay the block, and so exist only while the
+ * chunk is free.
+ */
+typedef struct sf_chunk {
+
+  /** The size of the previous chunk, if that chunk is free. */
+  size_t           prev_size;
+
+  /** The size of this chunk, header included, and its flags. */
+  size_t           head;
+
+  /** The next and previous chunks in its free list. */
+  struct sf_chunk* next;
+  struct sf_chunk* prev;
+
+} sf_chunk_s;
+
+
+
+/**
+ * A thread's arena.  It lives in its first segment, just after the segment's
+ * header, so that its segment's number identifies it.
+ */
+typedef struct sf_arena {
+
+  /** The free small chunks, one singly linked list per size class. */
+  sf_chunk_s*          small[SF_SMALL_CLASSES];
+
+  /** The bins of larger free chunks, and which of them hold any. */
+  sf_chunk_s*          bins[SF_BINS];
+  uint64_t             bin_map;
+
+  /** The chunk at the top of the current segment, which no bin holds. */
+  sf_chunk_s*          top;
+
+  /** The bytes of the segments before the current one. */
+  size_t               retired_bytes;
+
+  /** Whether the owning thread is in the middle of an operation on it. */
+  volatile int         busy;
+
+  /** The blocks freed by other threads, linked through `next`. */
+  sf_chunk_s* volatile remote;
+
+  /** The number of the next abandoned arena, plus one; 0 for none. */
+  uint32_t             next_abandoned;
+
+  /** The next arena made, for reporting the footprint. */
+  struct sf_arena*     next_arena;
+
+} sf_arena_s;
+// =============================================================================
+
+
+
+// =============================================================================
+// SEGREGATED FIT: GLOBALS
+
+/** The beginning of the heap, aligned to a segment; 0 until reserved. */
+static volatile uintptr_t sf_start = 0;
+
+/** The number of segments handed out. */
+static volatile size_t sf_segments = 0;
+
+/**
+ * The arenas abandoned by threads that have exited, as a stack: the number of
+ * the top arena's segment plus one in the low 32 bits, and a count of the pops
+ * in the high 32 bits, so that a pop that raced with others fails.
+ */
+static volatile uint64_t sf_abandoned = 0;
+
+/** The arenas made, as a list. */
+static sf_arena_s* volatile sf_arenas = NULL;
+
+/** The bytes mapped outside the heap, for large blocks and runs of pages. */
+static volatile size_t sf_mapped_bytes = 0;
+
+/** The calling thread's arena. */
+static __thread sf_arena_s* sf_thread_arena __attribute__((tls_model("initial-exec"))) = NULL;
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  The size of the chunk that holds a block of a given size.
+ * \param  size The size of the block.
+ * \return The chunk size; 0 if `size` is too large to represent.
+ */
+static size_t sf_chunk_size (size_t size)
+{
+
+  if (size > SIZE_MAX - SF_HEADER_SIZE - SF_ALIGN) {
+    return 0;
+  }
+  size_t chunk_size = (size + SF_HEADER_SIZE + SF_ALIGN - 1) & ~(size_t)(SF_ALIGN - 1);
+  return (chunk_size < SF_MIN_CHUNK) ? SF_MIN_CHUNK : chunk_size;
+
+} // sf_chunk_size ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  The bin for a free chunk of a given size: 4 bins for each power of
+ *         two, starting at `SF_MIN_CHUNK`.  Chunks too large for the last bin,
+ *         which only coalescing makes, go in it all the same.
+ * \param  size The chunk size.
+ * \return The bin's index.
+ */
+static int sf_bin_index (size_t size)
+{
+
+  int log2 = 63 - __builtin_clzl(size);
+  int bin  = (log2 - 5) * 4 + (int)((size >> (log2 - 2)) & 3);
+  return (bin < SF_BINS) ? bin : SF_BINS - 1;
+
+} // sf_bin_index ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief Insert a free chunk into, or remove it from, its bin.
+ */
+static void sf_bin_insert (sf_arena_s* arena, sf_chunk_s* chunk)
+{
+
+  int bin     = sf_bin_index(SF_SIZE(chunk));
+  chunk->prev = NULL;
+  chunk->next = arena->bins[bin];
+  if (chunk->next != NULL) {
+    chunk->next->prev = chunk;
+  }
+  arena->bins[bin] = chunk;
+  arena->bin_map  |= (uint64_t)1 << bin;
+
+} // sf_bin_insert ()
+
+static void sf_bin_remove (sf_arena_s* arena, sf_chunk_s* chunk)
+{
+
+  int bin = sf_bin_index(SF_SIZE(chunk));
+  if (chunk->prev == NULL) {
+    arena->bins[bin]  = chunk->next;
+  } else {
+    chunk->prev->next = chunk->next;
+  }
+  if (chunk->next != NULL) {
+    chunk->next->prev = chunk->prev;
+  }
+  if (arena->bins[bin] == NULL) {
+    arena->bin_map &= ~((uint64_t)1 << bin);
+  }
+
+} // sf_bin_remove ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief Mark a chunk in use, and say so in the header of the chunk after it.
+ */
+static void sf_set_inuse (sf_chunk_s* chunk, size_t size)
+{
+
+  chunk->head = size | SF_INUSE | (chunk->head & SF_PREV_INUSE);
+  SF_AT(chunk, size)->head |= SF_PREV_INUSE;
+
+} // sf_set_inuse ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief Add a free chunk to the arena's free space: coalesce it with the free
+ *        chunks on either side, or with the top, and bin what results.
+ * \param arena The arena that owns the chunk.
+ * \param chunk The chunk, whose header gives its size and whether the chunk
+ *              before it is in use.
+ */
+static void sf_release (sf_arena_s* arena, sf_chunk_s* chunk)
+{
+
+  size_t size = SF_SIZE(chunk);
+
+  // Coalesce with the chunk before, if it is free.
+  if ((chunk->head & SF_PREV_INUSE) == 0) {
+    sf_chunk_s* prev = SF_AT(chunk, -(intptr_t)chunk->prev_size);
+    sf_bin_remove(arena, prev);
+    size  += SF_SIZE(prev);
+    chunk  = prev;
+  }
+
+  // Coalesce with the top, or with the chunk after, if it is free.  The chunk
+  // that closes each segment is always in use, so neither crosses its end.
+  sf_chunk_s* next = SF_AT(chunk, size);
+  if (next == arena->top) {
+    arena->top       = chunk;
+    arena->top->head = (size + SF_SIZE(next)) | SF_PREV_INUSE;
+    return;
+  }
+  if ((next->head & SF_INUSE) == 0) {
+    sf_bin_remove(arena, next);
+    size += SF_SIZE(next);
+    next  = SF_AT(chunk, size);
+  }
+
+  chunk->head     = size | SF_PREV_INUSE;
+  next->prev_size = size;
+  next->head     &= ~(size_t)SF_PREV_INUSE;
+  sf_bin_insert(arena, chunk);
+
+} // sf_release ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief Trim an in-use chunk to a given size, releasing the rest, if the rest
+ *        is large enough to be a chunk.
+ */
+static void sf_trim (sf_arena_s* arena, sf_chunk_s* chunk, size_t size)
+{
+
+  size_t rest = SF_SIZE(chunk) - size;
+  if (rest >= SF_MIN_CHUNK) {
+    chunk->head = size | (chunk->head & SF_FLAGS);
+    sf_chunk_s* remainder = SF_AT(chunk, size);
+    remainder->head = rest | SF_PREV_INUSE;
+    sf_release(arena, remainder);
+  }
+
+} // sf_trim ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief Free a chunk of the arena's: onto the list of its size class if it is
+ *        small, and into the arena's free space otherwise.
+ */
+static void sf_free_local (sf_arena_s* arena, sf_chunk_s* chunk)
+{
+
+  size_t size = SF_SIZE(chunk);
+  if (size <= SF_SMALL_MAX) {
+    int size_class           = size / SF_ALIGN - 1;
+    chunk->next              = arena->small[size_class];
+    arena->small[size_class] = chunk;
+  } else {
+    sf_release(arena, chunk);
+  }
+
+} // sf_free_local ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief Push a chunk onto the remote stack of the arena that owns it.  Many
+ *        threads may push at once, and a signal handler may push in the middle
+ *        of another push; only the owner pops, and takes the whole stack.
+ */
+static void sf_free_remote (sf_arena_s* owner, sf_chunk_s* chunk)
+{
+
+  sf_chunk_s* head = __atomic_load_n(&owner->remote, __ATOMIC_RELAXED);
+  do {
+    chunk->next = head;
+  } while (!__atomic_compare_exchange_n(&owner->remote, &head, chunk, true,
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+} // sf_free_remote ()
+
+
+
+/**
+ * \brief Free, for real, the chunks that other threads have freed.
+ */
+static void sf_drain_remote (sf_arena_s* arena)
+{
+
+  sf_chunk_s* chunk = __atomic_exchange_n(&arena->remote, NULL, __ATOMIC_ACQUIRE);
+  while (chunk != NULL) {
+    sf_chunk_s* next = chunk->next;
+    sf_free_local(arena, chunk);
+    chunk = next;
+  }
+
+} // sf_drain_remote ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Hand out the next segment of the heap, reserving the heap the first
+ *         time.  Two threads that reserve it at once both map a region; one
+ *         keeps its region, and the other unmaps its own.
+ * \return The segment; 0 if the heap is exhausted or cannot be reserved.
+ */
+static uintptr_t sf_take_segment ()
+{
+
+  uintptr_t start = __atomic_load_n(&sf_start, __ATOMIC_ACQUIRE);
+  if (start == 0) {
+
+    // Reserve a segment more than needed, to align the heap to a segment, and
+    // a guard on either side, inaccessible; then map the heap between them.
+    size_t reserved = SF_HEAP_SIZE + SF_SEGMENT_SIZE + 2 * GUARD_SIZE;
+    void*  heap     = sys_mmap(NULL,
+			       reserved,
+			       PROT_NONE,
+			       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+			       -1,
+			       0);
+    if (heap == MAP_FAILED) {
+      return 0;
+    }
+    uintptr_t aligned = ((uintptr_t)heap + GUARD_SIZE + SF_SEGMENT_SIZE - 1) & ~(uintptr_t)(SF_SEGMENT_SIZE - 1);
+    if (sys_mmap((void*)aligned,
+	         SF_HEAP_SIZE,
+	         PROT_READ | PROT_WRITE,
+	         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+	         -1,
+	         0) == MAP_FAILED) {
+      sys_munmap(heap, reserved);
+      return 0;
+    }
+    vmt_name_region(heap, reserved);
+    if (__atomic_compare_exchange_n(&sf_start, &start, aligned, false,
+				    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      start = aligned;
+    } else {
+      sys_munmap(heap, reserved);
+    }
+
+  }
+
+  size_t number = __atomic_fetch_add(&sf_segments, 1, __ATOMIC_RELAXED);
+  if (number >= SF_HEAP_SIZE / SF_SEGMENT_SIZE) {
+    return 0;
+  }
+  return start + number * SF_SEGMENT_SIZE;
+
+} // sf_take_segment ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Give an arena a new segment, whose free space becomes its top; what
+ *         was left of the old top goes to the bins.
+ * \param  arena   The arena.
+ * \param  segment The segment.
+ * \param  offset  Where, past the segment's header, its free space begins.
+ */
+static void sf_add_segment (sf_arena_s* arena, uintptr_t segment, size_t offset)
+{
+
+  *(sf_arena_s**)segment = arena;
+
+  // The chunk that closes the segment is a bare header, always in use.
+  sf_chunk_s* fence = (sf_chunk_s*)(segment + SF_SEGMENT_SIZE - SF_HEADER_SIZE);
+  fence->head       = SF_INUSE;
+
+  sf_chunk_s* old_top = arena->top;
+  arena->top          = (sf_chunk_s*)(segment + offset);
+  arena->top->head    = ((uintptr_t)fence - (uintptr_t)arena->top) | SF_PREV_INUSE;
+
+  if (old_top != NULL) {
+    arena->retired_bytes += SF_SEGMENT_SIZE;
+    sf_release(arena, old_top);
+  }
+
+} // sf_add_segment ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  The arena whose first segment has a given number.
+ */
+static sf_arena_s* sf_arena_at (uint32_t number)
+{
+
+  return (sf_arena_s*)(__atomic_load_n(&sf_start, __ATOMIC_ACQUIRE) +
+		       (uintptr_t)number * SF_SEGMENT_SIZE + SF_SEGMENT_HEADER);
+
+} // sf_arena_at ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Give the calling thread an arena: one abandoned by a thread that has
+ *         exited, or a new one in a new segment.
+ * \return The arena; `NULL` if the heap is exhausted.
+ */
+static sf_arena_s* sf_acquire_arena ()
+{
+
+  // Pop an abandoned arena.  Every pop counts itself in the high half, so that
+  // if another thread pops the same arena first, the exchange fails.
+  uint64_t abandoned = __atomic_load_n(&sf_abandoned, __ATOMIC_ACQUIRE);
+  while ((uint32_t)abandoned != 0) {
+    sf_arena_s* arena   = sf_arena_at((uint32_t)abandoned - 1);
+    uint64_t    popped  = ((abandoned >> 32) + 1) << 32 | arena->next_abandoned;
+    if (__atomic_compare_exchange_n(&sf_abandoned, &abandoned, popped, true,
+				    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      sf_thread_arena = arena;
+      return arena;
+    }
+  }
+
+  // Make a new one.
+  uintptr_t segment = sf_take_segment();
+  if (segment == 0) {
+    return NULL;
+  }
+  sf_arena_s* arena = (sf_arena_s*)(segment + SF_SEGMENT_HEADER);
+  memset(arena, 0, sizeof(sf_arena_s));
+  size_t offset = (SF_SEGMENT_HEADER + sizeof(sf_arena_s) + SF_ALIGN - 1) & ~(size_t)(SF_ALIGN - 1);
+  sf_add_segment(arena, segment, offset);
+
+  arena->next_arena = __atomic_load_n(&sf_arenas, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&sf_arenas, &arena->next_arena, arena, true,
+				      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  sf_thread_arena = arena;
+  return arena;
+
+} // sf_acquire_arena ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Take a free chunk of at least a given size from the arena's bins, or
+ *         else split it from the top, which takes a new segment if it must.
+ * \param  arena The arena.
+ * \param  size  The chunk size.
+ * \return The chunk, in use and trimmed to `size`; `NULL` if the heap is full.
+ */
+static sf_chunk_s* sf_take (sf_arena_s* arena, size_t size)
+{
+
+  // First fit within the bin for this size, which may hold smaller chunks too,
+  // though none smaller by a quarter or more.
+  int         bin   = sf_bin_index(size);
+  sf_chunk_s* chunk = arena->bins[bin];
+  while (chunk != NULL && SF_SIZE(chunk) < size) {
+    chunk = chunk->next;
+  }
+
+  // Any chunk of a larger bin fits; take from the smallest that has one.
+  if (chunk == NULL && bin + 1 < SF_BINS) {
+    uint64_t larger = arena->bin_map & ~(((uint64_t)2 << bin) - 1);
+    if (larger != 0) {
+      chunk = arena->bins[__builtin_ctzl(larger)];
+    }
+  }
+
+  if (chunk != NULL) {
+    sf_bin_remove(arena, chunk);
+    sf_set_inuse(chunk, SF_SIZE(chunk));
+    sf_trim(arena, chunk, size);
+    return chunk;
+  }
+
+  // Split from the top, which must stay large enough to be a chunk.
+  if (SF_SIZE(arena->top) < size + SF_MIN_CHUNK) {
+    uintptr_t segment = sf_take_segment();
+    if (segment == 0) {
+      return NULL;
+    }
+    sf_add_segment(arena, segment, SF_SEGMENT_HEADER);
+  }
+  chunk            = arena->top;
+  arena->top       = SF_AT(chunk, size);
+  arena->top->head = (SF_SIZE(chunk) - size) | SF_PREV_INUSE;
+  chunk->head      = size | SF_INUSE | (chunk->head & SF_PREV_INUSE);
+  return chunk;
+
+} // sf_take ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Map a chunk of its own, of the pages that a given chunk size needs.
+ * \param  size The chunk size.
+ * \return The chunk; `NULL` if the mapping fails.
+ */
+static sf_chunk_s* sf_map_chunk (size_t size)
+{
+
+  size_t      total_size = size + PAGE_PAD(size);
+  sf_chunk_s* chunk      = ff_map_region(total_size);
+  if (chunk == NULL) {
+    return NULL;
+  }
+  __atomic_fetch_add(&sf_mapped_bytes, total_size, __ATOMIC_RELAXED);
+  chunk->prev_size = 0;
+  chunk->head      = total_size | SF_INUSE | SF_MAPPED;
+  return chunk;
+
+} // sf_map_chunk ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Begin an operation on the calling thread's arena, giving the thread
+ *         one if it has none.
+ * \return The arena; `NULL` if the thread has none and none can be had, or if
+ *         the operation interrupts another on the same arena.
+ */
+static sf_arena_s* sf_enter ()
+{
+
+  sf_arena_s* arena = sf_thread_arena;
+  if (arena == NULL) {
+    arena = sf_acquire_arena();
+  }
+  if (arena == NULL || arena->busy) {
+    return NULL;
+  }
+  arena->busy = 1;
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+  return arena;
+
+} // sf_enter ()
+
+static void sf_leave (sf_arena_s* arena)
+{
+
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+  arena->busy = 0;
+
+} // sf_leave ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief Initialize the allocator: give the calling thread its arena.
+ */
+void sf_init ()
+{
+
+  if (sf_thread_arena == NULL) {
+    sf_acquire_arena();
+  }
+
+} // sf_init ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Allocate and return `size` bytes of heap space, from the calling thread's
+ * arena: from the list of its size class if the block is small, and from the
+ * bins or the top if it is larger; and from a mapping of its own if it is
+ * large.  If the heap is full, or the arena is in use by the code that this
+ * call interrupts, the block is mapped whatever its size.
+ *
+ * \param size The number of bytes to allocate.
+ * \return A pointer to the allocated block, if successful; `NULL` if unsuccessful.
+ */
+void* sf_malloc (size_t size)
+{
+
+  // Cannot allocate an empty block.
+  size_t chunk_size = sf_chunk_size(size);
+  if (size == 0 || chunk_size == 0) {
+    return NULL;
+  }
+
+  sf_chunk_s* chunk = NULL;
+  sf_arena_s* arena = (chunk_size < SF_MAP_THRESHOLD) ? sf_enter() : NULL;
+  if (arena != NULL) {
+
+    if (__atomic_load_n(&arena->remote, __ATOMIC_RELAXED) != NULL) {
+      sf_drain_remote(arena);
+    }
+    if (chunk_size <= SF_SMALL_MAX) {
+      int size_class = chunk_size / SF_ALIGN - 1;
+      chunk          = arena->small[size_class];
+      if (chunk != NULL) {
+	arena->small[size_class] = chunk->next;
+      }
+    }
+    if (chunk == NULL) {
+      chunk = sf_take(arena, chunk_size);
+    }
+    sf_leave(arena);
+
+  }
+
+  if (chunk == NULL) {
+    chunk = sf_map_chunk(chunk_size);
+  }
+  return (chunk == NULL) ? NULL : SF_CHUNK_TO_BLOCK(chunk);
+
+} // sf_malloc ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Deallocate a given block: unmap it if it was mapped on its own, free it into
+ * its arena if the calling thread owns that arena, and otherwise leave it to
+ * the owner.
+ *
+ * \param ptr A pointer to the block to be deallocated.
+ */
+void sf_free (void* ptr)
+{
+
+  // This function is allowed to be passed a `NULL` pointer.  Do nothing.
+  if (ptr == NULL) {
+    return;
+  }
+
+  sf_chunk_s* chunk = SF_BLOCK_TO_CHUNK(ptr);
+
+  // Sanity check: Is this block already marked as free?
+  if ((chunk->head & SF_INUSE) == 0) {
+    ERROR("Double-free: ", (intptr_t)chunk);
+  }
+
+  if (chunk->head & SF_MAPPED) {
+    __atomic_fetch_sub(&sf_mapped_bytes, SF_SIZE(chunk), __ATOMIC_RELAXED);
+    ff_unmap_region(chunk, SF_SIZE(chunk));
+    return;
+  }
+
+  sf_arena_s* owner = SF_OWNER(chunk);
+  sf_arena_s* arena = sf_thread_arena;
+  if (arena == owner && !arena->busy) {
+    sf_enter();
+    sf_free_local(arena, chunk);
+    sf_leave(arena);
+  } else {
+    sf_free_remote(owner, chunk);
+  }
+
+} // sf_free ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Allocate a block of `nmemb * size` bytes on the heap, zeroing its contents.
+ *
+ * \param nmemb The number of elements in the new block.
+ * \param size  The size, in bytes, of each of the `nmemb` elements.
+ * \return      A pointer to the newly allocated and zeroed block, if successful;
+ *              `NULL` if unsuccessful.
+ */
+void* sf_calloc (size_t nmemb, size_t size)
+{
+
+  size_t block_size;
+  if (__builtin_mul_overflow(nmemb, size, &block_size)) {
+    return NULL;
+  }
+
+  // A freshly mapped block is zero already.
+  void* new_block_ptr = sf_malloc(block_size);
+  if (new_block_ptr != NULL && (SF_BLOCK_TO_CHUNK(new_block_ptr)->head & SF_MAPPED) == 0) {
+    memset(new_block_ptr, 0, block_size);
+  }
+
+  return new_block_ptr;
+
+} // sf_calloc ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * \brief  Resize a chunk of the calling thread's arena in place, if possible: a
+ *         chunk that shrinks releases its tail, and one that grows takes in the
+ *         free chunk after it, or the top, if that is enough.  Small chunks
+ *         keep their size class.
+ * \return Whether the chunk was resized.
+ */
+static bool sf_resize (sf_arena_s* arena, sf_chunk_s* chunk, size_t chunk_size)
+{
+
+  size_t      old_size = SF_SIZE(chunk);
+  sf_chunk_s* next     = SF_AT(chunk, old_size);
+
+  if (old_size <= SF_SMALL_MAX) {
+
+    return (chunk_size <= old_size);
+
+  } else if (chunk_size <= old_size) {
+
+    sf_trim(arena, chunk, chunk_size);
+    return true;
+
+  } else if (next == arena->top && SF_SIZE(next) >= chunk_size - old_size + SF_MIN_CHUNK) {
+
+    arena->top       = SF_AT(chunk, chunk_size);
+    arena->top->head = (SF_SIZE(next) - (chunk_size - old_size)) | SF_PREV_INUSE;
+    chunk->head      = chunk_size | (chunk->head & SF_FLAGS);
+    return true;
+
+  } else if (next != arena->top && (next->head & SF_INUSE) == 0 && old_size + SF_SIZE(next) >= chunk_size) {
+
+    size_t merged_size = old_size + SF_SIZE(next);
+    sf_bin_remove(arena, next);
+    sf_set_inuse(chunk, merged_size);
+    sf_trim(arena, chunk, chunk_size);
+    return true;
+
+  }
+  return false;
+
+} // sf_resize ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Update the given block at `ptr` to take on the given `size`, in place where
+ * possible (see `sf_resize()`), if the calling thread owns the block's arena.
+ * A mapped block is resized in place where the address space allows, and
+ * otherwise has its pages moved, not copied, into a new mapping between guards
+ * (see `ff_resize_region()` and `ff_remap_region()`).
+ * Otherwise a new block is allocated, the contents copied, and the old block
+ * freed.
+ *
+ * \param ptr  The block to be assigned a new size.
+ * \param size The new size that the block should assume.
+ * \return     A pointer to the resultant block, which may be `ptr` itself, or
+ *             may be a newly allocated block; `NULL` if unsuccessful, in which
+ *             case `ptr` is untouched.
+ */
+void* sf_realloc (void* ptr, size_t size)
+{
+
+  // Special case: If there is no original block, then just allocate the new one
+  // of the given size.
+  if (ptr == NULL) {
+    return sf_malloc(size);
+  }
+
+  // Special case: If the new size is 0, that's tantamount to freeing the block.
+  if (size == 0) {
+    sf_free(ptr);
+    return NULL;
+  }
+
+  sf_chunk_s* chunk      = SF_BLOCK_TO_CHUNK(ptr);
+  size_t      old_size   = SF_SIZE(chunk);
+  size_t      chunk_size = sf_chunk_size(size);
+  if (chunk_size == 0) {
+    return NULL;
+  }
+
+  if (chunk->head & SF_MAPPED) {
+
+    // A mapped block stays mapped while it is large, so that it can be resized
+    // in place, or else its pages moved rather than copied.
+    if (chunk_size >= SF_MAP_THRESHOLD) {
+      size_t total_size = chunk_size + PAGE_PAD(chunk_size);
+      if (ff_resize_region(chunk, old_size, total_size)) {
+	__atomic_fetch_add(&sf_mapped_bytes, total_size - old_size, __ATOMIC_RELAXED);
+	chunk->head = total_size | SF_INUSE | SF_MAPPED;
+	return ptr;
+      }
+      sf_chunk_s* moved = ff_remap_region(chunk, old_size, total_size);
+      if (moved == NULL) {
+	return NULL;
+      }
+      __atomic_fetch_add(&sf_mapped_bytes, total_size - old_size, __ATOMIC_RELAXED);
+      moved->head = total_size | SF_INUSE | SF_MAPPED;
+      return SF_CHUNK_TO_BLOCK(moved);
+    }
+
+  } else if (sf_thread_arena == SF_OWNER(chunk)) {
+
+    sf_arena_s* arena = sf_enter();
+    if (arena != NULL) {
+      bool resized = sf_resize(arena, chunk, chunk_size);
+      sf_leave(arena);
+      if (resized) {
+	return ptr;
+      }
+    }
+
+  }
+
+  // Move the block.
+  void* new_block_ptr = sf_malloc(size);
+  if (new_block_ptr != NULL) {
+    size_t old_block_size = old_size - SF_HEADER_SIZE;
+    memcpy(new_block_ptr, ptr, (old_block_size < size) ? old_block_size : size);
+    sf_free(ptr);
+  }
+  return new_block_ptr;
+
+} // sf_realloc ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Report the memory that the allocator holds: the part of each arena's
+ * segments below its top (free chunks included), and what is mapped outside
+ * the heap.  Arenas in use by other threads are read as they stand.
+ *
+ * \return The number of bytes.
+ */
+size_t sf_footprint ()
+{
+
+  size_t bytes = __atomic_load_n(&sf_mapped_bytes, __ATOMIC_RELAXED);
+  for (sf_arena_s* arena = sf_arenas; arena != NULL; arena = arena->next_arena) {
+    sf_chunk_s* top = arena->top;
+    bytes += arena->retired_bytes + ((uintptr_t)top - SF_SEGMENT(top));
+  }
+  return bytes;
+
+} // sf_footprint ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Map, or unmap, a run of whole pages outside the heap, as `ff_map_pages()`
+ * and `ff_unmap_pages()` do, counting them in this allocator's footprint.
+ */
+void* sf_map_pages (size_t pages)
+{
+
+  void* region = ff_map_run(pages * PAGE_SIZE);
+  if (region != NULL) {
+    __atomic_fetch_add(&sf_mapped_bytes, pages * PAGE_SIZE, __ATOMIC_RELAXED);
+  }
+  return region;
+
+} // sf_map_pages ()
+
+void sf_unmap_pages (void* ptr, size_t pages)
+{
+
+  __atomic_fetch_sub(&sf_mapped_bytes, pages * PAGE_SIZE, __ATOMIC_RELAXED);
+  ff_unmap_run(ptr, pages * PAGE_SIZE);
+
+} // sf_unmap_pages ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Give up the calling thread's arena as the thread exits, for the next new
+ * thread to adopt, with the blocks still allocated from it; those are freed
+ * into it, remotely, as before.
+ */
+void sf_thread_exit ()
+{
+
+  sf_arena_s* arena = sf_thread_arena;
+  if (arena == NULL || arena->busy) {
+    return;
+  }
+  sf_thread_arena = NULL;
+
+  uint32_t number    = (uint32_t)(((uintptr_t)arena - sf_start) / SF_SEGMENT_SIZE);
+  uint64_t abandoned = __atomic_load_n(&sf_abandoned, __ATOMIC_ACQUIRE);
+  do {
+    arena->next_abandoned = (uint32_t)abandoned;
+  } while (!__atomic_compare_exchange_n(&sf_abandoned, &abandoned,
+					(abandoned & ~(uint64_t)UINT32_MAX) | (number + 1), true,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+} // sf_thread_exit ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Nothing to reset in the child of a `fork()`: no lock is held.  The arenas of
+ * the threads that did not fork with it are left as they stand; the blocks
+ * freed into them are not reused.
+ */
+void sf_fork_child ()
+{
+
+} // sf_fork_child ()
+// =============================================================================
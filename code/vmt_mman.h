@@ -38,13 +38,30 @@
  * a best fit, a segregated fit, or a binary buddy allocator, and select which
  * one to use here.
  *
- * Our default choice is _first fit_, since it is most simple, and likely to be
- * fast and effective (we think) given the uses required by VMTrace.
+ * Our default choice is _segregated fit_: allocation and deallocation of the
+ * small blocks that VMTrace mostly needs take constant time, larger blocks are
+ * coalesced, and the largest are mapped on their own.  Each thread allocates
+ * from an arena of its own, without locks, so that signal handlers may too.  The _first fit_
+ * allocator (`ff_*`) remains available, by pointing these back at it.
  */
-#define vmt_malloc  ff_malloc
-#define vmt_free    ff_free
-#define vmt_calloc  ff_calloc
-#define vmt_realloc ff_realloc
+#define vmt_malloc  sf_malloc
+#define vmt_free    sf_free
+#define vmt_calloc  sf_calloc
+#define vmt_realloc sf_realloc
+#define vmt_init    sf_init
+#define vmt_footprint sf_footprint
+#define vmt_map_pages   sf_map_pages
+#define vmt_unmap_pages sf_unmap_pages
+#define vmt_fork_child  sf_fork_child
+#define vmt_thread_exit sf_thread_exit
+
+/**
+ * Every region that the allocator maps is named thus in `/proc/<pid>/maps`
+ * (`[anon:vmt]`), where the kernel names anonymous regions, so that VMTrace
+ * never takes its own memory for the program's.  The heap, and each large
+ * block, lies between guard pages, which no access is allowed to.
+ */
+#define VMT_REGION_NAME "vmt"
 // =============================================================================
 
 
@@ -80,6 +97,53 @@ void* vmt_malloc (size_t size);
  * \param ptr The address of the block to deallocate.
  */
 void vmt_free (void* ptr);
+
+/**
+ * \brief  Allocates a zeroed block of `nmemb * size` bytes in the private heap.
+ * \param  nmemb The number of elements.
+ * \param  size  The size of each element.
+ * \return a pointer to the allocated block, or `NULL` if the allocation fails.
+ */
+void* vmt_calloc (size_t nmemb, size_t size);
+
+/**
+ * \brief  Resizes the given block, in place if possible.
+ * \param  ptr  The address of the block; `NULL` to allocate a new one.
+ * \param  size The new size; 0 to free the block.
+ * \return a pointer to the resized block, or `NULL` if the resizing fails.
+ */
+void* vmt_realloc (void* ptr, size_t size);
+
+/**
+ * \brief  Reports the memory that the allocator holds, free blocks included.
+ * \return The number of bytes.
+ */
+size_t vmt_footprint ();
+
+/**
+ * \brief  Maps a run of whole pages, outside the private heap.
+ * \param  pages The number of pages.
+ * \return a pointer to the first page, or `NULL` if the mapping fails.
+ */
+void* vmt_map_pages (size_t pages);
+
+/**
+ * \brief Unmaps a run of pages that `vmt_map_pages()` mapped.
+ * \param ptr   The address of the first page.
+ * \param pages The number of pages.
+ */
+void vmt_unmap_pages (void* ptr, size_t pages);
+
+/**
+ * \brief Gives up the calling thread's share of the allocator, as it exits.
+ */
+void vmt_thread_exit ();
+
+/**
+ * \brief Makes the allocator usable in the child of a `fork()`, where the
+ *        threads that may have been using it do not exist.
+ */
+void vmt_fork_child ();
 // =============================================================================
 
 
@@ -0,0 +1,304 @@
+// =============================================================================
+/*******************************************************************************
+ * Live Statistics Viewer
+ *
+ * Maps, read-only, the statistics page that the manager of a process exports
+ * when it runs with `VMT_STATS` set (see stats.h), and prints, every interval,
+ * the rates of its faults, evictions, calls of mprotect (), system call walks
+ * and trace output, with the pages in its metadata store and its window. The
+ * rows of the page are summed here, so that the traced program pays nothing
+ * for being watched.
+ *
+ *     vmtrace-top [-i seconds] pid
+ *
+ * The viewer waits for the page to appear, follows the process through each
+ * program it executes, and stops once the process finishes tracing or exits.
+ ******************************************************************************/
+// =============================================================================
+
+
+
+// =============================================================================
+// INCLUDES
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "stats.h"
+// =============================================================================
+
+
+
+// =============================================================================
+// MACROS
+
+// Lines printed between headers.
+#define HEADER_EVERY 20
+// =============================================================================
+
+
+
+// =============================================================================
+// TYPES
+
+// The counters of a page, summed over its rows.
+struct totals {
+
+	uint64_t time_ns;
+	int threads;
+	uint64_t faults;
+	uint64_t evictions;
+	uint64_t mprotects;
+	uint64_t walks;
+	uint64_t trace_bytes;
+	int64_t tracked;
+	int64_t window;
+
+};
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * The time on CLOCK_MONOTONIC, in nanoseconds.
+ */
+static uint64_t now_ns () {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+} // now_ns ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Maps the statistics page of a process, read-only, and finds which object it
+ * is, so that one exported anew, by the next program that the process
+ * executes, can be told from it.
+ *
+ * @param name  The page's name.
+ * @param inode Where to store the object's inode.
+ * @return      The page; NULL if it does not exist (yet).
+ */
+static const struct stats_page *map_page (const char *name, ino_t *inode) {
+
+	int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+	if (fd == -1) {
+		return NULL;
+	}
+	struct stat st;
+	const struct stats_page *page = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size >= STATS_SIZE) {
+		page = mmap(NULL, STATS_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+		*inode = st.st_ino;
+	}
+	close(fd);
+	return (page == MAP_FAILED) ? NULL : page;
+
+} // map_page ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Whether the name of a process's statistics page still refers to the object
+ * mapped.
+ */
+static int same_page (const char *name, ino_t inode) {
+
+	int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+	if (fd == -1) {
+		return 0;
+	}
+	struct stat st;
+	int same = (fstat(fd, &st) == 0 && st.st_ino == inode);
+	close(fd);
+	return same;
+
+} // same_page ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Sums the rows of a page, as they stand. The retired row is read last: a
+ * thread that exits meanwhile adds its counts into it before clearing its own
+ * row, so that they are counted once or twice, but never missed.
+ */
+static void sum_page (const struct stats_page *page, struct totals *totals) {
+
+	memset(totals, 0, sizeof(*totals));
+	totals->time_ns = now_ns();
+	for (int i = 0; i <= STATS_ROWS; i++) {
+		const struct stats_row *row = (i == STATS_ROWS) ? &page->retired : &page->rows[i];
+		if (i != STATS_ROWS && row->tid != 0) {
+			totals->threads = totals->threads + 1;
+		}
+		totals->faults = totals->faults + row->faults;
+		totals->evictions = totals->evictions + row->evictions;
+		totals->mprotects = totals->mprotects + row->mprotects;
+		totals->walks = totals->walks + row->walks;
+		totals->tracked = totals->tracked + row->tracked;
+		totals->window = totals->window + row->window;
+	}
+	totals->trace_bytes = page->trace_bytes;
+
+} // sum_page ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * The rate at which a counter grew between two sums. A count that an exiting
+ * thread had counted twice in the earlier sum may seem to have shrunk; it grew
+ * by nothing.
+ */
+static double rate (uint64_t before, uint64_t after, double seconds) {
+
+	return (after > before) ? (after - before) / seconds : 0;
+
+} // rate ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Prints one line: the rates between two sums of a page, and where its gauges
+ * stand at the later one.
+ */
+static void print_rates (const struct stats_page *page, const struct totals *before, const struct totals *after) {
+
+	double seconds = (double) (after->time_ns - before->time_ns) / 1e9;
+	if (seconds <= 0) {
+		seconds = 1e-9;
+	}
+	time_t wall = time(NULL);
+	char clock[16];
+	strftime(clock, sizeof(clock), "%H:%M:%S", localtime(&wall));
+	printf("%8s %7d %11.0f %11.0f %11.0f %11.0f %11.1f %11lld %7lld/%llu\n",
+	       clock, after->threads,
+	       rate(before->faults, after->faults, seconds),
+	       rate(before->evictions, after->evictions, seconds),
+	       rate(before->mprotects, after->mprotects, seconds),
+	       rate(before->walks, after->walks, seconds),
+	       rate(before->trace_bytes, after->trace_bytes, seconds) / 1024.0,
+	       (long long) after->tracked, (long long) after->window, (unsigned long long) page->window_size);
+	fflush(stdout);
+
+} // print_rates ()
+// =============================================================================
+
+
+
+// =============================================================================
+/**
+ * Prints the headings of the columns.
+ */
+static void print_header () {
+
+	printf("%8s %7s %11s %11s %11s %11s %11s %11s %s\n",
+	       "time", "threads", "faults/s", "evicts/s", "mprotect/s", "walks/s", "trace KB/s", "tracked", "window");
+
+} // print_header ()
+// =============================================================================
+
+
+
+// =============================================================================
+int main (int argc, char * argv[]) {
+
+	double interval = 1;
+	int option;
+	while ((option = getopt(argc, argv, "i:")) != -1) {
+		switch (option) {
+			case 'i':
+				interval = atof(optarg);
+				break;
+			default:
+				interval = 0;
+		}
+	}
+	if (optind != argc - 1 || interval <= 0) {
+		fprintf(stderr, "usage: %s [-i seconds] pid\n", argv[0]);
+		return 1;
+	}
+	pid_t pid = atoi(argv[optind]);
+	char name[64];
+	snprintf(name, sizeof(name), STATS_NAME_FORMAT, (int) pid);
+	struct timespec pause = { (time_t) interval, (long) ((interval - (time_t) interval) * 1e9) };
+
+	//Waits for the page, which the manager exports just before the program's main ()
+	ino_t inode = 0;
+	const struct stats_page *page = map_page(name, &inode);
+	if (page == NULL) {
+		printf("waiting for %s (is VMT_STATS set?)\n", name);
+		fflush(stdout);
+	}
+	while (page == NULL) {
+		if (kill(pid, 0) == -1 && errno == ESRCH) {
+			fprintf(stderr, "%s: process %d has exited\n", argv[0], (int) pid);
+			return 1;
+		}
+		nanosleep(&pause, NULL);
+		page = map_page(name, &inode);
+	}
+
+	struct totals before;
+	struct totals after;
+	sum_page(page, &before);
+	for (int lines = 0; ; lines++) {
+		if (lines % HEADER_EVERY == 0) {
+			print_header();
+		}
+		nanosleep(&pause, NULL);
+		sum_page(page, &after);
+		print_rates(page, &before, &after);
+		before = after;
+
+		if (page->finished) {
+			printf("finished: %llu faults, %llu evictions, %llu mprotect () calls, %llu walks, %llu trace bytes\n",
+			       (unsigned long long) after.faults, (unsigned long long) after.evictions,
+			       (unsigned long long) after.mprotects, (unsigned long long) after.walks,
+			       (unsigned long long) after.trace_bytes);
+			return 0;
+		}
+
+		//A process killed before it finished leaves its page behind
+		if (kill(pid, 0) == -1 && errno == ESRCH) {
+			printf("process %d has exited\n", (int) pid);
+			return 0;
+		}
+
+		//A program that the process executed exports a page of its own, which starts afresh
+		if (!same_page(name, inode)) {
+			const struct stats_page *next = map_page(name, &inode);
+			if (next == NULL) {
+				continue;
+			}
+			munmap((void *) page, STATS_SIZE);
+			page = next;
+			printf("process %d executed another program\n", (int) pid);
+			sum_page(page, &before);
+			lines = -1;
+		}
+	}
+
+} // main ()
+// =============================================================================
@@ -0,0 +1,248 @@
+/* =============================================================================================================================== */
+/**
+ * \file zpool-test.c
+ * \brief A test of the compressed-object pool.  Random allocations and frees, with compactions between them, are checked by
+ *        the contents of every live object; then the pool's overhead over the bytes it holds, and the average time of an
+ *        allocation and a free, are reported for objects of the sizes that pages compress to.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "zpool.h"
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS and CONSTANTS */
+
+/** The number of objects the checked operations keep at once, at most. */
+#define SLOTS 20000
+
+/** The operations between checked compactions. */
+#define COMPACT_EVERY 10000
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* TYPES */
+
+/** A live object, or a free slot for one (a handle of 0). */
+typedef struct object_struct {
+  zpool_handle_t handle;
+  size_t         size;
+  uint8_t        seed;
+} object_s;
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Get a monotonic time in nanoseconds.
+ */
+static uint64_t now_ns () {
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+
+} // now_ns ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Pick the size of an object as a compressed page might be: mostly small, at times up to the largest.
+ */
+static size_t random_size () {
+
+  return (random() % 4 == 0) ? 1 + random() % ZPOOL_MAX_SIZE : 1 + random() % 1500;
+
+} // random_size ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Fill an object with the bytes of its seed, or check that it still holds them.
+ */
+static void fill (zpool_s* pool, object_s* object) {
+
+  uint8_t* bytes = zpool_map(pool, object->handle);
+  for (size_t i = 0; i < object->size; i++) {
+    bytes[i] = (uint8_t) (object->seed + i);
+  }
+
+} // fill ()
+
+static void verify (zpool_s* pool, object_s* object) {
+
+  uint8_t* bytes = zpool_map(pool, object->handle);
+  for (size_t i = 0; i < object->size; i++) {
+    assert(bytes[i] == (uint8_t) (object->seed + i));
+  }
+
+} // verify ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Report the bytes a pool holds against the bytes its objects asked for.
+ * \return The overhead, in percent.
+ */
+static double overhead (zpool_s* pool, const char* when) {
+
+  zpool_stats_s stats;
+  zpool_get_stats(pool, &stats);
+  double percent = (stats.object_bytes > 0)
+                   ? 100.0 * ((double) (stats.zspage_bytes + stats.metadata_bytes) - stats.object_bytes) / stats.object_bytes
+                   : 0;
+  printf("%-22s %8zu objects, %10zu bytes in %10zu zspage bytes + %8zu metadata bytes: %5.1f%% overhead\n",
+         when, stats.objects, stats.object_bytes, stats.zspage_bytes, stats.metadata_bytes, percent);
+  return percent;
+
+} // overhead ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Allocate and free objects at random, checking their contents as they are freed and, after each compaction, all of
+ *         them; then free them all and check that the pool gave back every zspage.
+ * \param  operations The number of operations.
+ */
+static void check (long operations) {
+
+  static object_s objects[SLOTS];
+  zpool_s         pool;
+  assert(zpool_create(&pool));
+
+  for (long op = 1; op <= operations; op++) {
+    object_s* object = &objects[random() % SLOTS];
+    if (object->handle == 0) {
+      object->size   = random_size();
+      object->seed   = (uint8_t) random();
+      object->handle = zpool_alloc(&pool, object->size);
+      assert(object->handle != 0);
+      fill(&pool, object);
+    } else {
+      verify(&pool, object);
+      zpool_free(&pool, object->handle, object->size);
+      object->handle = 0;
+    }
+
+    if (op % COMPACT_EVERY == 0) {
+      while (zpool_compact(&pool, 1000) == 1000)
+        ;
+      for (int i = 0; i < SLOTS; i++) {
+        if (objects[i].handle != 0) {
+          verify(&pool, &objects[i]);
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < SLOTS; i++) {
+    if (objects[i].handle != 0) {
+      verify(&pool, &objects[i]);
+      zpool_free(&pool, objects[i].handle, objects[i].size);
+      objects[i].handle = 0;
+    }
+  }
+  zpool_stats_s stats;
+  zpool_get_stats(&pool, &stats);
+  assert(stats.objects == 0 && stats.object_bytes == 0 && stats.zspage_bytes == 0);
+
+} // check ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Fill a pool with objects, free half of them at random, and compact it, reporting its overhead at each step and the
+ *         average time of an allocation and a free.
+ * \param  count The number of objects.
+ */
+static void measure (long count) {
+
+  zpool_s pool;
+  assert(zpool_create(&pool));
+  object_s* objects = calloc(count, sizeof(object_s));
+  assert(objects != NULL);
+
+  uint64_t start = now_ns();
+  for (long i = 0; i < count; i++) {
+    objects[i].size   = random_size();
+    objects[i].handle = zpool_alloc(&pool, objects[i].size);
+    assert(objects[i].handle != 0);
+  }
+  uint64_t alloc_ns = now_ns() - start;
+  double   full     = overhead(&pool, "filled:");
+
+  long freed = 0;
+  start = now_ns();
+  for (long i = 0; i < count; i++) {
+    if (random() % 2 == 0) {
+      zpool_free(&pool, objects[i].handle, objects[i].size);
+      objects[i].handle = 0;
+      freed++;
+    }
+  }
+  uint64_t free_ns = now_ns() - start;
+  overhead(&pool, "half freed:");
+
+  start = now_ns();
+  while (zpool_compact(&pool, 1000) == 1000)
+    ;
+  uint64_t compact_ns = now_ns() - start;
+  double   compacted  = overhead(&pool, "compacted:");
+
+  printf("alloc %.0f ns, free %.0f ns on average; compaction %.3f ms\n",
+         (double) alloc_ns / count, (freed > 0) ? (double) free_ns / freed : 0, compact_ns / 1e6);
+  printf("overhead filled %s, compacted %s the 10%% target\n", (full < 10) ? "within" : "over", (compacted < 10) ? "within" : "over");
+  free(objects);
+
+} // measure ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+int main (int argc, char** argv) {
+
+  if (argc > 2) {
+    fprintf(stderr, "USAGE: %s [ <# objects> ]\n", argv[0]);
+    exit(1);
+  }
+  long count = (argc == 2) ? atol(argv[1]) : 1000000;
+
+  srandom(1);
+  check(1000000);
+  printf("Checked the contents of every object through allocations, frees and compactions.\n");
+
+  measure(count);
+
+  return 0;
+
+} // main ()
+/* =============================================================================================================================== */
@@ -0,0 +1,602 @@
+/* =============================================================================================================================== */
+/**
+ * \file zpool.c
+ * \brief A pool of small objects of many sizes, packed by size class into runs of pages, for the compressed cache.
+ *
+ * Much as zsmalloc does for zram, objects are rounded up to a class, in steps of `ZPOOL_CLASS_STEP` bytes, and each class cuts
+ * zspages into objects of its size.  A class's zspages are 1 to `ZPOOL_MAX_PAGES` pages, the fewest that waste little of them, so
+ * that objects may straddle pages and little of each zspage is left over; classes whose zspages come out alike are merged into
+ * the largest of them, as in zsmalloc, so that fewer zspages are partly empty.  Objects are found through handles, so that
+ * compaction can move them into the fuller zspages of their class and release the zspages it empties.  Each object starts with
+ * its handle, so that compaction can find the handle of an object that it moves; a free object holds 0 there, and the index of
+ * the next free object of its zspage after it.
+ *
+ * A class's zspages with free objects are kept in lists by fullness group, as zsmalloc does, with a bit for each list that is
+ * not empty: allocation takes the fullest zspage, and compaction moves the objects of one of the emptiest into one of the
+ * fullest, each found in constant time.
+ *
+ * Pages come from `vmt_map_pages()`, a region of `ZPOOL_REGION_PAGES` at a time, which zspages are carved from, and the zspages'
+ * descriptors from `vmt_malloc()`, so that nothing here touches the program's heap.  A released zspage keeps its descriptor and
+ * its pages for the next zspage of as many pages, so that allocation maps nothing in the common case; past a share of the pages
+ * in use (see `ZPOOL_SPARE_SHARE`), the pages are given back to the kernel, but stay mapped for reuse.  The handle table comes
+ * from `vmt_calloc()`, and grows by half when it is full.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <stdbool.h>     // For true/false
+#include <stdint.h>      // For uint64_t
+#include <string.h>      // For memcpy()/memset()
+#include <sys/mman.h>    // For madvise()
+
+#include "vmt_mman.h"
+#include "zpool.h"
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS and CONSTANTS */
+
+/** The size of a page. */
+#define PAGE_SIZE 4096
+
+/** No object: the end of a zspage's free list. */
+#define ZSPAGE_NONE UINT16_MAX
+
+/** The fullness group of a zspage in no list. */
+#define ZSPAGE_UNLISTED UINT8_MAX
+
+/** The number of entries the handle table starts with. */
+#define INITIAL_HANDLES 512
+
+/** A class's zspages take the fewest pages that leave no more than one part in `ZSPAGE_WASTE_SHARE` of them unused: more pages
+ *  might waste less, but a zspage that is partly empty holds more. */
+#define ZSPAGE_WASTE_SHARE 32
+
+/** The size of the header that holds an object's handle. */
+#define HEADER_SIZE sizeof(zpool_handle_t)
+
+/** Pack a zspage and the index of an object in it into an entry of the handle table; unpack them. */
+#define HANDLE_PACK(zspage,index) (((uint64_t) (uintptr_t) (zspage) << 16) | (uint64_t) (index))
+#define HANDLE_ZSPAGE(entry)      ((zpool_zspage_s*) (uintptr_t) ((entry) >> 16))
+#define HANDLE_INDEX(entry)       ((uint16_t) ((entry) & 0xffff))
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Find an object in its zspage.
+ */
+static inline uint8_t* object_at (zpool_s* pool, zpool_zspage_s* zspage, uint16_t index) {
+
+  return zspage->base + (size_t) index * pool->classes[zspage->class].size;
+
+} // object_at ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Read or write the handle at the start of an object, or the index of the next free object after it.
+ */
+static inline zpool_handle_t object_handle (const uint8_t* object) {
+
+  zpool_handle_t handle;
+  memcpy(&handle, object, sizeof(handle));
+  return handle;
+
+} // object_handle ()
+
+static inline void set_object_handle (uint8_t* object, zpool_handle_t handle) {
+
+  memcpy(object, &handle, sizeof(handle));
+
+} // set_object_handle ()
+
+static inline uint16_t object_next (const uint8_t* object) {
+
+  uint16_t next;
+  memcpy(&next, object + HEADER_SIZE, sizeof(next));
+  return next;
+
+} // object_next ()
+
+static inline void set_object_next (uint8_t* object, uint16_t next) {
+
+  memcpy(object + HEADER_SIZE, &next, sizeof(next));
+
+} // set_object_next ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Put a zspage, which must have a free object, at the head of the list of its fullness group, or take it out.
+ */
+static void list_zspage (zpool_class_s* class, zpool_zspage_s* zspage) {
+
+  uint8_t group = (uint8_t) (zspage->inuse * ZPOOL_FULLNESS / class->objects);
+  zspage->prev = NULL;
+  zspage->next = class->partial[group];
+  if (class->partial[group] != NULL) {
+    class->partial[group]->prev = zspage;
+  }
+  class->partial[group] = zspage;
+  class->groups        |= 1U << group;
+  zspage->fullness      = group;
+
+} // list_zspage ()
+
+static void unlist_zspage (zpool_class_s* class, zpool_zspage_s* zspage) {
+
+  uint8_t group = zspage->fullness;
+  if (zspage->prev != NULL) {
+    zspage->prev->next = zspage->next;
+  } else {
+    class->partial[group] = zspage->next;
+  }
+  if (zspage->next != NULL) {
+    zspage->next->prev = zspage->prev;
+  }
+  if (class->partial[group] == NULL) {
+    class->groups &= ~(1U << group);
+  }
+  zspage->prev     = NULL;
+  zspage->next     = NULL;
+  zspage->fullness = ZSPAGE_UNLISTED;
+
+} // unlist_zspage ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Move a zspage whose number of objects allocated changed to the list of its fullness group, or out of the lists if it
+ *         is full.
+ */
+static void relist_zspage (zpool_class_s* class, zpool_zspage_s* zspage) {
+
+  uint8_t group = (zspage->free == ZSPAGE_NONE) ? ZSPAGE_UNLISTED : (uint8_t) (zspage->inuse * ZPOOL_FULLNESS / class->objects);
+  if (group != zspage->fullness) {
+    if (zspage->fullness != ZSPAGE_UNLISTED) {
+      unlist_zspage(class, zspage);
+    }
+    if (group != ZSPAGE_UNLISTED) {
+      list_zspage(class, zspage);
+    }
+  }
+
+} // relist_zspage ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Take the first zspage of the emptiest or of the fullest fullness group of a class.
+ * \return The zspage, or `NULL` if the class has no zspage with free objects.
+ */
+static zpool_zspage_s* emptiest_zspage (zpool_class_s* class) {
+
+  return (class->groups == 0) ? NULL : class->partial[__builtin_ctz(class->groups)];
+
+} // emptiest_zspage ()
+
+static zpool_zspage_s* fullest_zspage (zpool_class_s* class) {
+
+  return (class->groups == 0) ? NULL : class->partial[31 - __builtin_clz(class->groups)];
+
+} // fullest_zspage ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Take a run of pages for a zspage, with a descriptor: a released zspage's, preferably one whose pages were kept, or else
+ *         a new one, carved from the region.  The region that runs out is replaced by the next one given, or by one mapped here,
+ *         and the rest of it is kept as the pages of a released zspage.
+ * \return The descriptor, its `base` and `pages` set, or `NULL` if none could be had.
+ */
+static zpool_zspage_s* take_pages (zpool_s* pool, uint8_t pages) {
+
+  zpool_zspage_s* zspage = pool->spares[pages - 1];
+  if (zspage != NULL) {
+    pool->spares[pages - 1] = zspage->next;
+    pool->spare_pages      -= pages;
+    return zspage;
+  }
+  zspage = pool->released[pages - 1];
+  if (zspage != NULL) {
+    pool->released[pages - 1] = zspage->next;
+    return zspage;
+  }
+
+  if (pool->region_pages < pages) {
+    uint8_t* region = (pool->next_region != NULL) ? pool->next_region : vmt_map_pages(ZPOOL_REGION_PAGES);
+    if (region == NULL) {
+      return NULL;
+    }
+    pool->next_region = NULL;
+    zpool_zspage_s* rest = (pool->region_pages > 0) ? vmt_malloc(sizeof(zpool_zspage_s)) : NULL;
+    if (rest != NULL) {
+      pool->descriptors++;
+      rest->base  = pool->region;
+      rest->pages = (uint8_t) pool->region_pages;
+      rest->next  = pool->spares[rest->pages - 1];
+      pool->spares[rest->pages - 1] = rest;
+      pool->spare_pages            += rest->pages;
+    }
+    pool->region       = region;
+    pool->region_pages = ZPOOL_REGION_PAGES;
+  }
+
+  zspage = vmt_malloc(sizeof(zpool_zspage_s));
+  if (zspage == NULL) {
+    return NULL;
+  }
+  pool->descriptors++;
+  zspage->base        = pool->region;
+  zspage->pages       = pages;
+  pool->region       += (size_t) pages * PAGE_SIZE;
+  pool->region_pages -= pages;
+  return zspage;
+
+} // take_pages ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Create an empty zspage for a class, every object of it free, and list it.
+ * \return The zspage, or `NULL` if it could not be had.
+ */
+static zpool_zspage_s* create_zspage (zpool_s* pool, uint16_t class_index) {
+
+  zpool_class_s*  class  = &pool->classes[class_index];
+  zpool_zspage_s* zspage = take_pages(pool, (uint8_t) class->pages);
+  if (zspage == NULL) {
+    return NULL;
+  }
+
+  zspage->class = class_index;
+  zspage->inuse = 0;
+  zspage->free  = 0;
+  for (uint16_t i = 0; i < class->objects; i++) {
+    uint8_t* object = object_at(pool, zspage, i);
+    set_object_handle(object, 0);
+    set_object_next(object, (i + 1 < class->objects) ? i + 1 : ZSPAGE_NONE);
+  }
+
+  class->zspages++;
+  pool->zspage_pages += class->pages;
+  list_zspage(class, zspage);
+  return zspage;
+
+} // create_zspage ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Release an empty zspage, which must not be listed, keeping its descriptor and its pages; past as many of them as the
+ *         pool keeps (see `ZPOOL_SPARE_SHARE`), the pages' memory is given back to the kernel.
+ */
+static void release_zspage (zpool_s* pool, zpool_zspage_s* zspage) {
+
+  pool->classes[zspage->class].zspages--;
+  pool->zspage_pages -= zspage->pages;
+  size_t keep = pool->zspage_pages / ZPOOL_SPARE_SHARE;
+  if (pool->spare_pages + zspage->pages <= ((keep < ZPOOL_SPARE_PAGES) ? keep : ZPOOL_SPARE_PAGES)) {
+    zspage->next                    = pool->spares[zspage->pages - 1];
+    pool->spares[zspage->pages - 1] = zspage;
+    pool->spare_pages              += zspage->pages;
+  } else {
+    madvise(zspage->base, (size_t) zspage->pages * PAGE_SIZE, MADV_DONTNEED);
+    zspage->next                      = pool->released[zspage->pages - 1];
+    pool->released[zspage->pages - 1] = zspage;
+  }
+
+} // release_zspage ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Take a free object of a zspage, which must have one, for a handle; the zspage moves to the list of its fullness group,
+ *         or leaves the lists if this fills it.
+ * \return The index of the object.
+ */
+static uint16_t take_object (zpool_s* pool, zpool_zspage_s* zspage, zpool_handle_t handle) {
+
+  zpool_class_s* class  = &pool->classes[zspage->class];
+  uint16_t       index  = zspage->free;
+  uint8_t*       object = object_at(pool, zspage, index);
+
+  zspage->free = object_next(object);
+  set_object_handle(object, handle);
+  zspage->inuse++;
+  class->inuse++;
+  relist_zspage(class, zspage);
+  return index;
+
+} // take_object ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Give back an object of a zspage; the zspage moves to the list of its fullness group, which a full one joins again.  An
+ *         empty zspage is left for the caller.
+ */
+static void give_object (zpool_s* pool, zpool_zspage_s* zspage, uint16_t index) {
+
+  zpool_class_s* class  = &pool->classes[zspage->class];
+  uint8_t*       object = object_at(pool, zspage, index);
+
+  set_object_handle(object, 0);
+  set_object_next(object, zspage->free);
+  zspage->free = index;
+  zspage->inuse--;
+  class->inuse--;
+  relist_zspage(class, zspage);
+
+} // give_object ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+bool zpool_create (zpool_s* pool) {
+
+  memset(pool, 0, sizeof(zpool_s));
+
+  //Each class takes the fewest pages that waste little enough (see ZSPAGE_WASTE_SHARE), or else those that waste the least
+  for (uint16_t c = 0; c < ZPOOL_CLASSES; c++) {
+    zpool_class_s* class = &pool->classes[c];
+    class->size = (c + 1) * ZPOOL_CLASS_STEP;
+    size_t best_waste = SIZE_MAX;
+    for (uint16_t pages = 1; pages <= ZPOOL_MAX_PAGES; pages++) {
+      size_t objects = (pages * PAGE_SIZE) / class->size;
+      size_t waste   = (pages * PAGE_SIZE - objects * class->size) * ZPOOL_MAX_PAGES / pages;
+      if (waste < best_waste) {
+        best_waste     = waste;
+        class->pages   = pages;
+        class->objects = (uint16_t) objects;
+      }
+      if (waste * ZSPAGE_WASTE_SHARE <= ZPOOL_MAX_PAGES * PAGE_SIZE) {
+        break;
+      }
+    }
+  }
+
+  //As zsmalloc does, a class whose zspages have as many pages and objects as those of the next larger class is merged into it:
+  //its objects fit as many to a zspage there, and fewer classes leave fewer zspages partly empty
+  pool->merged[ZPOOL_CLASSES - 1] = ZPOOL_CLASSES - 1;
+  for (uint16_t c = ZPOOL_CLASSES - 1; c-- > 0; ) {
+    zpool_class_s* class  = &pool->classes[c];
+    zpool_class_s* larger = &pool->classes[pool->merged[c + 1]];
+    pool->merged[c]       = (class->pages == larger->pages && class->objects == larger->objects) ? pool->merged[c + 1] : c;
+  }
+
+  pool->handles = vmt_calloc(INITIAL_HANDLES, sizeof(uint64_t));
+  if (pool->handles == NULL) {
+    return false;
+  }
+  pool->handle_capacity = INITIAL_HANDLES;
+
+  //Handle 0 is no object; the rest are free, each entry the next free handle
+  for (size_t h = 1; h < INITIAL_HANDLES; h++) {
+    pool->handles[h] = (h + 1 < INITIAL_HANDLES) ? h + 1 : 0;
+  }
+  pool->free_handle = 1;
+  return true;
+
+} // zpool_create ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/**
+ * \brief  Take a free handle, doubling the handle table if there is none.
+ * \return The handle, or 0 if the table could not grow.
+ */
+static zpool_handle_t new_handle (zpool_s* pool) {
+
+  if (pool->free_handle == 0) {
+    size_t capacity = pool->handle_capacity + pool->handle_capacity / 2;
+    if (capacity > UINT32_MAX) {
+      return 0;
+    }
+    uint64_t* handles = vmt_realloc(pool->handles, capacity * sizeof(uint64_t));
+    if (handles == NULL) {
+      return 0;
+    }
+    for (size_t h = pool->handle_capacity; h < capacity; h++) {
+      handles[h] = (h + 1 < capacity) ? h + 1 : 0;
+    }
+    pool->handles         = handles;
+    pool->free_handle     = (zpool_handle_t) pool->handle_capacity;
+    pool->handle_capacity = capacity;
+  }
+
+  zpool_handle_t handle = pool->free_handle;
+  pool->free_handle = (zpool_handle_t) pool->handles[handle];
+  return handle;
+
+} // new_handle ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+zpool_handle_t zpool_alloc (zpool_s* pool, size_t size) {
+
+  if (size == 0 || size > ZPOOL_MAX_SIZE) {
+    return 0;
+  }
+
+  uint16_t        class_index = pool->merged[(size + HEADER_SIZE - 1) / ZPOOL_CLASS_STEP];
+  zpool_zspage_s* zspage      = fullest_zspage(&pool->classes[class_index]);
+  if (zspage == NULL && (zspage = create_zspage(pool, class_index)) == NULL) {
+    return 0;
+  }
+
+  zpool_handle_t handle = new_handle(pool);
+  if (handle == 0) {
+    if (zspage->inuse == 0) {
+      unlist_zspage(&pool->classes[class_index], zspage);
+      release_zspage(pool, zspage);
+    }
+    return 0;
+  }
+
+  uint16_t index = take_object(pool, zspage, handle);
+  pool->handles[handle] = HANDLE_PACK(zspage, index);
+  pool->stats.objects++;
+  pool->stats.object_bytes += size;
+  return handle;
+
+} // zpool_alloc ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+void zpool_free (zpool_s* pool, zpool_handle_t handle, size_t size) {
+
+  uint64_t        entry  = pool->handles[handle];
+  zpool_zspage_s* zspage = HANDLE_ZSPAGE(entry);
+
+  give_object(pool, zspage, HANDLE_INDEX(entry));
+  if (zspage->inuse == 0) {
+    unlist_zspage(&pool->classes[zspage->class], zspage);
+    release_zspage(pool, zspage);
+  }
+
+  pool->handles[handle] = pool->free_handle;
+  pool->free_handle     = handle;
+  pool->stats.objects--;
+  pool->stats.object_bytes -= size;
+
+} // zpool_free ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+void* zpool_map (zpool_s* pool, zpool_handle_t handle) {
+
+  uint64_t entry = pool->handles[handle];
+  return object_at(pool, HANDLE_ZSPAGE(entry), HANDLE_INDEX(entry)) + HEADER_SIZE;
+
+} // zpool_map ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+size_t zpool_compact (zpool_s* pool, size_t budget) {
+
+  size_t moved = 0;
+
+  for (uint16_t visited = 0; visited < ZPOOL_CLASSES && moved < budget; visited++) {
+    zpool_class_s* class = &pool->classes[pool->compact_class];
+
+    //Only a class whose free objects would fill a zspage has one to release
+    while (moved < budget && class->zspages * class->objects - class->inuse >= class->objects) {
+      zpool_zspage_s* source      = emptiest_zspage(class);
+      zpool_zspage_s* destination = fullest_zspage(class);
+      if (destination == source) {
+        destination = source->next;
+      }
+      if (destination == NULL) {
+        break;
+      }
+
+      //Moves the objects of the emptiest zspage into the fullest, pointing their handles at their new places
+      for (uint16_t i = 0; i < class->objects && source->inuse > 0 && destination->fullness != ZSPAGE_UNLISTED && moved < budget;
+           i++) {
+        uint8_t*       object = object_at(pool, source, i);
+        zpool_handle_t handle = object_handle(object);
+        if (handle == 0) {
+          continue;
+        }
+        uint16_t index = take_object(pool, destination, handle);
+        memcpy(object_at(pool, destination, index) + HEADER_SIZE, object + HEADER_SIZE, class->size - HEADER_SIZE);
+        pool->handles[handle] = HANDLE_PACK(destination, index);
+        give_object(pool, source, i);
+        moved++;
+        pool->stats.moved++;
+      }
+
+      if (source->inuse == 0) {
+        unlist_zspage(class, source);
+        release_zspage(pool, source);
+        pool->stats.released++;
+      }
+    }
+
+    //The next call resumes at this class if the budget ran out in it
+    if (moved < budget) {
+      pool->compact_class = (uint16_t) ((pool->compact_class + 1) % ZPOOL_CLASSES);
+    }
+  }
+
+  return moved;
+
+} // zpool_compact ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+void zpool_get_stats (zpool_s* pool, zpool_stats_s* stats) {
+
+  *stats = pool->stats;
+  for (uint16_t c = 0; c < ZPOOL_CLASSES; c++) {
+    stats->zspage_bytes += pool->classes[c].zspages * pool->classes[c].pages * PAGE_SIZE;
+  }
+  stats->spare_bytes    = pool->spare_pages * PAGE_SIZE;
+  stats->metadata_bytes = pool->descriptors * sizeof(zpool_zspage_s) + pool->handle_capacity * sizeof(uint64_t);
+
+} // zpool_get_stats ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+bool zpool_needs_region (zpool_s* pool) {
+
+  return pool->next_region == NULL;
+
+} // zpool_needs_region ()
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+bool zpool_add_region (zpool_s* pool, void* region) {
+
+  if (pool->next_region != NULL) {
+    return false;
+  }
+  pool->next_region = region;
+  return true;
+
+} // zpool_add_region ()
+/* =============================================================================================================================== */
@@ -0,0 +1,203 @@
+/* =============================================================================================================================== */
+/**
+ * \file zpool.h
+ * \brief A pool of small objects of many sizes, packed by size class into runs of pages, for the compressed cache.
+ */
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#if !defined (_ZPOOL_H)
+#define _ZPOOL_H
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* INCLUDES */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* MACROS */
+
+/** The step between the sizes of the classes. */
+#define ZPOOL_CLASS_STEP 16
+
+/** The largest object that the pool holds. */
+#define ZPOOL_MAX_SIZE   4092
+
+/** The number of size classes: objects and their headers, up to a page. */
+#define ZPOOL_CLASSES    (4096 / ZPOOL_CLASS_STEP)
+
+/** The most pages in a zspage; as zsmalloc's default chain size, so that objects of about half a page waste little. */
+#define ZPOOL_MAX_PAGES  8
+
+/** The number of fullness groups of a class's zspages with free objects: one with `inuse` of its `objects` allocated is in group
+ *  `inuse * ZPOOL_FULLNESS / objects`. */
+#define ZPOOL_FULLNESS   8
+
+/** The pages of each region that zspages are carved from. */
+#define ZPOOL_REGION_PAGES 256
+
+/** The most pages of released zspages that the pool keeps, for the zspages to come; past them, their memory goes back to the
+ *  kernel. */
+#define ZPOOL_SPARE_PAGES  64
+
+/** Below `ZPOOL_SPARE_PAGES`, the pool keeps one page of released zspages for every `ZPOOL_SPARE_SHARE` pages of the zspages in
+ *  use (but a zspage's worth at least), so that a small pool does not keep more than it holds. */
+#define ZPOOL_SPARE_SHARE  32
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* TYPES */
+
+/** A handle to an object; 0 is no object.  The object may move (when the pool is compacted), but its handle does not. */
+typedef uint32_t zpool_handle_t;
+
+/**
+ * A zspage: a run of pages cut into the objects of one class.  Its free objects are linked through their own memory.  A zspage
+ * with free objects is in the list of its fullness group; a full one is in no list, and an empty one is released, its
+ * descriptor and pages kept for another zspage of as many pages.
+ */
+typedef struct zpool_zspage_struct {
+  struct zpool_zspage_struct* prev;
+  struct zpool_zspage_struct* next;
+  uint8_t*                    base;     // The first page.
+  uint16_t                    inuse;    // The number of objects allocated.
+  uint16_t                    free;     // The first free object, or ZSPAGE_NONE.
+  uint16_t                    class;    // The index of its class.
+  uint8_t                     fullness; // Its fullness group, or ZSPAGE_UNLISTED if it is in no list.
+  uint8_t                     pages;    // The number of its pages.
+} zpool_zspage_s;
+
+/** One size class. */
+typedef struct zpool_class_struct {
+  zpool_zspage_s* partial[ZPOOL_FULLNESS]; // The zspages with free objects, by fullness group, the most recently listed first.
+  uint32_t        groups;   // The fullness groups whose lists are not empty, a bit each.
+  uint32_t        size;     // The size of its objects, header included.
+  uint16_t        pages;    // The pages of each of its zspages.
+  uint16_t        objects;  // The objects of each of its zspages.
+  size_t          zspages;  // The number of its zspages.
+  size_t          inuse;    // The number of its objects allocated.
+} zpool_class_s;
+
+/** What the pool holds. */
+typedef struct zpool_stats_struct {
+  size_t objects;        // Objects allocated.
+  size_t object_bytes;   // Bytes asked for by them.
+  size_t zspage_bytes;   // Bytes of the zspages.
+  size_t spare_bytes;    // Bytes of the pages of released zspages that the pool keeps.
+  size_t metadata_bytes; // Bytes of the zspages' descriptors, kept ones included, and of the handle table.
+  size_t moved;          // Objects moved by compaction so far.
+  size_t released;       // Zspages released by compaction so far.
+} zpool_stats_s;
+
+/**
+ * The pool.  Handles index the handle table; an entry packs the zspage of the object (its descriptor's address, shifted) with the
+ * object's index in it, or, for a free handle, the next free handle.  Zspages are carved from regions, and released ones are
+ * kept, by their number of pages, with their pages (`spares`) or, past `ZPOOL_SPARE_PAGES`, with their memory given back to the
+ * kernel (`released`).  Nothing here is thread-safe: the caller serializes.
+ */
+typedef struct zpool_struct {
+  zpool_class_s   classes[ZPOOL_CLASSES];
+  uint16_t        merged[ZPOOL_CLASSES];  // The class that holds the objects of each size class (see `zpool_create()`).
+  uint64_t*       handles;
+  size_t          handle_capacity;
+  zpool_handle_t  free_handle;
+  zpool_zspage_s* spares[ZPOOL_MAX_PAGES];
+  zpool_zspage_s* released[ZPOOL_MAX_PAGES];
+  size_t          spare_pages;
+  size_t          zspage_pages;   // The pages of the zspages in use.
+  size_t          descriptors;    // The zspage descriptors allocated, kept ones included.
+  uint8_t*        region;         // The rest of the region being carved, and its pages.
+  size_t          region_pages;
+  uint8_t*        next_region;    // A region given ahead (see `zpool_add_region()`), for when this one runs out.
+  uint16_t        compact_class;  // The class at which compaction resumes.
+  zpool_stats_s   stats;
+} zpool_s;
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+/* FUNCTIONS */
+
+/**
+ * \brief  Create an empty pool.
+ * \param  pool The pool.
+ * \return Whether the pool could be created.
+ */
+bool zpool_create (zpool_s* pool);
+
+/**
+ * \brief  Allocate an object, in constant time (but for growing the handle table, by half), from the fullest zspage of
+ *         its class.  A new zspage is carved from the region, which the pool maps itself only when it was given no next one.
+ * \param  pool The pool.
+ * \param  size Its size; at most `ZPOOL_MAX_SIZE`.
+ * \return Its handle, or 0 if it could not be allocated.
+ */
+zpool_handle_t zpool_alloc (zpool_s* pool, size_t size);
+
+/**
+ * \brief  Free an object, in constant time; a zspage that it leaves empty is released.
+ * \param  pool   The pool.
+ * \param  handle Its handle.
+ * \param  size   The size it was allocated with.
+ */
+void zpool_free (zpool_s* pool, zpool_handle_t handle, size_t size);
+
+/**
+ * \brief  Find an object.
+ * \param  pool   The pool.
+ * \param  handle Its handle.
+ * \return Its address, which holds until the pool is next compacted.
+ */
+void* zpool_map (zpool_s* pool, zpool_handle_t handle);
+
+/**
+ * \brief  Compact the pool: in each class whose free objects would fill a zspage, move the objects of a zspage of its emptiest
+ *         fullness group into one of its fullest, and release the zspages emptied.  Each call resumes at the class where the
+ *         last one stopped, and finds each pair of zspages in constant time.
+ * \param  pool   The pool.
+ * \param  budget The most objects to move.
+ * \return The number of objects moved; less than `budget` once there is nothing left to gain.
+ */
+size_t zpool_compact (zpool_s* pool, size_t budget);
+
+/**
+ * \brief  Check whether the pool wants a region, to carve zspages from once its own runs out.
+ * \param  pool The pool.
+ * \return Whether it has no next region.
+ */
+bool zpool_needs_region (zpool_s* pool);
+
+/**
+ * \brief  Give the pool a region, mapped with `vmt_map_pages()` outside the caller's lock, so that allocations need not map one.
+ * \param  pool   The pool.
+ * \param  region The region, of `ZPOOL_REGION_PAGES` pages.
+ * \return Whether the pool took it; if not, the caller unmaps it.
+ */
+bool zpool_add_region (zpool_s* pool, void* region);
+
+/**
+ * \brief  Report what the pool holds.
+ * \param  pool  The pool.
+ * \param  stats Receives the report.
+ */
+void zpool_get_stats (zpool_s* pool, zpool_stats_s* stats);
+/* =============================================================================================================================== */
+
+
+
+/* =============================================================================================================================== */
+#endif /* _ZPOOL_H */
+/* =============================================================================================================================== */